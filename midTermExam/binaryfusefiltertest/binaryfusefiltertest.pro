@@ -0,0 +1,15 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+QMAKE_CFLAGS += -std=c11
+INCLUDEPATH += ../cdatastructures
+
+SOURCES += \
+        main.c \
+        ../cdatastructures/dsallocator.c \
+        ../cdatastructures/dsbinaryfusefilter.c \
+        ../cdatastructures/dshashint.c
+
+unix: LIBS += -lm
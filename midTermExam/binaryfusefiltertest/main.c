@@ -0,0 +1,349 @@
+/* Test of BinaryFuseFilter.
+ *
+ * Usage: binaryfusefiltertest [maxValues [seed]]
+ *
+ * Filters with 8 and 16 bit fingerprints are built from sets of many
+ * sizes, up to maxValues.  The arrays they are built from hold repeated
+ * values, both the same value more than once and equal values at
+ * different addresses, which must be stored once.  Every value must be
+ * found, and the false positive rate for values not in the set must be
+ * close to that expected for the fingerprint size.
+ *
+ * Each filter is written to an array and created again from it.  The
+ * new filter must give the same answer as the old one for every value
+ * tried, and must write the same bytes.  Arrays which are cut short,
+ * too long, or have a damaged header must be refused.  The memory a
+ * filter reports must match what its allocator handed out, and nothing
+ * allocated while building it may be left over. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsbinaryfusefilter.h"
+#include "dshashint.h"
+
+/* Number of values not in the set queried to measure the false
+ * positive rate */
+
+#define NUM_PROBES 1000000
+
+static unsigned int maxValues = 1000000;
+static uint64_t randomState = 1;
+
+static unsigned int *numbers;
+static BloomFilterValue *values;
+static unsigned int probe;
+
+static size_t allocatedBytes;
+
+static uint64_t nextRandom(void)
+{
+    /* xorshift64* */
+
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static void *countingAllocate(void *context, size_t size)
+{
+    void *block = malloc(size);
+
+    (void) context;
+
+    if (block != NULL) {
+        allocatedBytes += size;
+    }
+
+    return block;
+}
+
+static void countingRelease(void *context, void *block, size_t size)
+{
+    (void) context;
+
+    allocatedBytes -= size;
+    free(block);
+}
+
+static const Allocator countingAllocator = {
+    countingAllocate, NULL, countingRelease, NULL, NULL
+};
+
+/* Numbers in the set are even, so any odd number is not in it */
+
+static void makeValues(unsigned int numValues, unsigned int numDistinct)
+{
+    unsigned int i;
+
+    for (i=0; i<numDistinct; ++i) {
+        numbers[i] = (unsigned int) (nextRandom() >> 32) & ~1U;
+        values[i] = &numbers[i];
+    }
+
+    /* The rest repeat earlier values, either the same pointer or a
+     * copy of the number in a new place */
+
+    for (; i<numValues; ++i) {
+        if (nextRandom() & 1) {
+            values[i] = values[(nextRandom() >> 32) % numDistinct];
+        } else {
+            numbers[i] = *(unsigned int *) values[(nextRandom() >> 32)
+                                                  % numDistinct];
+            values[i] = &numbers[i];
+        }
+    }
+
+    /* Shuffle, so that repeats are not all at the end */
+
+    for (i=numValues; i>1; --i) {
+        unsigned int j = (unsigned int) ((nextRandom() >> 32) % i);
+        BloomFilterValue swap = values[i - 1];
+
+        values[i - 1] = values[j];
+        values[j] = swap;
+    }
+}
+
+/* Arrays which do not hold a whole, valid filter must be refused */
+
+static int checkDamaged(unsigned char *array, size_t length)
+{
+    unsigned char *copy = malloc(length + 1);
+    int success = 1;
+    size_t i;
+
+    if (copy == NULL) {
+        return 0;
+    }
+
+    memcpy(copy, array, length);
+    copy[length] = 0;
+
+    success &= binaryfusefilter_newFromArray(copy, length - 1, intHashMix,
+                                             NULL) == NULL;
+    success &= binaryfusefilter_newFromArray(copy, length + 1, intHashMix,
+                                             NULL) == NULL;
+    success &= binaryfusefilter_newFromArray(copy, 0, intHashMix,
+                                             NULL) == NULL;
+
+    /* The magic number, the fingerprint size, and the segment length
+     * and count, each damaged in turn */
+
+    for (i=0; i<24; ++i) {
+        if (i >= 8 && i < 16) {
+            continue;
+        }
+
+        copy[i] ^= 0x40;
+        success &= binaryfusefilter_newFromArray(copy, length, intHashMix,
+                                                 NULL) == NULL;
+        copy[i] ^= 0x40;
+    }
+
+    free(copy);
+
+    return success;
+}
+
+static int runTest(unsigned int numValues, unsigned int numDistinct,
+                   unsigned int fingerprintBits)
+{
+    BinaryFuseFilter *filter;
+    BinaryFuseFilter *loaded;
+    unsigned char *array;
+    unsigned char *rewritten;
+    unsigned int falsePositives = 0;
+    unsigned int number;
+    unsigned int i;
+    size_t arraySize;
+    double rate;
+    double limit;
+    int success = 1;
+
+    makeValues(numValues, numDistinct);
+
+    filter = binaryfusefilter_newWithAllocator(values, numValues, intHashMix,
+                                               fingerprintBits,
+                                               &countingAllocator);
+
+    if (filter == NULL) {
+        fprintf(stderr, "%u values: the filter was not built\n", numValues);
+
+        return 0;
+    }
+
+    if (binaryfusefilter_memoryUsage(filter) != allocatedBytes) {
+        fprintf(stderr, "%u values: memory used while building was not "
+                        "all freed\n", numValues);
+        success = 0;
+    }
+
+    for (i=0; i<numValues; ++i) {
+        if (!binaryfusefilter_query(filter, values[i])) {
+            fprintf(stderr, "%u values: value %u was not found\n",
+                    numValues, *(unsigned int *) values[i]);
+            success = 0;
+            break;
+        }
+    }
+
+    /* Write the filter and load it again */
+
+    arraySize = binaryfusefilter_arraySize(filter);
+    array = malloc(arraySize);
+    rewritten = malloc(arraySize);
+
+    if (array == NULL || rewritten == NULL) {
+        fprintf(stderr, "out of memory\n");
+
+        return 0;
+    }
+
+    binaryfusefilter_write(filter, array);
+    loaded = binaryfusefilter_newFromArray(array, arraySize, intHashMix,
+                                           NULL);
+
+    if (loaded == NULL) {
+        fprintf(stderr, "%u values: the written filter was refused\n",
+                numValues);
+
+        return 0;
+    }
+
+    binaryfusefilter_write(loaded, rewritten);
+
+    if (memcmp(array, rewritten, arraySize) != 0) {
+        fprintf(stderr, "%u values: the loaded filter writes different "
+                        "bytes\n", numValues);
+        success = 0;
+    }
+
+    for (i=0; i<numValues; ++i) {
+        if (!binaryfusefilter_query(loaded, values[i])) {
+            fprintf(stderr, "%u values: value %u was not found after "
+                            "loading\n",
+                    numValues, *(unsigned int *) values[i]);
+            success = 0;
+            break;
+        }
+    }
+
+    /* Odd numbers are not in the set */
+
+    for (i=0; i<NUM_PROBES; ++i) {
+        number = (probe++ << 1) | 1;
+
+        if (binaryfusefilter_query(filter, &number)) {
+            ++falsePositives;
+        }
+
+        if (binaryfusefilter_query(loaded, &number)
+         != binaryfusefilter_query(filter, &number)) {
+            fprintf(stderr, "%u values: the loaded filter gives a different "
+                            "answer for %u\n", numValues, number);
+            success = 0;
+            break;
+        }
+    }
+
+    /* Allow twice the expected rate, plus some slack for small sets */
+
+    rate = (double) falsePositives / NUM_PROBES;
+    limit = 2.0 / (1 << fingerprintBits) + 0.0001;
+
+    if (rate > limit) {
+        fprintf(stderr, "%u values: false positive rate %f is above %f\n",
+                numValues, rate, limit);
+        success = 0;
+    }
+
+    if (!checkDamaged(array, arraySize)) {
+        fprintf(stderr, "%u values: a damaged array was accepted\n",
+                numValues);
+        success = 0;
+    }
+
+    printf("%2u bits, %7u values, %7u distinct: %5.2f bits per value, "
+           "%.6f false positives: %s\n",
+           fingerprintBits, numValues, numDistinct,
+           8.0 * (double) arraySize / numValues,
+           rate, success ? "ok" : "FAILED");
+
+    binaryfusefilter_free(loaded);
+    binaryfusefilter_free(filter);
+    free(array);
+    free(rewritten);
+
+    if (allocatedBytes != 0) {
+        fprintf(stderr, "%u values: memory was not freed\n", numValues);
+        allocatedBytes = 0;
+        success = 0;
+    }
+
+    return success;
+}
+
+int main(int argc, char *argv[])
+{
+    static const unsigned int fingerprintSizes[] = { 8, 16 };
+    unsigned int numValues;
+    unsigned int i;
+    int success = 1;
+
+    if (argc > 1) {
+        maxValues = (unsigned int) atoi(argv[1]);
+    }
+
+    if (argc > 2) {
+        randomState = (uint64_t) atoi(argv[2]);
+    }
+
+    if (maxValues < 1 || maxValues > 100000000) {
+        fprintf(stderr, "maxValues must be from 1 to 100000000\n");
+
+        return 1;
+    }
+
+    if (randomState == 0) {
+        fprintf(stderr, "seed must not be zero\n");
+
+        return 1;
+    }
+
+    numbers = malloc(maxValues * sizeof(unsigned int));
+    values = malloc(maxValues * sizeof(BloomFilterValue));
+
+    if (numbers == NULL || values == NULL) {
+        fprintf(stderr, "out of memory\n");
+
+        return 1;
+    }
+
+    for (i=0; i<sizeof(fingerprintSizes) / sizeof(*fingerprintSizes); ++i) {
+
+        /* Tiny sets, and one value repeated many times */
+
+        success &= runTest(1, 1, fingerprintSizes[i]);
+        success &= runTest(2, 2, fingerprintSizes[i]);
+        success &= runTest(3, 1, fingerprintSizes[i]);
+        success &= runTest(maxValues < 1000 ? maxValues : 1000, 1,
+                           fingerprintSizes[i]);
+
+        /* Growing sets, a quarter of them repeats */
+
+        for (numValues=10; numValues<=maxValues; numValues*=10) {
+            success &= runTest(numValues, numValues - numValues / 4,
+                               fingerprintSizes[i]);
+        }
+    }
+
+    free(numbers);
+    free(values);
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+/* Test of bloomfilter_insertConcurrent.
+ *
+ * Usage: bloomfiltertest [numThreads [numValues]]
+ *
+ * Several threads insert disjoint sets of values into one filter at
+ * once.  Every value must then be found by bloomfilter_query, and the
+ * table must be identical, bit for bit, to that of a filter built from
+ * the same values by one thread with bloomfilter_insert.  This is done
+ * for both layouts and a few numbers of hash functions. */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsbloomfilter.h"
+#include "dshashint.h"
+
+static unsigned int *values;
+static unsigned int numValues = 1000000;
+static unsigned int numThreads = 8;
+
+static BloomFilter *sharedFilter;
+
+/* Each thread inserts every numThreads'th value, starting from its own
+ * index, so that no value is inserted twice */
+
+static void *insertWorker(void *arg)
+{
+    unsigned int i;
+
+    for (i=(unsigned int) (size_t) arg; i<numValues; i+=numThreads) {
+        bloomfilter_insertConcurrent(sharedFilter, &values[i]);
+    }
+
+    return NULL;
+}
+
+static int runTest(BloomFilterLayout layout, unsigned int numFunctions)
+{
+    pthread_t threads[256];
+    unsigned int tableSize = numValues * 10;
+    size_t tableBytes;
+    BloomFilter *serialFilter;
+    unsigned char *serialTable;
+    unsigned char *sharedTable;
+    unsigned int i;
+    int success = 1;
+
+    serialFilter = bloomfilter_newWithLayout(tableSize, intHashMix,
+                                             numFunctions, layout);
+    sharedFilter = bloomfilter_newWithLayout(tableSize, intHashMix,
+                                             numFunctions, layout);
+
+    if (layout == BLOOM_FILTER_LAYOUT_BLOCKED) {
+        tableSize = (tableSize + 511) / 512 * 512;
+    }
+
+    tableBytes = (tableSize + 7) / 8;
+    serialTable = malloc(tableBytes);
+    sharedTable = malloc(tableBytes);
+
+    if (serialFilter == NULL || sharedFilter == NULL
+     || serialTable == NULL || sharedTable == NULL) {
+        fprintf(stderr, "out of memory\n");
+
+        return 0;
+    }
+
+    for (i=0; i<numValues; ++i) {
+        bloomfilter_insert(serialFilter, &values[i]);
+    }
+
+    for (i=0; i<numThreads; ++i) {
+        pthread_create(&threads[i], NULL, insertWorker, (void *) (size_t) i);
+    }
+
+    for (i=0; i<numThreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (i=0; i<numValues; ++i) {
+        if (!bloomfilter_query(sharedFilter, &values[i])) {
+            fprintf(stderr, "value %u was not found\n", values[i]);
+            success = 0;
+            break;
+        }
+    }
+
+    bloomfilter_read(serialFilter, serialTable);
+    bloomfilter_read(sharedFilter, sharedTable);
+
+    if (memcmp(serialTable, sharedTable, tableBytes) != 0) {
+        fprintf(stderr, "table differs from the serial build\n");
+        success = 0;
+    }
+
+    printf("%-8s layout, %2u functions: %s\n",
+           layout == BLOOM_FILTER_LAYOUT_BLOCKED ? "blocked" : "standard",
+           numFunctions, success ? "ok" : "FAILED");
+
+    bloomfilter_free(serialFilter);
+    bloomfilter_free(sharedFilter);
+    free(serialTable);
+    free(sharedTable);
+
+    return success;
+}
+
+int main(int argc, char *argv[])
+{
+    static const unsigned int functionCounts[] = { 1, 7, 16 };
+    unsigned int i;
+    int success = 1;
+
+    if (argc > 1) {
+        numThreads = (unsigned int) atoi(argv[1]);
+    }
+
+    if (argc > 2) {
+        numValues = (unsigned int) atoi(argv[2]);
+    }
+
+    if (numThreads < 1 || numThreads > 256) {
+        fprintf(stderr, "numThreads must be from 1 to 256\n");
+
+        return 1;
+    }
+
+    if (numValues < 1 || numValues > 100000000) {
+        fprintf(stderr, "numValues must be from 1 to 100000000\n");
+
+        return 1;
+    }
+
+    values = malloc(numValues * sizeof(unsigned int));
+
+    if (values == NULL) {
+        fprintf(stderr, "out of memory\n");
+
+        return 1;
+    }
+
+    for (i=0; i<numValues; ++i) {
+        values[i] = i;
+    }
+
+    printf("%u threads, %u values\n", numThreads, numValues);
+
+    for (i=0; i<sizeof(functionCounts) / sizeof(*functionCounts); ++i) {
+        success &= runTest(BLOOM_FILTER_LAYOUT_STANDARD, functionCounts[i]);
+        success &= runTest(BLOOM_FILTER_LAYOUT_BLOCKED, functionCounts[i]);
+    }
+
+    free(values);
+
+    return success ? 0 : 1;
+}
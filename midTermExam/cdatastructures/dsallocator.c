@@ -0,0 +1,165 @@
+/* Memory allocator hooks */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsallocator.h"
+
+
+/* The allocator used when none has been set: the C library functions */
+
+static void *allocator_systemAllocate(void *context, size_t size)
+{
+    (void) context;
+
+    return malloc(size);
+}
+
+static void *allocator_systemAllocateZeroed(void *context, size_t size)
+{
+    (void) context;
+
+    return calloc(1, size);
+}
+
+static void *allocator_systemReallocate(void *context,
+                                        void *block,
+                                        size_t oldSize,
+                                        size_t newSize)
+{
+    (void) context;
+    (void) oldSize;
+
+    return realloc(block, newSize);
+}
+
+static void allocator_systemRelease(void *context, void *block, size_t size)
+{
+    (void) context;
+    (void) size;
+
+    free(block);
+}
+
+static const Allocator ALLOCATOR_SYSTEM = {
+    allocator_systemAllocate,
+    allocator_systemReallocate,
+    allocator_systemRelease,
+    NULL,
+    allocator_systemAllocateZeroed
+};
+
+static const Allocator *allocator_current = &ALLOCATOR_SYSTEM;
+
+void allocator_setDefault(const Allocator *allocator)
+{
+    if (allocator == NULL) {
+        allocator = &ALLOCATOR_SYSTEM;
+    }
+
+    allocator_current = allocator;
+}
+
+const Allocator *allocator_default(void)
+{
+    return allocator_current;
+}
+
+void allocator_initUsage(AllocatorUsage *usage, const Allocator *allocator)
+{
+    if (allocator == NULL) {
+        allocator = allocator_current;
+    }
+
+    usage->allocator = allocator;
+    usage->bytesUsed = 0;
+}
+
+void *allocator_malloc(AllocatorUsage *usage, size_t size)
+{
+    const Allocator *allocator = usage->allocator;
+    void *block = allocator->allocate(allocator->context, size);
+
+    if (block != NULL) {
+        usage->bytesUsed += size;
+    }
+
+    return block;
+}
+
+void *allocator_calloc(AllocatorUsage *usage, size_t count, size_t size)
+{
+    /* Check for overflow of the total size */
+
+    if (size != 0 && count > (size_t) -1 / size) {
+        return NULL;
+    }
+
+    const Allocator *allocator = usage->allocator;
+    void *block;
+
+    if (allocator->allocateZeroed == NULL) {
+        block = allocator_malloc(usage, count * size);
+
+        if (block != NULL) {
+            memset(block, 0, count * size);
+        }
+
+        return block;
+    }
+
+    block = allocator->allocateZeroed(allocator->context, count * size);
+
+    if (block != NULL) {
+        usage->bytesUsed += count * size;
+    }
+
+    return block;
+}
+
+void *allocator_realloc(AllocatorUsage *usage,
+                        void *block,
+                        size_t oldSize,
+                        size_t newSize)
+{
+    const Allocator *allocator = usage->allocator;
+    void *newBlock;
+
+    if (block == NULL) {
+        return allocator_malloc(usage, newSize);
+    }
+
+    if (allocator->reallocate != NULL) {
+        newBlock = allocator->reallocate(allocator->context, block,
+                                         oldSize, newSize);
+    } else {
+
+        /* No reallocate function: move the contents to a new block */
+
+        newBlock = allocator->allocate(allocator->context, newSize);
+
+        if (newBlock != NULL) {
+            memcpy(newBlock, block, oldSize < newSize ? oldSize : newSize);
+            allocator->release(allocator->context, block, oldSize);
+        }
+    }
+
+    if (newBlock != NULL) {
+        usage->bytesUsed += newSize;
+        usage->bytesUsed -= oldSize;
+    }
+
+    return newBlock;
+}
+
+void allocator_free(AllocatorUsage *usage, void *block, size_t size)
+{
+    const Allocator *allocator = usage->allocator;
+
+    if (block == NULL) {
+        return;
+    }
+
+    allocator->release(allocator->context, block, size);
+    usage->bytesUsed -= size;
+}
@@ -0,0 +1,232 @@
+/**
+ * @file dsallocator.h
+ *
+ * @brief Memory allocator hooks.
+ *
+ * Every data structure in the library allocates its memory through an
+ * @ref Allocator, a small table of functions standing in for malloc,
+ * calloc, realloc and free.  By default these call the C library
+ * functions.
+ *
+ * To route allocations made by structures created from then on to a
+ * different allocator, use @ref allocator_setDefault.  Most structures
+ * can also be given their own allocator when they are created, with a
+ * constructor named after the structure followed by "_newWithAllocator"
+ * (for example @ref hashtable_newWithAllocator).
+ *
+ * The release and reallocate functions are always told the size of the
+ * block, so an allocator does not need to record it.  Each structure
+ * keeps count of the bytes it has allocated, which can be read with its
+ * "_memoryUsage" function (for example @ref hashtable_memoryUsage).
+ *
+ * Arrays returned to the caller, such as those from @ref set_toArray,
+ * are still allocated with malloc, as the caller frees them with free.
+ */
+
+#ifndef DSALLOCATOR_H
+#define DSALLOCATOR_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Function used to allocate a block of memory.
+ *
+ * @param context        The context pointer of the allocator.
+ * @param size           Size of the block in bytes.
+ * @return               The new block, or NULL if it could not be
+ *                       allocated.
+ */
+
+typedef void *(*AllocatorAllocateFunc)(void *context, size_t size);
+
+/**
+ * Function used to allocate a block of memory initialised to zero.
+ * An allocator which can obtain memory that is already zero (as calloc
+ * can from fresh pages) avoids writing to every byte of a large block
+ * before it is used.
+ *
+ * @param context        The context pointer of the allocator.
+ * @param size           Size of the block in bytes.
+ * @return               The new block, or NULL if it could not be
+ *                       allocated.
+ */
+
+typedef void *(*AllocatorAllocateZeroedFunc)(void *context, size_t size);
+
+/**
+ * Function used to change the size of a block of memory, keeping its
+ * contents.
+ *
+ * @param context        The context pointer of the allocator.
+ * @param block          The block, as returned by the allocate function.
+ * @param oldSize        Current size of the block in bytes.
+ * @param newSize        New size of the block in bytes.
+ * @return               The resized block, or NULL if it could not be
+ *                       resized, in which case the old block is left
+ *                       untouched.
+ */
+
+typedef void *(*AllocatorReallocateFunc)(void *context,
+                                         void *block,
+                                         size_t oldSize,
+                                         size_t newSize);
+
+/**
+ * Function used to free a block of memory.
+ *
+ * @param context        The context pointer of the allocator.
+ * @param block          The block to free.  This is never NULL.
+ * @param size           Size of the block in bytes.
+ */
+
+typedef void (*AllocatorReleaseFunc)(void *context, void *block, size_t size);
+
+/**
+ * A memory allocator.
+ */
+
+typedef struct _Allocator Allocator;
+
+/**
+ * Definition of an @ref Allocator.
+ */
+
+struct _Allocator {
+
+	/** Function used to allocate memory. */
+
+	AllocatorAllocateFunc allocate;
+
+	/** Function used to resize memory.  If NULL, blocks are resized
+	 *  by allocating a new block and copying the contents. */
+
+	AllocatorReallocateFunc reallocate;
+
+	/** Function used to free memory. */
+
+	AllocatorReleaseFunc release;
+
+	/** Pointer passed to each of the functions. */
+
+	void *context;
+
+	/** Function used to allocate memory initialised to zero.  If NULL,
+	 *  blocks are allocated with the allocate function and cleared. */
+
+	AllocatorAllocateZeroedFunc allocateZeroed;
+};
+
+/**
+ * Record of the memory allocated by a data structure.  This is used
+ * internally by the data structures in the library.
+ */
+
+typedef struct _AllocatorUsage {
+
+	/** The allocator used. */
+
+	const Allocator *allocator;
+
+	/** Number of bytes currently allocated. */
+
+	size_t bytesUsed;
+} AllocatorUsage;
+
+/**
+ * Set the allocator used by data structures created from now on,
+ * unless they are given their own.  The allocator must remain valid
+ * until every structure using it has been destroyed.  Structures
+ * created before the call keep using the allocator they were created
+ * with.  This is not thread safe, and is best done once at start up.
+ *
+ * Lists (@ref ListEntry and @ref SListEntry) have no structure of their
+ * own to remember an allocator in, so their entries always come from
+ * the current default.  The default must not be changed while such
+ * lists exist, unless their entries are allocated from a @ref Slab.
+ *
+ * @param allocator      The new default allocator, or NULL to go back
+ *                       to the C library functions.
+ */
+
+void allocator_setDefault(const Allocator *allocator);
+
+/**
+ * Retrieve the current default allocator.
+ *
+ * @return               The allocator set with @ref allocator_setDefault,
+ *                       or the allocator which calls the C library
+ *                       functions if none has been set.
+ */
+
+const Allocator *allocator_default(void);
+
+/**
+ * Initialise an @ref AllocatorUsage structure, with no bytes allocated.
+ *
+ * @param usage          The structure to initialise.
+ * @param allocator      The allocator to use, or NULL to use the current
+ *                       default allocator.
+ */
+
+void allocator_initUsage(AllocatorUsage *usage, const Allocator *allocator);
+
+/**
+ * Allocate a block of memory.
+ *
+ * @param usage          The allocator and byte count to use.
+ * @param size           Size of the block in bytes.
+ * @return               The new block, or NULL if it could not be
+ *                       allocated.
+ */
+
+void *allocator_malloc(AllocatorUsage *usage, size_t size);
+
+/**
+ * Allocate a block of memory, initialised to zero.
+ *
+ * @param usage          The allocator and byte count to use.
+ * @param count          Number of elements in the block.
+ * @param size           Size of each element in bytes.
+ * @return               The new block, or NULL if it could not be
+ *                       allocated.
+ */
+
+void *allocator_calloc(AllocatorUsage *usage, size_t count, size_t size);
+
+/**
+ * Change the size of a block of memory, keeping its contents.
+ *
+ * @param usage          The allocator and byte count to use.
+ * @param block          The block to resize, or NULL to allocate a new
+ *                       block.
+ * @param oldSize        Current size of the block in bytes.
+ * @param newSize        New size of the block in bytes.
+ * @return               The resized block, or NULL if it could not be
+ *                       resized, in which case the old block is left
+ *                       untouched.
+ */
+
+void *allocator_realloc(AllocatorUsage *usage,
+                        void *block,
+                        size_t oldSize,
+                        size_t newSize);
+
+/**
+ * Free a block of memory.
+ *
+ * @param usage          The allocator and byte count to use.
+ * @param block          The block to free.  If NULL, nothing is done.
+ * @param size           Size of the block in bytes.
+ */
+
+void allocator_free(AllocatorUsage *usage, void *block, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSALLOCATOR_H */
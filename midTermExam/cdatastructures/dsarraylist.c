@@ -8,6 +8,14 @@
 
 ArrayList *arraylist_new(unsigned int length)
 {
+    return arraylist_newWithAllocator(length, NULL);
+}
+
+ArrayList *arraylist_newWithAllocator(unsigned int length,
+                                      const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
 	/* If the length is not specified, use a sensible default */
 
 	if (length <= 0) {
@@ -17,21 +25,27 @@ ArrayList *arraylist_new(unsigned int length)
 	/* Allocate the new ArrayList and fill in the fields.  There are
 	 * initially no entries. */
 
-    ArrayList *newArraylist = (ArrayList *) malloc(sizeof(ArrayList));
+    allocator_initUsage(&usage, allocator);
+
+    ArrayList *newArraylist
+        = (ArrayList *) allocator_malloc(&usage, sizeof(ArrayList));
 
     if (newArraylist == NULL) {
 		return NULL;
 	}
 
+    newArraylist->_usage = usage;
+
     newArraylist->_alloced = length;
     newArraylist->length = 0;
 
 	/* Allocate the data array */
 
-    newArraylist->data = malloc(length * sizeof(ArrayListValue));
+    newArraylist->data = allocator_malloc(&newArraylist->_usage,
+                                          length * sizeof(ArrayListValue));
 
     if (newArraylist->data == NULL) {
-        free(newArraylist);
+        allocator_free(&newArraylist->_usage, newArraylist, sizeof(ArrayList));
 		return NULL;
 	}
 
@@ -43,11 +57,19 @@ void arraylist_free(ArrayList *arraylist)
 	/* Do not free if a NULL pointer is passed */
 
 	if (arraylist != NULL) {
-		free(arraylist->data);
-		free(arraylist);
+        AllocatorUsage usage = arraylist->_usage;
+
+        allocator_free(&usage, arraylist->data,
+                       arraylist->_alloced * sizeof(ArrayListValue));
+        allocator_free(&usage, arraylist, sizeof(ArrayList));
 	}
 }
 
+size_t arraylist_memoryUsage(ArrayList *arraylist)
+{
+    return arraylist->_usage.bytesUsed;
+}
+
 static int arraylist_enlarge(ArrayList *arraylist)
 {
 	/* Double the allocated size */
@@ -56,7 +78,11 @@ static int arraylist_enlarge(ArrayList *arraylist)
 
 	/* Reallocate the array to the new size */
 
-    ArrayListValue *data = realloc(arraylist->data, sizeof(ArrayListValue) * newSize);
+    ArrayListValue *data = allocator_realloc(&arraylist->_usage,
+                                             arraylist->data,
+                                             sizeof(ArrayListValue)
+                                             * arraylist->_alloced,
+                                             sizeof(ArrayListValue) * newSize);
 
 	if (data == NULL) {
 		return 0;
@@ -19,6 +19,8 @@
 #ifndef DSARRAYLIST_H
 #define DSARRAYLIST_H
 
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -55,6 +57,10 @@ struct _ArrayList {
 	/** Private data and should not be accessed */
 
 	unsigned int _alloced;
+
+	/** Private data and should not be accessed */
+
+	AllocatorUsage _usage;
 };
 
 /**
@@ -95,6 +101,24 @@ typedef int (*ArrayListCompareFunc)(ArrayListValue value1,
 
 ArrayList *arraylist_new(unsigned int length);
 
+/**
+ * Allocate a new ArrayList which takes its memory from a particular
+ * allocator.
+ *
+ * @param length         Hint to the initialise function as to the amount
+ *                       of memory to allocate initially to the ArrayList.
+ *                       If a value of zero is given, a sensible default
+ *                       size is used.
+ * @param allocator      The allocator to use, or NULL to use the default
+ *                       allocator.
+ * @return               A new arraylist, or NULL if it was not possible
+ *                       to allocate the memory.
+ * @see arraylist_free
+ */
+
+ArrayList *arraylist_newWithAllocator(unsigned int length,
+                                      const Allocator *allocator);
+
 /**
  * Destroy an ArrayList and free back the memory it uses.
  *
@@ -103,6 +127,15 @@ ArrayList *arraylist_new(unsigned int length);
 
 void arraylist_free(ArrayList *arraylist);
 
+/**
+ * Retrieve the number of bytes of memory allocated by an ArrayList.
+ *
+ * @param arraylist      The ArrayList.
+ * @return               The number of bytes allocated.
+ */
+
+size_t arraylist_memoryUsage(ArrayList *arraylist);
+
 /**
  * Append a value to the end of an ArrayList.
  *
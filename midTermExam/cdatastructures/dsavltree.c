@@ -1,6 +1,7 @@
 #include <stdlib.h>
 
 #include "dsavltree.h"
+#include "dsslab.h"
 
 
 /* AVL Tree (balanced binary search tree) */
@@ -14,26 +15,57 @@ struct _AVLTreeNode {
 };
 
 struct _AVLTree {
+    AllocatorUsage usage;
     AVLTreeNode *rootNode;
     AVLTreeCompareFunc compareFunc;
     unsigned int numNodes;
+    Slab *slab;
 };
 
 AVLTree *avltree_new(AVLTreeCompareFunc compareFunc)
 {
-    AVLTree *newTree = (AVLTree *) malloc(sizeof(AVLTree));
+    return avltree_newWithAllocator(compareFunc, NULL);
+}
+
+AVLTree *avltree_newWithAllocator(AVLTreeCompareFunc compareFunc,
+                                  const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
+    allocator_initUsage(&usage, allocator);
+
+    AVLTree *newTree = (AVLTree *) allocator_malloc(&usage, sizeof(AVLTree));
 
     if (newTree == NULL) {
 		return NULL;
 	}
 
+    newTree->usage = usage;
+
     newTree->rootNode = NULL;
     newTree->compareFunc = compareFunc;
     newTree->numNodes = 0;
+    newTree->slab = NULL;
 
     return newTree;
 }
 
+int avltree_useSlab(AVLTree *tree)
+{
+    if (tree->slab != NULL) {
+        return 1;
+    }
+
+    if (tree->numNodes != 0) {
+        return 0;
+    }
+
+    tree->slab = slab_newWithAllocator(sizeof(AVLTreeNode),
+                                       tree->usage.allocator);
+
+    return tree->slab != NULL;
+}
+
 static void avltree_freeSubtree(AVLTree *tree, AVLTreeNode *node)
 {
 	if (node == NULL) {
@@ -43,18 +75,25 @@ static void avltree_freeSubtree(AVLTree *tree, AVLTreeNode *node)
     avltree_freeSubtree(tree, node->children[AVL_TREE_NODE_LEFT]);
     avltree_freeSubtree(tree, node->children[AVL_TREE_NODE_RIGHT]);
 
-	free(node);
+    allocator_free(&tree->usage, node, sizeof(AVLTreeNode));
 }
 
 void avltree_free(AVLTree *tree)
 {
-	/* Destroy all nodes */
+	/* Destroy all nodes.  Nodes allocated from a slab are freed
+	 * along with it, without walking the tree. */
 
-    avltree_freeSubtree(tree, tree->rootNode);
+    if (tree->slab != NULL) {
+        slab_free(tree->slab);
+    } else {
+        avltree_freeSubtree(tree, tree->rootNode);
+    }
 
 	/* Free back the main tree data structure */
 
-	free(tree);
+    AllocatorUsage usage = tree->usage;
+
+    allocator_free(&usage, tree, sizeof(AVLTree));
 }
 
 int avltree_subtreeHeight(AVLTreeNode *node)
@@ -282,7 +321,14 @@ AVLTreeNode *avltree_insert(AVLTree *tree, AVLTreeKey key, AVLTreeValue value)
 
 	/* Create a new node.  Use the last node visited as the parent link. */
 
-    AVLTreeNode *newNode = (AVLTreeNode *) malloc(sizeof(AVLTreeNode));
+    AVLTreeNode *newNode;
+
+    if (tree->slab != NULL) {
+        newNode = (AVLTreeNode *) slab_allocate(tree->slab);
+    } else {
+        newNode = (AVLTreeNode *) allocator_malloc(&tree->usage,
+                                                   sizeof(AVLTreeNode));
+    }
 
     if (newNode == NULL) {
 		return NULL;
@@ -416,7 +462,11 @@ void avltree_removeNode(AVLTree *tree, AVLTreeNode *node)
 
 	/* Destroy the node */
 
-	free(node);
+    if (tree->slab != NULL) {
+        slab_release(tree->slab, node);
+    } else {
+        allocator_free(&tree->usage, node, sizeof(AVLTreeNode));
+    }
 
 	/* Keep track of the number of nodes */
 
@@ -525,6 +575,17 @@ unsigned int avltree_numEntries(AVLTree *tree)
     return tree->numNodes;
 }
 
+size_t avltree_memoryUsage(AVLTree *tree)
+{
+    size_t result = tree->usage.bytesUsed;
+
+    if (tree->slab != NULL) {
+        result += slab_memoryUsage(tree->slab);
+    }
+
+    return result;
+}
+
 static void avltree_toArrayAddSubtree(AVLTreeNode *subtree,
                                       AVLTreeValue *array,
                                       int *index)
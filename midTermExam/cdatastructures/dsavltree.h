@@ -34,6 +34,8 @@
 #ifndef DSAVLTREE_H
 #define DSAVLTREE_H
 
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -108,6 +110,33 @@ typedef int (*AVLTreeCompareFunc)(AVLTreeValue value1, AVLTreeValue value2);
 
 AVLTree *avltree_new(AVLTreeCompareFunc compareFunc);
 
+/**
+ * Create a new AVL tree which allocates its memory from a particular
+ * allocator.
+ *
+ * @param compareFunc     Function to use when comparing keys in the tree.
+ * @param allocator       The allocator to use, or NULL to use the default
+ *                        allocator.
+ * @return                A new AVL tree, or NULL if it was not possible
+ *                        to allocate the memory.
+ */
+
+AVLTree *avltree_newWithAllocator(AVLTreeCompareFunc compareFunc,
+                                  const Allocator *allocator);
+
+/**
+ * Allocate the nodes of an AVL tree from a @ref Slab owned by the
+ * tree, instead of with malloc.  Inserting and removing become cheaper,
+ * and @ref avltree_free releases all nodes at once without walking the
+ * tree.  This must be called while the tree is empty.
+ *
+ * @param tree            The tree.
+ * @return                Non-zero on success, or zero if the tree is not
+ *                        empty or the slab could not be allocated.
+ */
+
+int avltree_useSlab(AVLTree *tree);
+
 /**
  * Destroy an AVL tree.
  *
@@ -260,6 +289,16 @@ AVLTreeValue *avltree_toArray(AVLTree *tree);
 
 unsigned int avltree_numEntries(AVLTree *tree);
 
+/**
+ * Retrieve the number of bytes of memory allocated by an AVL tree.  This
+ * does not include memory used by the keys and values themselves.
+ *
+ * @param tree            The tree.
+ * @return                The number of bytes allocated.
+ */
+
+size_t avltree_memoryUsage(AVLTree *tree);
+
 #ifdef __cplusplus
 }
 #endif
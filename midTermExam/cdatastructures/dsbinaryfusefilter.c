@@ -0,0 +1,674 @@
+/* Binary fuse filter
+ *
+ * See "Binary Fuse Filters: Fast and Smaller Than Xor Filters", Graf
+ * and Lemire, ACM Journal of Experimental Algorithmics, 2022.
+ *
+ * Each value maps to three entries of the table, one in each of three
+ * consecutive segments.  The table is filled so that the XOR of the
+ * three entries of every value is that value's fingerprint.  To build
+ * it, values are peeled off one at a time: a value which is the only
+ * one left mapping to some entry can be given that entry last, after
+ * all the others are set.  If peeling gets stuck, a new seed is tried. */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsbinaryfusefilter.h"
+
+#define BINARY_FUSE_FILTER_MAX_SEGMENT_LENGTH 262144
+
+/* Building fails with a new seed only very rarely; this many failures
+ * in a row means something is wrong */
+
+#define BINARY_FUSE_FILTER_MAX_ATTEMPTS 100
+
+/* Size of the parameters at the start of a written filter */
+
+#define BINARY_FUSE_FILTER_HEADER_SIZE 24
+
+static const unsigned char BINARY_FUSE_FILTER_MAGIC[4] = { 'B', 'F', 'U', 'S' };
+
+struct _BinaryFuseFilter {
+    AllocatorUsage usage;
+    BloomFilterHashFunc hashFunc;
+    uint64_t seed;
+    unsigned int fingerprintBits;
+    uint32_t segmentLength;
+    uint32_t segmentLengthMask;
+    uint32_t segmentCount;
+    uint32_t segmentCountLength;
+    uint32_t arrayLength;
+    void *fingerprints;
+};
+
+/* The murmur3 64-bit finaliser */
+
+static uint64_t binaryfusefilter_mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+/* The next seed from a splitmix64 generator */
+
+static uint64_t binaryfusefilter_nextSeed(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+}
+
+/* The high 64 bits of the product of a 64-bit and a 32-bit number */
+
+static uint64_t binaryfusefilter_mulhi(uint64_t a, uint32_t b)
+{
+    return ((a >> 32) * b + (((a & 0xffffffffU) * b) >> 32)) >> 32;
+}
+
+static uint64_t binaryfusefilter_hash(BinaryFuseFilter *filter,
+                                      unsigned int valueHash)
+{
+    return binaryfusefilter_mix((uint64_t) valueHash + filter->seed);
+}
+
+/* Find the three table entries of a hash.  The first segment is chosen
+ * from the whole hash; the entries within the three segments come from
+ * different bits of it. */
+
+static void binaryfusefilter_indexes(BinaryFuseFilter *filter,
+                                     uint64_t hash,
+                                     uint32_t *indexes)
+{
+    uint32_t index = (uint32_t) binaryfusefilter_mulhi(
+        hash, filter->segmentCountLength);
+
+    indexes[0] = index;
+    indexes[1] = (index + filter->segmentLength)
+               ^ ((uint32_t) (hash >> 18) & filter->segmentLengthMask);
+    indexes[2] = (index + 2 * filter->segmentLength)
+               ^ ((uint32_t) hash & filter->segmentLengthMask);
+}
+
+static uint32_t binaryfusefilter_fingerprint(BinaryFuseFilter *filter,
+                                             uint64_t hash)
+{
+    hash ^= hash >> 32;
+
+    return (uint32_t) hash & ((1U << filter->fingerprintBits) - 1);
+}
+
+static uint32_t binaryfusefilter_get(BinaryFuseFilter *filter,
+                                     uint32_t index)
+{
+    if (filter->fingerprintBits == 8) {
+        return ((uint8_t *) filter->fingerprints)[index];
+    } else {
+        return ((uint16_t *) filter->fingerprints)[index];
+    }
+}
+
+static void binaryfusefilter_set(BinaryFuseFilter *filter,
+                                 uint32_t index,
+                                 uint32_t fingerprint)
+{
+    if (filter->fingerprintBits == 8) {
+        ((uint8_t *) filter->fingerprints)[index] = (uint8_t) fingerprint;
+    } else {
+        ((uint16_t *) filter->fingerprints)[index] = (uint16_t) fingerprint;
+    }
+}
+
+static size_t binaryfusefilter_tableSize(BinaryFuseFilter *filter)
+{
+    return (size_t) filter->arrayLength * (filter->fingerprintBits / 8);
+}
+
+/* Allocate a filter and its table, with the segments sized for a
+ * number of values, or as given when segmentLength is non-zero.
+ * These sizes are those recommended by the authors. */
+
+static BinaryFuseFilter *binaryfusefilter_allocate(
+    unsigned int numValues,
+    BloomFilterHashFunc hashFunc,
+    unsigned int fingerprintBits,
+    uint32_t segmentLength,
+    uint32_t segmentCount,
+    const Allocator *allocator)
+{
+    BinaryFuseFilter *filter;
+    AllocatorUsage usage;
+    uint64_t arrayLength;
+    double sizeFactor;
+    uint64_t capacity;
+    uint64_t numSegments;
+
+    if (fingerprintBits != 8 && fingerprintBits != 16) {
+        return NULL;
+    }
+
+    if (segmentLength == 0) {
+        if (numValues <= 1) {
+            segmentLength = 4;
+            capacity = 0;
+        } else {
+            segmentLength = 1U << (int) floor(log((double) numValues)
+                                              / log(3.33) + 2.25);
+
+            if (segmentLength > BINARY_FUSE_FILTER_MAX_SEGMENT_LENGTH) {
+                segmentLength = BINARY_FUSE_FILTER_MAX_SEGMENT_LENGTH;
+            }
+
+            sizeFactor = 0.875 + 0.25 * log(1000000.0)
+                                      / log((double) numValues);
+
+            if (sizeFactor < 1.125) {
+                sizeFactor = 1.125;
+            }
+
+            capacity = (uint64_t) floor(numValues * sizeFactor + 0.5);
+        }
+
+		/* Two extra segments follow the last one a value can start
+		 * in */
+
+        numSegments = (capacity + segmentLength - 1) / segmentLength;
+        segmentCount = numSegments <= 2 ? 1 : (uint32_t) (numSegments - 2);
+    }
+
+    arrayLength = ((uint64_t) segmentCount + 2) * segmentLength;
+
+    if (arrayLength > 0x7fffffffU) {
+        return NULL;
+    }
+
+    allocator_initUsage(&usage, allocator);
+
+    filter = allocator_malloc(&usage, sizeof(BinaryFuseFilter));
+
+    if (filter == NULL) {
+        return NULL;
+    }
+
+    filter->usage = usage;
+    filter->hashFunc = hashFunc;
+    filter->seed = 0;
+    filter->fingerprintBits = fingerprintBits;
+    filter->segmentLength = segmentLength;
+    filter->segmentLengthMask = segmentLength - 1;
+    filter->segmentCount = segmentCount;
+    filter->segmentCountLength = segmentCount * segmentLength;
+    filter->arrayLength = (uint32_t) arrayLength;
+
+    filter->fingerprints = allocator_calloc(&filter->usage,
+                                            binaryfusefilter_tableSize(filter),
+                                            1);
+
+    if (filter->fingerprints == NULL) {
+        allocator_free(&filter->usage, filter, sizeof(BinaryFuseFilter));
+        return NULL;
+    }
+
+    return filter;
+}
+
+static int binaryfusefilter_compareHashes(const void *a, const void *b)
+{
+    unsigned int hash1 = *(const unsigned int *) a;
+    unsigned int hash2 = *(const unsigned int *) b;
+
+    return (hash1 > hash2) - (hash1 < hash2);
+}
+
+/* Sort hashes and remove duplicates, returning the new count */
+
+static unsigned int binaryfusefilter_removeDuplicates(unsigned int *hashes,
+                                                     unsigned int count)
+{
+    unsigned int result = 0;
+    unsigned int i;
+
+    qsort(hashes, count, sizeof(unsigned int),
+          binaryfusefilter_compareHashes);
+
+    for (i=0; i<count; ++i) {
+        if (i == 0 || hashes[i] != hashes[i - 1]) {
+            hashes[result] = hashes[i];
+            ++result;
+        }
+    }
+
+    return result;
+}
+
+/* Fill the table of a filter from the hashes of its values.  Returns
+ * zero on failure. */
+
+static int binaryfusefilter_populate(BinaryFuseFilter *filter,
+                                     unsigned int *valueHashes,
+                                     unsigned int size)
+{
+    uint32_t capacity = filter->arrayLength;
+    uint32_t allocated = size + 1;
+    uint64_t state = 0x726b2b9d438b9d4dULL;
+    uint64_t *reverseOrder;
+    uint64_t *t2hash;
+    uint32_t *alone;
+    uint32_t *startPos;
+    uint8_t *t2count;
+    uint8_t *reverseH;
+    uint32_t indexes[5];
+    uint32_t blockBits;
+    uint32_t block;
+    uint32_t queueSize;
+    uint32_t stackSize = 0;
+    uint32_t duplicates;
+    uint32_t index;
+    uint32_t other;
+    uint32_t segment;
+    uint32_t fingerprint;
+    uint32_t i;
+    uint64_t hash;
+    uint8_t found;
+    int attempt;
+    int error;
+    int result = 0;
+
+	/* The sets of values mapping to each entry are tracked by their
+	 * number (in the top six bits of t2count), the XOR of their hashes
+	 * (t2hash), and the XOR of which of the three entries of each
+	 * value this is (in the bottom two bits of t2count) */
+
+    blockBits = 1;
+
+    while ((1U << blockBits) < filter->segmentCount) {
+        ++blockBits;
+    }
+
+    block = 1U << blockBits;
+
+    reverseOrder = allocator_calloc(&filter->usage, allocated,
+                                    sizeof(uint64_t));
+    t2hash = allocator_calloc(&filter->usage, capacity, sizeof(uint64_t));
+    alone = allocator_calloc(&filter->usage, capacity, sizeof(uint32_t));
+    startPos = allocator_calloc(&filter->usage, block, sizeof(uint32_t));
+    t2count = allocator_calloc(&filter->usage, capacity, 1);
+    reverseH = allocator_calloc(&filter->usage, allocated, 1);
+
+    if (reverseOrder == NULL || t2hash == NULL || alone == NULL
+     || startPos == NULL || t2count == NULL || reverseH == NULL) {
+        goto done;
+    }
+
+    reverseOrder[size] = 1;
+
+    for (attempt=0; attempt<BINARY_FUSE_FILTER_MAX_ATTEMPTS; ++attempt) {
+
+        filter->seed = binaryfusefilter_nextSeed(&state);
+
+		/* Order the hashes by their first segment, so that the table
+		 * is filled in in order, which is kinder to the cache */
+
+        for (i=0; i<block; ++i) {
+            startPos[i] = (uint32_t) (((uint64_t) i * size) >> blockBits);
+        }
+
+        for (i=0; i<size; ++i) {
+            hash = binaryfusefilter_hash(filter, valueHashes[i]);
+            segment = (uint32_t) (hash >> (64 - blockBits));
+
+            while (reverseOrder[startPos[segment]] != 0) {
+                segment = (segment + 1) & (block - 1);
+            }
+
+            reverseOrder[startPos[segment]] = hash;
+            ++startPos[segment];
+        }
+
+		/* Add each value to its three entries.  A value whose hash
+		 * cancels out an entry with exactly two values is a duplicate,
+		 * and is taken out again. */
+
+        error = 0;
+        duplicates = 0;
+
+        for (i=0; i<size; ++i) {
+            hash = reverseOrder[i];
+            binaryfusefilter_indexes(filter, hash, indexes);
+
+            t2count[indexes[0]] += 4;
+            t2hash[indexes[0]] ^= hash;
+            t2count[indexes[1]] += 4;
+            t2count[indexes[1]] ^= 1;
+            t2hash[indexes[1]] ^= hash;
+            t2count[indexes[2]] += 4;
+            t2count[indexes[2]] ^= 2;
+            t2hash[indexes[2]] ^= hash;
+
+            if ((t2hash[indexes[0]] & t2hash[indexes[1]]
+                 & t2hash[indexes[2]]) == 0
+             && ((t2hash[indexes[0]] == 0 && t2count[indexes[0]] == 8)
+              || (t2hash[indexes[1]] == 0 && t2count[indexes[1]] == 8)
+              || (t2hash[indexes[2]] == 0 && t2count[indexes[2]] == 8))) {
+                ++duplicates;
+                t2count[indexes[0]] -= 4;
+                t2hash[indexes[0]] ^= hash;
+                t2count[indexes[1]] -= 4;
+                t2count[indexes[1]] ^= 1;
+                t2hash[indexes[1]] ^= hash;
+                t2count[indexes[2]] -= 4;
+                t2count[indexes[2]] ^= 2;
+                t2hash[indexes[2]] ^= hash;
+            }
+
+			/* More than 63 values on one entry overflows the count */
+
+            if (t2count[indexes[0]] < 4 || t2count[indexes[1]] < 4
+             || t2count[indexes[2]] < 4) {
+                error = 1;
+            }
+        }
+
+        if (!error) {
+
+			/* Peel: start from the entries with just one value */
+
+            queueSize = 0;
+
+            for (i=0; i<capacity; ++i) {
+                alone[queueSize] = i;
+                queueSize += (t2count[i] >> 2) == 1;
+            }
+
+            stackSize = 0;
+
+            while (queueSize > 0) {
+                --queueSize;
+                index = alone[queueSize];
+
+                if ((t2count[index] >> 2) != 1) {
+                    continue;
+                }
+
+				/* Take the value off its other two entries, which may
+				 * leave them with just one value */
+
+                hash = t2hash[index];
+                binaryfusefilter_indexes(filter, hash, indexes);
+                indexes[3] = indexes[0];
+                indexes[4] = indexes[1];
+
+                found = t2count[index] & 3;
+                reverseH[stackSize] = found;
+                reverseOrder[stackSize] = hash;
+                ++stackSize;
+
+                other = indexes[found + 1];
+                alone[queueSize] = other;
+                queueSize += (t2count[other] >> 2) == 2;
+                t2count[other] -= 4;
+                t2count[other] ^= (uint8_t) ((found + 1) % 3);
+                t2hash[other] ^= hash;
+
+                other = indexes[found + 2];
+                alone[queueSize] = other;
+                queueSize += (t2count[other] >> 2) == 2;
+                t2count[other] -= 4;
+                t2count[other] ^= (uint8_t) ((found + 2) % 3);
+                t2hash[other] ^= hash;
+            }
+
+            if (stackSize + duplicates == size) {
+                result = 1;
+                break;
+            }
+
+			/* Duplicates may have confused the peeling: remove them
+			 * properly before trying again */
+
+            if (duplicates > 0) {
+                size = binaryfusefilter_removeDuplicates(valueHashes, size);
+            }
+        }
+
+        memset(reverseOrder, 0, size * sizeof(uint64_t));
+        reverseOrder[size] = 1;
+        memset(t2count, 0, capacity);
+        memset(t2hash, 0, capacity * sizeof(uint64_t));
+    }
+
+    if (!result) {
+        goto done;
+    }
+
+	/* Assign entries in the reverse of the order values were peeled.
+	 * Each value's entry is the last of its three to be set. */
+
+    for (i=stackSize; i>0; --i) {
+        hash = reverseOrder[i - 1];
+        found = reverseH[i - 1];
+        binaryfusefilter_indexes(filter, hash, indexes);
+        indexes[3] = indexes[0];
+        indexes[4] = indexes[1];
+
+        fingerprint = binaryfusefilter_fingerprint(filter, hash)
+                    ^ binaryfusefilter_get(filter, indexes[found + 1])
+                    ^ binaryfusefilter_get(filter, indexes[found + 2]);
+        binaryfusefilter_set(filter, indexes[found], fingerprint);
+    }
+
+done:
+    allocator_free(&filter->usage, reverseH, allocated);
+    allocator_free(&filter->usage, t2count, capacity);
+    allocator_free(&filter->usage, startPos, block * sizeof(uint32_t));
+    allocator_free(&filter->usage, alone, capacity * sizeof(uint32_t));
+    allocator_free(&filter->usage, t2hash, capacity * sizeof(uint64_t));
+    allocator_free(&filter->usage, reverseOrder,
+                   allocated * sizeof(uint64_t));
+
+    return result;
+}
+
+BinaryFuseFilter *binaryfusefilter_new(BloomFilterValue *values,
+                                       unsigned int numValues,
+                                       BloomFilterHashFunc hashFunc,
+                                       unsigned int fingerprintBits)
+{
+    return binaryfusefilter_newWithAllocator(values, numValues, hashFunc,
+                                             fingerprintBits, NULL);
+}
+
+BinaryFuseFilter *binaryfusefilter_newWithAllocator(
+    BloomFilterValue *values,
+    unsigned int numValues,
+    BloomFilterHashFunc hashFunc,
+    unsigned int fingerprintBits,
+    const Allocator *allocator)
+{
+    BinaryFuseFilter *filter;
+    unsigned int *valueHashes;
+    unsigned int i;
+    int populated;
+
+    filter = binaryfusefilter_allocate(numValues, hashFunc, fingerprintBits,
+                                       0, 0, allocator);
+
+    if (filter == NULL) {
+        return NULL;
+    }
+
+	/* Each value is hashed once up front */
+
+    valueHashes = allocator_malloc(&filter->usage,
+                                   ((size_t) numValues + 1)
+                                   * sizeof(unsigned int));
+
+    if (valueHashes == NULL) {
+        binaryfusefilter_free(filter);
+        return NULL;
+    }
+
+    for (i=0; i<numValues; ++i) {
+        valueHashes[i] = hashFunc(values[i]);
+    }
+
+    populated = binaryfusefilter_populate(filter, valueHashes, numValues);
+
+    allocator_free(&filter->usage, valueHashes,
+                   ((size_t) numValues + 1) * sizeof(unsigned int));
+
+    if (!populated) {
+        binaryfusefilter_free(filter);
+        return NULL;
+    }
+
+    return filter;
+}
+
+void binaryfusefilter_free(BinaryFuseFilter *filter)
+{
+    AllocatorUsage usage = filter->usage;
+
+    allocator_free(&usage, filter->fingerprints,
+                   binaryfusefilter_tableSize(filter));
+    allocator_free(&usage, filter, sizeof(BinaryFuseFilter));
+}
+
+size_t binaryfusefilter_memoryUsage(BinaryFuseFilter *filter)
+{
+    return filter->usage.bytesUsed;
+}
+
+int binaryfusefilter_query(BinaryFuseFilter *filter, BloomFilterValue value)
+{
+    uint64_t hash = binaryfusefilter_hash(filter, filter->hashFunc(value));
+    uint32_t indexes[3];
+
+    binaryfusefilter_indexes(filter, hash, indexes);
+
+    return (binaryfusefilter_fingerprint(filter, hash)
+            ^ binaryfusefilter_get(filter, indexes[0])
+            ^ binaryfusefilter_get(filter, indexes[1])
+            ^ binaryfusefilter_get(filter, indexes[2])) == 0;
+}
+
+/* Written filters store numbers little-endian */
+
+static void binaryfusefilter_writeNumber(unsigned char *array,
+                                         uint64_t value,
+                                         unsigned int length)
+{
+    unsigned int i;
+
+    for (i=0; i<length; ++i) {
+        array[i] = (unsigned char) (value >> (8 * i));
+    }
+}
+
+static uint64_t binaryfusefilter_readNumber(unsigned char *array,
+                                            unsigned int length)
+{
+    uint64_t value = 0;
+    unsigned int i;
+
+    for (i=length; i>0; --i) {
+        value = (value << 8) | array[i - 1];
+    }
+
+    return value;
+}
+
+size_t binaryfusefilter_arraySize(BinaryFuseFilter *filter)
+{
+    return BINARY_FUSE_FILTER_HEADER_SIZE
+         + binaryfusefilter_tableSize(filter);
+}
+
+void binaryfusefilter_write(BinaryFuseFilter *filter, unsigned char *array)
+{
+    unsigned int width = filter->fingerprintBits / 8;
+    uint32_t i;
+
+	/* Magic, fingerprint size, seed, segment length and segment count,
+	 * then the table */
+
+    memcpy(array, BINARY_FUSE_FILTER_MAGIC, 4);
+    binaryfusefilter_writeNumber(array + 4, filter->fingerprintBits, 4);
+    binaryfusefilter_writeNumber(array + 8, filter->seed, 8);
+    binaryfusefilter_writeNumber(array + 16, filter->segmentLength, 4);
+    binaryfusefilter_writeNumber(array + 20, filter->segmentCount, 4);
+
+    array += BINARY_FUSE_FILTER_HEADER_SIZE;
+
+    for (i=0; i<filter->arrayLength; ++i) {
+        binaryfusefilter_writeNumber(array + (size_t) i * width,
+                                     binaryfusefilter_get(filter, i),
+                                     width);
+    }
+}
+
+BinaryFuseFilter *binaryfusefilter_newFromArray(unsigned char *array,
+                                                size_t length,
+                                                BloomFilterHashFunc hashFunc,
+                                                const Allocator *allocator)
+{
+    BinaryFuseFilter *filter;
+    unsigned int fingerprintBits;
+    unsigned int width;
+    uint32_t segmentLength;
+    uint32_t segmentCount;
+    uint32_t i;
+
+    if (length < BINARY_FUSE_FILTER_HEADER_SIZE
+     || memcmp(array, BINARY_FUSE_FILTER_MAGIC, 4) != 0) {
+        return NULL;
+    }
+
+    fingerprintBits = (unsigned int) binaryfusefilter_readNumber(array + 4, 4);
+    segmentLength = (uint32_t) binaryfusefilter_readNumber(array + 16, 4);
+    segmentCount = (uint32_t) binaryfusefilter_readNumber(array + 20, 4);
+
+	/* The segment length must be a power of two */
+
+    if (segmentLength == 0
+     || segmentLength > BINARY_FUSE_FILTER_MAX_SEGMENT_LENGTH
+     || (segmentLength & (segmentLength - 1)) != 0
+     || segmentCount == 0) {
+        return NULL;
+    }
+
+    filter = binaryfusefilter_allocate(0, hashFunc, fingerprintBits,
+                                       segmentLength, segmentCount,
+                                       allocator);
+
+    if (filter == NULL) {
+        return NULL;
+    }
+
+    if (length != binaryfusefilter_arraySize(filter)) {
+        binaryfusefilter_free(filter);
+        return NULL;
+    }
+
+    filter->seed = binaryfusefilter_readNumber(array + 8, 8);
+
+    width = fingerprintBits / 8;
+    array += BINARY_FUSE_FILTER_HEADER_SIZE;
+
+    for (i=0; i<filter->arrayLength; ++i) {
+        binaryfusefilter_set(filter, i,
+                             (uint32_t) binaryfusefilter_readNumber(
+                                 array + (size_t) i * width, width));
+    }
+
+    return filter;
+}
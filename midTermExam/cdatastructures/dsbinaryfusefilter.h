@@ -0,0 +1,167 @@
+/**
+ * @file dsbinaryfusefilter.h
+ *
+ * @brief Binary fuse filter
+ *
+ * A binary fuse filter answers the same question as a
+ * @ref BloomFilter: whether a value may be part of a set, with
+ * occasional false positives but never false negatives.  Unlike a
+ * bloom filter, it is built once from the complete set of values and
+ * can not be changed afterwards.  In exchange it needs less memory for
+ * the same false positive rate, and each query reads exactly three
+ * entries of its table.
+ *
+ * Each entry of the table is a fingerprint of 8 or 16 bits.  With 8
+ * bits the false positive rate is about 1 in 256, using about 9 bits
+ * per value; with 16 bits it is about 1 in 65536, using about 18 bits
+ * per value.
+ *
+ * To create a binary fuse filter from an array of values, use
+ * @ref binaryfusefilter_new.  To destroy it, use
+ * @ref binaryfusefilter_free.  To query whether a value is part of the
+ * set, use @ref binaryfusefilter_query.
+ *
+ * A filter can be saved to a flat array of bytes with
+ * @ref binaryfusefilter_write, and created again from it with
+ * @ref binaryfusefilter_newFromArray.
+ */
+
+#ifndef DSBINARYFUSEFILTER_H
+#define DSBINARYFUSEFILTER_H
+
+#include "dsbloomfilter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A binary fuse filter structure.
+ */
+
+typedef struct _BinaryFuseFilter BinaryFuseFilter;
+
+/**
+ * Create a binary fuse filter holding a set of values.  Values which
+ * are equal, or which have the same hash, are only stored once.
+ *
+ * @param values           Array of the values in the set.
+ * @param numValues        Number of values in the array.
+ * @param hashFunc         Hash function to use on values stored in the
+ *                         filter.
+ * @param fingerprintBits  Size of each fingerprint: 8 or 16 bits.
+ * @return                 A new binary fuse filter, or NULL if the
+ *                         fingerprint size is not supported or it was
+ *                         not possible to allocate the new filter.
+ */
+
+BinaryFuseFilter *binaryfusefilter_new(BloomFilterValue *values,
+                                       unsigned int numValues,
+                                       BloomFilterHashFunc hashFunc,
+                                       unsigned int fingerprintBits);
+
+/**
+ * Create a binary fuse filter holding a set of values, allocating its
+ * memory from a particular allocator.  Memory needed while the filter
+ * is built is also allocated from it.
+ *
+ * @param values           Array of the values in the set.
+ * @param numValues        Number of values in the array.
+ * @param hashFunc         Hash function to use on values stored in the
+ *                         filter.
+ * @param fingerprintBits  Size of each fingerprint: 8 or 16 bits.
+ * @param allocator        The allocator to use, or NULL to use the
+ *                         default allocator.
+ * @return                 A new binary fuse filter, or NULL if the
+ *                         fingerprint size is not supported or it was
+ *                         not possible to allocate the new filter.
+ */
+
+BinaryFuseFilter *binaryfusefilter_newWithAllocator(
+    BloomFilterValue *values,
+    unsigned int numValues,
+    BloomFilterHashFunc hashFunc,
+    unsigned int fingerprintBits,
+    const Allocator *allocator);
+
+/**
+ * Create a binary fuse filter from an array written by
+ * @ref binaryfusefilter_write.
+ *
+ * @param array            Pointer to the array.
+ * @param length           Length of the array in bytes.
+ * @param hashFunc         Hash function to use on values.  This must be
+ *                         the same function used by the filter which
+ *                         was written.
+ * @param allocator        The allocator to use, or NULL to use the
+ *                         default allocator.
+ * @return                 A new binary fuse filter, or NULL if the
+ *                         array does not hold a valid filter or it was
+ *                         not possible to allocate the new filter.
+ */
+
+BinaryFuseFilter *binaryfusefilter_newFromArray(unsigned char *array,
+                                                size_t length,
+                                                BloomFilterHashFunc hashFunc,
+                                                const Allocator *allocator);
+
+/**
+ * Destroy a binary fuse filter.
+ *
+ * @param filter           The binary fuse filter to destroy.
+ */
+
+void binaryfusefilter_free(BinaryFuseFilter *filter);
+
+/**
+ * Retrieve the number of bytes of memory allocated by a binary fuse
+ * filter.
+ *
+ * @param filter           The binary fuse filter.
+ * @return                 The number of bytes allocated.
+ */
+
+size_t binaryfusefilter_memoryUsage(BinaryFuseFilter *filter);
+
+/**
+ * Query a binary fuse filter for a particular value.
+ *
+ * @param filter           The binary fuse filter.
+ * @param value            The value to look up.
+ * @return                 Zero if the value was definitely not in the
+ *                         set the filter was created from.  Non-zero
+ *                         indicates that it either may or may not have
+ *                         been.
+ */
+
+int binaryfusefilter_query(BinaryFuseFilter *filter, BloomFilterValue value);
+
+/**
+ * Find the number of bytes needed to write a binary fuse filter to an
+ * array with @ref binaryfusefilter_write.
+ *
+ * @param filter           The binary fuse filter.
+ * @return                 The number of bytes needed.
+ */
+
+size_t binaryfusefilter_arraySize(BinaryFuseFilter *filter);
+
+/**
+ * Write a binary fuse filter to an array of bytes.  The array holds
+ * the parameters of the filter followed by its table, and is the same
+ * on all platforms.
+ *
+ * @param filter           The binary fuse filter.
+ * @param array            Pointer to the array to write to.  This should
+ *                         be @ref binaryfusefilter_arraySize bytes in
+ *                         length.
+ */
+
+void binaryfusefilter_write(BinaryFuseFilter *filter, unsigned char *array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSBINARYFUSEFILTER_H */
+
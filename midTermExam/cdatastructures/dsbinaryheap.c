@@ -4,6 +4,7 @@
 
 
 struct _BinaryHeap {
+    AllocatorUsage usage;
     BinaryHeapType heapType;
 	BinaryHeapValue *values;
     unsigned int numValues;
@@ -25,12 +26,25 @@ static int binaryheap_compare(BinaryHeap *heap,
 BinaryHeap *binaryheap_new(BinaryHeapType heapType,
                            BinaryHeapCompareFunc compareFunc)
 {
-    BinaryHeap *heap = malloc(sizeof(BinaryHeap));
+    return binaryheap_newWithAllocator(heapType, compareFunc, NULL);
+}
+
+BinaryHeap *binaryheap_newWithAllocator(BinaryHeapType heapType,
+                                        BinaryHeapCompareFunc compareFunc,
+                                        const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
+    allocator_initUsage(&usage, allocator);
+
+    BinaryHeap *heap = allocator_malloc(&usage, sizeof(BinaryHeap));
 
 	if (heap == NULL) {
 		return NULL;
 	}
 
+    heap->usage = usage;
+
     heap->heapType = heapType;
     heap->numValues = 0;
     heap->compareFunc = compareFunc;
@@ -38,10 +52,11 @@ BinaryHeap *binaryheap_new(BinaryHeapType heapType,
 	/* Initial size of 16 elements */
 
     heap->allocedSize = 16;
-    heap->values = malloc(sizeof(BinaryHeapValue) * heap->allocedSize);
+    heap->values = allocator_malloc(&heap->usage,
+                                    sizeof(BinaryHeapValue) * heap->allocedSize);
 
 	if (heap->values == NULL) {
-		free(heap);
+        allocator_free(&heap->usage, heap, sizeof(BinaryHeap));
 		return NULL;
 	}
 
@@ -50,8 +65,11 @@ BinaryHeap *binaryheap_new(BinaryHeapType heapType,
 
 void binaryheap_free(BinaryHeap *heap)
 {
-	free(heap->values);
-	free(heap);
+    AllocatorUsage usage = heap->usage;
+
+    allocator_free(&usage, heap->values,
+                   sizeof(BinaryHeapValue) * heap->allocedSize);
+    allocator_free(&usage, heap, sizeof(BinaryHeap));
 }
 
 int binaryheap_insert(BinaryHeap *heap, BinaryHeapValue value)
@@ -66,8 +84,10 @@ int binaryheap_insert(BinaryHeap *heap, BinaryHeapValue value)
 		/* Double the table size */
 
         newSize = heap->allocedSize * 2;
-        newValues = realloc(heap->values,
-                            sizeof(BinaryHeapValue) * newSize);
+        newValues = allocator_realloc(&heap->usage, heap->values,
+                                      sizeof(BinaryHeapValue)
+                                      * heap->allocedSize,
+                                      sizeof(BinaryHeapValue) * newSize);
 
         if (newValues == NULL) {
 			return 0;
@@ -203,3 +223,8 @@ unsigned int binaryheap_numEntries(BinaryHeap *heap)
 {
     return heap->numValues;
 }
+
+size_t binaryheap_memoryUsage(BinaryHeap *heap)
+{
+    return heap->usage.bytesUsed;
+}
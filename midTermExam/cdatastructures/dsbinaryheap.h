@@ -18,6 +18,8 @@
 #ifndef DSBINARYHEAP_H
 #define DSBINARYHEAP_H
 
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -84,6 +86,23 @@ typedef struct _BinaryHeap BinaryHeap;
 BinaryHeap *binaryheap_new(BinaryHeapType heapType,
                            BinaryHeapCompareFunc compareFunc);
 
+/**
+ * Create a new @ref BinaryHeap which allocates its memory from a
+ * particular allocator.
+ *
+ * @param heapType         The type of heap: min heap or max heap.
+ * @param compareFunc      Pointer to a function used to compare the priority
+ *                         of values in the heap.
+ * @param allocator        The allocator to use, or NULL to use the default
+ *                         allocator.
+ * @return                 A new binary heap, or NULL if it was not possible
+ *                         to allocate the memory.
+ */
+
+BinaryHeap *binaryheap_newWithAllocator(BinaryHeapType heapType,
+                                        BinaryHeapCompareFunc compareFunc,
+                                        const Allocator *allocator);
+
 /**
  * Destroy a binary heap.
  *
@@ -123,6 +142,15 @@ BinaryHeapValue binaryheap_pop(BinaryHeap *heap);
 
 unsigned int binaryheap_numEntries(BinaryHeap *heap);
 
+/**
+ * Retrieve the number of bytes of memory allocated by a binary heap.
+ *
+ * @param heap             The heap.
+ * @return                 The number of bytes allocated.
+ */
+
+size_t binaryheap_memoryUsage(BinaryHeap *heap);
+
 #ifdef __cplusplus
 }
 #endif
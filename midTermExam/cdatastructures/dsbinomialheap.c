@@ -17,11 +17,13 @@ struct _BinomialTree
 
 struct _BinomialHeap
 {
+    AllocatorUsage usage;
     BinomialHeapType heapType;
     BinomialHeapCompareFunc compareFunc;
     unsigned int numValues;
 	BinomialTree **roots;
     unsigned int rootsLength;
+    unsigned int rootsAlloced;
 };
 
 static int binomialheap_compare(BinomialHeap *heap,
@@ -42,7 +44,7 @@ static void binomialtree_ref(BinomialTree *tree)
 	}
 }
 
-static void binomialtree_unref(BinomialTree *tree)
+static void binomialtree_unref(BinomialHeap *heap, BinomialTree *tree)
 {
 	if (tree == NULL) {
 		return;
@@ -58,11 +60,12 @@ static void binomialtree_unref(BinomialTree *tree)
     if (tree->refCount == 0) {
         int i;
 		for (i=0; i<tree->order; ++i) {
-            binomialtree_unref(tree->subtrees[i]);
+            binomialtree_unref(heap, tree->subtrees[i]);
 		}
 
-		free(tree->subtrees);
-		free(tree);
+        allocator_free(&heap->usage, tree->subtrees,
+                       sizeof(BinomialTree *) * tree->order);
+        allocator_free(&heap->usage, tree, sizeof(BinomialTree));
 	}
 }
 
@@ -86,7 +89,8 @@ static BinomialTree *binomialtree_merge(BinomialHeap *heap,
 
 	/* Allocate a new tree */
 
-    BinomialTree *newTree = malloc(sizeof(BinomialTree));
+    BinomialTree *newTree = allocator_malloc(&heap->usage,
+                                             sizeof(BinomialTree));
 
     if (newTree == NULL) {
 		return NULL;
@@ -102,10 +106,12 @@ static BinomialTree *binomialtree_merge(BinomialHeap *heap,
 	/* Copy subtrees of the smallest tree.  The last entry in the
 	 * array is the larger tree */
 
-    newTree->subtrees = malloc(sizeof(BinomialTree *) * newTree->order);
+    newTree->subtrees = allocator_malloc(&heap->usage,
+                                         sizeof(BinomialTree *)
+                                         * newTree->order);
 
     if (newTree->subtrees == NULL) {
-        free(newTree);
+        allocator_free(&heap->usage, newTree, sizeof(BinomialTree));
 		return NULL;
 	}
 
@@ -127,15 +133,18 @@ static BinomialTree *binomialtree_merge(BinomialHeap *heap,
  * binomial_heap_merge.  Go through the list of roots so far and remove
  * references that have been added. */
 
-static void binomialheap_mergeUndo(BinomialTree **newRoots, unsigned int count)
+static void binomialheap_mergeUndo(BinomialHeap *heap,
+                                   BinomialTree **newRoots,
+                                   unsigned int count,
+                                   unsigned int length)
 {
 	unsigned int i;
 
 	for (i=0; i<=count; ++i) {
-        binomialtree_unref(newRoots[i]);
+        binomialtree_unref(heap, newRoots[i]);
 	}
 
-    free(newRoots);
+    allocator_free(&heap->usage, newRoots, sizeof(BinomialTree *) * length);
 }
 
 /* Merge the data in the 'other' heap into the 'heap' heap.
@@ -156,7 +165,8 @@ static int binomialheap_merge(BinomialHeap *heap, BinomialHeap *other)
 
 	/* Allocate an array for the new roots */
 
-    BinomialTree **newRoots = malloc(sizeof(BinomialTree *) * max);
+    BinomialTree **newRoots = allocator_malloc(&heap->usage,
+                                               sizeof(BinomialTree *) * max);
 
     if (newRoots == NULL) {
 		return 0;
@@ -234,11 +244,11 @@ static int binomialheap_merge(BinomialHeap *heap, BinomialHeap *other)
 				 * (freeing any BinomialTree structures
 				 * that were created in the process) */
 
-                binomialheap_mergeUndo(newRoots, i);
+                binomialheap_mergeUndo(heap, newRoots, i, max);
 
 				/* Unreference the carry variable */
 
-                binomialtree_unref(carry);
+                binomialtree_unref(heap, carry);
 
 				return 0;
 			}
@@ -252,7 +262,7 @@ static int binomialheap_merge(BinomialHeap *heap, BinomialHeap *other)
 
 		/* Unreference previous carried value */
 
-        binomialtree_unref(carry);
+        binomialtree_unref(heap, carry);
 
 		/* Assign the new value of carry, and add a reference */
 
@@ -266,15 +276,17 @@ static int binomialheap_merge(BinomialHeap *heap, BinomialHeap *other)
 
     for (i=0; i<heap->rootsLength; ++i) {
 		if (heap->roots[i] != NULL) {
-            binomialtree_unref(heap->roots[i]);
+            binomialtree_unref(heap, heap->roots[i]);
 		}
 	}
 
 	/* Free the old roots array and use the new one */
 
-	free(heap->roots);
+    allocator_free(&heap->usage, heap->roots,
+                   sizeof(BinomialTree *) * heap->rootsAlloced);
     heap->roots = newRoots;
     heap->rootsLength = newRootsLength;
+    heap->rootsAlloced = max;
 
 	/* Merged successfully */
 
@@ -284,14 +296,27 @@ static int binomialheap_merge(BinomialHeap *heap, BinomialHeap *other)
 BinomialHeap *binomialheap_new(BinomialHeapType heapType,
                                BinomialHeapCompareFunc compareFunc)
 {
+    return binomialheap_newWithAllocator(heapType, compareFunc, NULL);
+}
+
+BinomialHeap *binomialheap_newWithAllocator(BinomialHeapType heapType,
+                                            BinomialHeapCompareFunc compareFunc,
+                                            const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
+    allocator_initUsage(&usage, allocator);
+
 	/* Allocate a new heap */
 
-    BinomialHeap *newHeap = calloc(1, sizeof(BinomialHeap));
+    BinomialHeap *newHeap = allocator_calloc(&usage, 1, sizeof(BinomialHeap));
 
     if (newHeap == NULL) {
 		return NULL;
 	}
 
+    newHeap->usage = usage;
+
 	/* Initialise and return */
 
     newHeap->heapType = heapType;
@@ -307,20 +332,24 @@ void binomialheap_free(BinomialHeap *heap)
 
     unsigned int i;
     for (i=0; i<heap->rootsLength; ++i) {
-        binomialtree_unref(heap->roots[i]);
+        binomialtree_unref(heap, heap->roots[i]);
 	}
 
 	/* Free the heap itself */
 
-	free(heap->roots);
-	free(heap);
+    AllocatorUsage usage = heap->usage;
+
+    allocator_free(&usage, heap->roots,
+                   sizeof(BinomialTree *) * heap->rootsAlloced);
+    allocator_free(&usage, heap, sizeof(BinomialHeap));
 }
 
 int binomialheap_insert(BinomialHeap *heap, BinomialHeapValue value)
 {
 	/* Allocate an order 0 tree for storing the new value */
 
-    BinomialTree *newTree = malloc(sizeof(BinomialTree));
+    BinomialTree *newTree = allocator_malloc(&heap->usage,
+                                             sizeof(BinomialTree));
 
     if (newTree == NULL) {
 		return 0;
@@ -354,7 +383,7 @@ int binomialheap_insert(BinomialHeap *heap, BinomialHeapValue value)
 
 	/* Remove reference to the new tree. */
 
-    binomialtree_unref(newTree);
+    binomialtree_unref(heap, newTree);
 
 	return result;
 }
@@ -407,7 +436,7 @@ BinomialHeapValue binomialheap_pop(BinomialHeap *heap)
 		/* Remove reference to least tree */
 
         result = leastTree->value;
-        binomialtree_unref(leastTree);
+        binomialtree_unref(heap, leastTree);
 
 		/* Update the number of values */
 
@@ -432,3 +461,7 @@ unsigned int binomialheap_numEntries(BinomialHeap *heap)
     return heap->numValues;
 }
 
+size_t binomialheap_memoryUsage(BinomialHeap *heap)
+{
+    return heap->usage.bytesUsed;
+}
@@ -18,6 +18,8 @@
 #ifndef DSBINOMIALHEAP_H
 #define DSBINOMIALHEAP_H
 
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -84,6 +86,23 @@ typedef struct _BinomialHeap BinomialHeap;
 BinomialHeap *binomialheap_new(BinomialHeapType heapType,
                                BinomialHeapCompareFunc compareFunc);
 
+/**
+ * Create a new @ref BinomialHeap which allocates its memory from a
+ * particular allocator.
+ *
+ * @param heapType         The type of heap: min heap or max heap.
+ * @param compareFunc      Pointer to a function used to compare the priority
+ *                         of values in the heap.
+ * @param allocator        The allocator to use, or NULL to use the default
+ *                         allocator.
+ * @return                 A new binomial heap, or NULL if it was not possible
+ *                         to allocate the memory.
+ */
+
+BinomialHeap *binomialheap_newWithAllocator(BinomialHeapType heapType,
+                                            BinomialHeapCompareFunc compareFunc,
+                                            const Allocator *allocator);
+
 /**
  * Destroy a binomial heap.
  *
@@ -123,6 +142,15 @@ BinomialHeapValue binomialheap_pop(BinomialHeap *heap);
 
 unsigned int binomialheap_numEntries(BinomialHeap *heap);
 
+/**
+ * Retrieve the number of bytes of memory allocated by a binomial heap.
+ *
+ * @param heap             The heap.
+ * @return                 The number of bytes allocated.
+ */
+
+size_t binomialheap_memoryUsage(BinomialHeap *heap);
+
 #ifdef __cplusplus
 }
 #endif
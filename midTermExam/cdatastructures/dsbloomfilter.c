@@ -1,14 +1,55 @@
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "dsbloomfilter.h"
 
+#if (defined(__GNUC__) || defined(__clang__)) \
+    && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BLOOM_FILTER_USE_X86_SIMD
+#endif
+
+/* Atomic operations for bloomfilter_insertConcurrent: the compiler's
+ * builtins where available, since they work on plain integers in any C
+ * standard, otherwise C11 atomics */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BLOOM_FILTER_USE_ATOMIC_BUILTINS
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L \
+    && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#else
+#error "bloomfilter_insertConcurrent needs atomic operations"
+#endif
+
+/* Blocked filters keep all the bits for a value in one block of this
+ * many bytes, the size of a cache line */
+
+#define BLOOM_FILTER_BLOCK_SIZE 64
+#define BLOOM_FILTER_BLOCK_BITS (BLOOM_FILTER_BLOCK_SIZE * 8)
+
+/* Number of values tested together by bloomfilter_queryBatch: one
+ * AVX-512 register, or two AVX2 registers, of 32-bit lanes */
+
+#define BLOOM_FILTER_BATCH_SIZE 16
+
+/* ln(2), which BLOOM_FILTER_LN2 gives on most but not all systems */
+
+#define BLOOM_FILTER_LN2 0.69314718055994530942
 
 struct _BloomFilter {
+    AllocatorUsage usage;
     BloomFilterHashFunc hashFunc;
+    BloomFilterLayout layout;
 	unsigned char *table;
     unsigned int tableSize;
     unsigned int numFunctions;
+    unsigned int numBlocks;
+    unsigned char *allocation;
+    size_t allocationSize;
 };
 
 /* Salt values.  These salts are XORed with the output of the hash function to
@@ -46,8 +87,81 @@ static const unsigned int SALTS[] = {
 BloomFilter *bloomfilter_new(unsigned int tableSize,
                              BloomFilterHashFunc hashFunc,
                              unsigned int numFunctions)
+{
+    return bloomfilter_newWithAllocator(tableSize, hashFunc, numFunctions,
+                                        BLOOM_FILTER_LAYOUT_STANDARD, NULL);
+}
+
+int bloomfilter_optimalSize(unsigned int capacity,
+                            double falsePositiveRate,
+                            unsigned int *tableSize,
+                            unsigned int *numFunctions)
+{
+    double bits;
+    double functions;
+
+    if (capacity == 0 || !(falsePositiveRate > 0 && falsePositiveRate < 1)) {
+        return 0;
+    }
+
+	/* m = -n ln(p) / ln(2)^2 bits, and k = (m / n) ln(2) functions */
+
+    bits = ceil(-(double) capacity * log(falsePositiveRate)
+                / (BLOOM_FILTER_LN2 * BLOOM_FILTER_LN2));
+
+    if (bits > UINT_MAX) {
+        return 0;
+    }
+
+    functions = floor(bits / capacity * BLOOM_FILTER_LN2 + 0.5);
+
+    if (functions < 1) {
+        functions = 1;
+    } else if (functions > sizeof(SALTS) / sizeof(*SALTS)) {
+        functions = sizeof(SALTS) / sizeof(*SALTS);
+    }
+
+    *tableSize = (unsigned int) bits;
+    *numFunctions = (unsigned int) functions;
+
+    return 1;
+}
+
+BloomFilter *bloomfilter_newForCapacity(unsigned int capacity,
+                                        double falsePositiveRate,
+                                        BloomFilterHashFunc hashFunc)
+{
+    unsigned int tableSize;
+    unsigned int numFunctions;
+
+    if (!bloomfilter_optimalSize(capacity, falsePositiveRate,
+                                 &tableSize, &numFunctions)) {
+        return NULL;
+    }
+
+    return bloomfilter_new(tableSize, hashFunc, numFunctions);
+}
+
+BloomFilter *bloomfilter_newWithLayout(unsigned int tableSize,
+                                       BloomFilterHashFunc hashFunc,
+                                       unsigned int numFunctions,
+                                       BloomFilterLayout layout)
+{
+    return bloomfilter_newWithAllocator(tableSize, hashFunc, numFunctions,
+                                        layout, NULL);
+}
+
+BloomFilter *bloomfilter_newWithAllocator(unsigned int tableSize,
+                                          BloomFilterHashFunc hashFunc,
+                                          unsigned int numFunctions,
+                                          BloomFilterLayout layout,
+                                          const Allocator *allocator)
 {
 	BloomFilter *filter;
+    AllocatorUsage usage;
+    unsigned int numBlocks = 0;
+    size_t alignment;
+    size_t offset;
 
 	/* There is a limit on the number of functions which can be
 	 * applied, due to the table size */
@@ -56,40 +170,140 @@ BloomFilter *bloomfilter_new(unsigned int tableSize,
 		return NULL;
 	}
 
+	/* Blocked filters hold a whole number of blocks */
+
+    if (layout == BLOOM_FILTER_LAYOUT_BLOCKED) {
+        numBlocks = tableSize / BLOOM_FILTER_BLOCK_BITS
+                  + (tableSize % BLOOM_FILTER_BLOCK_BITS != 0);
+
+        if (numBlocks == 0) {
+            numBlocks = 1;
+        }
+
+        if (numBlocks > UINT_MAX / BLOOM_FILTER_BLOCK_BITS) {
+            return NULL;
+        }
+
+        tableSize = numBlocks * BLOOM_FILTER_BLOCK_BITS;
+    }
+
 	/* Allocate bloom filter structure */
 
-	filter = malloc(sizeof(BloomFilter));
+    allocator_initUsage(&usage, allocator);
+
+    filter = allocator_malloc(&usage, sizeof(BloomFilter));
 
 	if (filter == NULL) {
 		return NULL;
 	}
 
+    filter->usage = usage;
+
 	/* Allocate table, each entry is one bit; these are packed into
-	 * bytes.  When allocating we must round the length up to the nearest
-	 * byte. */
+	 * bytes.  When allocating we must round the length up to a whole
+	 * number of 64-bit words, which bloomfilter_insertConcurrent
+	 * updates.  The blocks of a blocked filter must line up with cache
+	 * lines, and the words of other filters with their size, so room
+	 * is left to align the table. */
+
+    alignment = layout == BLOOM_FILTER_LAYOUT_BLOCKED
+              ? BLOOM_FILTER_BLOCK_SIZE : sizeof(uint64_t);
 
-    filter->table = calloc((tableSize + 7) / 8, 1);
+    filter->allocationSize = ((size_t) tableSize + 63) / 64
+                           * sizeof(uint64_t) + alignment - 1;
 
-	if (filter->table == NULL) {
-		free(filter);
+    filter->allocation = allocator_calloc(&filter->usage,
+                                          filter->allocationSize, 1);
+
+    if (filter->allocation == NULL) {
+        allocator_free(&filter->usage, filter, sizeof(BloomFilter));
 		return NULL;
 	}
 
+    filter->table = filter->allocation;
+    offset = (size_t) ((uintptr_t) filter->allocation % alignment);
+
+    if (offset != 0) {
+        filter->table += alignment - offset;
+    }
+
     filter->hashFunc = hashFunc;
+    filter->layout = layout;
     filter->numFunctions = numFunctions;
     filter->tableSize = tableSize;
+    filter->numBlocks = numBlocks;
 
 	return filter;
 }
 
 void bloomfilter_free(BloomFilter *bloomfilter)
 {
-	free(bloomfilter->table);
-	free(bloomfilter);
+    AllocatorUsage usage = bloomfilter->usage;
+
+    allocator_free(&usage, bloomfilter->allocation,
+                   bloomfilter->allocationSize);
+    allocator_free(&usage, bloomfilter, sizeof(BloomFilter));
+}
+
+size_t bloomfilter_memoryUsage(BloomFilter *bloomfilter)
+{
+    return bloomfilter->usage.bytesUsed;
+}
+
+/* Extend a 32-bit hash to 64 well-mixed bits (the splitmix64
+ * finaliser) */
+
+static uint64_t bloomfilter_mix64(unsigned int hash)
+{
+    uint64_t x = (uint64_t) hash + 0x9e3779b97f4a7c15ULL;
+
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+    return x ^ (x >> 31);
+}
+
+/* Find the block of a blocked filter which holds the bits for a value,
+ * and the two hashes from which the bit positions within the block are
+ * generated (Kirsch-Mitzenmacher double hashing).  The top half of the
+ * 64-bit hash picks the block, by multiplying rather than dividing;
+ * the bottom half gives the first bit position and the step between
+ * positions.  The step is odd, so the positions do not repeat. */
+
+static unsigned char *bloomfilter_block(BloomFilter *bloomfilter,
+                                        BloomFilterValue value,
+                                        unsigned int *position,
+                                        unsigned int *step)
+{
+    uint64_t hash = bloomfilter_mix64(bloomfilter->hashFunc(value));
+    uint64_t block = ((hash >> 32) * bloomfilter->numBlocks) >> 32;
+
+    *position = (unsigned int) hash;
+    *step = ((unsigned int) hash >> 9) | 1;
+
+    return bloomfilter->table + block * BLOOM_FILTER_BLOCK_SIZE;
 }
 
 void bloomfilter_insert(BloomFilter *bloomfilter, BloomFilterValue value)
 {
+    if (bloomfilter->layout == BLOOM_FILTER_LAYOUT_BLOCKED) {
+        unsigned char *block;
+        unsigned int position;
+        unsigned int step;
+        unsigned int bit;
+        unsigned int i;
+
+        block = bloomfilter_block(bloomfilter, value, &position, &step);
+
+        for (i=0; i<bloomfilter->numFunctions; ++i) {
+            bit = position % BLOOM_FILTER_BLOCK_BITS;
+            block[bit / 8] |= (unsigned char) (1 << (bit % 8));
+            position += step;
+        }
+
+        return;
+    }
+
 	/* Generate hash of the value to insert */
 
     unsigned int hash = bloomfilter->hashFunc(value);
@@ -121,8 +335,114 @@ void bloomfilter_insert(BloomFilter *bloomfilter, BloomFilterValue value)
 	}
 }
 
+/* Find the bit of a 64-bit word of the table which holds a bit index.
+ * The table is still laid out as bytes, so the byte order must be
+ * allowed for. */
+
+static uint64_t bloomfilter_wordBit(unsigned int index)
+{
+    static const uint16_t byteOrder = 1;
+    unsigned int byte = (index / 8) % sizeof(uint64_t);
+
+    if (*(const unsigned char *) &byteOrder == 0) {
+        byte = sizeof(uint64_t) - 1 - byte;
+    }
+
+    return (uint64_t) 1 << (byte * 8 + index % 8);
+}
+
+/* Set bits in a word of the table, which other threads may be setting
+ * bits in too.  Bits are only ever set, never cleared, so no ordering
+ * is needed.  The word is checked first, so that values inserted often
+ * do not keep taking its cache line away from other threads. */
+
+static void bloomfilter_atomicOr(uint64_t *word, uint64_t bits)
+{
+#ifdef BLOOM_FILTER_USE_ATOMIC_BUILTINS
+    if ((__atomic_load_n(word, __ATOMIC_RELAXED) & bits) != bits) {
+        __atomic_fetch_or(word, bits, __ATOMIC_RELAXED);
+    }
+#else
+    _Atomic uint64_t *atomicWord = (_Atomic uint64_t *) word;
+
+    if ((atomic_load_explicit(atomicWord, memory_order_relaxed) & bits)
+        != bits) {
+        atomic_fetch_or_explicit(atomicWord, bits, memory_order_relaxed);
+    }
+#endif
+}
+
+void bloomfilter_insertConcurrent(BloomFilter *bloomfilter,
+                                  BloomFilterValue value)
+{
+    uint64_t *words = (uint64_t *) bloomfilter->table;
+    unsigned int hash;
+    unsigned int index;
+    unsigned int i;
+
+    if (bloomfilter->layout == BLOOM_FILTER_LAYOUT_BLOCKED) {
+        uint64_t bits[BLOOM_FILTER_BLOCK_SIZE / sizeof(uint64_t)];
+        unsigned char *block;
+        unsigned int position;
+        unsigned int step;
+        unsigned int bit;
+
+		/* Gather the bits for each word of the block, so that each
+		 * word is updated at most once */
+
+        block = bloomfilter_block(bloomfilter, value, &position, &step);
+        words = (uint64_t *) block;
+        memset(bits, 0, sizeof(bits));
+
+        for (i=0; i<bloomfilter->numFunctions; ++i) {
+            bit = position % BLOOM_FILTER_BLOCK_BITS;
+            bits[bit / 64] |= bloomfilter_wordBit(bit);
+            position += step;
+        }
+
+        for (i=0; i<BLOOM_FILTER_BLOCK_SIZE / sizeof(uint64_t); ++i) {
+            if (bits[i] != 0) {
+                bloomfilter_atomicOr(&words[i], bits[i]);
+            }
+        }
+
+        return;
+    }
+
+	/* The same bits as bloomfilter_insert */
+
+    hash = bloomfilter->hashFunc(value);
+
+    for (i=0; i<bloomfilter->numFunctions; ++i) {
+        index = (hash ^ SALTS[i]) % bloomfilter->tableSize;
+        bloomfilter_atomicOr(&words[index / 64], bloomfilter_wordBit(index));
+    }
+}
+
 int bloomfilter_query(BloomFilter *bloomfilter, BloomFilterValue value)
 {
+    if (bloomfilter->layout == BLOOM_FILTER_LAYOUT_BLOCKED) {
+        unsigned char *block;
+        unsigned int position;
+        unsigned int step;
+        unsigned int bit;
+        unsigned int i;
+
+        block = bloomfilter_block(bloomfilter, value, &position, &step);
+
+        for (i=0; i<bloomfilter->numFunctions; ++i) {
+            bit = position % BLOOM_FILTER_BLOCK_BITS;
+
+            if ((block[bit / 8] & (1 << (bit % 8))) == 0) {
+                return 0;
+            }
+
+            position += step;
+        }
+
+        return 1;
+    }
+
 	/* Generate hash of the value to lookup */
 
     unsigned int hash = bloomfilter->hashFunc(value);
@@ -197,15 +517,19 @@ BloomFilter *bloomfilter_union(BloomFilter *filter1, BloomFilter *filter2)
 
     if (filter1->tableSize != filter2->tableSize
             || filter1->numFunctions != filter2->numFunctions
-            || filter1->hashFunc != filter2->hashFunc) {
+            || filter1->hashFunc != filter2->hashFunc
+            || filter1->layout != filter2->layout) {
 		return NULL;
 	}
 
 	/* Create a new bloom filter for the result */
 
-    BloomFilter *result = bloomfilter_new(filter1->tableSize,
-                             filter1->hashFunc,
-                             filter1->numFunctions);
+    BloomFilter *result
+        = bloomfilter_newWithAllocator(filter1->tableSize,
+                                       filter1->hashFunc,
+                                       filter1->numFunctions,
+                                       filter1->layout,
+                                       filter1->usage.allocator);
 
 	if (result == NULL) {
 		return NULL;
@@ -234,15 +558,19 @@ BloomFilter *bloomfilter_intersection(BloomFilter *filter1, BloomFilter *filter2
 
     if (filter1->tableSize != filter2->tableSize
             || filter1->numFunctions != filter2->numFunctions
-            || filter1->hashFunc != filter2->hashFunc) {
+            || filter1->hashFunc != filter2->hashFunc
+            || filter1->layout != filter2->layout) {
 		return NULL;
 	}
 
 	/* Create a new bloom filter for the result */
 
-    BloomFilter *result = bloomfilter_new(filter1->tableSize,
-                             filter1->hashFunc,
-                             filter1->numFunctions);
+    BloomFilter *result
+        = bloomfilter_newWithAllocator(filter1->tableSize,
+                                       filter1->hashFunc,
+                                       filter1->numFunctions,
+                                       filter1->layout,
+                                       filter1->usage.allocator);
 
 	if (result == NULL) {
 		return NULL;
@@ -262,3 +590,226 @@ BloomFilter *bloomfilter_intersection(BloomFilter *filter1, BloomFilter *filter2
 
 	return result;
 }
+
+/* Values in a batch, already hashed: for each, the index of the first
+ * 32-bit word of its block, and the first bit position and step for
+ * double hashing.  Unused entries are zero, which is a valid block. */
+
+typedef struct {
+    unsigned int blockWord[BLOOM_FILTER_BATCH_SIZE];
+    unsigned int position[BLOOM_FILTER_BATCH_SIZE];
+    unsigned int step[BLOOM_FILTER_BATCH_SIZE];
+} BloomFilterBatch;
+
+/* Function testing the values of a batch, returning a bitmask of those
+ * which may be in the filter */
+
+typedef unsigned int (*BloomFilterBatchFunc)(BloomFilter *bloomfilter,
+                                             BloomFilterBatch *batch,
+                                             unsigned int count);
+
+static unsigned int bloomfilter_testBatch(BloomFilter *bloomfilter,
+                                          BloomFilterBatch *batch,
+                                          unsigned int count)
+{
+    unsigned char *block;
+    unsigned int position;
+    unsigned int result = 0;
+    unsigned int bit;
+    unsigned int i;
+    unsigned int j;
+
+    for (j=0; j<count; ++j) {
+        block = bloomfilter->table + batch->blockWord[j] * 4;
+        position = batch->position[j];
+
+        for (i=0; i<bloomfilter->numFunctions; ++i) {
+            bit = position % BLOOM_FILTER_BLOCK_BITS;
+
+            if ((block[bit / 8] & (1 << (bit % 8))) == 0) {
+                break;
+            }
+
+            position += batch->step[j];
+        }
+
+        if (i == bloomfilter->numFunctions) {
+            result |= 1U << j;
+        }
+    }
+
+    return result;
+}
+
+#ifdef BLOOM_FILTER_USE_X86_SIMD
+
+/* The SIMD versions read the table as little-endian 32-bit words, in
+ * which bit n of the block is bit n % 32 of word n / 32, as it is in
+ * the byte layout.  For each hash function in turn, the word holding
+ * the bit of every value in the batch is gathered at once. */
+
+__attribute__((target("avx2")))
+static unsigned int bloomfilter_testBatchAvx2(BloomFilter *bloomfilter,
+                                              BloomFilterBatch *batch,
+                                              unsigned int count)
+{
+    const int *table = (const int *) bloomfilter->table;
+    __m256i bitMask = _mm256_set1_epi32(BLOOM_FILTER_BLOCK_BITS - 1);
+    __m256i shiftMask = _mm256_set1_epi32(31);
+    __m256i one = _mm256_set1_epi32(1);
+    __m256i blockWord;
+    __m256i position;
+    __m256i step;
+    __m256i found;
+    __m256i bit;
+    __m256i words;
+    unsigned int result = 0;
+    unsigned int half;
+    unsigned int i;
+
+    for (half=0; half<count; half+=8) {
+        blockWord = _mm256_loadu_si256(
+            (const __m256i *) (batch->blockWord + half));
+        position = _mm256_loadu_si256(
+            (const __m256i *) (batch->position + half));
+        step = _mm256_loadu_si256((const __m256i *) (batch->step + half));
+        found = one;
+
+		/* Stop as soon as every value has a bit missing */
+
+        for (i=0; i<bloomfilter->numFunctions
+                  && !_mm256_testz_si256(found, found); ++i) {
+            bit = _mm256_and_si256(position, bitMask);
+            words = _mm256_i32gather_epi32(
+                table,
+                _mm256_add_epi32(blockWord, _mm256_srli_epi32(bit, 5)),
+                4);
+            words = _mm256_srlv_epi32(words,
+                                      _mm256_and_si256(bit, shiftMask));
+            found = _mm256_and_si256(found, words);
+            position = _mm256_add_epi32(position, step);
+        }
+
+        result |= (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(
+                      _mm256_cmpeq_epi32(found, one))) << half;
+    }
+
+    return result & (0xffffffffU >> (32 - count));
+}
+
+__attribute__((target("avx512f")))
+static unsigned int bloomfilter_testBatchAvx512(BloomFilter *bloomfilter,
+                                                BloomFilterBatch *batch,
+                                                unsigned int count)
+{
+    __m512i bitMask = _mm512_set1_epi32(BLOOM_FILTER_BLOCK_BITS - 1);
+    __m512i shiftMask = _mm512_set1_epi32(31);
+    __m512i one = _mm512_set1_epi32(1);
+    __m512i blockWord = _mm512_loadu_si512(batch->blockWord);
+    __m512i position = _mm512_loadu_si512(batch->position);
+    __m512i step = _mm512_loadu_si512(batch->step);
+    __m512i bit;
+    __m512i words;
+    __mmask16 found = (__mmask16) (0xffffU >> (16 - count));
+    unsigned int i;
+
+	/* Only the words of values not yet ruled out are gathered */
+
+    for (i=0; i<bloomfilter->numFunctions && found != 0; ++i) {
+        bit = _mm512_and_si512(position, bitMask);
+        words = _mm512_mask_i32gather_epi32(
+            _mm512_setzero_si512(), found,
+            _mm512_add_epi32(blockWord, _mm512_srli_epi32(bit, 5)),
+            bloomfilter->table, 4);
+        words = _mm512_srlv_epi32(words, _mm512_and_si512(bit, shiftMask));
+        found = _mm512_mask_test_epi32_mask(found, words, one);
+        position = _mm512_add_epi32(position, step);
+    }
+
+    return found;
+}
+
+#endif
+
+/* Pick the fastest way of testing a batch which this CPU supports */
+
+static BloomFilterBatchFunc bloomfilter_batchFunc(void)
+{
+#ifdef BLOOM_FILTER_USE_X86_SIMD
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f")) {
+        return bloomfilter_testBatchAvx512;
+    }
+
+    if (__builtin_cpu_supports("avx2")) {
+        return bloomfilter_testBatchAvx2;
+    }
+#endif
+
+    return bloomfilter_testBatch;
+}
+
+void bloomfilter_queryBatch(BloomFilter *bloomfilter,
+                            BloomFilterValue *values,
+                            unsigned int n,
+                            unsigned char *outBitmap)
+{
+    BloomFilterBatchFunc testBatch;
+    BloomFilterBatch batch;
+    unsigned char *block;
+    unsigned int result;
+    unsigned int count;
+    unsigned int start;
+    unsigned int j;
+
+	/* Values in the standard layout are tested one at a time, since
+	 * each bit may be anywhere in the table */
+
+    if (bloomfilter->layout != BLOOM_FILTER_LAYOUT_BLOCKED) {
+        memset(outBitmap, 0, (n + 7) / 8);
+
+        for (j=0; j<n; ++j) {
+            if (bloomfilter_query(bloomfilter, values[j])) {
+                outBitmap[j / 8] |= (unsigned char) (1 << (j % 8));
+            }
+        }
+
+        return;
+    }
+
+    testBatch = bloomfilter_batchFunc();
+
+    for (start=0; start<n; start+=BLOOM_FILTER_BATCH_SIZE) {
+        count = n - start;
+
+        if (count > BLOOM_FILTER_BATCH_SIZE) {
+            count = BLOOM_FILTER_BATCH_SIZE;
+        }
+
+		/* Hash every value in the batch first, prefetching its block,
+		 * so that the cache misses of the whole batch overlap */
+
+        memset(&batch, 0, sizeof(batch));
+
+        for (j=0; j<count; ++j) {
+            block = bloomfilter_block(bloomfilter, values[start + j],
+                                      &batch.position[j], &batch.step[j]);
+            batch.blockWord[j] = (unsigned int)
+                ((block - bloomfilter->table) / 4);
+#if defined(__GNUC__)
+            __builtin_prefetch(block);
+#endif
+        }
+
+        result = testBatch(bloomfilter, &batch, count);
+
+		/* Batches start on a byte boundary of the bitmap */
+
+        outBitmap[start / 8] = (unsigned char) result;
+
+        if (count > 8) {
+            outBitmap[start / 8 + 1] = (unsigned char) (result >> 8);
+        }
+    }
+}
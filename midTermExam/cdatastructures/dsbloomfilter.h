@@ -12,14 +12,22 @@
  * bloom filter, use @ref bloomfilter_free.
  *
  * To insert a value into a bloom filter, use @ref bloomfilter_insert.
+ * Several threads can fill one filter at once, without locking, with
+ * @ref bloomfilter_insertConcurrent.
  *
  * To query whether a value is part of the set, use
  * @ref bloomfilter_query.
+ *
+ * A filter created with @ref bloomfilter_newWithLayout can use the
+ * blocked layout, which keeps all of the bits for a value in one cache
+ * line so that each query costs a single cache miss.
  */
 
 #ifndef DSBLOOMFILTER_H
 #define DSBLOOMFILTER_H
 
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -46,6 +54,27 @@ typedef void *BloomFilterValue;
 
 typedef unsigned int (*BloomFilterHashFunc)(BloomFilterValue data);
 
+/**
+ * Layout of the bits in the table of a @ref BloomFilter.
+ */
+
+typedef enum {
+	/** Each hash function picks any bit in the table. */
+
+	BLOOM_FILTER_LAYOUT_STANDARD,
+
+	/** The table is split into blocks of 512 bits, one cache line
+	 *  each.  The hash of a value picks one block, and all bits for the
+	 *  value are set within it.  The bits are derived from a 64-bit
+	 *  mix of the hash by double hashing, without any division.  This
+	 *  gives a slightly higher false positive rate than the standard
+	 *  layout for the same table size, but inserts and queries touch
+	 *  only one cache line.  The table size is rounded up to a
+	 *  multiple of 512. */
+
+	BLOOM_FILTER_LAYOUT_BLOCKED
+} BloomFilterLayout;
+
 /**
  * Create a new bloom filter.
  *
@@ -70,6 +99,90 @@ BloomFilter *bloomfilter_new(unsigned int tableSize,
                              BloomFilterHashFunc hashFunc,
                              unsigned int numFunctions);
 
+/**
+ * Find the table size and number of hash functions which give a
+ * bloom filter with the least memory for a number of values and a
+ * false positive rate.
+ *
+ * @param capacity         The number of values to be inserted.
+ * @param falsePositiveRate  The largest chance of a false positive
+ *                         once that many values have been inserted,
+ *                         between 0 and 1.
+ * @param tableSize        Pointer to a variable to receive the table
+ *                         size.
+ * @param numFunctions     Pointer to a variable to receive the number
+ *                         of hash functions.
+ * @return                 Non-zero on success, or zero if the arguments
+ *                         are out of range or the table would be too
+ *                         large.
+ */
+
+int bloomfilter_optimalSize(unsigned int capacity,
+                            double falsePositiveRate,
+                            unsigned int *tableSize,
+                            unsigned int *numFunctions);
+
+/**
+ * Create a new bloom filter sized for a number of values and a false
+ * positive rate, using @ref bloomfilter_optimalSize.
+ *
+ * @param capacity         The number of values to be inserted.
+ * @param falsePositiveRate  The largest chance of a false positive
+ *                         once that many values have been inserted,
+ *                         between 0 and 1.
+ * @param hashFunc         Hash function to use on values stored in the
+ *                         filter.
+ * @return                 A new bloom filter, or NULL if the arguments
+ *                         are out of range or it was not possible to
+ *                         allocate the new bloom filter.
+ */
+
+BloomFilter *bloomfilter_newForCapacity(unsigned int capacity,
+                                        double falsePositiveRate,
+                                        BloomFilterHashFunc hashFunc);
+
+/**
+ * Create a new bloom filter using a particular layout.
+ *
+ * @param tableSize        The size of the bloom filter.
+ * @param hashFunc         Hash function to use on values stored in the
+ *                         filter.
+ * @param numFunctions     Number of hash functions to apply to each
+ *                         element on insertion.  The maximum number of
+ *                         functions is 64.
+ * @param layout           The layout of the table.
+ * @return                 A new bloom filter, or NULL if it was not
+ *                         possible to allocate the new bloom filter.
+ */
+
+BloomFilter *bloomfilter_newWithLayout(unsigned int tableSize,
+                                       BloomFilterHashFunc hashFunc,
+                                       unsigned int numFunctions,
+                                       BloomFilterLayout layout);
+
+/**
+ * Create a new bloom filter which allocates its memory from a
+ * particular allocator.
+ *
+ * @param tableSize        The size of the bloom filter.
+ * @param hashFunc         Hash function to use on values stored in the
+ *                         filter.
+ * @param numFunctions     Number of hash functions to apply to each
+ *                         element on insertion.  The maximum number of
+ *                         functions is 64.
+ * @param layout           The layout of the table.
+ * @param allocator        The allocator to use, or NULL to use the
+ *                         default allocator.
+ * @return                 A new bloom filter, or NULL if it was not
+ *                         possible to allocate the new bloom filter.
+ */
+
+BloomFilter *bloomfilter_newWithAllocator(unsigned int tableSize,
+                                          BloomFilterHashFunc hashFunc,
+                                          unsigned int numFunctions,
+                                          BloomFilterLayout layout,
+                                          const Allocator *allocator);
+
 /**
  * Destroy a bloom filter.
  *
@@ -78,6 +191,15 @@ BloomFilter *bloomfilter_new(unsigned int tableSize,
 
 void bloomfilter_free(BloomFilter *bloomfilter);
 
+/**
+ * Retrieve the number of bytes of memory allocated by a bloom filter.
+ *
+ * @param bloomfilter      The bloom filter.
+ * @return                 The number of bytes allocated.
+ */
+
+size_t bloomfilter_memoryUsage(BloomFilter *bloomfilter);
+
 /**
  * Insert a value into a bloom filter.
  *
@@ -87,6 +209,20 @@ void bloomfilter_free(BloomFilter *bloomfilter);
 
 void bloomfilter_insert(BloomFilter *bloomfilter, BloomFilterValue value);
 
+/**
+ * Insert a value into a bloom filter, from any number of threads at
+ * once.  Bits are set with atomic OR operations, so no insert is lost;
+ * no lock is needed.  Other functions on the filter, including
+ * @ref bloomfilter_query, must not run at the same time: the threads
+ * inserting must be synchronised with (for example, joined) first.
+ *
+ * @param bloomfilter          The bloom filter.
+ * @param value                The value to insert.
+ */
+
+void bloomfilter_insertConcurrent(BloomFilter *bloomfilter,
+                                  BloomFilterValue value);
+
 /**
  * Query a bloom filter for a particular value.
  *
@@ -100,13 +236,38 @@ void bloomfilter_insert(BloomFilter *bloomfilter, BloomFilterValue value);
 
 int bloomfilter_query(BloomFilter *bloomfilter, BloomFilterValue value);
 
+/**
+ * Query a bloom filter for many values at once.  This gives the same
+ * results as calling @ref bloomfilter_query on each value in turn.
+ * For filters using @ref BLOOM_FILTER_LAYOUT_BLOCKED it is much
+ * faster: the blocks for several values are fetched from memory at
+ * once, and on CPUs supporting AVX2 or AVX-512 the bits of 8 or 16
+ * values are tested together.  The instructions used are picked when
+ * the function is called, from those the CPU supports.
+ *
+ * @param bloomfilter          The bloom filter.
+ * @param values               Array of values to look up.
+ * @param n                    Number of values in the array.
+ * @param outBitmap            Array of (n + 7) / 8 bytes.  Bit (i % 8) of
+ *                             byte (i / 8) is set to one if value i may
+ *                             have been inserted, or zero if it was
+ *                             definitely not inserted.  Unused bits of
+ *                             the last byte are set to zero.
+ */
+
+void bloomfilter_queryBatch(BloomFilter *bloomfilter,
+                            BloomFilterValue *values,
+                            unsigned int n,
+                            unsigned char *outBitmap);
+
 /**
  * Read the contents of a bloom filter into an array.
  *
  * @param bloomfilter          The bloom filter.
  * @param array                Pointer to the array to read into.  This
  *                             should be (table_size + 7) / 8 bytes in
- *                             length.
+ *                             length, after rounding the table size up
+ *                             for @ref BLOOM_FILTER_LAYOUT_BLOCKED.
  */
 
 void bloomfilter_read(BloomFilter *bloomfilter, unsigned char *array);
@@ -120,7 +281,8 @@ void bloomfilter_read(BloomFilter *bloomfilter, unsigned char *array);
  * @param bloomfilter          The bloom filter.
  * @param array                Pointer to the array to load from.  This
  *                             should be (table_size + 7) / 8 bytes in
- *                             length.
+ *                             length, after rounding the table size up
+ *                             for @ref BLOOM_FILTER_LAYOUT_BLOCKED.
  */
 
 void bloomfilter_load(BloomFilter *bloomfilter, unsigned char *array);
@@ -131,7 +293,8 @@ void bloomfilter_load(BloomFilter *bloomfilter, unsigned char *array);
  * filters.
  *
  * Both of the original filters must have been created using the
- * same parameters to @ref bloom_filter_new.
+ * same parameters to @ref bloom_filter_new.  The new filter uses the
+ * allocator of the first filter.
  *
  * @param filter1              The first filter.
  * @param filter2              The second filter.
@@ -150,7 +313,8 @@ BloomFilter *bloomfilter_union(BloomFilter *filter1, BloomFilter *filter2);
  * original filters.
  *
  * Both of the original filters must have been created using the
- * same parameters to @ref bloom_filter_new.
+ * same parameters to @ref bloom_filter_new.  The new filter uses the
+ * allocator of the first filter.
  *
  * @param filter1              The first filter.
  * @param filter2              The second filter.
@@ -0,0 +1,528 @@
+/* Fixed-capacity cache */
+
+#include <stdlib.h>
+
+#include "dscache.h"
+#include "dshashint.h"
+
+
+typedef struct _CacheEntry CacheEntry;
+
+/* Each entry is on one hash chain, through chainNext, and on the
+ * recency list, through newer and older.  Unused entries are kept on a
+ * free list through chainNext. */
+
+struct _CacheEntry {
+    CacheKey key;
+    CacheValue value;
+    unsigned int hash;
+    int used;
+    CacheEntry *chainNext;
+    CacheEntry *newer;
+    CacheEntry *older;
+};
+
+/* The recency list runs from the newest entry to the oldest.  For LRU
+ * the oldest is the least recently used; for CLOCK and SIEVE the hand
+ * moves from the oldest entry towards the newest, and back round to the
+ * oldest.  A NULL hand stands for the oldest entry. */
+
+struct _Cache {
+    AllocatorUsage usage;
+    CachePolicy policy;
+    HashTableHashFunc hashFunc;
+    HashTableEqualFunc equalFunc;
+    HashTableKeyFreeFunc keyFreeFunc;
+    HashTableValueFreeFunc valueFreeFunc;
+    CacheEvictFunc evictFunc;
+    void *evictContext;
+    unsigned int capacity;
+    unsigned int entries;
+    CacheEntry *entryArray;
+    CacheEntry *freeList;
+    CacheEntry **table;
+    unsigned int tableSize;
+    CacheEntry *newest;
+    CacheEntry *oldest;
+    CacheEntry *hand;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
+/* The table has a power of two number of chains, at least as many as
+ * the capacity, so chains hold one entry on average at most */
+
+#define CACHE_MAX_TABLE_SIZE 0x80000000U
+
+/* Mix the bits of a hash, so that the low bits used to choose a chain
+ * depend on all of them */
+
+static unsigned int cache_hash(Cache *cache, CacheKey key)
+{
+    return intMix(cache->hashFunc(key));
+}
+
+static CacheEntry **cache_chain(Cache *cache, unsigned int hash)
+{
+    return &cache->table[hash & (cache->tableSize - 1)];
+}
+
+/* Chain all the entries into the free list, in order, so that a new
+ * cache fills its entry array from the start */
+
+static void cache_initFreeList(Cache *cache)
+{
+    unsigned int i;
+
+    cache->freeList = NULL;
+
+    for (i=cache->capacity; i>0; --i) {
+        cache->entryArray[i - 1].chainNext = cache->freeList;
+        cache->freeList = &cache->entryArray[i - 1];
+    }
+}
+
+static void cache_freeStructure(Cache *cache)
+{
+    AllocatorUsage usage = cache->usage;
+
+    allocator_free(&usage, cache, sizeof(Cache));
+}
+
+Cache *cache_new(unsigned int capacity,
+                 HashTableHashFunc hashFunc,
+                 HashTableEqualFunc equalFunc,
+                 CachePolicy policy)
+{
+    return cache_newWithAllocator(capacity, hashFunc, equalFunc, policy,
+                                  NULL);
+}
+
+Cache *cache_newWithAllocator(unsigned int capacity,
+                              HashTableHashFunc hashFunc,
+                              HashTableEqualFunc equalFunc,
+                              CachePolicy policy,
+                              const Allocator *allocator)
+{
+    AllocatorUsage usage;
+    Cache *cache;
+    unsigned int tableSize;
+
+    if (capacity == 0 || capacity > CACHE_MAX_TABLE_SIZE) {
+        return NULL;
+    }
+
+    allocator_initUsage(&usage, allocator);
+
+    cache = (Cache *) allocator_malloc(&usage, sizeof(Cache));
+
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->usage = usage;
+
+    tableSize = 16;
+
+    while (tableSize < capacity) {
+        tableSize <<= 1;
+    }
+
+	/* All the entries are allocated now, so that nothing is allocated
+	 * while the cache is in use */
+
+    cache->entryArray = (CacheEntry *) allocator_malloc(
+        &cache->usage, (size_t) capacity * sizeof(CacheEntry));
+
+    if (cache->entryArray == NULL) {
+        cache_freeStructure(cache);
+
+        return NULL;
+    }
+
+    cache->table = (CacheEntry **) allocator_calloc(&cache->usage,
+                                                    tableSize,
+                                                    sizeof(CacheEntry *));
+
+    if (cache->table == NULL) {
+        allocator_free(&cache->usage, cache->entryArray,
+                       (size_t) capacity * sizeof(CacheEntry));
+        cache_freeStructure(cache);
+
+        return NULL;
+    }
+
+    cache->policy = policy;
+    cache->hashFunc = hashFunc;
+    cache->equalFunc = equalFunc;
+    cache->keyFreeFunc = NULL;
+    cache->valueFreeFunc = NULL;
+    cache->evictFunc = NULL;
+    cache->evictContext = NULL;
+    cache->capacity = capacity;
+    cache->entries = 0;
+    cache->tableSize = tableSize;
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->hand = NULL;
+    cache_resetStats(cache);
+
+    cache_initFreeList(cache);
+
+    return cache;
+}
+
+/* Call the free functions for the key and value of an entry */
+
+static void cache_freeEntryData(Cache *cache, CacheEntry *entry)
+{
+    if (cache->keyFreeFunc != NULL) {
+        cache->keyFreeFunc(entry->key);
+    }
+
+    if (cache->valueFreeFunc != NULL) {
+        cache->valueFreeFunc(entry->value);
+    }
+}
+
+void cache_free(Cache *cache)
+{
+    cache_clear(cache);
+
+    allocator_free(&cache->usage, cache->table,
+                   (size_t) cache->tableSize * sizeof(CacheEntry *));
+    allocator_free(&cache->usage, cache->entryArray,
+                   (size_t) cache->capacity * sizeof(CacheEntry));
+    cache_freeStructure(cache);
+}
+
+void cache_registerFreeFunctions(Cache *cache,
+                                 HashTableKeyFreeFunc keyFreeFunc,
+                                 HashTableValueFreeFunc valueFreeFunc)
+{
+    cache->keyFreeFunc = keyFreeFunc;
+    cache->valueFreeFunc = valueFreeFunc;
+}
+
+void cache_setEvictFunc(Cache *cache, CacheEvictFunc evictFunc,
+                        void *context)
+{
+    cache->evictFunc = evictFunc;
+    cache->evictContext = context;
+}
+
+/* Find the link in a chain which points to the entry for a key.  The
+ * link holds NULL if the key is not in the cache. */
+
+static CacheEntry **cache_findLink(Cache *cache, CacheKey key,
+                                   unsigned int hash)
+{
+    CacheEntry **link = cache_chain(cache, hash);
+
+    while (*link != NULL) {
+        if ((*link)->hash == hash && cache->equalFunc((*link)->key, key)) {
+            break;
+        }
+
+        link = &(*link)->chainNext;
+    }
+
+    return link;
+}
+
+/* Take an entry out of the recency list.  If the hand is on it, the
+ * hand moves on to the next entry it would have looked at. */
+
+static void cache_unlink(Cache *cache, CacheEntry *entry)
+{
+    if (cache->hand == entry) {
+        cache->hand = entry->newer;
+    }
+
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+}
+
+/* Add an entry to the recency list, as the newest entry */
+
+static void cache_linkNewest(Cache *cache, CacheEntry *entry)
+{
+    entry->newer = NULL;
+    entry->older = cache->newest;
+
+    if (cache->newest != NULL) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+
+    cache->newest = entry;
+}
+
+/* Add an entry to the recency list just behind the hand, so that it is
+ * the last entry the hand reaches.  Behind the oldest entry is the
+ * newest, as the hand wraps round. */
+
+static void cache_linkBehindHand(Cache *cache, CacheEntry *entry)
+{
+    CacheEntry *hand = cache->hand;
+
+    if (hand == NULL || hand == cache->oldest) {
+        cache_linkNewest(cache, entry);
+
+        return;
+    }
+
+    entry->newer = hand;
+    entry->older = hand->older;
+    hand->older->newer = entry;
+    hand->older = entry;
+}
+
+/* Mark an entry as used */
+
+static void cache_touch(Cache *cache, CacheEntry *entry)
+{
+    if (cache->policy == CACHE_POLICY_LRU) {
+        if (cache->newest != entry) {
+            cache_unlink(cache, entry);
+            cache_linkNewest(cache, entry);
+        }
+    } else {
+        entry->used = 1;
+    }
+}
+
+/* Remove an entry from its chain and the recency list, and put it on
+ * the free list */
+
+static void cache_removeEntry(Cache *cache, CacheEntry **link)
+{
+    CacheEntry *entry = *link;
+
+    *link = entry->chainNext;
+    cache_unlink(cache, entry);
+
+    entry->chainNext = cache->freeList;
+    cache->freeList = entry;
+    --cache->entries;
+}
+
+/* Choose the entry to evict */
+
+static CacheEntry *cache_victim(Cache *cache)
+{
+    CacheEntry *entry;
+
+    if (cache->policy == CACHE_POLICY_LRU) {
+        return cache->oldest;
+    }
+
+	/* Sweep the hand round, giving each used entry a second chance.
+	 * This ends within one turn, since every entry passed is cleared. */
+
+    entry = cache->hand != NULL ? cache->hand : cache->oldest;
+
+    while (entry->used) {
+        entry->used = 0;
+        entry = entry->newer != NULL ? entry->newer : cache->oldest;
+    }
+
+    return entry;
+}
+
+static void cache_evict(Cache *cache)
+{
+    CacheEntry *victim = cache_victim(cache);
+    CacheEntry **link;
+
+    if (cache->policy != CACHE_POLICY_LRU) {
+        cache->hand = victim;
+    }
+
+    ++cache->evictions;
+
+    if (cache->evictFunc != NULL) {
+        cache->evictFunc(victim->key, victim->value, cache->evictContext);
+    }
+
+	/* Unlinking moves the hand on past the victim.  The key and value
+	 * are still in the entry on the free list. */
+
+    link = cache_chain(cache, victim->hash);
+
+    while (*link != victim) {
+        link = &(*link)->chainNext;
+    }
+
+    cache_removeEntry(cache, link);
+    cache_freeEntryData(cache, victim);
+}
+
+void cache_put(Cache *cache, CacheKey key, CacheValue value)
+{
+    unsigned int hash = cache_hash(cache, key);
+    CacheEntry **link = cache_findLink(cache, key, hash);
+    CacheEntry *entry = *link;
+
+    if (entry != NULL) {
+
+		/* Replace the key and value, freeing the old ones */
+
+        if (cache->valueFreeFunc != NULL && entry->value != value) {
+            cache->valueFreeFunc(entry->value);
+        }
+
+        if (cache->keyFreeFunc != NULL && entry->key != key) {
+            cache->keyFreeFunc(entry->key);
+        }
+
+        entry->key = key;
+        entry->value = value;
+        cache_touch(cache, entry);
+
+        return;
+    }
+
+    if (cache->entries == cache->capacity) {
+        cache_evict(cache);
+
+		/* The victim may have been on the same chain */
+
+        link = cache_findLink(cache, key, hash);
+    }
+
+    entry = cache->freeList;
+    cache->freeList = entry->chainNext;
+
+    entry->key = key;
+    entry->value = value;
+    entry->hash = hash;
+    entry->chainNext = NULL;
+    *link = entry;
+
+	/* A new entry goes at the front for LRU and SIEVE.  For CLOCK it
+	 * goes where the hand is, which after an eviction is where the
+	 * victim was.  New CLOCK entries start with their bit set, as they
+	 * have just been used; new SIEVE entries do not, so that entries
+	 * never used again are evicted on the hand's next pass. */
+
+    if (cache->policy == CACHE_POLICY_CLOCK) {
+        entry->used = 1;
+        cache_linkBehindHand(cache, entry);
+    } else {
+        entry->used = 0;
+        cache_linkNewest(cache, entry);
+    }
+
+    ++cache->entries;
+}
+
+CacheValue cache_get(Cache *cache, CacheKey key)
+{
+    CacheEntry *entry = *cache_findLink(cache, key, cache_hash(cache, key));
+
+    if (entry == NULL) {
+        ++cache->misses;
+
+        return CACHE_NULL;
+    }
+
+    ++cache->hits;
+    cache_touch(cache, entry);
+
+    return entry->value;
+}
+
+CacheValue cache_peek(Cache *cache, CacheKey key)
+{
+    CacheEntry *entry = *cache_findLink(cache, key, cache_hash(cache, key));
+
+    if (entry == NULL) {
+        return CACHE_NULL;
+    }
+
+    return entry->value;
+}
+
+int cache_remove(Cache *cache, CacheKey key)
+{
+    CacheEntry **link = cache_findLink(cache, key, cache_hash(cache, key));
+    CacheEntry *entry = *link;
+
+    if (entry == NULL) {
+        return 0;
+    }
+
+	/* The entry is taken out before its key is freed, as the key may
+	 * be the one passed in */
+
+    cache_removeEntry(cache, link);
+    cache_freeEntryData(cache, entry);
+
+    return 1;
+}
+
+void cache_clear(Cache *cache)
+{
+    CacheEntry *entry;
+    unsigned int i;
+
+    for (entry=cache->newest; entry != NULL; entry=entry->older) {
+        cache_freeEntryData(cache, entry);
+    }
+
+    for (i=0; i<cache->tableSize; ++i) {
+        cache->table[i] = NULL;
+    }
+
+    cache_initFreeList(cache);
+
+    cache->entries = 0;
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->hand = NULL;
+}
+
+unsigned int cache_numEntries(Cache *cache)
+{
+    return cache->entries;
+}
+
+unsigned int cache_capacity(Cache *cache)
+{
+    return cache->capacity;
+}
+
+size_t cache_memoryUsage(Cache *cache)
+{
+    return cache->usage.bytesUsed;
+}
+
+void cache_stats(Cache *cache, CacheStats *stats)
+{
+    unsigned long gets = cache->hits + cache->misses;
+
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->hitRate = gets > 0 ? (double) cache->hits / gets : 0.0;
+}
+
+void cache_resetStats(Cache *cache)
+{
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+}
+
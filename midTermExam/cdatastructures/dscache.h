@@ -0,0 +1,318 @@
+/**
+ * @file dscache.h
+ *
+ * @brief Fixed-capacity cache.
+ *
+ * A cache maps keys to values, like a @ref HashTable, but holds at
+ * most a fixed number of entries.  When a new key is added to a full
+ * cache, an existing entry is chosen by the cache's eviction policy and
+ * removed to make room for it.
+ *
+ * All the memory a cache needs is allocated when it is created: each
+ * entry holds its own links for the hash chains and for the recency
+ * order, so looking up, adding and evicting entries never allocate or
+ * free memory, and all take constant time.
+ *
+ * Keys are hashed and compared with the same functions as a
+ * @ref HashTable, for example @ref stringHash and @ref stringEqual.
+ *
+ * To create a cache, use @ref cache_new.  To destroy a cache, use
+ * @ref cache_free.
+ *
+ * To add a value to a cache, use @ref cache_put.  To look up a value,
+ * use @ref cache_get, or @ref cache_peek to look without counting as a
+ * use of the entry.  To remove a value, use @ref cache_remove.
+ *
+ * To be told when entries are evicted, use @ref cache_setEvictFunc.
+ * To read the number of hits, misses and evictions, use
+ * @ref cache_stats.
+ */
+
+#ifndef DSCACHE_H
+#define DSCACHE_H
+
+#include <stddef.h>
+
+#include "dsallocator.h"
+#include "dshashtable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A cache structure.
+ */
+
+typedef struct _Cache Cache;
+
+/**
+ * A key to look up a value in a @ref Cache.
+ */
+
+typedef HashTableKey CacheKey;
+
+/**
+ * A value stored in a @ref Cache.
+ */
+
+typedef HashTableValue CacheValue;
+
+/**
+ * A null @ref CacheValue.
+ */
+
+#define CACHE_NULL ((void *) 0)
+
+/**
+ * Policy used by a @ref Cache to choose which entry to evict.
+ */
+
+typedef enum {
+	/** Least recently used: evict the entry which has gone longest
+	 *  without being used.  Each hit moves the entry to the front of
+	 *  the recency list. */
+
+	CACHE_POLICY_LRU,
+
+	/** CLOCK: entries are kept in a ring with a "used" bit, which a
+	 *  hit sets.  A hand sweeps the ring, clearing bits, and evicts the
+	 *  first entry whose bit is clear.  New entries take the place of
+	 *  the evicted one.  Hits only set a bit, so are cheaper than with
+	 *  LRU. */
+
+	CACHE_POLICY_CLOCK,
+
+	/** SIEVE: like CLOCK, but new entries are added at the head of
+	 *  the queue rather than where the hand is, so that entries which
+	 *  are never used again are evicted quickly.  Usually gives a
+	 *  better hit rate than LRU for web and key-value workloads. */
+
+	CACHE_POLICY_SIEVE
+} CachePolicy;
+
+/**
+ * Function called when an entry is evicted from a cache to make room
+ * for a new one.  It is called before the key and value are freed by
+ * the functions given to @ref cache_registerFreeFunctions.
+ *
+ * @param key      The key of the evicted entry.
+ * @param value    The value of the evicted entry.
+ * @param context  The context pointer passed to
+ *                 @ref cache_setEvictFunc.
+ */
+
+typedef void (*CacheEvictFunc)(CacheKey key, CacheValue value,
+                               void *context);
+
+/**
+ * Create a new cache.
+ *
+ * @param capacity           The largest number of entries the cache can
+ *                           hold.
+ * @param hashFunc           Function used to generate hash keys for the
+ *                           keys used in the cache.
+ * @param equalFunc          Function used to test keys used in the cache
+ *                           for equality.
+ * @param policy             The eviction policy.
+ * @return                   A new cache, or NULL if the capacity is zero
+ *                           or it was not possible to allocate the
+ *                           memory.
+ */
+
+Cache *cache_new(unsigned int capacity,
+                 HashTableHashFunc hashFunc,
+                 HashTableEqualFunc equalFunc,
+                 CachePolicy policy);
+
+/**
+ * Create a new cache which allocates its memory from a particular
+ * allocator.
+ *
+ * @param capacity           The largest number of entries the cache can
+ *                           hold.
+ * @param hashFunc           Function used to generate hash keys for the
+ *                           keys used in the cache.
+ * @param equalFunc          Function used to test keys used in the cache
+ *                           for equality.
+ * @param policy             The eviction policy.
+ * @param allocator          The allocator to use, or NULL to use the
+ *                           default allocator.
+ * @return                   A new cache, or NULL if the capacity is zero
+ *                           or it was not possible to allocate the
+ *                           memory.
+ */
+
+Cache *cache_newWithAllocator(unsigned int capacity,
+                              HashTableHashFunc hashFunc,
+                              HashTableEqualFunc equalFunc,
+                              CachePolicy policy,
+                              const Allocator *allocator);
+
+/**
+ * Destroy a cache.  The free functions are called for every entry
+ * still in the cache; the eviction function is not.
+ *
+ * @param cache              The cache to destroy.
+ */
+
+void cache_free(Cache *cache);
+
+/**
+ * Register functions used to free the key and value when an entry is
+ * removed from a cache, whether it is evicted, removed, replaced or
+ * the cache is destroyed.
+ *
+ * @param cache              The cache.
+ * @param keyFreeFunc        Function used to free keys, or NULL.
+ * @param valueFreeFunc      Function used to free values, or NULL.
+ */
+
+void cache_registerFreeFunctions(Cache *cache,
+                                 HashTableKeyFreeFunc keyFreeFunc,
+                                 HashTableValueFreeFunc valueFreeFunc);
+
+/**
+ * Set a function to be called when an entry is evicted from a cache.
+ *
+ * @param cache              The cache.
+ * @param evictFunc          The function, or NULL for none.
+ * @param context            Context pointer to pass to the function.
+ */
+
+void cache_setEvictFunc(Cache *cache, CacheEvictFunc evictFunc,
+                        void *context);
+
+/**
+ * Add a value to a cache.  If the key is already in the cache, its key
+ * and value are replaced, as with @ref hashtable_insert.  Otherwise, if
+ * the cache is full, an entry is first evicted according to the
+ * cache's policy.  Either way the entry counts as used.
+ *
+ * @param cache              The cache.
+ * @param key                The key.
+ * @param value              The value.
+ */
+
+void cache_put(Cache *cache, CacheKey key, CacheValue value);
+
+/**
+ * Look up a value in a cache, counting a hit or a miss.  On a hit the
+ * entry counts as used.
+ *
+ * @param cache              The cache.
+ * @param key                The key.
+ * @return                   The value, or @ref CACHE_NULL if the key is
+ *                           not in the cache.
+ */
+
+CacheValue cache_get(Cache *cache, CacheKey key);
+
+/**
+ * Look up a value in a cache without counting a hit or a miss, and
+ * without the entry counting as used.
+ *
+ * @param cache              The cache.
+ * @param key                The key.
+ * @return                   The value, or @ref CACHE_NULL if the key is
+ *                           not in the cache.
+ */
+
+CacheValue cache_peek(Cache *cache, CacheKey key);
+
+/**
+ * Remove an entry from a cache.
+ *
+ * @param cache              The cache.
+ * @param key                The key of the entry to remove.
+ * @return                   Non-zero if an entry was removed, or zero if
+ *                           the key was not in the cache.
+ */
+
+int cache_remove(Cache *cache, CacheKey key);
+
+/**
+ * Remove all entries from a cache.  The free functions are called for
+ * every entry; the eviction function is not.
+ *
+ * @param cache              The cache.
+ */
+
+void cache_clear(Cache *cache);
+
+/**
+ * Retrieve the number of entries in a cache.
+ *
+ * @param cache              The cache.
+ * @return                   The number of entries.
+ */
+
+unsigned int cache_numEntries(Cache *cache);
+
+/**
+ * Retrieve the capacity of a cache.
+ *
+ * @param cache              The cache.
+ * @return                   The largest number of entries the cache can
+ *                           hold.
+ */
+
+unsigned int cache_capacity(Cache *cache);
+
+/**
+ * Retrieve the number of bytes of memory used by a cache, not counting
+ * the keys and values.
+ *
+ * @param cache              The cache.
+ * @return                   The number of bytes allocated.
+ */
+
+size_t cache_memoryUsage(Cache *cache);
+
+/**
+ * Counts kept by a @ref Cache, filled in by @ref cache_stats.
+ */
+
+typedef struct _CacheStats {
+
+	/** Number of calls to @ref cache_get which found the key. */
+
+    unsigned long hits;
+
+	/** Number of calls to @ref cache_get which did not find the key. */
+
+    unsigned long misses;
+
+	/** Number of entries evicted to make room for new ones. */
+
+    unsigned long evictions;
+
+	/** Hits as a fraction of all calls to @ref cache_get, or zero if
+	 *  there have been none. */
+
+    double hitRate;
+} CacheStats;
+
+/**
+ * Retrieve the counts kept by a cache.
+ *
+ * @param cache              The cache.
+ * @param stats              Structure to fill in.
+ */
+
+void cache_stats(Cache *cache, CacheStats *stats);
+
+/**
+ * Reset the counts kept by a cache to zero.
+ *
+ * @param cache              The cache.
+ */
+
+void cache_resetStats(Cache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSCACHE_H */
+
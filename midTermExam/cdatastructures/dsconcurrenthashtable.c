@@ -0,0 +1,755 @@
+/* Concurrent hash table implementation */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "dsconcurrenthashtable.h"
+#include "dshashint.h"
+
+
+typedef struct _ConcurrentHashTableEntry ConcurrentHashTableEntry;
+typedef struct _ConcurrentHashTableBuckets ConcurrentHashTableBuckets;
+typedef struct _ConcurrentHashTableShard ConcurrentHashTableShard;
+typedef struct _ConcurrentHashTableReader ConcurrentHashTableReader;
+
+/* Entries are immutable once linked into a chain, apart from their next
+ * pointer.  Replacing the value of a key links in a new entry instead,
+ * so that a lookup never sees a half-written pair. */
+
+struct _ConcurrentHashTableEntry {
+    HashTablePair pair;
+    unsigned int hash;
+    int ownsPair;
+    _Atomic(ConcurrentHashTableEntry *) next;
+    ConcurrentHashTableEntry *retiredNext;
+};
+
+struct _ConcurrentHashTableBuckets {
+    unsigned int size;
+    ConcurrentHashTableBuckets *retiredNext;
+    _Atomic(ConcurrentHashTableEntry *) chains[];
+};
+
+/* Entries and bucket arrays unlinked during an epoch are kept on the
+ * limbo list for that epoch (modulo 3) until the global epoch is two
+ * ahead, at which point no lookup can still be reading them.  All
+ * allocation and freeing for a shard happens with its lock held, so
+ * each shard keeps its own count of bytes allocated. */
+
+struct _ConcurrentHashTableShard {
+    pthread_mutex_t lock;
+    AllocatorUsage usage;
+    _Atomic(ConcurrentHashTableBuckets *) buckets;
+    _Atomic unsigned int entries;
+    ConcurrentHashTableEntry *retiredEntries[3];
+    ConcurrentHashTableBuckets *retiredBuckets[3];
+    unsigned long long retiredEpoch[3];
+};
+
+/* A reader slot is zero when free.  Otherwise it holds the global epoch
+ * observed by the lookup using it, shifted left with the low bit set.
+ * Each slot has a cache line to itself so that readers do not contend. */
+
+struct _ConcurrentHashTableReader {
+    _Atomic unsigned long long state;
+    char padding[64 - sizeof(unsigned long long)];
+};
+
+struct _ConcurrentHashTable {
+    AllocatorUsage usage;
+    HashTableHashFunc hashFunc;
+    HashTableEqualFunc equalFunc;
+    HashTableKeyFreeFunc keyFreeFunc;
+    HashTableValueFreeFunc valueFreeFunc;
+    ConcurrentHashTableShard *shards;
+    unsigned int numShards;
+    unsigned int shardBits;
+    _Atomic unsigned long long epoch;
+    ConcurrentHashTableReader readers[CONCURRENT_HASH_TABLE_MAX_READERS];
+};
+
+/* Initial number of buckets in each shard.  Always a power of two. */
+
+#define CONCURRENT_HASH_TABLE_INITIAL_BUCKETS 16
+
+/* Shards and buckets are selected with shifts and masks, so the user
+ * hash is spread with intMix first.  The top bits of the mixed hash
+ * choose the shard, the bottom bits the bucket within it. */
+
+static ConcurrentHashTableShard *concurrenthashtable_shard(
+    ConcurrentHashTable *hashTable, unsigned int mixed)
+{
+    if (hashTable->shardBits == 0) {
+        return &hashTable->shards[0];
+    }
+
+    return &hashTable->shards[mixed >> (32 - hashTable->shardBits)];
+}
+
+static size_t concurrenthashtable_bucketsSize(unsigned int size)
+{
+    return sizeof(ConcurrentHashTableBuckets)
+         + size * sizeof(_Atomic(ConcurrentHashTableEntry *));
+}
+
+static ConcurrentHashTableBuckets *concurrenthashtable_allocateBuckets(
+    ConcurrentHashTableShard *shard, unsigned int size)
+{
+    ConcurrentHashTableBuckets *buckets
+        = allocator_malloc(&shard->usage,
+                           concurrenthashtable_bucketsSize(size));
+
+    if (buckets == NULL) {
+        return NULL;
+    }
+
+    buckets->size = size;
+    buckets->retiredNext = NULL;
+
+    unsigned int i;
+
+    for (i=0; i<size; ++i) {
+        atomic_init(&buckets->chains[i], NULL);
+    }
+
+    return buckets;
+}
+
+static void concurrenthashtable_freeBuckets(ConcurrentHashTableShard *shard,
+                                            ConcurrentHashTableBuckets *buckets)
+{
+    allocator_free(&shard->usage, buckets,
+                   concurrenthashtable_bucketsSize(buckets->size));
+}
+
+/* Free an entry, and its key and value if it still owns them */
+
+static void concurrenthashtable_freeEntry(ConcurrentHashTable *hashTable,
+                                          ConcurrentHashTableShard *shard,
+                                          ConcurrentHashTableEntry *entry)
+{
+    if (entry->ownsPair) {
+        if (hashTable->keyFreeFunc != NULL) {
+            hashTable->keyFreeFunc(entry->pair.key);
+        }
+
+        if (hashTable->valueFreeFunc != NULL) {
+            hashTable->valueFreeFunc(entry->pair.value);
+        }
+    }
+
+    allocator_free(&shard->usage, entry, sizeof(ConcurrentHashTableEntry));
+}
+
+/* Free the limbo lists of a shard which no lookup can still be reading,
+ * given the current global epoch.  Called with the shard lock held. */
+
+static void concurrenthashtable_reclaim(ConcurrentHashTable *hashTable,
+                                        ConcurrentHashTableShard *shard,
+                                        unsigned long long epoch)
+{
+    ConcurrentHashTableEntry *entry;
+    ConcurrentHashTableBuckets *buckets;
+    unsigned int i;
+
+    for (i=0; i<3; ++i) {
+        if (shard->retiredEpoch[i] + 2 > epoch) {
+            continue;
+        }
+
+        while (shard->retiredEntries[i] != NULL) {
+            entry = shard->retiredEntries[i];
+            shard->retiredEntries[i] = entry->retiredNext;
+            concurrenthashtable_freeEntry(hashTable, shard, entry);
+        }
+
+        while (shard->retiredBuckets[i] != NULL) {
+            buckets = shard->retiredBuckets[i];
+            shard->retiredBuckets[i] = buckets->retiredNext;
+            concurrenthashtable_freeBuckets(shard, buckets);
+        }
+    }
+}
+
+/* Non-zero if a shard has entries or bucket arrays waiting to be
+ * freed.  Called with the shard lock held. */
+
+static int concurrenthashtable_hasRetired(ConcurrentHashTableShard *shard)
+{
+    unsigned int i;
+
+    for (i=0; i<3; ++i) {
+        if (shard->retiredEntries[i] != NULL
+         || shard->retiredBuckets[i] != NULL) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Advance the global epoch if every active lookup has seen the current
+ * one */
+
+static void concurrenthashtable_tryAdvance(ConcurrentHashTable *hashTable)
+{
+    unsigned long long epoch = atomic_load(&hashTable->epoch);
+    unsigned long long state;
+    unsigned int i;
+
+    for (i=0; i<CONCURRENT_HASH_TABLE_MAX_READERS; ++i) {
+        state = atomic_load(&hashTable->readers[i].state);
+
+        if (state != 0 && (state >> 1) != epoch) {
+            return;
+        }
+    }
+
+    atomic_compare_exchange_strong(&hashTable->epoch, &epoch, epoch + 1);
+}
+
+/* Free whatever a shard has retired that no lookup can still be
+ * reading.  While anything is waiting, each write also tries to move the
+ * epoch on, as retired memory is only freed two epochs later.  Called
+ * with the shard lock held. */
+
+static void concurrenthashtable_collect(ConcurrentHashTable *hashTable,
+                                        ConcurrentHashTableShard *shard)
+{
+    if (!concurrenthashtable_hasRetired(shard)) {
+        return;
+    }
+
+    concurrenthashtable_tryAdvance(hashTable);
+    concurrenthashtable_reclaim(hashTable, shard,
+                                atomic_load(&hashTable->epoch));
+}
+
+/* Return the limbo list index for the current epoch.  Called with the
+ * shard lock held, after concurrenthashtable_reclaim, so any older
+ * epoch sharing the index has already been emptied. */
+
+static unsigned int concurrenthashtable_limbo(ConcurrentHashTable *hashTable,
+                                              ConcurrentHashTableShard *shard)
+{
+    unsigned long long epoch = atomic_load(&hashTable->epoch);
+    unsigned int i = (unsigned int) (epoch % 3);
+
+    shard->retiredEpoch[i] = epoch;
+
+    return i;
+}
+
+static void concurrenthashtable_retireEntry(ConcurrentHashTable *hashTable,
+                                            ConcurrentHashTableShard *shard,
+                                            ConcurrentHashTableEntry *entry)
+{
+    unsigned int i = concurrenthashtable_limbo(hashTable, shard);
+
+    entry->retiredNext = shard->retiredEntries[i];
+    shard->retiredEntries[i] = entry;
+}
+
+/* Enter a lookup: claim a reader slot and publish the current epoch in
+ * it.  The epoch is read again after publishing, as the table may have
+ * advanced without seeing the slot. */
+
+static unsigned int concurrenthashtable_enter(ConcurrentHashTable *hashTable)
+{
+    unsigned long long epoch;
+    unsigned long long expected;
+    unsigned long long current;
+    unsigned int tries = 0;
+
+    /* Start the search at a slot derived from the stack address, which
+     * differs between threads */
+
+    unsigned int slot = (unsigned int) (((uintptr_t) &tries) >> 12)
+                      % CONCURRENT_HASH_TABLE_MAX_READERS;
+
+    for (;;) {
+        epoch = atomic_load(&hashTable->epoch);
+        expected = 0;
+
+        if (atomic_compare_exchange_strong(&hashTable->readers[slot].state,
+                                           &expected, (epoch << 1) | 1)) {
+            break;
+        }
+
+        slot = (slot + 1) % CONCURRENT_HASH_TABLE_MAX_READERS;
+
+        if (++tries % CONCURRENT_HASH_TABLE_MAX_READERS == 0) {
+            sched_yield();
+        }
+    }
+
+    for (;;) {
+        current = atomic_load(&hashTable->epoch);
+
+        if (current == epoch) {
+            break;
+        }
+
+        epoch = current;
+        atomic_store(&hashTable->readers[slot].state, (epoch << 1) | 1);
+    }
+
+    return slot;
+}
+
+static void concurrenthashtable_exit(ConcurrentHashTable *hashTable,
+                                     unsigned int slot)
+{
+    atomic_store(&hashTable->readers[slot].state, 0);
+}
+
+ConcurrentHashTable *concurrenthashtable_new(HashTableHashFunc hashFunc,
+                                             HashTableEqualFunc equalFunc,
+                                             unsigned int numShards)
+{
+    return concurrenthashtable_newWithAllocator(hashFunc, equalFunc,
+                                                numShards, NULL);
+}
+
+ConcurrentHashTable *concurrenthashtable_newWithAllocator(
+    HashTableHashFunc hashFunc,
+    HashTableEqualFunc equalFunc,
+    unsigned int numShards,
+    const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
+    allocator_initUsage(&usage, allocator);
+
+    ConcurrentHashTable *hashTable
+        = allocator_malloc(&usage, sizeof(ConcurrentHashTable));
+
+    if (hashTable == NULL) {
+        return NULL;
+    }
+
+    hashTable->usage = usage;
+
+    /* Round the number of shards up to a power of two */
+
+    unsigned int shardBits = 0;
+
+    while ((1U << shardBits) < numShards && shardBits < 16) {
+        ++shardBits;
+    }
+
+    hashTable->hashFunc = hashFunc;
+    hashTable->equalFunc = equalFunc;
+    hashTable->keyFreeFunc = NULL;
+    hashTable->valueFreeFunc = NULL;
+    hashTable->numShards = 1U << shardBits;
+    hashTable->shardBits = shardBits;
+    atomic_init(&hashTable->epoch, 0);
+
+    unsigned int i;
+
+    for (i=0; i<CONCURRENT_HASH_TABLE_MAX_READERS; ++i) {
+        atomic_init(&hashTable->readers[i].state, 0);
+    }
+
+    hashTable->shards = allocator_calloc(&hashTable->usage,
+                                         hashTable->numShards,
+                                         sizeof(ConcurrentHashTableShard));
+
+    if (hashTable->shards == NULL) {
+        allocator_free(&hashTable->usage, hashTable,
+                       sizeof(ConcurrentHashTable));
+        return NULL;
+    }
+
+    /* Set up each shard with its own lock and bucket array */
+
+    ConcurrentHashTableShard *shard;
+    ConcurrentHashTableBuckets *buckets;
+
+    for (i=0; i<hashTable->numShards; ++i) {
+        shard = &hashTable->shards[i];
+        allocator_initUsage(&shard->usage, hashTable->usage.allocator);
+        buckets = concurrenthashtable_allocateBuckets(
+            shard, CONCURRENT_HASH_TABLE_INITIAL_BUCKETS);
+
+        if (buckets == NULL || pthread_mutex_init(&shard->lock, NULL) != 0) {
+            if (buckets != NULL) {
+                concurrenthashtable_freeBuckets(shard, buckets);
+            }
+            concurrenthashtable_free(hashTable);
+
+            return NULL;
+        }
+
+        atomic_init(&shard->buckets, buckets);
+        atomic_init(&shard->entries, 0);
+    }
+
+    return hashTable;
+}
+
+void concurrenthashtable_free(ConcurrentHashTable *hashTable)
+{
+    ConcurrentHashTableShard *shard;
+    ConcurrentHashTableBuckets *buckets;
+    ConcurrentHashTableEntry *rover;
+    ConcurrentHashTableEntry *next;
+    unsigned int i;
+    unsigned int j;
+
+    for (i=0; i<hashTable->numShards; ++i) {
+        shard = &hashTable->shards[i];
+        buckets = atomic_load(&shard->buckets);
+
+        /* Shards are left zeroed if creating the table failed before
+         * they were set up */
+
+        if (buckets == NULL) {
+            continue;
+        }
+
+        /* Nothing can be reading the table any more, so everything in
+         * the limbo lists can go */
+
+        concurrenthashtable_reclaim(hashTable, shard, ULLONG_MAX);
+
+        /* Free all entries in all chains */
+
+        for (j=0; j<buckets->size; ++j) {
+            rover = atomic_load(&buckets->chains[j]);
+
+            while (rover != NULL) {
+                next = atomic_load(&rover->next);
+                concurrenthashtable_freeEntry(hashTable, shard, rover);
+                rover = next;
+            }
+        }
+
+        concurrenthashtable_freeBuckets(shard, buckets);
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    AllocatorUsage usage = hashTable->usage;
+
+    allocator_free(&usage, hashTable->shards,
+                   hashTable->numShards * sizeof(ConcurrentHashTableShard));
+    allocator_free(&usage, hashTable, sizeof(ConcurrentHashTable));
+}
+
+void concurrenthashtable_registerFreeFunctions(ConcurrentHashTable *hashTable,
+                                               HashTableKeyFreeFunc keyFreeFunc,
+                                               HashTableValueFreeFunc valueFreeFunc)
+{
+    hashTable->keyFreeFunc = keyFreeFunc;
+    hashTable->valueFreeFunc = valueFreeFunc;
+}
+
+/* Double the bucket array of a shard.  Lookups may still be walking the
+ * old chains, so entries are copied rather than relinked, and the old
+ * entries and array are retired.  Called with the shard lock held. */
+
+static int concurrenthashtable_enlarge(ConcurrentHashTable *hashTable,
+                                       ConcurrentHashTableShard *shard)
+{
+    ConcurrentHashTableBuckets *oldBuckets = atomic_load(&shard->buckets);
+    ConcurrentHashTableBuckets *newBuckets
+        = concurrenthashtable_allocateBuckets(shard, oldBuckets->size * 2);
+
+    if (newBuckets == NULL) {
+        return 0;
+    }
+
+    ConcurrentHashTableEntry *rover;
+    ConcurrentHashTableEntry *copy;
+    ConcurrentHashTableEntry *next;
+    unsigned int index;
+    unsigned int i;
+
+    for (i=0; i<oldBuckets->size; ++i) {
+        rover = atomic_load(&oldBuckets->chains[i]);
+
+        while (rover != NULL) {
+            copy = allocator_malloc(&shard->usage,
+                                    sizeof(ConcurrentHashTableEntry));
+
+            if (copy == NULL) {
+                break;
+            }
+
+            copy->pair = rover->pair;
+            copy->hash = rover->hash;
+            copy->ownsPair = 1;
+
+            index = intMix(rover->hash) & (newBuckets->size - 1);
+            atomic_init(&copy->next, atomic_load(&newBuckets->chains[index]));
+            atomic_store(&newBuckets->chains[index], copy);
+
+            rover = atomic_load(&rover->next);
+        }
+
+        if (rover != NULL) {
+            break;
+        }
+    }
+
+    /* Allocation failed part way through: drop the copies, which do not
+     * own their pairs yet, and keep the old array */
+
+    if (i < oldBuckets->size) {
+        for (i=0; i<newBuckets->size; ++i) {
+            rover = atomic_load(&newBuckets->chains[i]);
+
+            while (rover != NULL) {
+                next = atomic_load(&rover->next);
+                allocator_free(&shard->usage, rover,
+                               sizeof(ConcurrentHashTableEntry));
+                rover = next;
+            }
+        }
+
+        concurrenthashtable_freeBuckets(shard, newBuckets);
+
+        return 0;
+    }
+
+    /* Publish the new array and retire the old one.  The old entries
+     * hand their keys and values over to the copies. */
+
+    atomic_store(&shard->buckets, newBuckets);
+
+    unsigned int limbo = concurrenthashtable_limbo(hashTable, shard);
+
+    for (i=0; i<oldBuckets->size; ++i) {
+        rover = atomic_load(&oldBuckets->chains[i]);
+
+        while (rover != NULL) {
+            next = atomic_load(&rover->next);
+
+            rover->ownsPair = 0;
+            rover->retiredNext = shard->retiredEntries[limbo];
+            shard->retiredEntries[limbo] = rover;
+
+            rover = next;
+        }
+    }
+
+    oldBuckets->retiredNext = shard->retiredBuckets[limbo];
+    shard->retiredBuckets[limbo] = oldBuckets;
+
+    /* Move the epoch on, so that the old copies can be freed by the
+     * shard's next writes even if nothing is ever removed */
+
+    concurrenthashtable_tryAdvance(hashTable);
+    concurrenthashtable_reclaim(hashTable, shard,
+                                atomic_load(&hashTable->epoch));
+
+    return 1;
+}
+
+/* Find the link which points at the entry for a key in a shard, or NULL
+ * if the key is not present.  Called with the shard lock held. */
+
+static _Atomic(ConcurrentHashTableEntry *) *concurrenthashtable_findLink(
+    ConcurrentHashTable *hashTable,
+    ConcurrentHashTableShard *shard,
+    HashTableKey key,
+    unsigned int hash)
+{
+    ConcurrentHashTableBuckets *buckets = atomic_load(&shard->buckets);
+    unsigned int index = intMix(hash) & (buckets->size - 1);
+    _Atomic(ConcurrentHashTableEntry *) *link = &buckets->chains[index];
+    ConcurrentHashTableEntry *rover;
+
+    while ((rover = atomic_load(link)) != NULL) {
+        if (rover->hash == hash
+         && hashTable->equalFunc(key, rover->pair.key) != 0) {
+            return link;
+        }
+
+        link = &rover->next;
+    }
+
+    return NULL;
+}
+
+/* Insert into a shard.  Called with the shard lock held. */
+
+static int concurrenthashtable_insertLocked(ConcurrentHashTable *hashTable,
+                                            ConcurrentHashTableShard *shard,
+                                            HashTableKey key,
+                                            HashTableValue value,
+                                            unsigned int hash)
+{
+    concurrenthashtable_collect(hashTable, shard);
+
+    /* Grow the shard once it averages more than one entry per bucket */
+
+    ConcurrentHashTableBuckets *buckets = atomic_load(&shard->buckets);
+
+    if (atomic_load(&shard->entries) >= buckets->size
+     && !concurrenthashtable_enlarge(hashTable, shard)) {
+        return 0;
+    }
+
+    ConcurrentHashTableEntry *newEntry
+        = allocator_malloc(&shard->usage, sizeof(ConcurrentHashTableEntry));
+
+    if (newEntry == NULL) {
+        return 0;
+    }
+
+    newEntry->pair.key = key;
+    newEntry->pair.value = value;
+    newEntry->hash = hash;
+    newEntry->ownsPair = 1;
+
+    _Atomic(ConcurrentHashTableEntry *) *link
+        = concurrenthashtable_findLink(hashTable, shard, key, hash);
+
+    if (link != NULL) {
+
+        /* Same key: swap in the new entry in place of the old one,
+         * which is freed (with its key and value) once no lookup can
+         * be reading it */
+
+        ConcurrentHashTableEntry *oldEntry = atomic_load(link);
+
+        atomic_init(&newEntry->next, atomic_load(&oldEntry->next));
+        atomic_store(link, newEntry);
+
+        concurrenthashtable_retireEntry(hashTable, shard, oldEntry);
+        concurrenthashtable_tryAdvance(hashTable);
+
+        return 1;
+    }
+
+    /* Link in at the head of the chain */
+
+    buckets = atomic_load(&shard->buckets);
+    link = &buckets->chains[intMix(hash) & (buckets->size - 1)];
+
+    atomic_init(&newEntry->next, atomic_load(link));
+    atomic_store(link, newEntry);
+
+    atomic_fetch_add(&shard->entries, 1);
+
+    return 1;
+}
+
+int concurrenthashtable_insert(ConcurrentHashTable *hashTable,
+                               HashTableKey key,
+                               HashTableValue value)
+{
+    unsigned int hash = hashTable->hashFunc(key);
+    ConcurrentHashTableShard *shard
+        = concurrenthashtable_shard(hashTable, intMix(hash));
+
+    pthread_mutex_lock(&shard->lock);
+
+    int result = concurrenthashtable_insertLocked(hashTable, shard,
+                                                  key, value, hash);
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return result;
+}
+
+HashTableValue concurrenthashtable_lookup(ConcurrentHashTable *hashTable,
+                                          HashTableKey key)
+{
+    unsigned int hash = hashTable->hashFunc(key);
+    unsigned int mixed = intMix(hash);
+    ConcurrentHashTableShard *shard
+        = concurrenthashtable_shard(hashTable, mixed);
+    HashTableValue result = HASH_TABLE_NULL;
+
+    unsigned int slot = concurrenthashtable_enter(hashTable);
+
+    ConcurrentHashTableBuckets *buckets = atomic_load(&shard->buckets);
+    ConcurrentHashTableEntry *rover
+        = atomic_load(&buckets->chains[mixed & (buckets->size - 1)]);
+
+    while (rover != NULL) {
+        if (rover->hash == hash
+         && hashTable->equalFunc(key, rover->pair.key) != 0) {
+            result = rover->pair.value;
+            break;
+        }
+
+        rover = atomic_load(&rover->next);
+    }
+
+    concurrenthashtable_exit(hashTable, slot);
+
+    return result;
+}
+
+int concurrenthashtable_remove(ConcurrentHashTable *hashTable,
+                               HashTableKey key)
+{
+    unsigned int hash = hashTable->hashFunc(key);
+    ConcurrentHashTableShard *shard
+        = concurrenthashtable_shard(hashTable, intMix(hash));
+    int result = 0;
+
+    pthread_mutex_lock(&shard->lock);
+
+    concurrenthashtable_collect(hashTable, shard);
+
+    _Atomic(ConcurrentHashTableEntry *) *link
+        = concurrenthashtable_findLink(hashTable, shard, key, hash);
+
+    if (link != NULL) {
+
+        /* Unlink the entry.  Lookups already on it can still follow its
+         * next pointer, which is left intact. */
+
+        ConcurrentHashTableEntry *entry = atomic_load(link);
+
+        atomic_store(link, atomic_load(&entry->next));
+        atomic_fetch_sub(&shard->entries, 1);
+
+        concurrenthashtable_retireEntry(hashTable, shard, entry);
+        concurrenthashtable_tryAdvance(hashTable);
+
+        result = 1;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return result;
+}
+
+unsigned int concurrenthashtable_numEntries(ConcurrentHashTable *hashTable)
+{
+    unsigned int result = 0;
+    unsigned int i;
+
+    for (i=0; i<hashTable->numShards; ++i) {
+        result += atomic_load(&hashTable->shards[i].entries);
+    }
+
+    return result;
+}
+
+size_t concurrenthashtable_memoryUsage(ConcurrentHashTable *hashTable)
+{
+    size_t result = hashTable->usage.bytesUsed;
+    ConcurrentHashTableShard *shard;
+    unsigned int i;
+
+    for (i=0; i<hashTable->numShards; ++i) {
+        shard = &hashTable->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        result += shard->usage.bytesUsed;
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return result;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file dsconcurrenthashtable.h
+ *
+ * @brief Thread-safe hash table.
+ *
+ * A concurrent hash table maps keys to values like a @ref HashTable,
+ * but may be used from several threads at once.  Keys are partitioned
+ * across a number of shards, each with its own lock and its own table,
+ * so that writers to different shards do not contend.  Lookups take no
+ * lock at all: entries that are removed or replaced are only freed once
+ * no lookup can still be reading them (epoch-based reclamation).
+ *
+ * To create a concurrent hash table, use @ref concurrenthashtable_new.
+ * To destroy it, use @ref concurrenthashtable_free.
+ *
+ * To insert a value, use @ref concurrenthashtable_insert.  To remove a
+ * value, use @ref concurrenthashtable_remove.  To look up a value by its
+ * key, use @ref concurrenthashtable_lookup.
+ *
+ * The same hash and equality functions used with @ref HashTable can be
+ * used here.  They must be safe to call from several threads at once.
+ */
+
+#ifndef DSCONCURRENTHASHTABLE_H
+#define DSCONCURRENTHASHTABLE_H
+
+#include "dshashtable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A concurrent hash table structure.
+ */
+
+typedef struct _ConcurrentHashTable ConcurrentHashTable;
+
+/**
+ * Maximum number of threads which can be inside
+ * @ref concurrenthashtable_lookup at the same time.  Further lookups
+ * wait for a reader slot to become free.
+ */
+
+#define CONCURRENT_HASH_TABLE_MAX_READERS 128
+
+/**
+ * Create a new concurrent hash table.
+ *
+ * @param hashFunc             Function used to generate hash keys for the
+ *                             keys used in the table.
+ * @param equalFunc            Function used to test keys used in the table
+ *                             for equality.
+ * @param numShards            Number of shards to split the table into.
+ *                             This is rounded up to a power of two.  A
+ *                             few times the number of writing threads is
+ *                             a good choice.
+ * @return                     A new concurrent hash table, or NULL if it
+ *                             was not possible to allocate it.
+ */
+
+ConcurrentHashTable *concurrenthashtable_new(HashTableHashFunc hashFunc,
+                                             HashTableEqualFunc equalFunc,
+                                             unsigned int numShards);
+
+/**
+ * Create a new concurrent hash table which allocates its memory from a
+ * particular allocator.  The allocator functions are only ever called
+ * by one thread at a time for each shard, but different shards may call
+ * them at the same time.
+ *
+ * @param hashFunc             Function used to generate hash keys for the
+ *                             keys used in the table.
+ * @param equalFunc            Function used to test keys used in the table
+ *                             for equality.
+ * @param numShards            Number of shards to split the table into.
+ *                             This is rounded up to a power of two.
+ * @param allocator            The allocator to use, or NULL to use the
+ *                             default allocator.
+ * @return                     A new concurrent hash table, or NULL if it
+ *                             was not possible to allocate it.
+ */
+
+ConcurrentHashTable *concurrenthashtable_newWithAllocator(
+    HashTableHashFunc hashFunc,
+    HashTableEqualFunc equalFunc,
+    unsigned int numShards,
+    const Allocator *allocator);
+
+/**
+ * Destroy a concurrent hash table.  No other thread may be using the
+ * table when it is destroyed.
+ *
+ * @param hashTable            The table to destroy.
+ */
+
+void concurrenthashtable_free(ConcurrentHashTable *hashTable);
+
+/**
+ * Register functions used to free the key and value when an entry is
+ * removed from a concurrent hash table.  Freeing is deferred until no
+ * lookup can still be reading the entry.  This must be called before
+ * the table is shared between threads.
+ *
+ * @param hashTable            The table.
+ * @param keyFreeFunc          Function used to free keys.
+ * @param valueFreeFunc        Function used to free values.
+ */
+
+void concurrenthashtable_registerFreeFunctions(ConcurrentHashTable *hashTable,
+                                               HashTableKeyFreeFunc keyFreeFunc,
+                                               HashTableValueFreeFunc valueFreeFunc);
+
+/**
+ * Insert a value into a concurrent hash table, overwriting any existing
+ * entry using the same key.
+ *
+ * @param hashTable            The table.
+ * @param key                  The key for the new value.
+ * @param value                The value to insert.
+ * @return                     Non-zero if the value was added successfully,
+ *                             or zero if it was not possible to allocate
+ *                             memory for the new entry.
+ */
+
+int concurrenthashtable_insert(ConcurrentHashTable *hashTable,
+                               HashTableKey key,
+                               HashTableValue value);
+
+/**
+ * Look up a value in a concurrent hash table by key.  This does not
+ * take any lock.
+ *
+ * If a value free function is registered, the value returned is only
+ * safe to use until another thread replaces or removes the entry.
+ *
+ * @param hashTable            The table.
+ * @param key                  The key of the value to look up.
+ * @return                     The value, or @ref HASH_TABLE_NULL if there
+ *                             is no value with that key in the table.
+ */
+
+HashTableValue concurrenthashtable_lookup(ConcurrentHashTable *hashTable,
+                                          HashTableKey key);
+
+/**
+ * Remove a value from a concurrent hash table.
+ *
+ * @param hashTable            The table.
+ * @param key                  The key of the value to remove.
+ * @return                     Non-zero if a key was removed, or zero if the
+ *                             specified key was not found in the table.
+ */
+
+int concurrenthashtable_remove(ConcurrentHashTable *hashTable,
+                               HashTableKey key);
+
+/**
+ * Retrieve the number of entries in a concurrent hash table.  If other
+ * threads are modifying the table, the result is only approximate.
+ *
+ * @param hashTable            The table.
+ * @return                     The number of entries in the table.
+ */
+
+unsigned int concurrenthashtable_numEntries(ConcurrentHashTable *hashTable);
+
+/**
+ * Retrieve the number of bytes of memory allocated by a concurrent hash
+ * table, including entries waiting to be freed.  This takes the lock of
+ * each shard in turn.
+ *
+ * @param hashTable            The table.
+ * @return                     The number of bytes allocated.
+ */
+
+size_t concurrenthashtable_memoryUsage(ConcurrentHashTable *hashTable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSCONCURRENTHASHTABLE_H */
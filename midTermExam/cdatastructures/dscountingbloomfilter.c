@@ -0,0 +1,218 @@
+/* Counting bloom filter */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dscountingbloomfilter.h"
+
+/* Largest value of a four-bit counter.  Counters which reach it stay
+ * there. */
+
+#define COUNTING_BLOOM_FILTER_MAX_COUNT 15
+
+#define COUNTING_BLOOM_FILTER_MAX_FUNCTIONS 64
+
+struct _CountingBloomFilter {
+    AllocatorUsage usage;
+    BloomFilterHashFunc hashFunc;
+    unsigned char *table;
+    unsigned int tableSize;
+    unsigned int numFunctions;
+};
+
+/* Size of the table in bytes.  Counters are packed two to a byte,
+ * rounding up; the sum is done in size_t so that a table of UINT_MAX
+ * counters does not wrap to zero. */
+
+static size_t countingbloomfilter_tableBytes(unsigned int tableSize)
+{
+    return ((size_t) tableSize + 1) / 2;
+}
+
+CountingBloomFilter *countingbloomfilter_new(unsigned int tableSize,
+                                             BloomFilterHashFunc hashFunc,
+                                             unsigned int numFunctions)
+{
+    return countingbloomfilter_newWithAllocator(tableSize, hashFunc,
+                                                numFunctions, NULL);
+}
+
+CountingBloomFilter *countingbloomfilter_newWithAllocator(
+    unsigned int tableSize,
+    BloomFilterHashFunc hashFunc,
+    unsigned int numFunctions,
+    const Allocator *allocator)
+{
+    CountingBloomFilter *filter;
+    AllocatorUsage usage;
+
+    if (tableSize == 0
+     || numFunctions > COUNTING_BLOOM_FILTER_MAX_FUNCTIONS) {
+        return NULL;
+    }
+
+    allocator_initUsage(&usage, allocator);
+
+    filter = allocator_malloc(&usage, sizeof(CountingBloomFilter));
+
+    if (filter == NULL) {
+        return NULL;
+    }
+
+    filter->usage = usage;
+
+    filter->table = allocator_calloc(&filter->usage,
+                                     countingbloomfilter_tableBytes(tableSize),
+                                     1);
+
+    if (filter->table == NULL) {
+        allocator_free(&filter->usage, filter, sizeof(CountingBloomFilter));
+        return NULL;
+    }
+
+    filter->hashFunc = hashFunc;
+    filter->tableSize = tableSize;
+    filter->numFunctions = numFunctions;
+
+    return filter;
+}
+
+void countingbloomfilter_free(CountingBloomFilter *filter)
+{
+    AllocatorUsage usage = filter->usage;
+
+    allocator_free(&usage, filter->table,
+                   countingbloomfilter_tableBytes(filter->tableSize));
+    allocator_free(&usage, filter, sizeof(CountingBloomFilter));
+}
+
+size_t countingbloomfilter_memoryUsage(CountingBloomFilter *filter)
+{
+    return filter->usage.bytesUsed;
+}
+
+/* Find the counters for a value.  The hash is mixed to 64 bits, and
+ * its two halves are combined to give each index (Kirsch-Mitzenmacher
+ * double hashing), mapped onto the table by multiplying rather than
+ * dividing. */
+
+static void countingbloomfilter_indexes(CountingBloomFilter *filter,
+                                        BloomFilterValue value,
+                                        unsigned int *indexes)
+{
+    uint64_t hash = (uint64_t) filter->hashFunc(value)
+                  + 0x9e3779b97f4a7c15ULL;
+    uint32_t hash1;
+    uint32_t hash2;
+    unsigned int i;
+
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+
+    hash1 = (uint32_t) hash;
+    hash2 = (uint32_t) (hash >> 32) | 1;
+
+    for (i=0; i<filter->numFunctions; ++i) {
+        indexes[i] = (unsigned int)
+            (((uint64_t) hash1 * filter->tableSize) >> 32);
+        hash1 += hash2;
+    }
+}
+
+static unsigned int countingbloomfilter_get(CountingBloomFilter *filter,
+                                            unsigned int index)
+{
+    return (filter->table[index / 2] >> ((index % 2) * 4)) & 0xf;
+}
+
+static void countingbloomfilter_set(CountingBloomFilter *filter,
+                                    unsigned int index,
+                                    unsigned int count)
+{
+    unsigned int shift = (index % 2) * 4;
+    unsigned char *b = &filter->table[index / 2];
+
+    *b = (unsigned char) ((*b & ~(0xf << shift)) | (count << shift));
+}
+
+void countingbloomfilter_insert(CountingBloomFilter *filter,
+                                BloomFilterValue value)
+{
+    unsigned int indexes[COUNTING_BLOOM_FILTER_MAX_FUNCTIONS];
+    unsigned int count;
+    unsigned int i;
+
+    countingbloomfilter_indexes(filter, value, indexes);
+
+    for (i=0; i<filter->numFunctions; ++i) {
+        count = countingbloomfilter_get(filter, indexes[i]);
+
+        if (count < COUNTING_BLOOM_FILTER_MAX_COUNT) {
+            countingbloomfilter_set(filter, indexes[i], count + 1);
+        }
+    }
+}
+
+int countingbloomfilter_remove(CountingBloomFilter *filter,
+                               BloomFilterValue value)
+{
+    unsigned int indexes[COUNTING_BLOOM_FILTER_MAX_FUNCTIONS];
+    unsigned int count;
+    unsigned int i;
+
+    countingbloomfilter_indexes(filter, value, indexes);
+
+	/* Check that every counter is set before changing any of them */
+
+    for (i=0; i<filter->numFunctions; ++i) {
+        if (countingbloomfilter_get(filter, indexes[i]) == 0) {
+            return 0;
+        }
+    }
+
+	/* Saturated counters no longer know how many values use them, so
+	 * are left alone */
+
+    for (i=0; i<filter->numFunctions; ++i) {
+        count = countingbloomfilter_get(filter, indexes[i]);
+
+        if (count > 0 && count < COUNTING_BLOOM_FILTER_MAX_COUNT) {
+            countingbloomfilter_set(filter, indexes[i], count - 1);
+        }
+    }
+
+    return 1;
+}
+
+int countingbloomfilter_query(CountingBloomFilter *filter,
+                              BloomFilterValue value)
+{
+    unsigned int indexes[COUNTING_BLOOM_FILTER_MAX_FUNCTIONS];
+    unsigned int i;
+
+    countingbloomfilter_indexes(filter, value, indexes);
+
+    for (i=0; i<filter->numFunctions; ++i) {
+        if (countingbloomfilter_get(filter, indexes[i]) == 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void countingbloomfilter_read(CountingBloomFilter *filter,
+                              unsigned char *array)
+{
+    memcpy(array, filter->table,
+           countingbloomfilter_tableBytes(filter->tableSize));
+}
+
+void countingbloomfilter_load(CountingBloomFilter *filter,
+                              unsigned char *array)
+{
+    memcpy(filter->table, array,
+           countingbloomfilter_tableBytes(filter->tableSize));
+}
@@ -0,0 +1,172 @@
+/**
+ * @file dscountingbloomfilter.h
+ *
+ * @brief Counting bloom filter
+ *
+ * A counting bloom filter is a @ref BloomFilter which also supports
+ * removing values.  Each entry of the table is a small counter instead
+ * of a single bit: inserting a value increments its counters, and
+ * removing it decrements them again.  The counters are four bits wide,
+ * packed two to a byte, so the table takes four times the memory of a
+ * bloom filter with the same number of entries.
+ *
+ * A counter which reaches 15 sticks there, since its true count is no
+ * longer known.  Such a counter is never decremented, so a value can
+ * not be removed by accident, but entries shared by very many values
+ * stay set.
+ *
+ * To create a counting bloom filter, use @ref countingbloomfilter_new.
+ * To destroy it, use @ref countingbloomfilter_free.
+ *
+ * To insert a value, use @ref countingbloomfilter_insert.  To remove a
+ * value, use @ref countingbloomfilter_remove.  To query whether a value
+ * is part of the set, use @ref countingbloomfilter_query.
+ */
+
+#ifndef DSCOUNTINGBLOOMFILTER_H
+#define DSCOUNTINGBLOOMFILTER_H
+
+#include "dsbloomfilter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A counting bloom filter structure.
+ */
+
+typedef struct _CountingBloomFilter CountingBloomFilter;
+
+/**
+ * Create a new counting bloom filter.
+ *
+ * @param tableSize        The number of counters in the table.  The
+ *                         greater the table size, the more elements can
+ *                         be stored, and the lesser the chance of false
+ *                         positives.
+ * @param hashFunc         Hash function to use on values stored in the
+ *                         filter.
+ * @param numFunctions     Number of counters used for each element.  The
+ *                         maximum number of functions is 64.
+ * @return                 A new counting bloom filter, or NULL if it was
+ *                         not possible to allocate the new filter.
+ */
+
+CountingBloomFilter *countingbloomfilter_new(unsigned int tableSize,
+                                             BloomFilterHashFunc hashFunc,
+                                             unsigned int numFunctions);
+
+/**
+ * Create a new counting bloom filter which allocates its memory from a
+ * particular allocator.
+ *
+ * @param tableSize        The number of counters in the table.
+ * @param hashFunc         Hash function to use on values stored in the
+ *                         filter.
+ * @param numFunctions     Number of counters used for each element.  The
+ *                         maximum number of functions is 64.
+ * @param allocator        The allocator to use, or NULL to use the
+ *                         default allocator.
+ * @return                 A new counting bloom filter, or NULL if it was
+ *                         not possible to allocate the new filter.
+ */
+
+CountingBloomFilter *countingbloomfilter_newWithAllocator(
+    unsigned int tableSize,
+    BloomFilterHashFunc hashFunc,
+    unsigned int numFunctions,
+    const Allocator *allocator);
+
+/**
+ * Destroy a counting bloom filter.
+ *
+ * @param filter           The counting bloom filter to destroy.
+ */
+
+void countingbloomfilter_free(CountingBloomFilter *filter);
+
+/**
+ * Retrieve the number of bytes of memory allocated by a counting bloom
+ * filter.
+ *
+ * @param filter           The counting bloom filter.
+ * @return                 The number of bytes allocated.
+ */
+
+size_t countingbloomfilter_memoryUsage(CountingBloomFilter *filter);
+
+/**
+ * Insert a value into a counting bloom filter.
+ *
+ * @param filter               The counting bloom filter.
+ * @param value                The value to insert.
+ */
+
+void countingbloomfilter_insert(CountingBloomFilter *filter,
+                                BloomFilterValue value);
+
+/**
+ * Remove a value from a counting bloom filter.  The value should have
+ * been inserted earlier, and not already removed: removing a value
+ * which was never inserted can make other values appear to be absent.
+ *
+ * @param filter               The counting bloom filter.
+ * @param value                The value to remove.
+ * @return                     Non-zero if the value was removed, or zero
+ *                             if the value was definitely not in the
+ *                             filter, in which case nothing is changed.
+ */
+
+int countingbloomfilter_remove(CountingBloomFilter *filter,
+                               BloomFilterValue value);
+
+/**
+ * Query a counting bloom filter for a particular value.
+ *
+ * @param filter               The counting bloom filter.
+ * @param value                The value to look up.
+ * @return                     Zero if the value was definitely not
+ *                             inserted into the filter, or was removed.
+ *                             Non-zero indicates that it either may or
+ *                             may not be in the filter.
+ */
+
+int countingbloomfilter_query(CountingBloomFilter *filter,
+                              BloomFilterValue value);
+
+/**
+ * Read the counters of a counting bloom filter into an array.  Counter
+ * i is stored in the low four bits of byte i / 2 when i is even, and
+ * in the high four bits when i is odd.
+ *
+ * @param filter               The counting bloom filter.
+ * @param array                Pointer to the array to read into.  This
+ *                             should be (table_size + 1) / 2 bytes in
+ *                             length.
+ */
+
+void countingbloomfilter_read(CountingBloomFilter *filter,
+                              unsigned char *array);
+
+/**
+ * Load the counters of a counting bloom filter from an array.
+ * The data loaded should be the output read from
+ * @ref countingbloomfilter_read, from a filter created using the same
+ * arguments used to create the original filter.
+ *
+ * @param filter               The counting bloom filter.
+ * @param array                Pointer to the array to load from.  This
+ *                             should be (table_size + 1) / 2 bytes in
+ *                             length.
+ */
+
+void countingbloomfilter_load(CountingBloomFilter *filter,
+                              unsigned char *array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSCOUNTINGBLOOMFILTER_H */
+
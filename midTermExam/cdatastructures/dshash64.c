@@ -0,0 +1,364 @@
+/* Fast 64-bit hashing
+ *
+ * This is wyhash (final version 4) by Wang Yi, which is in the public
+ * domain.  Each step multiplies two 64-bit words to 128 bits and XORs
+ * the halves together. */
+
+/* rand_s is only declared when this is defined first */
+
+#ifdef _WIN32
+#define _CRT_RAND_S
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dshash64.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+/* Source of the secret from which random seeds are made: the operating
+ * system's cryptographic random number generator */
+
+#if defined(_WIN32)
+#define HASH64_RANDOM_RAND_S
+#elif defined(__linux__) && defined(__GLIBC__) \
+    && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 25))
+#include <errno.h>
+#include <sys/random.h>
+#define HASH64_RANDOM_GETRANDOM
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) \
+    || defined(__NetBSD__) || defined(__DragonFly__)
+#define HASH64_RANDOM_ARC4RANDOM
+#elif defined(__unix__)
+#define HASH64_RANDOM_URANDOM
+#else
+#error "hash64_randomSeed needs a system random number generator"
+#endif
+
+/* The secret is shared by all threads, so it is published with atomic
+ * operations: the compiler's builtins where available, otherwise C11
+ * atomics */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HASH64_USE_ATOMIC_BUILTINS
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L \
+    && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#else
+#error "hash64_randomSeed needs atomic operations"
+#endif
+
+static const uint64_t HASH64_SECRET[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL,
+};
+
+/* Multiply two 64-bit numbers, giving the low half of the product in
+ * a and the high half in b */
+
+static void hash64_multiply(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ unsigned __int128 product = *a;
+
+    product *= *b;
+    *a = (uint64_t) product;
+    *b = (uint64_t) (product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t hh = (*a >> 32) * (*b >> 32);
+    uint64_t hl = (*a >> 32) * (uint32_t) *b;
+    uint64_t lh = (uint32_t) *a * (*b >> 32);
+    uint64_t ll = (uint64_t) (uint32_t) *a * (uint32_t) *b;
+    uint64_t low = ll + (hl << 32);
+    uint64_t carry = low < ll;
+
+    low += lh << 32;
+    carry += low < (lh << 32);
+    *a = low;
+    *b = hh + (hl >> 32) + (lh >> 32) + carry;
+#endif
+}
+
+static uint64_t hash64_mix(uint64_t a, uint64_t b)
+{
+    hash64_multiply(&a, &b);
+
+    return a ^ b;
+}
+
+/* Data is always read little-endian, so that hashes are the same on
+ * every platform.  On little-endian machines this is a plain load. */
+
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) \
+    || defined(_M_X64) || defined(_M_IX86)
+#define HASH64_LITTLE_ENDIAN
+#endif
+
+static uint64_t hash64_read8(const unsigned char *p)
+{
+#ifdef HASH64_LITTLE_ENDIAN
+    uint64_t value;
+
+    memcpy(&value, p, sizeof(value));
+
+    return value;
+#else
+    return (uint64_t) p[0] | ((uint64_t) p[1] << 8)
+         | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24)
+         | ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40)
+         | ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+#endif
+}
+
+static uint64_t hash64_read4(const unsigned char *p)
+{
+#ifdef HASH64_LITTLE_ENDIAN
+    uint32_t value;
+
+    memcpy(&value, p, sizeof(value));
+
+    return value;
+#else
+    return (uint64_t) p[0] | ((uint64_t) p[1] << 8)
+         | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24);
+#endif
+}
+
+uint64_t hash64_bytes(const void *data, size_t length, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *) data;
+    uint64_t seed1;
+    uint64_t seed2;
+    uint64_t a;
+    uint64_t b;
+    size_t i;
+
+    seed ^= hash64_mix(seed ^ HASH64_SECRET[0], HASH64_SECRET[1]);
+
+    if (length <= 16) {
+
+		/* Short keys are read as overlapping words from each end */
+
+        if (length >= 4) {
+            a = (hash64_read4(p) << 32)
+              | hash64_read4(p + ((length >> 3) << 2));
+            b = (hash64_read4(p + length - 4) << 32)
+              | hash64_read4(p + length - 4 - ((length >> 3) << 2));
+        } else if (length > 0) {
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[length >> 1] << 8)
+              | p[length - 1];
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        i = length;
+
+		/* Long keys are hashed 48 bytes at a time, as three
+		 * independent streams */
+
+        if (i > 48) {
+            seed1 = seed;
+            seed2 = seed;
+
+            do {
+                seed = hash64_mix(hash64_read8(p) ^ HASH64_SECRET[1],
+                                  hash64_read8(p + 8) ^ seed);
+                seed1 = hash64_mix(hash64_read8(p + 16) ^ HASH64_SECRET[2],
+                                   hash64_read8(p + 24) ^ seed1);
+                seed2 = hash64_mix(hash64_read8(p + 32) ^ HASH64_SECRET[3],
+                                   hash64_read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (i > 16) {
+            seed = hash64_mix(hash64_read8(p) ^ HASH64_SECRET[1],
+                              hash64_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+		/* The last 16 bytes, which may overlap those already read */
+
+        a = hash64_read8(p + i - 16);
+        b = hash64_read8(p + i - 8);
+    }
+
+    a ^= HASH64_SECRET[1];
+    b ^= seed;
+    hash64_multiply(&a, &b);
+
+    return hash64_mix(a ^ HASH64_SECRET[0] ^ length, b ^ HASH64_SECRET[1]);
+}
+
+uint64_t hash64_string(const char *string, uint64_t seed)
+{
+    return hash64_bytes(string, strlen(string), seed);
+}
+
+/* Fold a 64-bit hash to the size of a hash key */
+
+static unsigned int hash64_fold(uint64_t hash)
+{
+    return (unsigned int) (hash ^ (hash >> 32));
+}
+
+unsigned int fastStringHash(void *string)
+{
+    return hash64_fold(hash64_string((const char *) string, 0));
+}
+
+unsigned int fastStringHashSeeded(void *string, uint64_t seed)
+{
+    return hash64_fold(hash64_string((const char *) string, seed));
+}
+
+unsigned int binaryKeyHash(void *key)
+{
+    return binaryKeyHashSeeded(key, 0);
+}
+
+unsigned int binaryKeyHashSeeded(void *key, uint64_t seed)
+{
+    BinaryKey *binaryKey = (BinaryKey *) key;
+
+    return hash64_fold(hash64_bytes(binaryKey->data, binaryKey->length,
+                                    seed));
+}
+
+int binaryKeyEqual(void *key1, void *key2)
+{
+    BinaryKey *binaryKey1 = (BinaryKey *) key1;
+    BinaryKey *binaryKey2 = (BinaryKey *) key2;
+
+    return binaryKey1->length == binaryKey2->length
+        && (binaryKey1->length == 0
+            || memcmp(binaryKey1->data, binaryKey2->data,
+                      binaryKey1->length) == 0);
+}
+
+/* Fill a buffer from the system's random number generator, stopping
+ * the program if it fails: a predictable seed would silently remove
+ * the protection seeding is used for */
+
+static void hash64_systemRandom(uint64_t *buffer, size_t count)
+{
+    int success = 1;
+
+#if defined(HASH64_RANDOM_RAND_S)
+    unsigned int low;
+    unsigned int high;
+    size_t i;
+
+    for (i=0; i<count && success; ++i) {
+        success = rand_s(&low) == 0 && rand_s(&high) == 0;
+        buffer[i] = ((uint64_t) high << 32) | low;
+    }
+#elif defined(HASH64_RANDOM_GETRANDOM)
+    unsigned char *bytes = (unsigned char *) buffer;
+    size_t size = count * sizeof(uint64_t);
+    ssize_t result;
+
+    while (size > 0 && success) {
+        result = getrandom(bytes, size, 0);
+
+        if (result > 0) {
+            bytes += result;
+            size -= (size_t) result;
+        } else if (result < 0 && errno != EINTR) {
+            success = 0;
+        }
+    }
+#elif defined(HASH64_RANDOM_ARC4RANDOM)
+    arc4random_buf(buffer, count * sizeof(uint64_t));
+#else
+    FILE *file = fopen("/dev/urandom", "rb");
+
+    success = file != NULL
+           && fread(buffer, sizeof(uint64_t), count, file) == count;
+
+    if (file != NULL) {
+        fclose(file);
+    }
+#endif
+
+    if (!success) {
+        fprintf(stderr, "hash64_randomSeed: the system random number "
+                        "generator failed\n");
+        abort();
+    }
+}
+
+/* The secret is read once per process.  Every seed is then a keyed
+ * hash of the next value of a counter, so seeds are all different, and
+ * can not be worked out from one another without the secret. */
+
+static uint64_t hash64_secret[2];
+static int hash64_secretState;
+static uint64_t hash64_seedCounter;
+
+uint64_t hash64_randomSeed(void)
+{
+    uint64_t secret[2];
+    uint64_t counter;
+    int expected = 0;
+
+#ifdef HASH64_USE_ATOMIC_BUILTINS
+    if (__atomic_load_n(&hash64_secretState, __ATOMIC_ACQUIRE) == 2) {
+        secret[0] = hash64_secret[0];
+        secret[1] = hash64_secret[1];
+    } else {
+
+		/* Whichever thread gets here first stores its secret.  Any
+		 * other thread which gets here before that is done uses its
+		 * own, which is just as good for the one seed. */
+
+        hash64_systemRandom(secret, 2);
+
+        if (__atomic_compare_exchange_n(&hash64_secretState, &expected, 1,
+                                        0, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+            hash64_secret[0] = secret[0];
+            hash64_secret[1] = secret[1];
+            __atomic_store_n(&hash64_secretState, 2, __ATOMIC_RELEASE);
+        }
+    }
+
+    counter = __atomic_fetch_add(&hash64_seedCounter, 1, __ATOMIC_RELAXED);
+#else
+    _Atomic int *state = (_Atomic int *) &hash64_secretState;
+
+    if (atomic_load_explicit(state, memory_order_acquire) == 2) {
+        secret[0] = hash64_secret[0];
+        secret[1] = hash64_secret[1];
+    } else {
+        hash64_systemRandom(secret, 2);
+
+        if (atomic_compare_exchange_strong_explicit(state, &expected, 1,
+                                                    memory_order_acquire,
+                                                    memory_order_relaxed)) {
+            hash64_secret[0] = secret[0];
+            hash64_secret[1] = secret[1];
+            atomic_store_explicit(state, 2, memory_order_release);
+        }
+    }
+
+    counter = atomic_fetch_add_explicit(
+        (_Atomic uint64_t *) &hash64_seedCounter, 1, memory_order_relaxed);
+#endif
+
+    return hash64_mix(hash64_bytes(&counter, sizeof(counter), secret[0])
+                      ^ HASH64_SECRET[2],
+                      secret[1] ^ HASH64_SECRET[3]);
+}
@@ -0,0 +1,143 @@
+/**
+ * @file dshash64.h
+ *
+ * Fast 64-bit hash functions for strings and binary data.
+ *
+ * @ref hash64_bytes hashes a block of memory of any length, and
+ * @ref hash64_string a text string.  Both take a seed, so that
+ * different seeds give unrelated hashes.  They read the data 8 to 48
+ * bytes at a time, so are much faster than @ref stringHash on long
+ * keys, and every bit of the result depends on every bit of the data.
+ * The results are the same on all platforms.
+ *
+ * For a hash table or set keyed by strings, @ref fastStringHash can be
+ * used in place of @ref stringHash.  Keys which are not text strings,
+ * and so may contain zero bytes, can be stored as @ref BinaryKey
+ * structures with @ref binaryKeyHash and @ref binaryKeyEqual.
+ *
+ * Tables whose keys come from untrusted sources should use a secret
+ * seed, so that keys can not be chosen to collide: see
+ * @ref fastStringHashSeeded, @ref binaryKeyHashSeeded and
+ * @ref hash64_randomSeed.
+ */
+
+#ifndef DSHASH64_H
+#define DSHASH64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A key made of a block of binary data, which may contain zero bytes.
+ */
+
+typedef struct _BinaryKey {
+
+	/** Pointer to the data. */
+
+	void *data;
+
+	/** Length of the data in bytes. */
+
+	size_t length;
+} BinaryKey;
+
+/**
+ * Generate a 64-bit hash of a block of memory.
+ *
+ * @param data            Pointer to the data.
+ * @param length          Length of the data in bytes.
+ * @param seed            The seed.
+ * @return                A hash of the data.
+ */
+
+uint64_t hash64_bytes(const void *data, size_t length, uint64_t seed);
+
+/**
+ * Generate a 64-bit hash of a string.  This is the same as the hash
+ * of its characters with @ref hash64_bytes.
+ *
+ * @param string          The string.
+ * @param seed            The seed.
+ * @return                A hash of the string.
+ */
+
+uint64_t hash64_string(const char *string, uint64_t seed);
+
+/**
+ * Generate a hash key from a string, with @ref hash64_string.  This
+ * can be used in place of @ref stringHash.
+ *
+ * @param string          The string.
+ * @return                A hash key for the string.
+ */
+
+unsigned int fastStringHash(void *string);
+
+/**
+ * Generate a hash key from a string and a seed, with
+ * @ref hash64_string.
+ *
+ * @param string          The string.
+ * @param seed            The seed.
+ * @return                A hash key for the string.
+ */
+
+unsigned int fastStringHashSeeded(void *string, uint64_t seed);
+
+/**
+ * Generate a hash key for a pointer to a @ref BinaryKey.
+ *
+ * @param key             Pointer to the key.
+ * @return                A hash key for the data of the key.
+ */
+
+unsigned int binaryKeyHash(void *key);
+
+/**
+ * Generate a hash key for a pointer to a @ref BinaryKey and a seed.
+ *
+ * @param key             Pointer to the key.
+ * @param seed            The seed.
+ * @return                A hash key for the data of the key.
+ */
+
+unsigned int binaryKeyHashSeeded(void *key, uint64_t seed);
+
+/**
+ * Compare two pointers to @ref BinaryKey structures to determine if
+ * their data is equal.
+ *
+ * @param key1            Pointer to the first key.
+ * @param key2            Pointer to the second key.
+ * @return                Non-zero if the keys have the same length and
+ *                        data, zero if they do not.
+ */
+
+int binaryKeyEqual(void *key1, void *key2);
+
+/**
+ * Generate a random seed.  A secret is read once per process from the
+ * system's cryptographic random number generator (rand_s on Windows,
+ * getrandom, arc4random or /dev/urandom elsewhere), and each seed is
+ * made from the secret and a count of the seeds generated so far, so
+ * seeds can not be guessed, and no two are the same.  This is safe to
+ * call from several threads at once.  If the random number generator
+ * fails, the program is stopped with a message rather than given a
+ * seed which could be guessed.
+ *
+ * @return                A random seed.
+ */
+
+uint64_t hash64_randomSeed(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSHASH64_H */
+
@@ -9,3 +9,20 @@ unsigned int intHash(void *vlocation)
 	return (unsigned int) *location;
 }
 
+/* The same, mixed with the murmur3 32-bit finaliser */
+
+unsigned int intHashMix(void *vlocation)
+{
+    return intMix((unsigned int) *((int *) vlocation));
+}
+
+unsigned int intMix(unsigned int hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+
+    return hash;
+}
@@ -1,7 +1,9 @@
 /**
  * @file dshashint.h
  *
- * Hash function for a pointer to an integer.  See @ref intHash.
+ * Hash functions for a pointer to an integer.  See @ref intHash and
+ * @ref intHashMix.  @ref intMix is the mixing function used by
+ * @ref intHashMix, for use on hashes which are already integers.
  */
 
 #ifndef DSHASHINT_H
@@ -21,6 +23,32 @@ extern "C" {
 
 unsigned int intHash(void *location);
 
+/**
+ * Generate a hash key for a pointer to an integer, mixing the bits of
+ * the value so that every bit of the key depends on every bit of the
+ * value.  Unlike @ref intHash, sequential values give unrelated keys,
+ * so the low bits of the key can be used on their own, as by tables
+ * with a power of two size.
+ *
+ * @param location        The pointer.
+ * @return                A hash key for the value at the location.
+ */
+
+unsigned int intHashMix(void *location);
+
+/**
+ * Mix the bits of an integer so that every bit of the result depends on
+ * every bit of the integer.  This is the MurmurHash3 32-bit finaliser,
+ * and is reversible, so different integers give different results.  It
+ * is used by the containers which choose a bucket with the low bits of
+ * a hash to spread hashes whose low bits are weak.
+ *
+ * @param value           The integer.
+ * @return                The mixed integer.
+ */
+
+unsigned int intMix(unsigned int value);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,4 +1,5 @@
 #include <limits.h>
+#include <stdint.h>
 
 #include "dshashpointer.h"
 
@@ -9,3 +10,16 @@ unsigned int pointerHash(void *location)
 	return (unsigned int) (unsigned long) location;
 }
 
+/* The same, mixed with the splitmix64 finaliser and folded to the size
+ * of a hash key */
+
+unsigned int pointerHashMix(void *location)
+{
+    uint64_t hash = (uint64_t) (uintptr_t) location;
+
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+
+    return (unsigned int) (hash ^ (hash >> 32));
+}
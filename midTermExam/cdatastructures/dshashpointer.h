@@ -1,7 +1,8 @@
 /**
  * @file dshashpointer.h
  *
- * Hash function for a generic (void) pointer.  See @ref pointerHash.
+ * Hash functions for a generic (void) pointer.  See @ref pointerHash
+ * and @ref pointerHashMix.
  */
 
 #ifndef DSHASHPOINTER_H
@@ -21,6 +22,19 @@ extern "C" {
 
 unsigned int pointerHash(void *location);
 
+/**
+ * Generate a hash key for a pointer, mixing all of the bits of the
+ * address.  The low bits of an address are usually zero, since objects
+ * are aligned, and its high bits are usually the same for all objects;
+ * with this function neither matters, so the low bits of the key can
+ * be used on their own, as by tables with a power of two size.
+ *
+ * @param location        The pointer
+ * @return                A hash key for the pointer.
+ */
+
+unsigned int pointerHashMix(void *location);
+
 #ifdef __cplusplus
 }
 #endif
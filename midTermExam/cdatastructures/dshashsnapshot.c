@@ -0,0 +1,724 @@
+/* Hash table snapshots
+ *
+ * A snapshot file is laid out as:
+ *
+ *   header   magic "HSNP", version, seed, number of entries, number of
+ *            slots, offset of the slots and size of the file
+ *   records  for each entry: key length and value length (4 bytes
+ *            each), then the key and the value, each padded to a
+ *            multiple of 8 bytes
+ *   slots    a power of two number of slots, at most three quarters
+ *            of them used, each holding the 64-bit hash of a key and
+ *            the offset of its record, or zero if the slot is empty
+ *
+ * All numbers are little-endian, and all positions are offsets from the
+ * start of the file.  Keys are hashed with hash64_bytes and the seed
+ * of the file, and the slots are searched by linear probing from the
+ * slot chosen by the low bits of the hash.  The slots are written last,
+ * so that the records can be written as the table is walked.
+ *
+ * A snapshot is written to a temporary file next to the file named,
+ * which is flushed to disk and then renamed over it in one step, so
+ * that a reader never sees a partly written snapshot, and a crash
+ * while writing leaves any old snapshot in place.  On POSIX systems
+ * the directory is then flushed too, so that the new name survives a
+ * crash.
+ *
+ * Snapshots are opened with mmap on POSIX systems and with
+ * MapViewOfFile on Windows.  Elsewhere the file is read into memory. */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dshashsnapshot.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#include <windows.h>
+#define HASH_SNAPSHOT_USE_WIN32
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HASH_SNAPSHOT_USE_MMAP
+#endif
+
+#define HASH_SNAPSHOT_VERSION 1
+#define HASH_SNAPSHOT_HEADER_SIZE 64
+#define HASH_SNAPSHOT_RECORD_HEADER_SIZE 8
+#define HASH_SNAPSHOT_SLOT_SIZE 16
+#define HASH_SNAPSHOT_MIN_SLOTS 16
+
+/* Where a snapshot can not be mapped, it is read into a buffer which
+ * starts at this size and doubles until the whole file fits */
+
+#define HASH_SNAPSHOT_READ_SIZE (1024 * 1024)
+
+static const unsigned char HASH_SNAPSHOT_MAGIC[4] = { 'H', 'S', 'N', 'P' };
+
+struct _HashSnapshot {
+    AllocatorUsage usage;
+    const unsigned char *data;
+    size_t length;
+    int mapped;
+    uint64_t seed;
+    uint64_t numEntries;
+    uint64_t slotMask;
+    uint64_t slotsOffset;
+};
+
+/* Numbers are read and written little-endian.  On little-endian
+ * machines a read is a plain load. */
+
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) \
+    || defined(_M_X64) || defined(_M_IX86)
+#define HASH_SNAPSHOT_LITTLE_ENDIAN
+#endif
+
+static void hashsnapshot_writeNumber(unsigned char *array,
+                                     uint64_t value,
+                                     unsigned int length)
+{
+    unsigned int i;
+
+    for (i=0; i<length; ++i) {
+        array[i] = (unsigned char) (value >> (8 * i));
+    }
+}
+
+static uint64_t hashsnapshot_read64(const unsigned char *array)
+{
+#ifdef HASH_SNAPSHOT_LITTLE_ENDIAN
+    uint64_t value;
+
+    memcpy(&value, array, sizeof(value));
+
+    return value;
+#else
+    uint64_t value = 0;
+    unsigned int i;
+
+    for (i=8; i>0; --i) {
+        value = (value << 8) | array[i - 1];
+    }
+
+    return value;
+#endif
+}
+
+static uint32_t hashsnapshot_read32(const unsigned char *array)
+{
+#ifdef HASH_SNAPSHOT_LITTLE_ENDIAN
+    uint32_t value;
+
+    memcpy(&value, array, sizeof(value));
+
+    return value;
+#else
+    return (uint32_t) array[0] | ((uint32_t) array[1] << 8)
+         | ((uint32_t) array[2] << 16) | ((uint32_t) array[3] << 24);
+#endif
+}
+
+/* Round a length up to a multiple of 8 bytes */
+
+static uint64_t hashsnapshot_align(uint64_t length)
+{
+    return (length + 7) & ~(uint64_t) 7;
+}
+
+BinaryKey hashsnapshot_stringData(void *string)
+{
+    BinaryKey result;
+
+    result.data = string;
+    result.length = strlen((char *) string) + 1;
+
+    return result;
+}
+
+BinaryKey hashsnapshot_binaryKeyData(void *key)
+{
+    return *((BinaryKey *) key);
+}
+
+/* Write a block of data followed by the padding after it */
+
+static int hashsnapshot_writeBlock(FILE *file, BinaryKey block)
+{
+    static const unsigned char padding[8] = { 0 };
+    size_t paddingLength = (size_t) (hashsnapshot_align(block.length)
+                                     - block.length);
+
+    if (block.length > 0
+     && fwrite(block.data, block.length, 1, file) != 1) {
+        return 0;
+    }
+
+    return paddingLength == 0
+        || fwrite(padding, paddingLength, 1, file) == 1;
+}
+
+#ifdef HASH_SNAPSHOT_USE_MMAP
+
+/* Flush the directory holding a file, so that a name just given to it
+ * by rename is on disk.  The buffer must be at least as long as the
+ * name.  The snapshot is already in place by now, so this is only done
+ * as well as the file system allows, and a failure is not reported. */
+
+static void hashsnapshot_syncDirectory(const char *filename, char *buffer)
+{
+    const char *slash = strrchr(filename, '/');
+    size_t length;
+    int fd;
+
+    if (slash == NULL) {
+        strcpy(buffer, ".");
+    } else {
+        length = slash == filename ? 1 : (size_t) (slash - filename);
+        memcpy(buffer, filename, length);
+        buffer[length] = '\0';
+    }
+
+    fd = open(buffer, O_RDONLY);
+
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+#endif
+
+int hashsnapshot_write(HashTable *hashTable,
+                       const char *filename,
+                       HashSnapshotDataFunc keyFunc,
+                       HashSnapshotDataFunc valueFunc)
+{
+    unsigned char header[HASH_SNAPSHOT_HEADER_SIZE];
+    unsigned char recordHeader[HASH_SNAPSHOT_RECORD_HEADER_SIZE];
+    AllocatorUsage usage;
+    HashTableIterator iterator;
+    HashTablePair pair;
+    BinaryKey key;
+    BinaryKey value;
+    unsigned char *slots;
+    unsigned char *slot;
+    uint64_t numSlots;
+    uint64_t numEntries = 0;
+    uint64_t offset = HASH_SNAPSHOT_HEADER_SIZE;
+    uint64_t seed;
+    uint64_t hash;
+    uint64_t index;
+    size_t filenameLength = strlen(filename);
+    char *tempName;
+    FILE *file;
+    int success;
+
+    allocator_initUsage(&usage, NULL);
+
+	/* Keep the slots at most three quarters full.  Linear probing
+	 * still finds a key in a couple of probes at this load, and the
+	 * slots, which are held in memory while the snapshot is written,
+	 * take half the space they would if kept half full. */
+
+    numSlots = HASH_SNAPSHOT_MIN_SLOTS;
+
+    while (numSlots - numSlots / 4
+           < (uint64_t) hashtable_numEntries(hashTable)) {
+        numSlots *= 2;
+    }
+
+    if (numSlots > SIZE_MAX / HASH_SNAPSHOT_SLOT_SIZE
+     || filenameLength > SIZE_MAX - 5) {
+        return 0;
+    }
+
+    tempName = allocator_malloc(&usage, filenameLength + 5);
+
+    if (tempName == NULL) {
+        return 0;
+    }
+
+    memcpy(tempName, filename, filenameLength);
+    memcpy(tempName + filenameLength, ".tmp", 5);
+
+    slots = allocator_calloc(&usage, (size_t) numSlots,
+                             HASH_SNAPSHOT_SLOT_SIZE);
+
+    if (slots == NULL) {
+        allocator_free(&usage, tempName, filenameLength + 5);
+        return 0;
+    }
+
+    file = fopen(tempName, "wb");
+
+    if (file == NULL) {
+        allocator_free(&usage, slots,
+                       (size_t) numSlots * HASH_SNAPSHOT_SLOT_SIZE);
+        allocator_free(&usage, tempName, filenameLength + 5);
+        return 0;
+    }
+
+	/* The header is written last, when the offsets are known */
+
+    memset(header, 0, sizeof(header));
+    success = fwrite(header, sizeof(header), 1, file) == 1;
+
+    seed = hash64_randomSeed();
+
+    hashtable_iterate(hashTable, &iterator);
+
+    while (success && hashtable_iteratorHasMore(&iterator)) {
+        pair = hashtable_iteratorNext(&iterator);
+        key = keyFunc(pair.key);
+        value = valueFunc(pair.value);
+
+        if ((uint64_t) key.length > 0xffffffffU
+         || (uint64_t) value.length > 0xffffffffU) {
+            success = 0;
+            break;
+        }
+
+		/* Take the first free slot along the probe sequence */
+
+        hash = hash64_bytes(key.data, key.length, seed);
+        index = hash & (numSlots - 1);
+
+        while (hashsnapshot_read64(slots + index * HASH_SNAPSHOT_SLOT_SIZE
+                                   + 8) != 0) {
+            index = (index + 1) & (numSlots - 1);
+        }
+
+        slot = slots + index * HASH_SNAPSHOT_SLOT_SIZE;
+        hashsnapshot_writeNumber(slot, hash, 8);
+        hashsnapshot_writeNumber(slot + 8, offset, 8);
+
+        hashsnapshot_writeNumber(recordHeader, key.length, 4);
+        hashsnapshot_writeNumber(recordHeader + 4, value.length, 4);
+
+        success = fwrite(recordHeader, sizeof(recordHeader), 1, file) == 1
+               && hashsnapshot_writeBlock(file, key)
+               && hashsnapshot_writeBlock(file, value);
+
+        offset += HASH_SNAPSHOT_RECORD_HEADER_SIZE
+                + hashsnapshot_align(key.length)
+                + hashsnapshot_align(value.length);
+        ++numEntries;
+    }
+
+    if (success) {
+        memcpy(header, HASH_SNAPSHOT_MAGIC, 4);
+        hashsnapshot_writeNumber(header + 4, HASH_SNAPSHOT_VERSION, 4);
+        hashsnapshot_writeNumber(header + 8, seed, 8);
+        hashsnapshot_writeNumber(header + 16, numEntries, 8);
+        hashsnapshot_writeNumber(header + 24, numSlots, 8);
+        hashsnapshot_writeNumber(header + 32, offset, 8);
+        hashsnapshot_writeNumber(header + 40,
+                                 offset + numSlots * HASH_SNAPSHOT_SLOT_SIZE,
+                                 8);
+
+        success = fwrite(slots, HASH_SNAPSHOT_SLOT_SIZE, (size_t) numSlots,
+                         file) == numSlots
+               && fseek(file, 0, SEEK_SET) == 0
+               && fwrite(header, sizeof(header), 1, file) == 1
+               && fflush(file) == 0;
+    }
+
+	/* The data must be on disk before the rename, or a crash could
+	 * leave the new name pointing at an incomplete file */
+
+#if defined(HASH_SNAPSHOT_USE_WIN32)
+    if (success && _commit(_fileno(file)) != 0) {
+        success = 0;
+    }
+#elif defined(HASH_SNAPSHOT_USE_MMAP)
+    if (success && fsync(fileno(file)) != 0) {
+        success = 0;
+    }
+#endif
+
+    if (fclose(file) != 0) {
+        success = 0;
+    }
+
+	/* rename does not replace an existing file on Windows, and
+	 * removing the old file first would leave no snapshot at all if
+	 * the process stopped in between */
+
+#ifdef HASH_SNAPSHOT_USE_WIN32
+    if (success && !MoveFileExA(tempName, filename,
+                                MOVEFILE_REPLACE_EXISTING
+                                | MOVEFILE_WRITE_THROUGH)) {
+        success = 0;
+    }
+#else
+    if (success && rename(tempName, filename) != 0) {
+        success = 0;
+    }
+#endif
+
+    if (!success) {
+        remove(tempName);
+    }
+
+#ifdef HASH_SNAPSHOT_USE_MMAP
+    if (success) {
+        hashsnapshot_syncDirectory(filename, tempName);
+    }
+#endif
+
+    allocator_free(&usage, slots, (size_t) numSlots * HASH_SNAPSHOT_SLOT_SIZE);
+    allocator_free(&usage, tempName, filenameLength + 5);
+
+    return success;
+}
+
+/* Check the header of a snapshot, and fill in the fields describing its
+ * layout */
+
+static int hashsnapshot_readHeader(HashSnapshot *snapshot)
+{
+    const unsigned char *data = snapshot->data;
+    uint64_t numSlots;
+    uint64_t slotsOffset;
+
+    if (snapshot->length < HASH_SNAPSHOT_HEADER_SIZE
+     || memcmp(data, HASH_SNAPSHOT_MAGIC, 4) != 0
+     || hashsnapshot_read32(data + 4) != HASH_SNAPSHOT_VERSION
+     || hashsnapshot_read64(data + 40) != (uint64_t) snapshot->length) {
+        return 0;
+    }
+
+    numSlots = hashsnapshot_read64(data + 24);
+    slotsOffset = hashsnapshot_read64(data + 32);
+
+	/* The slots must fill the end of the file exactly, and there must
+	 * be a power of two of them */
+
+    if (numSlots < HASH_SNAPSHOT_MIN_SLOTS
+     || (numSlots & (numSlots - 1)) != 0
+     || slotsOffset < HASH_SNAPSHOT_HEADER_SIZE
+     || slotsOffset % 8 != 0
+     || slotsOffset > snapshot->length
+     || numSlots != (snapshot->length - slotsOffset)
+                    / HASH_SNAPSHOT_SLOT_SIZE
+     || (snapshot->length - slotsOffset) % HASH_SNAPSHOT_SLOT_SIZE != 0) {
+        return 0;
+    }
+
+    snapshot->seed = hashsnapshot_read64(data + 8);
+    snapshot->numEntries = hashsnapshot_read64(data + 16);
+    snapshot->slotMask = numSlots - 1;
+    snapshot->slotsOffset = slotsOffset;
+
+    return 1;
+}
+
+/* Map a file into memory, or read it in where mapping is not
+ * available */
+
+static int hashsnapshot_load(HashSnapshot *snapshot, const char *filename)
+{
+#if defined(HASH_SNAPSHOT_USE_MMAP)
+    struct stat status;
+    void *mapping;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+
+    if (fd < 0) {
+        return 0;
+    }
+
+    if (fstat(fd, &status) != 0 || status.st_size <= 0
+     || (uint64_t) status.st_size > (uint64_t) SIZE_MAX) {
+        close(fd);
+        return 0;
+    }
+
+    mapping = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_SHARED,
+                   fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return 0;
+    }
+
+	/* Lookups touch pages at random, so reading ahead would only
+	 * waste memory */
+
+    posix_madvise(mapping, (size_t) status.st_size, POSIX_MADV_RANDOM);
+
+    snapshot->data = (const unsigned char *) mapping;
+    snapshot->length = (size_t) status.st_size;
+    snapshot->mapped = 1;
+
+    return 1;
+#elif defined(HASH_SNAPSHOT_USE_WIN32)
+    LARGE_INTEGER size;
+    HANDLE file;
+    HANDLE mapping;
+    void *view;
+
+    file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                       OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+
+    if (file == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0
+     || (uint64_t) size.QuadPart > (uint64_t) SIZE_MAX) {
+        CloseHandle(file);
+        return 0;
+    }
+
+	/* The view keeps the mapping and the file open, so both handles
+	 * can be closed as soon as it is made */
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+
+    if (mapping == NULL) {
+        return 0;
+    }
+
+    view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if (view == NULL) {
+        return 0;
+    }
+
+    snapshot->data = (const unsigned char *) view;
+    snapshot->length = (size_t) size.QuadPart;
+    snapshot->mapped = 1;
+
+    return 1;
+#else
+    unsigned char header[HASH_SNAPSHOT_HEADER_SIZE];
+    unsigned char *data;
+    unsigned char *larger;
+    uint64_t length;
+    size_t numRead;
+    size_t size;
+    size_t newSize;
+    FILE *file;
+
+    file = fopen(filename, "rb");
+
+    if (file == NULL) {
+        return 0;
+    }
+
+	/* ftell may not be able to give the size of a large file, so it
+	 * is taken from the header, and the file must end exactly there */
+
+    if (fread(header, sizeof(header), 1, file) != 1) {
+        fclose(file);
+        return 0;
+    }
+
+    length = hashsnapshot_read64(header + 40);
+
+    if (length < sizeof(header) || length > (uint64_t) SIZE_MAX) {
+        fclose(file);
+        return 0;
+    }
+
+	/* The length is not trusted until that much has been read, so the
+	 * buffer starts small and doubles as the data arrives */
+
+    size = length < HASH_SNAPSHOT_READ_SIZE ? (size_t) length
+                                            : HASH_SNAPSHOT_READ_SIZE;
+    data = allocator_malloc(&snapshot->usage, size);
+
+    if (data == NULL) {
+        fclose(file);
+        return 0;
+    }
+
+    memcpy(data, header, sizeof(header));
+    numRead = sizeof(header);
+
+    for (;;) {
+        numRead += fread(data + numRead, 1, size - numRead, file);
+
+        if (numRead < size || size == length) {
+            break;
+        }
+
+        newSize = length - size < size ? (size_t) length : size * 2;
+        larger = allocator_malloc(&snapshot->usage, newSize);
+
+        if (larger == NULL) {
+            break;
+        }
+
+        memcpy(larger, data, size);
+        allocator_free(&snapshot->usage, data, size);
+        data = larger;
+        size = newSize;
+    }
+
+    if (numRead != length || fgetc(file) != EOF) {
+        allocator_free(&snapshot->usage, data, size);
+        fclose(file);
+        return 0;
+    }
+
+    fclose(file);
+
+    snapshot->data = data;
+    snapshot->length = (size_t) length;
+    snapshot->mapped = 0;
+
+    return 1;
+#endif
+}
+
+static void hashsnapshot_unload(HashSnapshot *snapshot)
+{
+#if defined(HASH_SNAPSHOT_USE_MMAP)
+    if (snapshot->mapped) {
+        munmap((void *) snapshot->data, snapshot->length);
+        return;
+    }
+#elif defined(HASH_SNAPSHOT_USE_WIN32)
+    if (snapshot->mapped) {
+        UnmapViewOfFile(snapshot->data);
+        return;
+    }
+#endif
+
+    allocator_free(&snapshot->usage, (void *) snapshot->data,
+                   snapshot->length);
+}
+
+/* Free the snapshot structure itself, which holds the record of the
+ * allocator used for it */
+
+static void hashsnapshot_freeStructure(HashSnapshot *snapshot)
+{
+    AllocatorUsage usage = snapshot->usage;
+
+    allocator_free(&usage, snapshot, sizeof(HashSnapshot));
+}
+
+HashSnapshot *hashsnapshot_open(const char *filename)
+{
+    AllocatorUsage usage;
+    HashSnapshot *snapshot;
+
+    allocator_initUsage(&usage, NULL);
+
+    snapshot = (HashSnapshot *) allocator_malloc(&usage,
+                                                 sizeof(HashSnapshot));
+
+    if (snapshot == NULL) {
+        return NULL;
+    }
+
+    snapshot->usage = usage;
+
+    if (!hashsnapshot_load(snapshot, filename)) {
+        hashsnapshot_freeStructure(snapshot);
+        return NULL;
+    }
+
+    if (!hashsnapshot_readHeader(snapshot)) {
+        hashsnapshot_close(snapshot);
+        return NULL;
+    }
+
+    return snapshot;
+}
+
+void hashsnapshot_close(HashSnapshot *snapshot)
+{
+    hashsnapshot_unload(snapshot);
+    hashsnapshot_freeStructure(snapshot);
+}
+
+size_t hashsnapshot_numEntries(HashSnapshot *snapshot)
+{
+    return (size_t) snapshot->numEntries;
+}
+
+const void *hashsnapshot_lookup(HashSnapshot *snapshot,
+                                const void *key,
+                                size_t keyLength,
+                                size_t *valueLength)
+{
+    const unsigned char *slots = snapshot->data + snapshot->slotsOffset;
+    const unsigned char *slot;
+    const unsigned char *record;
+    uint64_t hash = hash64_bytes(key, keyLength, snapshot->seed);
+    uint64_t index = hash & snapshot->slotMask;
+    uint64_t offset;
+    uint64_t end;
+    uint64_t probe;
+    uint32_t recordKeyLength;
+    uint32_t recordValueLength;
+
+	/* The probe count is bounded so that a damaged file with no empty
+	 * slots can not loop forever */
+
+    for (probe=0; probe<=snapshot->slotMask; ++probe) {
+        slot = slots + index * HASH_SNAPSHOT_SLOT_SIZE;
+        offset = hashsnapshot_read64(slot + 8);
+
+        if (offset == 0) {
+            return NULL;
+        }
+
+        if (hashsnapshot_read64(slot) == hash
+         && offset >= HASH_SNAPSHOT_HEADER_SIZE
+         && offset <= snapshot->slotsOffset
+                      - HASH_SNAPSHOT_RECORD_HEADER_SIZE) {
+
+            record = snapshot->data + offset;
+            recordKeyLength = hashsnapshot_read32(record);
+            recordValueLength = hashsnapshot_read32(record + 4);
+
+			/* Records are checked to lie before the slots, so that a
+			 * damaged file can not cause reads outside it */
+
+            end = offset + HASH_SNAPSHOT_RECORD_HEADER_SIZE
+                + hashsnapshot_align(recordKeyLength) + recordValueLength;
+
+            if (recordKeyLength == keyLength
+             && end <= snapshot->slotsOffset
+             && (keyLength == 0
+                 || memcmp(record + HASH_SNAPSHOT_RECORD_HEADER_SIZE, key,
+                           keyLength) == 0)) {
+
+                if (valueLength != NULL) {
+                    *valueLength = recordValueLength;
+                }
+
+                return record + HASH_SNAPSHOT_RECORD_HEADER_SIZE
+                     + hashsnapshot_align(recordKeyLength);
+            }
+        }
+
+        index = (index + 1) & snapshot->slotMask;
+    }
+
+    return NULL;
+}
+
+const void *hashsnapshot_lookupString(HashSnapshot *snapshot,
+                                      const char *key,
+                                      size_t *valueLength)
+{
+    return hashsnapshot_lookup(snapshot, key, strlen(key) + 1, valueLength);
+}
@@ -0,0 +1,177 @@
+/**
+ * @file dshashsnapshot.h
+ *
+ * @brief Hash table snapshots
+ *
+ * A hash table snapshot is a file holding the keys and values of a
+ * @ref HashTable, laid out as an open-addressed hash table which can be
+ * searched where it is.  Opening a snapshot maps the file into memory
+ * instead of reading it, and lookups read the keys and values directly
+ * from the mapping, so a large table is available as soon as it is
+ * opened; only the pages which lookups touch are ever read from disk.
+ *
+ * Keys and values are stored as blocks of bytes.  When a snapshot is
+ * written, a function is given to convert each key and each value of
+ * the table to a block: @ref hashsnapshot_stringData for text strings,
+ * @ref hashsnapshot_binaryKeyData for @ref BinaryKey structures, or a
+ * function of the caller's own.
+ *
+ * The file contains no pointers, and is the same on all platforms.
+ *
+ * To write a snapshot of a hash table, use @ref hashsnapshot_write.  To
+ * open a snapshot, use @ref hashsnapshot_open, and to close it, use
+ * @ref hashsnapshot_close.  To look up a key, use
+ * @ref hashsnapshot_lookup or @ref hashsnapshot_lookupString.
+ */
+
+#ifndef DSHASHSNAPSHOT_H
+#define DSHASHSNAPSHOT_H
+
+#include <stddef.h>
+
+#include "dshash64.h"
+#include "dshashtable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * An open hash table snapshot.
+ */
+
+typedef struct _HashSnapshot HashSnapshot;
+
+/**
+ * Function used to convert a key or a value of a hash table to the
+ * block of bytes stored for it in a snapshot.
+ *
+ * @param item     The key or value.
+ * @return         The data and length of the block.  The data must
+ *                 stay valid until the snapshot has been written.
+ */
+
+typedef BinaryKey (*HashSnapshotDataFunc)(void *item);
+
+/**
+ * Convert a text string to a block for a snapshot.  The block includes
+ * the terminating zero, so that strings read from the snapshot can be
+ * used as they are.
+ *
+ * @param string          The string.
+ * @return                A block holding the string.
+ */
+
+BinaryKey hashsnapshot_stringData(void *string);
+
+/**
+ * Convert a pointer to a @ref BinaryKey to a block for a snapshot.
+ *
+ * @param key             Pointer to the key.
+ * @return                A block holding the data of the key.
+ */
+
+BinaryKey hashsnapshot_binaryKeyData(void *key);
+
+/**
+ * Write a snapshot of a hash table to a file, replacing the file if it
+ * already exists.  The hash table must not be changed while the
+ * snapshot is written.
+ *
+ * The snapshot is first written to a file of the same name followed by
+ * ".tmp", which is flushed to disk and then renamed, so the file named
+ * always holds either the old snapshot or the complete new one.
+ *
+ * Besides the keys and values, a snapshot holds an index of 16 bytes
+ * for each of a power of two number of slots, between 4/3 and 8/3 of
+ * the number of entries.  The index is built in memory before it is
+ * written, so writing a snapshot of 20 million entries allocates
+ * 512 MiB for it, and the same is added to the size of the file.
+ *
+ * @param hashTable       The hash table.
+ * @param filename        Name of the file to write.
+ * @param keyFunc         Function to convert the keys of the table.
+ * @param valueFunc       Function to convert the values of the table.
+ * @return                Non-zero on success, or zero if the file could
+ *                        not be written, a key or value was larger than
+ *                        4 GiB, or it was not possible to allocate
+ *                        memory.  On failure the file named is not
+ *                        changed, and no temporary file is left
+ *                        behind.
+ */
+
+int hashsnapshot_write(HashTable *hashTable,
+                       const char *filename,
+                       HashSnapshotDataFunc keyFunc,
+                       HashSnapshotDataFunc valueFunc);
+
+/**
+ * Open a snapshot written by @ref hashsnapshot_write.  Where the system
+ * supports it the file is mapped into memory; otherwise it is read into
+ * memory as a whole.
+ *
+ * @param filename        Name of the file to open.
+ * @return                The snapshot, or NULL if the file could not be
+ *                        opened or does not hold a valid snapshot.
+ */
+
+HashSnapshot *hashsnapshot_open(const char *filename);
+
+/**
+ * Close a snapshot.  Any pointers returned by lookups in it are no
+ * longer valid.
+ *
+ * @param snapshot        The snapshot to close.
+ */
+
+void hashsnapshot_close(HashSnapshot *snapshot);
+
+/**
+ * Retrieve the number of entries in a snapshot.
+ *
+ * @param snapshot        The snapshot.
+ * @return                The number of entries.
+ */
+
+size_t hashsnapshot_numEntries(HashSnapshot *snapshot);
+
+/**
+ * Look up a key in a snapshot.
+ *
+ * @param snapshot        The snapshot.
+ * @param key             Pointer to the data of the key.
+ * @param keyLength       Length of the key in bytes.
+ * @param valueLength     If not NULL, receives the length of the value
+ *                        in bytes.
+ * @return                Pointer to the value, which is inside the
+ *                        snapshot and aligned to 8 bytes, or NULL if the
+ *                        key is not in the snapshot.
+ */
+
+const void *hashsnapshot_lookup(HashSnapshot *snapshot,
+                                const void *key,
+                                size_t keyLength,
+                                size_t *valueLength);
+
+/**
+ * Look up a text string key in a snapshot whose keys were written with
+ * @ref hashsnapshot_stringData.
+ *
+ * @param snapshot        The snapshot.
+ * @param key             The key.
+ * @param valueLength     If not NULL, receives the length of the value
+ *                        in bytes.
+ * @return                Pointer to the value, or NULL if the key is not
+ *                        in the snapshot.
+ */
+
+const void *hashsnapshot_lookupString(HashSnapshot *snapshot,
+                                      const char *key,
+                                      size_t *valueLength);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSHASHSNAPSHOT_H */
+
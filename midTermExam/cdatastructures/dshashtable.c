@@ -2,229 +2,1528 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "dsavltree.h"
+#include "dshash64.h"
+#include "dshashint.h"
 #include "dshashtable.h"
+#include "dsslab.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HASH_TABLE_USE_SSE2
+#endif
+
+/* Hint that a cache line will be read soon */
+
+#if defined(__GNUC__)
+#define HASH_TABLE_PREFETCH(address) __builtin_prefetch(address)
+#elif defined(HASH_TABLE_USE_SSE2)
+#define HASH_TABLE_PREFETCH(address) \
+    _mm_prefetch((const char *) (address), _MM_HINT_T0)
+#else
+#define HASH_TABLE_PREFETCH(address) ((void) (address))
+#endif
+
+/* Number of keys in flight at once in hashtable_lookupBatch.  Enough to
+ * cover memory latency, but few enough that the prefetched lines are
+ * still in cache when they are used. */
+
+#define HASH_TABLE_BATCH_SIZE 16
+
+/* Each entry keeps the full hash of its key.  Chain walks compare it
+ * before calling the equality function, and resizes reuse it instead
+ * of hashing every key again. */
 
 struct _HashTableEntry {
 	HashTablePair pair;
+    unsigned int hash;
 	HashTableEntry *next;
 };
 
 struct _HashTable {
+    AllocatorUsage usage;
+    HashTableEngine engine;
 	HashTableEntry **table;
     unsigned int tableSize;
+    signed char *ctrl;
+    HashTablePair *slots;
+    unsigned int *hashes;
+    unsigned int numGroups;
+    unsigned int growthLeft;
     HashTableHashFunc hashFunc;
+    HashTableSeededHashFunc seededHashFunc;
+    uint64_t seed;
     HashTableEqualFunc equalFunc;
+    HashTableCompareFunc compareFunc;
+    AVLTree **trees;
     HashTableKeyFreeFunc keyFreeFunc;
     HashTableValueFreeFunc valueFreeFunc;
 	unsigned int entries;
-    unsigned int primeIndex;
+    unsigned int sizeIndex;
+    unsigned int reserved;
+    int powerOfTwo;
+    int incrementalResize;
+    HashTableEntry **oldTable;
+    unsigned int oldTableSize;
+    unsigned int rehashIndex;
+    Slab *slab;
+#ifdef HASH_TABLE_STATS
+    unsigned long searches;
+    unsigned long searchProbes;
+    unsigned int maxSearchProbes;
+    unsigned long resizes;
+    clock_t resizeTime;
+#endif
 };
 
+/* Statistics are only counted when built with HASH_TABLE_STATS, so that
+ * other builds pay nothing for them */
+
+#ifdef HASH_TABLE_STATS
+#define HASH_TABLE_COUNT_SEARCH(hashTable, probes) \
+    hashtable_countSearch(hashTable, probes)
+#else
+#define HASH_TABLE_COUNT_SEARCH(hashTable, probes) ((void) 0)
+#endif
+
 /* This is a set of good hash table prime numbers, from:
  *   http://planetmath.org/encyclopedia/GoodHashTablePrimes.html
  * Each prime is roughly double the previous value, and as far as
  * possible from the nearest powers of two. */
 
-static const unsigned int HASH_TABLE_PRIMES[] = {
-	193, 389, 769, 1543, 3079, 6151, 12289, 24593, 49157, 98317,
-	196613, 393241, 786433, 1572869, 3145739, 6291469,
-	12582917, 25165843, 50331653, 100663319, 201326611,
-	402653189, 805306457, 1610612741,
-};
+static const unsigned int HASH_TABLE_PRIMES[] = {
+	193, 389, 769, 1543, 3079, 6151, 12289, 24593, 49157, 98317,
+	196613, 393241, 786433, 1572869, 3145739, 6291469,
+	12582917, 25165843, 50331653, 100663319, 201326611,
+	402653189, 805306457, 1610612741,
+};
+
+static const unsigned int HASH_TABLE_NUM_PRIMES
+    = sizeof(HASH_TABLE_PRIMES) / sizeof(int);
+
+/* In power of two mode the table starts at 256 chains and doubles on
+ * each resize, up to 2^31 chains. */
+
+#define HASH_TABLE_POWER_OF_TWO_MIN_SIZE 256U
+#define HASH_TABLE_MAX_POWER_OF_TWO_INDEX 23
+
+/* Number of non-empty chains migrated by each operation during an
+ * incremental resize.  The table is enlarged when it is 1/3 full and
+ * the next table is about twice the size, so the migration must run
+ * at least three chains ahead of the inserts to complete before the
+ * next resize is due. */
+
+#define HASH_TABLE_REHASH_CHAINS 4
+
+/* A table is halved by the first insert after removes have left fewer
+ * entries than 1/HASH_TABLE_SHRINK_LOAD of its buckets.  This is well
+ * below the load at which it grows again, so that a table whose size
+ * goes up and down a little is not resized back and forth. */
+
+#define HASH_TABLE_SHRINK_LOAD 12
+
+/* With the long chain guard, a chain is indexed by a tree once it has
+ * more than this many entries, and the tree is dropped again when it
+ * has fewer than HASH_TABLE_UNTREEIFY_THRESHOLD.  With a load factor
+ * of at most 1/3, chains this long almost never happen by chance. */
+
+#define HASH_TABLE_TREEIFY_THRESHOLD 8
+#define HASH_TABLE_UNTREEIFY_THRESHOLD 6
+
+#ifdef HASH_TABLE_STATS
+
+static void hashtable_countSearch(HashTable *hashTable, unsigned int probes)
+{
+    ++hashTable->searches;
+    hashTable->searchProbes += probes;
+
+    if (probes > hashTable->maxSearchProbes) {
+        hashTable->maxSearchProbes = probes;
+    }
+}
+
+static void hashtable_countResize(HashTable *hashTable, clock_t start)
+{
+    ++hashTable->resizes;
+    hashTable->resizeTime += clock() - start;
+}
+
+#endif
+
+/* Generate the hash of a key, with the seed if the table has one.
+ * Power of two tables (both the flat engine and the chained engine in
+ * power of two mode) select buckets with a mask, so weak low bits in
+ * the user hash (such as those of aligned pointers) must be spread
+ * with intMix first.  In power of two mode the hash is mixed here, so
+ * that the hash stored in each entry is the one its bucket is chosen
+ * from. */
+
+static unsigned int hashtable_hash(HashTable *hashTable, HashTableKey key)
+{
+    unsigned int hash;
+
+    if (hashTable->seededHashFunc != NULL) {
+        hash = hashTable->seededHashFunc(key, hashTable->seed);
+    } else {
+        hash = hashTable->hashFunc(key);
+    }
+
+    if (hashTable->powerOfTwo) {
+        hash = intMix(hash);
+    }
+
+    return hash;
+}
+
+/* Find the chain of a table of a particular size a hash belongs in */
+
+static unsigned int hashtable_bucket(HashTable *hashTable,
+                                     unsigned int hash,
+                                     unsigned int tableSize)
+{
+    if (hashTable->powerOfTwo) {
+        return hash & (tableSize - 1);
+    }
+
+    return hash % tableSize;
+}
+
+/* Find the size of the table for a size index, or zero if the table
+ * can not grow that large.  Past the last prime the table has one
+ * more size, the largest prime which fits in an unsigned int.  Power
+ * of two tables stop at 2^31 buckets. */
+
+static unsigned int hashtable_sizeAt(HashTable *hashTable,
+                                     unsigned int sizeIndex)
+{
+    if (hashTable->powerOfTwo) {
+        if (sizeIndex > HASH_TABLE_MAX_POWER_OF_TWO_INDEX) {
+            return 0;
+        }
+
+        return HASH_TABLE_POWER_OF_TWO_MIN_SIZE << sizeIndex;
+    }
+
+    if (sizeIndex < HASH_TABLE_NUM_PRIMES) {
+        return HASH_TABLE_PRIMES[sizeIndex];
+    } else if (sizeIndex == HASH_TABLE_NUM_PRIMES) {
+        return 4294967291U;
+    }
+
+    return 0;
+}
+
+/* Internal function used to allocate the table on hash table creation
+ * and when enlarging the table */
+
+static int hashtable_allocateTable(HashTable *hashTable)
+{
+	/* Determine the table size based on the current size index */
+
+    hashTable->tableSize = hashtable_sizeAt(hashTable, hashTable->sizeIndex);
+
+	/* Allocate the table and initialise to NULL for all entries */
+
+    hashTable->table = allocator_calloc(&hashTable->usage,
+                                        hashTable->tableSize,
+                                        sizeof(HashTableEntry *));
+
+    return hashTable->table != NULL;
+}
+
+static void hashtable_freeTable(HashTable *hashTable,
+                                HashTableEntry **table,
+                                unsigned int tableSize)
+{
+    allocator_free(&hashTable->usage, table,
+                   tableSize * sizeof(HashTableEntry *));
+}
+
+/* Call the free functions for a pair, if there are any registered */
+
+static void hashtable_freePair(HashTable *hashTable, HashTablePair *pair)
+{
+	/* If there is a function registered for freeing keys, use it to free
+	 * the key */
+
+    if (hashTable->keyFreeFunc != NULL) {
+        hashTable->keyFreeFunc(pair->key);
+	}
+
+	/* Likewise with the value */
+
+    if (hashTable->valueFreeFunc != NULL) {
+        hashTable->valueFreeFunc(pair->value);
+	}
+}
+
+/* Allocate a chain entry, from the slab if the table has one */
+
+static HashTableEntry *hashtable_allocateEntry(HashTable *hashTable)
+{
+    if (hashTable->slab != NULL) {
+        return (HashTableEntry *) slab_allocate(hashTable->slab);
+    }
+
+    return (HashTableEntry *) allocator_malloc(&hashTable->usage,
+                                               sizeof(HashTableEntry));
+}
+
+/* Free an entry, calling the free functions if there are any registered */
+
+static void hashtable_freeEntry(HashTable *hashTable, HashTableEntry *entry)
+{
+    hashtable_freePair(hashTable, &(entry->pair));
+
+	/* Free the data structure */
+
+    if (hashTable->slab != NULL) {
+        slab_release(hashTable->slab, entry);
+    } else {
+        allocator_free(&hashTable->usage, entry, sizeof(HashTableEntry));
+    }
+}
+
+/* Long chain guard.
+ *
+ * A chain which grows too long is indexed by an AVL tree of its keys,
+ * whose values are the entries.  The entries stay linked in the chain,
+ * in the same order as the tree, so everything which walks chains
+ * works unchanged.  The link to an entry is then the next pointer of
+ * the entry before it in the tree, which is found in logarithmic time.
+ * Trees are only kept for the current table, in an array parallel to
+ * it which is allocated when the first one is needed. */
+
+static AVLTreeNode *hashtable_treeNeighbour(AVLTreeNode *node,
+                                            AVLTreeNodeSide side)
+{
+    AVLTreeNode *child = avltree_nodeChild(node, side);
+    AVLTreeNode *parent;
+
+    if (child != NULL) {
+        node = child;
+
+        while ((child = avltree_nodeChild(node, 1 - side)) != NULL) {
+            node = child;
+        }
+
+        return node;
+    }
+
+    parent = avltree_nodeParent(node);
+
+    while (parent != NULL && avltree_nodeChild(parent, side) == node) {
+        node = parent;
+        parent = avltree_nodeParent(node);
+    }
+
+    return parent;
+}
+
+/* Find the link which points at the entry of a tree node */
+
+static HashTableEntry **hashtable_treeLink(HashTable *hashTable,
+                                           unsigned int index,
+                                           AVLTreeNode *node)
+{
+    AVLTreeNode *previous = hashtable_treeNeighbour(node, AVL_TREE_NODE_LEFT);
+
+    if (previous == NULL) {
+        return &hashTable->table[index];
+    }
+
+    return &((HashTableEntry *) avltree_nodeValue(previous))->next;
+}
+
+/* Stop indexing a chain.  The chain itself is left as it is. */
+
+static void hashtable_freeTree(HashTable *hashTable, unsigned int index)
+{
+    avltree_free(hashTable->trees[index]);
+    hashTable->trees[index] = NULL;
+}
+
+static void hashtable_freeTrees(HashTable *hashTable)
+{
+    unsigned int i;
+
+    if (hashTable->trees == NULL) {
+        return;
+    }
+
+    for (i=0; i<hashTable->tableSize; ++i) {
+        if (hashTable->trees[i] != NULL) {
+            hashtable_freeTree(hashTable, i);
+        }
+    }
+
+    allocator_free(&hashTable->usage, hashTable->trees,
+                   hashTable->tableSize * sizeof(AVLTree *));
+    hashTable->trees = NULL;
+}
+
+/* Index a chain with a tree, and put the chain into the order of the
+ * tree.  If memory runs out, the chain is just left unindexed. */
+
+static void hashtable_treeify(HashTable *hashTable, unsigned int index)
+{
+    HashTableEntry **link;
+    HashTableEntry *rover;
+    AVLTreeNode *node;
+    AVLTree *tree;
+
+    if (hashTable->trees == NULL) {
+        hashTable->trees = allocator_calloc(&hashTable->usage,
+                                            hashTable->tableSize,
+                                            sizeof(AVLTree *));
+
+        if (hashTable->trees == NULL) {
+            return;
+        }
+    }
+
+    tree = avltree_newWithAllocator(hashTable->compareFunc,
+                                    hashTable->usage.allocator);
+
+    if (tree == NULL) {
+        return;
+    }
+
+    for (rover=hashTable->table[index]; rover != NULL; rover=rover->next) {
+        if (avltree_insert(tree, rover->pair.key, rover) == NULL) {
+            avltree_free(tree);
+            return;
+        }
+    }
+
+    link = &hashTable->table[index];
+    node = avltree_rootNode(tree);
+
+    while (avltree_nodeChild(node, AVL_TREE_NODE_LEFT) != NULL) {
+        node = avltree_nodeChild(node, AVL_TREE_NODE_LEFT);
+    }
+
+    while (node != NULL) {
+        rover = (HashTableEntry *) avltree_nodeValue(node);
+        *link = rover;
+        link = &rover->next;
+        node = hashtable_treeNeighbour(node, AVL_TREE_NODE_RIGHT);
+    }
+
+    *link = NULL;
+
+    hashTable->trees[index] = tree;
+}
+
+/* Find the tree indexing the chain of the current table an entry
+ * belongs in, if there is one */
+
+static AVLTree *hashtable_entryTree(HashTable *hashTable,
+                                    HashTableEntry *entry)
+{
+    if (hashTable->trees == NULL) {
+        return NULL;
+    }
+
+    return hashTable->trees[hashtable_bucket(hashTable, entry->hash,
+                                             hashTable->tableSize)];
+}
+
+/* Link an entry into the current table, using its stored hash */
+
+static void hashtable_linkEntry(HashTable *hashTable, HashTableEntry *entry)
+{
+    unsigned int index = hashtable_bucket(hashTable, entry->hash,
+                                          hashTable->tableSize);
+    HashTableEntry **link = &hashTable->table[index];
+    AVLTreeNode *node;
+
+    if (hashTable->trees != NULL && hashTable->trees[index] != NULL) {
+        node = avltree_insert(hashTable->trees[index], entry->pair.key, entry);
+
+        if (node != NULL) {
+            link = hashtable_treeLink(hashTable, index, node);
+        } else {
+            hashtable_freeTree(hashTable, index);
+        }
+    }
+
+    entry->next = *link;
+    *link = entry;
+}
+
+/* Flat (open addressing) engine.
+ *
+ * The table is an array of slots split into groups of
+ * HASH_TABLE_GROUP_WIDTH.  Each slot has a one-byte control tag: a full
+ * slot stores the low 7 bits of the key hash (always >= 0), while empty
+ * and deleted slots have negative tags.  A lookup compares the tags of
+ * a whole group in one go, and only calls the equality function on
+ * slots whose tag matches.  Groups are probed quadratically, and the
+ * search stops at the first group containing an empty slot.
+ *
+ * The full hash of each key is kept in a separate array, which only
+ * resizing reads, so that the keys need not be hashed again. */
+
+#define HASH_TABLE_GROUP_WIDTH 16
+#define HASH_TABLE_FLAT_INITIAL_GROUPS 8
+#define HASH_TABLE_FLAT_MAX_GROUPS (1U << 27)
+#define HASH_TABLE_CTRL_EMPTY ((signed char) -128)
+#define HASH_TABLE_CTRL_DELETED ((signed char) -2)
+
+#ifdef HASH_TABLE_USE_SSE2
+
+/* Bitmask of the slots in a group whose tag equals the given tag */
+
+static unsigned int hashtable_groupMatch(const signed char *group,
+                                         signed char tag)
+{
+    __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+
+    return (unsigned int) _mm_movemask_epi8(
+        _mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag)));
+}
+
+/* Bitmask of the slots in a group which are empty or deleted.  These
+ * are the only tags below -1. */
+
+static unsigned int hashtable_groupMatchFree(const signed char *group)
+{
+    __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+
+    return (unsigned int) _mm_movemask_epi8(
+        _mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl));
+}
+
+#else
+
+static unsigned int hashtable_groupMatch(const signed char *group,
+                                         signed char tag)
+{
+    unsigned int mask = 0;
+    unsigned int i;
+
+    for (i=0; i<HASH_TABLE_GROUP_WIDTH; ++i) {
+        if (group[i] == tag) {
+            mask |= 1U << i;
+        }
+    }
+
+    return mask;
+}
+
+static unsigned int hashtable_groupMatchFree(const signed char *group)
+{
+    unsigned int mask = 0;
+    unsigned int i;
+
+    for (i=0; i<HASH_TABLE_GROUP_WIDTH; ++i) {
+        if (group[i] < -1) {
+            mask |= 1U << i;
+        }
+    }
+
+    return mask;
+}
+
+#endif
+
+/* Index of the lowest set bit in a non-zero mask */
+
+static unsigned int hashtable_lowestBit(unsigned int mask)
+{
+#if defined(__GNUC__)
+    return (unsigned int) __builtin_ctz(mask);
+#else
+    unsigned int i = 0;
+
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        ++i;
+    }
+
+    return i;
+#endif
+}
+
+static void hashtable_flatFreeArrays(HashTable *hashTable,
+                                     signed char *ctrl,
+                                     HashTablePair *slots,
+                                     unsigned int *hashes,
+                                     unsigned int numGroups)
+{
+    unsigned int capacity = numGroups * HASH_TABLE_GROUP_WIDTH;
+
+    allocator_free(&hashTable->usage, ctrl, capacity);
+    allocator_free(&hashTable->usage, slots, capacity * sizeof(HashTablePair));
+    allocator_free(&hashTable->usage, hashes,
+                   capacity * sizeof(unsigned int));
+}
+
+static int hashtable_flatAllocate(HashTable *hashTable, unsigned int numGroups)
+{
+    unsigned int capacity = numGroups * HASH_TABLE_GROUP_WIDTH;
+
+    signed char *ctrl = allocator_malloc(&hashTable->usage, capacity);
+    HashTablePair *slots = allocator_malloc(&hashTable->usage,
+                                            capacity * sizeof(HashTablePair));
+    unsigned int *hashes = allocator_malloc(&hashTable->usage,
+                                            capacity * sizeof(unsigned int));
+
+    if (ctrl == NULL || slots == NULL || hashes == NULL) {
+        allocator_free(&hashTable->usage, ctrl, capacity);
+        allocator_free(&hashTable->usage, slots,
+                       capacity * sizeof(HashTablePair));
+        allocator_free(&hashTable->usage, hashes,
+                       capacity * sizeof(unsigned int));
+
+        return 0;
+    }
+
+    memset(ctrl, HASH_TABLE_CTRL_EMPTY, capacity);
+
+    hashTable->ctrl = ctrl;
+    hashTable->slots = slots;
+    hashTable->hashes = hashes;
+    hashTable->numGroups = numGroups;
+
+    /* Keep the table at most 7/8 full, counting deleted slots, so that
+     * every probe sequence is guaranteed to reach an empty slot. */
+
+    hashTable->growthLeft = capacity - capacity / 8;
+
+    return 1;
+}
+
+/* Find the slot holding a key, or NULL if the key is not present */
+
+static HashTablePair *hashtable_flatFind(HashTable *hashTable,
+                                         HashTableKey key,
+                                         unsigned int hash)
+{
+    signed char tag = (signed char) (hash & 0x7f);
+    unsigned int groupMask = hashTable->numGroups - 1;
+    unsigned int group = (hash >> 7) & groupMask;
+    unsigned int probe = 0;
+    signed char *ctrl;
+    HashTablePair *pair;
+    unsigned int match;
+
+    for (;;) {
+        ctrl = &hashTable->ctrl[group * HASH_TABLE_GROUP_WIDTH];
+
+        match = hashtable_groupMatch(ctrl, tag);
+
+        while (match != 0) {
+            pair = &hashTable->slots[group * HASH_TABLE_GROUP_WIDTH
+                                     + hashtable_lowestBit(match)];
+
+            if (hashTable->equalFunc(key, pair->key) != 0) {
+                HASH_TABLE_COUNT_SEARCH(hashTable, probe + 1);
+                return pair;
+            }
+
+            match &= match - 1;
+        }
+
+        /* An empty slot ends the probe sequence: the key would have
+         * been placed here had it been inserted. */
+
+        if (hashtable_groupMatch(ctrl, HASH_TABLE_CTRL_EMPTY) != 0) {
+            HASH_TABLE_COUNT_SEARCH(hashTable, probe + 1);
+            return NULL;
+        }
+
+        ++probe;
+        group = (group + probe) & groupMask;
+    }
+}
+
+/* Find the first empty or deleted slot along the probe sequence of a
+ * hash */
+
+static unsigned int hashtable_flatFindFree(HashTable *hashTable,
+                                           unsigned int hash)
+{
+    unsigned int groupMask = hashTable->numGroups - 1;
+    unsigned int group = (hash >> 7) & groupMask;
+    unsigned int probe = 0;
+    unsigned int match;
+
+    for (;;) {
+        match = hashtable_groupMatchFree(
+            &hashTable->ctrl[group * HASH_TABLE_GROUP_WIDTH]);
+
+        if (match != 0) {
+            return group * HASH_TABLE_GROUP_WIDTH + hashtable_lowestBit(match);
+        }
+
+        ++probe;
+        group = (group + probe) & groupMask;
+    }
+}
+
+/* Rebuild the table with a number of groups, which must leave room for
+ * all of the live entries.  This also clears out all deleted slots. */
+
+static int hashtable_flatRebuild(HashTable *hashTable,
+                                 unsigned int newNumGroups)
+{
+    signed char *oldCtrl = hashTable->ctrl;
+    HashTablePair *oldSlots = hashTable->slots;
+    unsigned int *oldHashes = hashTable->hashes;
+    unsigned int oldNumGroups = hashTable->numGroups;
+    unsigned int oldCapacity = oldNumGroups * HASH_TABLE_GROUP_WIDTH;
+#ifdef HASH_TABLE_STATS
+    clock_t resizeStart = clock();
+#endif
+
+    if (!hashtable_flatAllocate(hashTable, newNumGroups)) {
+        hashTable->ctrl = oldCtrl;
+        hashTable->slots = oldSlots;
+        hashTable->hashes = oldHashes;
+        hashTable->numGroups = oldNumGroups;
+
+        return 0;
+    }
+
+    /* Move every live entry into the new arrays */
+
+    unsigned int hash;
+    unsigned int slot;
+    unsigned int i;
+
+    for (i=0; i<oldCapacity; ++i) {
+        if (oldCtrl[i] < 0) {
+            continue;
+        }
+
+        hash = oldHashes[i];
+        slot = hashtable_flatFindFree(hashTable, hash);
+
+        hashTable->ctrl[slot] = (signed char) (hash & 0x7f);
+        hashTable->slots[slot] = oldSlots[i];
+        hashTable->hashes[slot] = hash;
+        --hashTable->growthLeft;
+    }
+
+    hashtable_flatFreeArrays(hashTable, oldCtrl, oldSlots, oldHashes,
+                             oldNumGroups);
+
+#ifdef HASH_TABLE_STATS
+    hashtable_countResize(hashTable, resizeStart);
+#endif
+
+    return 1;
+}
+
+/* Rebuild the table, doubling it if it is more than half full with live
+ * entries.  Otherwise it is mostly deleted slots, which a rebuild at the
+ * same size clears out.  A table of the largest size can not double, so
+ * the insert which needed it fails. */
+
+static int hashtable_flatResize(HashTable *hashTable)
+{
+    unsigned int capacity = hashTable->numGroups * HASH_TABLE_GROUP_WIDTH;
+    unsigned int newNumGroups = hashTable->numGroups;
+
+    if ((uint64_t) hashTable->entries * 2 >= capacity - capacity / 8) {
+        if (newNumGroups >= HASH_TABLE_FLAT_MAX_GROUPS) {
+            return 0;
+        }
+
+        newNumGroups *= 2;
+    }
+
+    return hashtable_flatRebuild(hashTable, newNumGroups);
+}
+
+/* Find the smallest number of groups which can hold a number of
+ * entries, or zero if there is none */
+
+static unsigned int hashtable_flatGroupsFor(uint64_t entries)
+{
+    uint64_t numGroups = HASH_TABLE_FLAT_INITIAL_GROUPS;
+    uint64_t capacity = numGroups * HASH_TABLE_GROUP_WIDTH;
+
+    while (capacity - capacity / 8 < entries) {
+        if (numGroups >= HASH_TABLE_FLAT_MAX_GROUPS) {
+            return 0;
+        }
+
+        numGroups *= 2;
+        capacity = numGroups * HASH_TABLE_GROUP_WIDTH;
+    }
+
+    return (unsigned int) numGroups;
+}
+
+/* Add a key which is not in the table yet, returning its slot, or NULL
+ * if the table needed to grow and could not */
+
+static HashTablePair *hashtable_flatAdd(HashTable *hashTable,
+                                        HashTableKey key,
+                                        HashTableValue value,
+                                        unsigned int hash)
+{
+    /* A deleted slot can always be reused.  Taking an empty slot uses
+     * up some of the remaining capacity, so grow first if none is
+     * left. */
+
+    unsigned int slot = hashtable_flatFindFree(hashTable, hash);
+
+    if (hashTable->ctrl[slot] == HASH_TABLE_CTRL_EMPTY
+     && hashTable->growthLeft == 0) {
+
+        if (!hashtable_flatResize(hashTable)) {
+            return NULL;
+        }
+
+        slot = hashtable_flatFindFree(hashTable, hash);
+    }
+
+    if (hashTable->ctrl[slot] == HASH_TABLE_CTRL_EMPTY) {
+        --hashTable->growthLeft;
+    }
+
+    hashTable->ctrl[slot] = (signed char) (hash & 0x7f);
+    hashTable->slots[slot].key = key;
+    hashTable->slots[slot].value = value;
+    hashTable->hashes[slot] = hash;
+
+    ++hashTable->entries;
+
+    return &hashTable->slots[slot];
+}
+
+static int hashtable_flatInsert(HashTable *hashTable,
+                                HashTableKey key,
+                                HashTableValue value)
+{
+    unsigned int hash = intMix(hashtable_hash(hashTable, key));
+
+    /* Overwrite any existing entry with the same key */
+
+    HashTablePair *pair = hashtable_flatFind(hashTable, key, hash);
+
+    if (pair != NULL) {
+        hashtable_freePair(hashTable, pair);
+
+        pair->key = key;
+        pair->value = value;
+
+        return 1;
+    }
+
+    return hashtable_flatAdd(hashTable, key, value, hash) != NULL;
+}
+
+static int hashtable_flatRemove(HashTable *hashTable, HashTableKey key)
+{
+    unsigned int hash = intMix(hashtable_hash(hashTable, key));
+    HashTablePair *pair = hashtable_flatFind(hashTable, key, hash);
+
+    if (pair == NULL) {
+        return 0;
+    }
+
+    unsigned int slot = (unsigned int) (pair - hashTable->slots);
+    unsigned int group = slot / HASH_TABLE_GROUP_WIDTH;
+
+    /* If the group still has an empty slot, no probe sequence ever
+     * continued past it, so this slot can become empty again.
+     * Otherwise it must be marked as deleted to keep later keys in
+     * the sequence reachable. */
+
+    if (hashtable_groupMatch(&hashTable->ctrl[group * HASH_TABLE_GROUP_WIDTH],
+                             HASH_TABLE_CTRL_EMPTY) != 0) {
+        hashTable->ctrl[slot] = HASH_TABLE_CTRL_EMPTY;
+        ++hashTable->growthLeft;
+    } else {
+        hashTable->ctrl[slot] = HASH_TABLE_CTRL_DELETED;
+    }
+
+    hashtable_freePair(hashTable, pair);
+
+    --hashTable->entries;
+
+    return 1;
+}
+
+/* Index of the first full slot at or after the given slot, or the table
+ * capacity if there are none */
+
+static unsigned int hashtable_flatNextFull(HashTable *hashTable,
+                                           unsigned int slot)
+{
+    unsigned int capacity = hashTable->numGroups * HASH_TABLE_GROUP_WIDTH;
+
+    while (slot < capacity && hashTable->ctrl[slot] < 0) {
+        ++slot;
+    }
+
+    return slot;
+}
+
+HashTable *hashtable_new(HashTableHashFunc hashFunc,
+                         HashTableEqualFunc equalFunc)
+{
+    return hashtable_newWithEngine(hashFunc, equalFunc,
+                                   HASH_TABLE_ENGINE_CHAINED);
+}
+
+HashTable *hashtable_newWithEngine(HashTableHashFunc hashFunc,
+                                   HashTableEqualFunc equalFunc,
+                                   HashTableEngine engine)
+{
+    return hashtable_newWithAllocator(hashFunc, equalFunc, engine, NULL);
+}
+
+HashTable *hashtable_newWithAllocator(HashTableHashFunc hashFunc,
+                                      HashTableEqualFunc equalFunc,
+                                      HashTableEngine engine,
+                                      const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
+    allocator_initUsage(&usage, allocator);
+
+	/* Allocate a new hash table structure */
+
+    HashTable *hashTable = (HashTable *) allocator_malloc(&usage,
+                                                          sizeof(HashTable));
+
+    if (hashTable == NULL) {
+		return NULL;
+	}
+
+    hashTable->usage = usage;
+
+    hashTable->engine = engine;
+    hashTable->hashFunc = hashFunc;
+    hashTable->seededHashFunc = NULL;
+    hashTable->seed = 0;
+    hashTable->equalFunc = equalFunc;
+    hashTable->compareFunc = NULL;
+    hashTable->trees = NULL;
+    hashTable->keyFreeFunc = NULL;
+    hashTable->valueFreeFunc = NULL;
+    hashTable->entries = 0;
+    hashTable->sizeIndex = 0;
+    hashTable->reserved = 0;
+    hashTable->powerOfTwo = 0;
+    hashTable->table = NULL;
+    hashTable->tableSize = 0;
+    hashTable->ctrl = NULL;
+    hashTable->slots = NULL;
+    hashTable->hashes = NULL;
+    hashTable->numGroups = 0;
+    hashTable->growthLeft = 0;
+    hashTable->incrementalResize = 0;
+    hashTable->oldTable = NULL;
+    hashTable->oldTableSize = 0;
+    hashTable->rehashIndex = 0;
+    hashTable->slab = NULL;
+#ifdef HASH_TABLE_STATS
+    hashtable_resetStats(hashTable);
+#endif
+
+	/* Allocate the table */
+
+    int allocated;
+
+    if (engine == HASH_TABLE_ENGINE_FLAT) {
+        allocated = hashtable_flatAllocate(hashTable,
+                                           HASH_TABLE_FLAT_INITIAL_GROUPS);
+    } else {
+        allocated = hashtable_allocateTable(hashTable);
+    }
+
+    if (!allocated) {
+        allocator_free(&hashTable->usage, hashTable, sizeof(HashTable));
+
+		return NULL;
+	}
+
+    return hashTable;
+}
+
+/* Free the hash table structure itself, which holds the record of the
+ * allocator used for it */
+
+static void hashtable_freeStructure(HashTable *hashTable)
+{
+    AllocatorUsage usage = hashTable->usage;
+
+    allocator_free(&usage, hashTable, sizeof(HashTable));
+}
+
+void hashtable_free(HashTable *hashTable)
+{
+	HashTableEntry *rover;
+	HashTableEntry *next;
+	unsigned int i;
+
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        for (i=0; i<hashTable->numGroups * HASH_TABLE_GROUP_WIDTH; ++i) {
+            if (hashTable->ctrl[i] >= 0) {
+                hashtable_freePair(hashTable, &hashTable->slots[i]);
+            }
+        }
+
+        hashtable_flatFreeArrays(hashTable, hashTable->ctrl,
+                                 hashTable->slots, hashTable->hashes,
+                                 hashTable->numGroups);
+        hashtable_freeStructure(hashTable);
+
+        return;
+    }
+
+	/* Free all entries in all chains.  During an incremental resize
+	 * some of the entries are still in the old table.  Entries
+	 * allocated from a slab are freed along with it, so the chains
+	 * only need walking if there are free functions to call. */
+
+    if (hashTable->slab == NULL
+     || hashTable->keyFreeFunc != NULL
+     || hashTable->valueFreeFunc != NULL) {
+
+        for (i=0; i<hashTable->oldTableSize; ++i) {
+            rover = hashTable->oldTable[i];
+            while (rover != NULL) {
+                next = rover->next;
+                hashtable_freeEntry(hashTable, rover);
+                rover = next;
+            }
+        }
+
+        for (i=0; i<hashTable->tableSize; ++i) {
+            rover = hashTable->table[i];
+            while (rover != NULL) {
+                next = rover->next;
+                hashtable_freeEntry(hashTable, rover);
+                rover = next;
+            }
+        }
+    }
+
+    if (hashTable->slab != NULL) {
+        slab_free(hashTable->slab);
+    }
+
+	/* Free the tables */
+
+    hashtable_freeTrees(hashTable);
+
+    hashtable_freeTable(hashTable, hashTable->oldTable,
+                        hashTable->oldTableSize);
+    hashtable_freeTable(hashTable, hashTable->table, hashTable->tableSize);
+
+	/* Free the hash table structure */
+
+    hashtable_freeStructure(hashTable);
+}
+
+void hashtable_registerFreeFunctions(HashTable *hashTable,
+                                     HashTableKeyFreeFunc keyFreeFunc,
+                                     HashTableValueFreeFunc valueFreeFunc)
+{
+    hashTable->keyFreeFunc = keyFreeFunc;
+    hashTable->valueFreeFunc = valueFreeFunc;
+}
+
+void hashtable_setIncrementalResize(HashTable *hashTable, int enabled)
+{
+    hashTable->incrementalResize = enabled;
+}
+
+int hashtable_setSeededHash(HashTable *hashTable,
+                            HashTableSeededHashFunc hashFunc)
+{
+    if (hashTable->entries != 0) {
+        return 0;
+    }
+
+	/* The address of the table makes the seeds of tables created at
+	 * the same moment differ */
+
+    hashTable->seededHashFunc = hashFunc;
+    hashTable->seed = hash64_randomSeed()
+                    ^ (uint64_t) (uintptr_t) hashTable;
+
+    return 1;
+}
+
+void hashtable_setChainGuard(HashTable *hashTable,
+                             HashTableCompareFunc compareFunc)
+{
+    hashtable_freeTrees(hashTable);
+
+    hashTable->compareFunc = compareFunc;
+}
+
+int hashtable_useSlab(HashTable *hashTable)
+{
+    /* The flat engine has no entries to allocate */
+
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT
+     || hashTable->slab != NULL) {
+        return 1;
+    }
+
+    if (hashTable->entries != 0) {
+        return 0;
+    }
+
+    hashTable->slab = slab_newWithAllocator(sizeof(HashTableEntry),
+                                            hashTable->usage.allocator);
+
+    return hashTable->slab != NULL;
+}
+
+
+/* Link every entry of a chain into the current table */
+
+static void hashtable_moveChain(HashTable *hashTable, HashTableEntry *rover)
+{
+    HashTableEntry *next;
+
+	while (rover != NULL) {
+		next = rover->next;
+
+		/* Link this entry into the new table, using the stored hash */
+
+        hashtable_linkEntry(hashTable, rover);
+
+		/* Advance to next in the chain */
+
+		rover = next;
+	}
+}
+
+/* Migrate chains from the old table while an incremental resize is in
+ * progress.  At most maxChains non-empty chains are moved, and at most
+ * ten times as many buckets are visited, so that each call does a
+ * bounded amount of work. */
+
+static void hashtable_rehashStep(HashTable *hashTable, unsigned int maxChains)
+{
+    unsigned int maxVisits = maxChains * 10;
+    HashTableEntry *rover;
+
+    while (hashTable->oldTable != NULL && maxChains > 0 && maxVisits > 0) {
+        rover = hashTable->oldTable[hashTable->rehashIndex];
+
+        if (rover != NULL) {
+            hashTable->oldTable[hashTable->rehashIndex] = NULL;
+            hashtable_moveChain(hashTable, rover);
+            --maxChains;
+        }
 
-static const unsigned int HASH_TABLE_NUM_PRIMES
-    = sizeof(HASH_TABLE_PRIMES) / sizeof(int);
+        --maxVisits;
+        ++hashTable->rehashIndex;
 
-/* Internal function used to allocate the table on hash table creation
- * and when enlarging the table */
+		/* All chains migrated: the old table can go */
 
-static int hashtable_allocateTable(HashTable *hashTable)
+        if (hashTable->rehashIndex >= hashTable->oldTableSize) {
+            hashtable_freeTable(hashTable, hashTable->oldTable,
+                                hashTable->oldTableSize);
+            hashTable->oldTable = NULL;
+            hashTable->oldTableSize = 0;
+            hashTable->rehashIndex = 0;
+        }
+    }
+}
+
+/* Move the entries of the table to a table of another size */
+
+static int hashtable_resize(HashTable *hashTable, unsigned int sizeIndex)
 {
-	/* Determine the table size based on the current prime index.
-	 * An attempt is made here to ensure sensible behavior if the
-	 * maximum prime is exceeded, but in practice other things are
-	 * likely to break long before that happens. */
+	/* A previous incremental resize must be completed before another
+	 * one can start */
 
-    unsigned int newTableSize;
+    while (hashTable->oldTable != NULL) {
+        hashtable_rehashStep(hashTable, hashTable->oldTableSize);
+    }
 
-    if (hashTable->primeIndex < HASH_TABLE_NUM_PRIMES) {
-        newTableSize = HASH_TABLE_PRIMES[hashTable->primeIndex];
-	} else {
-        newTableSize = hashTable->entries * 10;
-	}
+    if (sizeIndex == hashTable->sizeIndex) {
+        return 1;
+    }
 
-    hashTable->tableSize = newTableSize;
+	/* Chains are split up by the resize, so their trees go.  Any that
+	 * are still too long are indexed again as they are next inserted
+	 * into. */
 
-	/* Allocate the table and initialise to NULL for all entries */
+    hashtable_freeTrees(hashTable);
 
-    hashTable->table = calloc(hashTable->tableSize,
-                              sizeof(HashTableEntry *));
+	/* Store a copy of the old table */
 
-    return hashTable->table != NULL;
-}
+    HashTableEntry **oldTable = hashTable->table;
+    unsigned int oldTableSize = hashTable->tableSize;
+    unsigned int oldSizeIndex = hashTable->sizeIndex;
+#ifdef HASH_TABLE_STATS
+    clock_t resizeStart = clock();
+#endif
 
-/* Free an entry, calling the free functions if there are any registered */
+	/* Allocate the new table */
 
-static void hashtable_freeEntry(HashTable *hashTable, HashTableEntry *entry)
-{
-    HashTablePair *pair = &(entry->pair);
+    hashTable->sizeIndex = sizeIndex;
 
-	/* If there is a function registered for freeing keys, use it to free
-	 * the key */
+    if (!hashtable_allocateTable(hashTable)) {
 
-    if (hashTable->keyFreeFunc != NULL) {
-        hashTable->keyFreeFunc(pair->key);
-	}
+		/* Failed to allocate the new table */
 
-	/* Likewise with the value */
+        hashTable->table = oldTable;
+        hashTable->tableSize = oldTableSize;
+        hashTable->sizeIndex = oldSizeIndex;
 
-    if (hashTable->valueFreeFunc != NULL) {
-        hashTable->valueFreeFunc(pair->value);
+		return 0;
 	}
 
-	/* Free the data structure */
+	/* In incremental mode, keep the old table around and let
+	 * subsequent operations migrate its chains a few at a time */
+
+    unsigned int i;
+
+    if (hashTable->incrementalResize) {
+        hashTable->oldTable = oldTable;
+        hashTable->oldTableSize = oldTableSize;
+        hashTable->rehashIndex = 0;
+    } else {
+
+		/* Link all entries from all chains into the new table */
+
+        for (i=0; i<oldTableSize; ++i) {
+            hashtable_moveChain(hashTable, oldTable[i]);
+        }
 
-	free(entry);
+		/* Free the old table */
+
+        hashtable_freeTable(hashTable, oldTable, oldTableSize);
+    }
+
+#ifdef HASH_TABLE_STATS
+    hashtable_countResize(hashTable, resizeStart);
+#endif
+
+	return 1;
 }
 
-HashTable *hashtable_new(HashTableHashFunc hashFunc,
-                         HashTableEqualFunc equalFunc)
+static int hashtable_enlarge(HashTable *hashTable)
 {
-	/* Allocate a new hash table structure */
+	/* If the table is already as large as it can be, it stays as it is.
+	 * Chains get longer, but inserts still succeed. */
 
-    HashTable *hashTable = (HashTable *) malloc(sizeof(HashTable));
-
-    if (hashTable == NULL) {
-		return NULL;
-	}
+    if (hashtable_sizeAt(hashTable, hashTable->sizeIndex + 1) == 0) {
+        return 1;
+    }
 
-    hashTable->hashFunc = hashFunc;
-    hashTable->equalFunc = equalFunc;
-    hashTable->keyFreeFunc = NULL;
-    hashTable->valueFreeFunc = NULL;
-    hashTable->entries = 0;
-    hashTable->primeIndex = 0;
+    return hashtable_resize(hashTable, hashTable->sizeIndex + 1);
+}
 
-	/* Allocate the table */
+/* Find the size index of the smallest table which can hold a number of
+ * entries without being enlarged, or of the largest table if none can */
 
-    if (!hashtable_allocateTable(hashTable)) {
-        free(hashTable);
+static unsigned int hashtable_sizeIndexFor(HashTable *hashTable,
+                                           uint64_t entries)
+{
+    unsigned int sizeIndex = 0;
 
-		return NULL;
-	}
+    while (entries * 3 >= hashtable_sizeAt(hashTable, sizeIndex)
+        && hashtable_sizeAt(hashTable, sizeIndex + 1) != 0) {
+        ++sizeIndex;
+    }
 
-    return hashTable;
+    return sizeIndex;
 }
 
-void hashtable_free(HashTable *hashTable)
+int hashtable_reserve(HashTable *hashTable, unsigned int n)
 {
-	HashTableEntry *rover;
-	HashTableEntry *next;
-	unsigned int i;
+    unsigned int numGroups;
+    unsigned int sizeIndex;
 
-	/* Free all entries in all chains */
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        numGroups = hashtable_flatGroupsFor(n);
 
-    for (i=0; i<hashTable->tableSize; ++i) {
-        rover = hashTable->table[i];
-		while (rover != NULL) {
-			next = rover->next;
-            hashtable_freeEntry(hashTable, rover);
-			rover = next;
-		}
-	}
+        if (numGroups == 0) {
+            return 0;
+        }
 
-	/* Free the table */
+        if (numGroups > hashTable->numGroups
+         && !hashtable_flatRebuild(hashTable, numGroups)) {
+            return 0;
+        }
 
-    free(hashTable->table);
+        hashTable->reserved = n;
 
-	/* Free the hash table structure */
+        return 1;
+    }
+
+	/* The new table is filled in one go, even in incremental mode:
+	 * the table is normally still empty at this point. */
+
+    sizeIndex = hashtable_sizeIndexFor(hashTable, n);
+
+    if (sizeIndex > hashTable->sizeIndex) {
+        if (!hashtable_resize(hashTable, sizeIndex)) {
+            return 0;
+        }
+
+        while (hashTable->oldTable != NULL) {
+            hashtable_rehashStep(hashTable, hashTable->oldTableSize);
+        }
+    }
 
-    free(hashTable);
+    hashTable->reserved = n;
+
+    return 1;
 }
 
-void hashtable_registerFreeFunctions(HashTable *hashTable,
-                                     HashTableKeyFreeFunc keyFreeFunc,
-                                     HashTableValueFreeFunc valueFreeFunc)
+int hashtable_compact(HashTable *hashTable)
 {
-    hashTable->keyFreeFunc = keyFreeFunc;
-    hashTable->valueFreeFunc = valueFreeFunc;
+    unsigned int numGroups;
+    unsigned int sizeIndex;
+
+    hashTable->reserved = 0;
+
+	/* For the flat engine, the rebuild also clears out deleted
+	 * slots, so it is done even if the size stays the same */
+
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        numGroups = hashtable_flatGroupsFor(hashTable->entries);
+
+        return hashtable_flatRebuild(hashTable, numGroups);
+    }
+
+    sizeIndex = hashtable_sizeIndexFor(hashTable, hashTable->entries);
+
+    if (sizeIndex < hashTable->sizeIndex
+     && !hashtable_resize(hashTable, sizeIndex)) {
+        return 0;
+    }
+
+    while (hashTable->oldTable != NULL) {
+        hashtable_rehashStep(hashTable, hashTable->oldTableSize);
+    }
+
+    return 1;
 }
 
+/* Halve a table which removes have left mostly empty, unless it was
+ * reserved at this size.  This is called by inserts rather than by
+ * hashtable_remove, so that entries can be removed while iterating
+ * over the table.  If memory runs out the table just stays as it is. */
 
-static int hashtable_enlarge(HashTable *hashTable)
+static void hashtable_shrink(HashTable *hashTable)
 {
-	/* Store a copy of the old table */
+    unsigned int capacity;
+    unsigned int numGroups;
+
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        capacity = hashTable->numGroups * HASH_TABLE_GROUP_WIDTH;
+        numGroups = hashTable->numGroups / 2;
+
+        if (numGroups >= HASH_TABLE_FLAT_INITIAL_GROUPS
+         && hashTable->entries < capacity / HASH_TABLE_SHRINK_LOAD
+         && hashtable_flatGroupsFor(hashTable->reserved) <= numGroups) {
+            hashtable_flatRebuild(hashTable, numGroups);
+        }
+
+        return;
+    }
+
+    if (hashTable->sizeIndex > 0
+     && hashTable->entries < hashTable->tableSize / HASH_TABLE_SHRINK_LOAD
+     && hashtable_sizeIndexFor(hashTable, hashTable->reserved)
+        < hashTable->sizeIndex) {
+        hashtable_resize(hashTable, hashTable->sizeIndex - 1);
+    }
+}
 
+int hashtable_setPowerOfTwoSize(HashTable *hashTable, int enabled)
+{
     HashTableEntry **oldTable = hashTable->table;
     unsigned int oldTableSize = hashTable->tableSize;
-    unsigned int oldPrimeIndex = hashTable->primeIndex;
+    unsigned int oldSizeIndex = hashTable->sizeIndex;
+    int oldPowerOfTwo = hashTable->powerOfTwo;
 
-	/* Allocate a new, larger table */
+	/* The flat engine always uses power of two tables */
 
-    ++hashTable->primeIndex;
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        return 1;
+    }
 
-    if (!hashtable_allocateTable(hashTable)) {
+    if (hashTable->entries != 0) {
+        return 0;
+    }
 
-		/* Failed to allocate the new table */
+    enabled = enabled != 0;
+
+    if (enabled == hashTable->powerOfTwo) {
+        return 1;
+    }
+
+	/* The table is empty, so it is simply replaced by the first table
+	 * of the new mode.  An old table left by an incremental resize is
+	 * empty too, and goes first. */
+
+    while (hashTable->oldTable != NULL) {
+        hashtable_rehashStep(hashTable, hashTable->oldTableSize);
+    }
+
+    hashtable_freeTrees(hashTable);
 
+    hashTable->powerOfTwo = enabled;
+    hashTable->sizeIndex = hashtable_sizeIndexFor(hashTable,
+                                                  hashTable->reserved);
+
+    if (!hashtable_allocateTable(hashTable)) {
         hashTable->table = oldTable;
         hashTable->tableSize = oldTableSize;
-        hashTable->primeIndex = oldPrimeIndex;
+        hashTable->sizeIndex = oldSizeIndex;
+        hashTable->powerOfTwo = oldPowerOfTwo;
 
-		return 0;
-	}
+        return 0;
+    }
 
-	/* Link all entries from all chains into the new table */
+    hashtable_freeTable(hashTable, oldTable, oldTableSize);
 
-    HashTableEntry *rover;
-    HashTablePair *pair;
-    HashTableEntry *next;
-    unsigned int index;
-    unsigned int i;
+    return 1;
+}
 
-    for (i=0; i<oldTableSize; ++i) {
-        rover = oldTable[i];
+/* Find the link (the table slot or the "next" pointer of the previous
+ * entry) which points at the entry for a key, or NULL if the key is
+ * not present.  While an incremental resize is in progress the key
+ * may still be in the old table, so both tables are searched. */
 
-		while (rover != NULL) {
-			next = rover->next;
+static HashTableEntry **hashtable_findLink(HashTable *hashTable,
+                                           HashTableKey key,
+                                           unsigned int hash,
+                                           unsigned int *chainLength)
+{
+    unsigned int index = hashtable_bucket(hashTable, hash,
+                                          hashTable->tableSize);
+    HashTableEntry **rover = &hashTable->table[index];
+    AVLTreeNode *node;
+    unsigned int length = 0;
+    unsigned int probes = 0;
+
+	/* Chains indexed by a tree are searched through it, which counts
+	 * as a single probe */
+
+    if (hashTable->trees != NULL && hashTable->trees[index] != NULL) {
+        node = avltree_lookupNode(hashTable->trees[index], key);
+        probes = 1;
+
+        if (node != NULL) {
+            HASH_TABLE_COUNT_SEARCH(hashTable, probes);
+            return hashtable_treeLink(hashTable, index, node);
+        }
+    } else {
+        while (*rover != NULL) {
+            ++probes;
+
+            if ((*rover)->hash == hash
+             && hashTable->equalFunc(key, (*rover)->pair.key) != 0) {
+                HASH_TABLE_COUNT_SEARCH(hashTable, probes);
+                return rover;
+            }
+
+            rover = &((*rover)->next);
+            ++length;
+        }
+    }
+
+    if (chainLength != NULL) {
+        *chainLength = length;
+    }
+
+    if (hashTable->oldTable == NULL) {
+        HASH_TABLE_COUNT_SEARCH(hashTable, probes);
+        return NULL;
+    }
+
+    rover = &hashTable->oldTable[hashtable_bucket(hashTable, hash,
+                                                  hashTable->oldTableSize)];
 
-			/* Fetch rover HashTablePair */
+	while (*rover != NULL) {
+        ++probes;
 
-			pair = &(rover->pair);
+        if ((*rover)->hash == hash
+         && hashTable->equalFunc(key, (*rover)->pair.key) != 0) {
+            HASH_TABLE_COUNT_SEARCH(hashTable, probes);
+            return rover;
+		}
 
-			/* Find the index into the new table */
+		rover = &((*rover)->next);
+	}
 
-            index = hashTable->hashFunc(pair->key) % hashTable->tableSize;
+    HASH_TABLE_COUNT_SEARCH(hashTable, probes);
 
-			/* Link this entry into the chain */
+    return NULL;
+}
 
-            rover->next = hashTable->table[index];
-            hashTable->table[index] = rover;
+/* Add a key which is not in the table yet, after a search of the
+ * table found it has chainLength entries in its chain.  Returns the new
+ * entry, or NULL if it could not be allocated. */
 
-			/* Advance to next in the chain */
+static HashTableEntry *hashtable_addEntry(HashTable *hashTable,
+                                          HashTableKey key,
+                                          HashTableValue value,
+                                          unsigned int hash,
+                                          unsigned int chainLength)
+{
+    HashTableEntry *newEntry = hashtable_allocateEntry(hashTable);
 
-			rover = next;
-		}
+    if (newEntry == NULL) {
+		return NULL;
 	}
 
-	/* Free the old table */
+    newEntry->pair.key = key;
+    newEntry->pair.value = value;
+    newEntry->hash = hash;
 
-    free(oldTable);
+	/* Link into the list.  New entries always go into the current
+	 * table. */
 
-	return 1;
+    hashtable_linkEntry(hashTable, newEntry);
+
+	/* With the long chain guard, index the chain if it has grown too
+	 * long */
+
+    if (hashTable->compareFunc != NULL
+     && chainLength >= HASH_TABLE_TREEIFY_THRESHOLD) {
+        hashtable_treeify(hashTable,
+                          hashtable_bucket(hashTable, hash,
+                                           hashTable->tableSize));
+    }
+
+	/* Maintain the count of the number of entries */
+
+    ++hashTable->entries;
+
+    return newEntry;
 }
 
 int hashtable_insert(HashTable *hashTable,
                      HashTableKey key,
                      HashTableValue value)
 {
+    hashtable_shrink(hashTable);
+
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        return hashtable_flatInsert(hashTable, key, value);
+    }
+
+    hashtable_rehashStep(hashTable, HASH_TABLE_REHASH_CHAINS);
+
 	/* If there are too many items in the table with respect to the table
 	 * size, the number of hash collisions increases and performance
 	 * decreases. Enlarge the table size to prevent this happening */
 
-    if ((hashTable->entries * 3) / hashTable->tableSize > 0) {
+    if ((uint64_t) hashTable->entries * 3 >= hashTable->tableSize) {
 
 		/* Table is more than 1/3 full */
 
@@ -236,155 +1535,334 @@ int hashtable_insert(HashTable *hashTable,
 		}
 	}
 
-	/* Generate the hash of the key and hence the index into the table */
-
-    unsigned int index = hashTable->hashFunc(key) % hashTable->tableSize;
+	/* Generate the hash of the key and look for an existing entry
+	 * with the same key */
 
-	/* Traverse the chain at this location and look for an existing
-	 * entry with the same key */
-
-    HashTableEntry *rover = hashTable->table[index];
-    HashTablePair *pair;
+    unsigned int hash = hashtable_hash(hashTable, key);
+    unsigned int chainLength = 0;
+    HashTableEntry **link = hashtable_findLink(hashTable, key, hash,
+                                               &chainLength);
 
-	while (rover != NULL) {
+    if (link != NULL) {
 
-		/* Fetch rover's HashTablePair entry */
+		/* Same key: overwrite this entry with new data */
 
-		pair = &(rover->pair);
+        HashTablePair *pair = &((*link)->pair);
 
-        if (hashTable->equalFunc(pair->key, key) != 0) {
+		/* A tree indexing the chain holds the old key, which is about
+		 * to be freed, so the entry is taken out and put back with the
+		 * new one */
 
-			/* Same key: overwrite this entry with new data */
+        AVLTree *tree = hashtable_entryTree(hashTable, *link);
+        int indexed = tree != NULL && avltree_remove(tree, pair->key);
 
-			/* If there is a value free function, free the old data
-			 * before adding in the new data */
+		/* If there is a value free function, free the old data
+		 * before adding in the new data */
 
-            if (hashTable->valueFreeFunc != NULL) {
-                hashTable->valueFreeFunc(pair->value);
-			}
+        if (hashTable->valueFreeFunc != NULL) {
+            hashTable->valueFreeFunc(pair->value);
+		}
 
-			/* Same with the key: use the new key value and free
-			 * the old one */
+		/* Same with the key: use the new key value and free
+		 * the old one */
 
-            if (hashTable->keyFreeFunc != NULL) {
-                hashTable->keyFreeFunc(pair->key);
-			}
+        if (hashTable->keyFreeFunc != NULL) {
+            hashTable->keyFreeFunc(pair->key);
+		}
 
-			pair->key = key;
-			pair->value = value;
+		pair->key = key;
+		pair->value = value;
 
-			/* Finished */
+        if (indexed && avltree_insert(tree, key, *link) == NULL) {
+            hashtable_freeTree(hashTable,
+                               hashtable_bucket(hashTable, hash,
+                                                hashTable->tableSize));
+        }
 
-			return 1;
-		}
+		/* Finished */
 
-		rover = rover->next;
+		return 1;
 	}
 
 	/* Not in the hash table yet.  Create a new entry */
 
-    HashTableEntry *newEntry = (HashTableEntry *) malloc(sizeof(HashTableEntry));
+    return hashtable_addEntry(hashTable, key, value, hash,
+                              chainLength) != NULL;
+}
 
-    if (newEntry == NULL) {
-		return 0;
-	}
+HashTableValue hashtable_lookup(HashTable *hashTable, HashTableKey key)
+{
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        HashTablePair *pair = hashtable_flatFind(
+            hashTable, key, intMix(hashtable_hash(hashTable, key)));
 
-    newEntry->pair.key = key;
-    newEntry->pair.value = value;
+        return pair != NULL ? pair->value : HASH_TABLE_NULL;
+    }
 
-	/* Link into the list */
+    hashtable_rehashStep(hashTable, HASH_TABLE_REHASH_CHAINS);
 
-    newEntry->next = hashTable->table[index];
-    hashTable->table[index] = newEntry;
+	/* Walk the chain for this key until the corresponding entry is
+	 * found */
 
-	/* Maintain the count of the number of entries */
+    HashTableEntry **link = hashtable_findLink(hashTable, key,
+                                               hashtable_hash(hashTable, key),
+                                               NULL);
 
-    ++hashTable->entries;
+    if (link != NULL) {
 
-	/* Added successfully */
+		/* Found the entry.  Return the data. */
 
-	return 1;
+        return (*link)->pair.value;
+	}
+
+	/* Not found */
+
+	return HASH_TABLE_NULL;
 }
 
-HashTableValue hashtable_lookup(HashTable *hashTable, HashTableKey key)
+HashTableValue *hashtable_lookupOrInsert(HashTable *hashTable,
+                                         HashTableKey key,
+                                         HashTableValue defaultValue,
+                                         int *inserted)
 {
-	/* Generate the hash of the key and hence the index into the table */
+    unsigned int hash;
+    HashTablePair *pair;
+    HashTableEntry **link;
+    HashTableEntry *entry;
+    unsigned int chainLength = 0;
 
-    unsigned int index = hashTable->hashFunc(key) % hashTable->tableSize;
+    if (inserted != NULL) {
+        *inserted = 0;
+    }
 
-	/* Walk the chain at this index until the corresponding entry is
-	 * found */
+    hashtable_shrink(hashTable);
 
-    HashTableEntry *rover = hashTable->table[index];
-    HashTablePair *pair;
+	/* Search for the key once, and add it where the search ended if it
+	 * is not there */
 
-	while (rover != NULL) {
-		pair = &(rover->pair);
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        hash = intMix(hashtable_hash(hashTable, key));
+        pair = hashtable_flatFind(hashTable, key, hash);
 
-        if (hashTable->equalFunc(key, pair->key) != 0) {
+        if (pair == NULL) {
+            pair = hashtable_flatAdd(hashTable, key, defaultValue, hash);
 
-			/* Found the entry.  Return the data. */
+            if (pair == NULL) {
+                return NULL;
+            }
 
-			return pair->value;
-		}
+            if (inserted != NULL) {
+                *inserted = 1;
+            }
+        }
 
-		rover = rover->next;
-	}
+        return &pair->value;
+    }
 
-	/* Not found */
+    hashtable_rehashStep(hashTable, HASH_TABLE_REHASH_CHAINS);
 
-	return HASH_TABLE_NULL;
+	/* As in hashtable_insert, the table is enlarged before the search,
+	 * as a resize would move the link the search finds */
+
+    if ((uint64_t) hashTable->entries * 3 >= hashTable->tableSize
+     && !hashtable_enlarge(hashTable)) {
+        return NULL;
+    }
+
+    hash = hashtable_hash(hashTable, key);
+    link = hashtable_findLink(hashTable, key, hash, &chainLength);
+
+    if (link != NULL) {
+        return &((*link)->pair.value);
+    }
+
+    entry = hashtable_addEntry(hashTable, key, defaultValue, hash,
+                               chainLength);
+
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    if (inserted != NULL) {
+        *inserted = 1;
+    }
+
+    return &entry->pair.value;
+}
+
+int hashtable_update(HashTable *hashTable,
+                     HashTableKey key,
+                     HashTableUpdateFunc updateFunc,
+                     void *context)
+{
+    HashTableValue *slot;
+    HashTableValue value;
+    int inserted;
+
+    slot = hashtable_lookupOrInsert(hashTable, key, HASH_TABLE_NULL,
+                                    &inserted);
+
+    if (slot == NULL) {
+        return 0;
+    }
+
+    value = updateFunc(*slot, context);
+
+	/* The old value is freed if it has been replaced */
+
+    if (!inserted && value != *slot && hashTable->valueFreeFunc != NULL) {
+        hashTable->valueFreeFunc(*slot);
+    }
+
+    *slot = value;
+
+    return 1;
 }
 
 int hashtable_remove(HashTable *hashTable, HashTableKey key)
 {
-	/* Generate the hash of the key and hence the index into the table */
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        return hashtable_flatRemove(hashTable, key);
+    }
 
-    unsigned int index = hashTable->hashFunc(key) % hashTable->tableSize;
+    hashtable_rehashStep(hashTable, HASH_TABLE_REHASH_CHAINS);
 
-	/* Rover points at the pointer which points at the current entry
-	 * in the chain being inspected.  ie. the entry in the table, or
-	 * the "next" pointer of the previous entry in the chain.  This
-	 * allows us to unlink the entry when we find it. */
+	/* The link points at the pointer which points at the entry to
+	 * remove.  ie. the entry in the table, or the "next" pointer of
+	 * the previous entry in the chain.  This allows us to unlink the
+	 * entry. */
 
-    int result = 0;
-    HashTableEntry **rover = &hashTable->table[index];
-    HashTableEntry *entry;
-    HashTablePair *pair;
+    HashTableEntry **link = hashtable_findLink(hashTable, key,
+                                               hashtable_hash(hashTable, key),
+                                               NULL);
 
-	while (*rover != NULL) {
+    if (link == NULL) {
+        return 0;
+    }
 
-		pair = &((*rover)->pair);
+    HashTableEntry *entry = *link;
 
-        if (hashTable->equalFunc(key, pair->key) != 0) {
+	/* Unlink from the list, and from the tree indexing it if there is
+	 * one.  A tree which has become small is no longer needed. */
 
-			/* This is the entry to remove */
+    *link = entry->next;
 
-			entry = *rover;
+    AVLTree *tree = hashtable_entryTree(hashTable, entry);
 
-			/* Unlink from the list */
+    if (tree != NULL && avltree_remove(tree, entry->pair.key)
+     && avltree_numEntries(tree) < HASH_TABLE_UNTREEIFY_THRESHOLD) {
+        hashtable_freeTree(hashTable,
+                           hashtable_bucket(hashTable, entry->hash,
+                                            hashTable->tableSize));
+    }
 
-			*rover = entry->next;
+	/* Destroy the entry structure */
 
-			/* Destroy the entry structure */
+    hashtable_freeEntry(hashTable, entry);
 
-            hashtable_freeEntry(hashTable, entry);
+	/* Track count of entries */
 
-			/* Track count of entries */
+    --hashTable->entries;
 
-            --hashTable->entries;
+	return 1;
+}
 
-			result = 1;
+/* Batched lookup for the flat engine: hash a group of keys and prefetch
+ * the control bytes and first slots of their home groups, then resolve
+ * them one by one. */
 
-			break;
-		}
+static void hashtable_flatLookupBatch(HashTable *hashTable,
+                                      HashTableKey *keys,
+                                      unsigned int n,
+                                      HashTableValue *outValues)
+{
+    unsigned int hashes[HASH_TABLE_BATCH_SIZE];
+    unsigned int groupMask = hashTable->numGroups - 1;
+    unsigned int group;
+    unsigned int start;
+    unsigned int count;
+    unsigned int i;
+    HashTablePair *pair;
 
-		/* Advance to the next entry */
+    for (start=0; start<n; start+=count) {
+        count = n - start;
 
-		rover = &((*rover)->next);
-	}
+        if (count > HASH_TABLE_BATCH_SIZE) {
+            count = HASH_TABLE_BATCH_SIZE;
+        }
+
+        for (i=0; i<count; ++i) {
+            hashes[i] = intMix(hashtable_hash(hashTable, keys[start + i]));
+            group = (hashes[i] >> 7) & groupMask;
+
+            HASH_TABLE_PREFETCH(&hashTable->ctrl[group * HASH_TABLE_GROUP_WIDTH]);
+            HASH_TABLE_PREFETCH(&hashTable->slots[group * HASH_TABLE_GROUP_WIDTH]);
+        }
+
+        for (i=0; i<count; ++i) {
+            pair = hashtable_flatFind(hashTable, keys[start + i], hashes[i]);
+            outValues[start + i] = pair != NULL ? pair->value : HASH_TABLE_NULL;
+        }
+    }
+}
 
-	return result;
+void hashtable_lookupBatch(HashTable *hashTable,
+                           HashTableKey *keys,
+                           unsigned int n,
+                           HashTableValue *outValues)
+{
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        hashtable_flatLookupBatch(hashTable, keys, n, outValues);
+        return;
+    }
+
+    hashtable_rehashStep(hashTable, HASH_TABLE_REHASH_CHAINS);
+
+	/* The keys are processed in groups.  Each group goes through three
+	 * stages, so that the memory accesses of one stage are issued for
+	 * every key before any of them is waited on:
+	 *
+	 *   1. hash every key and prefetch its bucket;
+	 *   2. read the bucket and prefetch the first entry of the chain;
+	 *   3. walk the chains. */
+
+    unsigned int hashes[HASH_TABLE_BATCH_SIZE];
+    HashTableEntry **link;
+    HashTableEntry *head;
+    unsigned int start;
+    unsigned int count;
+    unsigned int i;
+
+    for (start=0; start<n; start+=count) {
+        count = n - start;
+
+        if (count > HASH_TABLE_BATCH_SIZE) {
+            count = HASH_TABLE_BATCH_SIZE;
+        }
+
+        for (i=0; i<count; ++i) {
+            hashes[i] = hashtable_hash(hashTable, keys[start + i]);
+
+            HASH_TABLE_PREFETCH(&hashTable->table[
+                hashtable_bucket(hashTable, hashes[i], hashTable->tableSize)]);
+        }
+
+        for (i=0; i<count; ++i) {
+            head = hashTable->table[
+                hashtable_bucket(hashTable, hashes[i], hashTable->tableSize)];
+
+            if (head != NULL) {
+                HASH_TABLE_PREFETCH(head);
+            }
+        }
+
+        for (i=0; i<count; ++i) {
+            link = hashtable_findLink(hashTable, keys[start + i], hashes[i],
+                                      NULL);
+            outValues[start + i] = link != NULL ? (*link)->pair.value
+                                                : HASH_TABLE_NULL;
+        }
+    }
 }
 
 unsigned int hashtable_numEntries(HashTable *hashTable)
@@ -392,6 +1870,45 @@ unsigned int hashtable_numEntries(HashTable *hashTable)
     return hashTable->entries;
 }
 
+size_t hashtable_memoryUsage(HashTable *hashTable)
+{
+    size_t result = hashTable->usage.bytesUsed;
+
+    unsigned int i;
+
+    if (hashTable->slab != NULL) {
+        result += slab_memoryUsage(hashTable->slab);
+    }
+
+    if (hashTable->trees != NULL) {
+        for (i=0; i<hashTable->tableSize; ++i) {
+            if (hashTable->trees[i] != NULL) {
+                result += avltree_memoryUsage(hashTable->trees[i]);
+            }
+        }
+    }
+
+    return result;
+}
+
+/* During an incremental resize, iterators see the chains of the old
+ * table followed by those of the current table */
+
+static unsigned int hashtable_numChains(HashTable *hashTable)
+{
+    return hashTable->oldTableSize + hashTable->tableSize;
+}
+
+static HashTableEntry *hashtable_chainAt(HashTable *hashTable,
+                                         unsigned int chain)
+{
+    if (chain < hashTable->oldTableSize) {
+        return hashTable->oldTable[chain];
+    } else {
+        return hashTable->table[chain - hashTable->oldTableSize];
+    }
+}
+
 void hashtable_iterate(HashTable *hashTable, HashTableIterator *iterator)
 {
     iterator->hashTable = hashTable;
@@ -400,13 +1917,22 @@ void hashtable_iterate(HashTable *hashTable, HashTableIterator *iterator)
 
     iterator->nextEntry = NULL;
 
+	/* The flat engine has no entry structures; nextChain is used as
+	 * the index of the next full slot instead. */
+
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        iterator->nextChain = hashtable_flatNextFull(hashTable, 0);
+
+        return;
+    }
+
 	/* Find the first entry */
 
     unsigned int chain;
-    for (chain=0; chain<hashTable->tableSize; ++chain) {
+    for (chain=0; chain<hashtable_numChains(hashTable); ++chain) {
 
-        if (hashTable->table[chain] != NULL) {
-            iterator->nextEntry = hashTable->table[chain];
+        if (hashtable_chainAt(hashTable, chain) != NULL) {
+            iterator->nextEntry = hashtable_chainAt(hashTable, chain);
             iterator->nextChain = chain;
 			break;
 		}
@@ -415,6 +1941,13 @@ void hashtable_iterate(HashTable *hashTable, HashTableIterator *iterator)
 
 int hashtable_iteratorHasMore(HashTableIterator *iterator)
 {
+    HashTable *hashTable = iterator->hashTable;
+
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        return iterator->nextChain
+             < hashTable->numGroups * HASH_TABLE_GROUP_WIDTH;
+    }
+
     return iterator->nextEntry != NULL;
 }
 
@@ -423,6 +1956,18 @@ HashTablePair hashtable_iteratorNext(HashTableIterator *iterator)
     HashTable *hashTable = iterator->hashTable;
     HashTablePair pair = {NULL, NULL};
 
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        if (!hashtable_iteratorHasMore(iterator)) {
+            return pair;
+        }
+
+        pair = hashTable->slots[iterator->nextChain];
+        iterator->nextChain = hashtable_flatNextFull(hashTable,
+                                                     iterator->nextChain + 1);
+
+        return pair;
+    }
+
     if (iterator->nextEntry == NULL) {
 		return pair;
 	}
@@ -450,12 +1995,12 @@ HashTablePair hashtable_iteratorNext(HashTableIterator *iterator)
 
         iterator->nextEntry = NULL;
 
-        while (chain < hashTable->tableSize) {
+        while (chain < hashtable_numChains(hashTable)) {
 
 			/* Is there anything in this chain? */
 
-            if (hashTable->table[chain] != NULL) {
-                iterator->nextEntry = hashTable->table[chain];
+            if (hashtable_chainAt(hashTable, chain) != NULL) {
+                iterator->nextEntry = hashtable_chainAt(hashTable, chain);
 				break;
 			}
 
@@ -470,3 +2015,103 @@ HashTablePair hashtable_iteratorNext(HashTableIterator *iterator)
 	return pair;
 }
 
+
+/* Add a chain (or for the flat engine, an entry) to the histogram */
+
+static void hashtable_statsCount(HashTableStats *stats, unsigned int length)
+{
+    if (length > stats->maxChainLength) {
+        stats->maxChainLength = length;
+    }
+
+    if (length >= HASH_TABLE_STATS_HISTOGRAM_SIZE) {
+        length = HASH_TABLE_STATS_HISTOGRAM_SIZE - 1;
+    }
+
+    ++stats->chainLengths[length];
+}
+
+void hashtable_stats(HashTable *hashTable, HashTableStats *stats)
+{
+    HashTableEntry *rover;
+    unsigned int groupMask;
+    unsigned int capacity;
+    unsigned int length;
+    unsigned int group;
+    unsigned int probe;
+    unsigned int i;
+
+    memset(stats, 0, sizeof(HashTableStats));
+
+    stats->entries = hashTable->entries;
+    stats->bytesUsed = hashtable_memoryUsage(hashTable);
+
+	/* For the flat engine, count the groups probed to reach each
+	 * entry from the home group of its key */
+
+    if (hashTable->engine == HASH_TABLE_ENGINE_FLAT) {
+        capacity = hashTable->numGroups * HASH_TABLE_GROUP_WIDTH;
+        groupMask = hashTable->numGroups - 1;
+        stats->buckets = capacity;
+
+        for (i=0; i<capacity; ++i) {
+            if (hashTable->ctrl[i] < 0) {
+                continue;
+            }
+
+            group = (hashTable->hashes[i] >> 7) & groupMask;
+            length = 1;
+
+            for (probe=1; group != i / HASH_TABLE_GROUP_WIDTH
+                          && probe <= groupMask; ++probe) {
+                group = (group + probe) & groupMask;
+                ++length;
+            }
+
+            hashtable_statsCount(stats, length);
+        }
+    } else {
+        stats->buckets = hashtable_numChains(hashTable);
+
+        for (i=0; i<hashtable_numChains(hashTable); ++i) {
+            length = 0;
+
+            for (rover=hashtable_chainAt(hashTable, i); rover != NULL;
+                 rover=rover->next) {
+                ++length;
+            }
+
+            hashtable_statsCount(stats, length);
+        }
+    }
+
+    if (stats->buckets > 0) {
+        stats->loadFactor = (double) stats->entries / stats->buckets;
+    }
+
+#ifdef HASH_TABLE_STATS
+    stats->countsEnabled = 1;
+    stats->lookups = hashTable->searches;
+    stats->maxLookupProbes = hashTable->maxSearchProbes;
+    stats->resizes = hashTable->resizes;
+    stats->resizeSeconds = (double) hashTable->resizeTime / CLOCKS_PER_SEC;
+
+    if (hashTable->searches > 0) {
+        stats->averageLookupProbes = (double) hashTable->searchProbes
+                                   / hashTable->searches;
+    }
+#endif
+}
+
+void hashtable_resetStats(HashTable *hashTable)
+{
+#ifdef HASH_TABLE_STATS
+    hashTable->searches = 0;
+    hashTable->searchProbes = 0;
+    hashTable->maxSearchProbes = 0;
+    hashTable->resizes = 0;
+    hashTable->resizeTime = 0;
+#else
+    (void) hashTable;
+#endif
+}
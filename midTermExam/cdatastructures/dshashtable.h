@@ -10,12 +10,22 @@
  * To create a hash table, use @ref hashtable_new.  To destroy a
  * hash table, use @ref hashtable_free.
  *
+ * Two storage engines are available.  The default engine chains
+ * entries in linked lists hanging off each bucket.  The flat engine,
+ * selected with @ref hashtable_newWithEngine, stores entries directly
+ * in an open-addressed array and needs no allocation per entry.
+ *
  * To insert a value into a hash table, use @ref hashtable_insert.
  *
  * To remove a value from a hash table, use @ref hashtable_remove.
  *
  * To look up a value by its key, use @ref hashtable_lookup.
  *
+ * Tables whose keys come from untrusted sources should be protected
+ * against keys chosen to collide, with a seeded hash function
+ * (@ref hashtable_setSeededHash) and the long chain guard
+ * (@ref hashtable_setChainGuard).
+ *
  * To iterate over all values in a hash table, use
  * @ref hashtable_iterate to initialise a @ref HashTableIterator
  * structure.  Each value can then be read in turn using
@@ -25,6 +35,10 @@
 #ifndef DSHASHTABLE_H
 #define DSHASHTABLE_H
 
+#include <stdint.h>
+
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -79,6 +93,23 @@ struct _HashTableIterator {
     unsigned int nextChain;
 };
 
+/**
+ * Storage engine used by a @ref HashTable.
+ */
+
+typedef enum {
+	/** Separate chaining: one linked list entry per key. */
+
+	HASH_TABLE_ENGINE_CHAINED,
+
+	/** Open addressing: keys are stored in flat groups of slots, each
+	 *  with a one-byte control tag, probed a group at a time.  The
+	 *  hash of each key is kept alongside it, so that growing the
+	 *  table does not call the hash function again. */
+
+	HASH_TABLE_ENGINE_FLAT
+} HashTableEngine;
+
 /**
  * A null @ref HashTableValue.
  */
@@ -95,6 +126,19 @@ struct _HashTableIterator {
 
 typedef unsigned int (*HashTableHashFunc)(HashTableKey value);
 
+/**
+ * Hash function taking a seed, used to generate hash values for keys
+ * used in a hash table.  Different seeds should give unrelated hash
+ * values.
+ *
+ * @param value  The value to generate a hash value for.
+ * @param seed   The seed.
+ * @return       The hash value.
+ */
+
+typedef unsigned int (*HashTableSeededHashFunc)(HashTableKey value,
+                                                uint64_t seed);
+
 /**
  * Function used to compare two keys for equality.
  *
@@ -104,6 +148,16 @@ typedef unsigned int (*HashTableHashFunc)(HashTableKey value);
 
 typedef int (*HashTableEqualFunc)(HashTableKey value1, HashTableKey value2);
 
+/**
+ * Function used to order keys, for the long chain guard.
+ *
+ * @return   A negative number if value1 should be sorted before value2,
+ *           a positive number if value2 should be sorted before value1,
+ *           zero if the two keys are equal.
+ */
+
+typedef int (*HashTableCompareFunc)(HashTableKey value1, HashTableKey value2);
+
 /**
  * Type of function used to free keys when entries are removed from a
  * hash table.
@@ -118,6 +172,19 @@ typedef void (*HashTableKeyFreeFunc)(HashTableKey value);
 
 typedef void (*HashTableValueFreeFunc)(HashTableValue value);
 
+/**
+ * Function used by @ref hashtable_update to compute the new value for
+ * a key.
+ *
+ * @param value    The current value for the key, or
+ *                 @ref HASH_TABLE_NULL if the key was not in the table.
+ * @param context  The context pointer passed to @ref hashtable_update.
+ * @return         The new value for the key.
+ */
+
+typedef HashTableValue (*HashTableUpdateFunc)(HashTableValue value,
+                                              void *context);
+
 /**
  * Create a new hash table.
  *
@@ -133,6 +200,46 @@ typedef void (*HashTableValueFreeFunc)(HashTableValue value);
 HashTable *hashtable_new(HashTableHashFunc hashFunc,
                          HashTableEqualFunc equalFunc);
 
+/**
+ * Create a new hash table using a particular storage engine.  The
+ * engine only affects the memory layout of the table: all other
+ * hash table functions behave the same whichever engine is used.
+ *
+ * @param hashFunc             Function used to generate hash keys for the
+ *                             keys used in the table.
+ * @param equalFunc            Function used to test keys used in the table
+ *                             for equality.
+ * @param engine               The storage engine to use.
+ * @return                     A new hash table structure, or NULL if it
+ *                             was not possible to allocate the new hash
+ *                             table.
+ */
+
+HashTable *hashtable_newWithEngine(HashTableHashFunc hashFunc,
+                                   HashTableEqualFunc equalFunc,
+                                   HashTableEngine engine);
+
+/**
+ * Create a new hash table which allocates its memory from a particular
+ * allocator.
+ *
+ * @param hashFunc             Function used to generate hash keys for the
+ *                             keys used in the table.
+ * @param equalFunc            Function used to test keys used in the table
+ *                             for equality.
+ * @param engine               The storage engine to use.
+ * @param allocator            The allocator to use, or NULL to use the
+ *                             default allocator.
+ * @return                     A new hash table structure, or NULL if it
+ *                             was not possible to allocate the new hash
+ *                             table.
+ */
+
+HashTable *hashtable_newWithAllocator(HashTableHashFunc hashFunc,
+                                      HashTableEqualFunc equalFunc,
+                                      HashTableEngine engine,
+                                      const Allocator *allocator);
+
 /**
  * Destroy a hash table.
  *
@@ -154,6 +261,128 @@ void hashtable_registerFreeFunctions(HashTable *hashTable,
                                      HashTableKeyFreeFunc keyFreeFunc,
                                      HashTableValueFreeFunc valueFreeFunc);
 
+/**
+ * Enable or disable incremental resizing.  Normally, when a hash table
+ * grows, all of its entries are moved to the new table in one go.  With
+ * incremental resizing the old table is kept, and each subsequent
+ * insert, lookup or remove moves a few of its chains across, so that no
+ * single operation pays for the whole resize.
+ *
+ * Because lookups may move entries while a resize is in progress, an
+ * iterator is invalidated by any operation on the table, including
+ * @ref hashtable_lookup.  Tables using @ref HASH_TABLE_ENGINE_FLAT
+ * always resize in one go.
+ *
+ * @param hashTable            The hash table.
+ * @param enabled              Non-zero to enable incremental resizing,
+ *                             zero to disable it.
+ */
+
+void hashtable_setIncrementalResize(HashTable *hashTable, int enabled);
+
+/**
+ * Allocate the entries of a hash table from a @ref Slab owned by the
+ * table, instead of allocating each one with malloc.  This makes
+ * inserts and removes cheaper, keeps entries close together in memory,
+ * and lets @ref hashtable_free release all entries at once.  It must be
+ * called while the table is empty.  Tables using
+ * @ref HASH_TABLE_ENGINE_FLAT have no entries to allocate, and are not
+ * affected.
+ *
+ * @param hashTable            The hash table.
+ * @return                     Non-zero on success, or zero if the table
+ *                             is not empty or it was not possible to
+ *                             allocate the slab.
+ */
+
+int hashtable_useSlab(HashTable *hashTable);
+
+/**
+ * Enable or disable power of two table sizes.  Normally the chains of
+ * a table are chosen by dividing the hash by a prime table size.  In
+ * power of two mode the table size is a power of two, and the chain
+ * is chosen with a mask of the low bits of the hash, which is much
+ * cheaper than a division.  The hash is first mixed so that all of its
+ * bits affect the chain chosen, so the hash function need not have
+ * good low bits.  It must be called while the table is empty.  Tables
+ * using @ref HASH_TABLE_ENGINE_FLAT always have power of two sizes,
+ * and are not affected.
+ *
+ * @param hashTable            The hash table.
+ * @param enabled              Non-zero to use power of two sizes, zero
+ *                             to use prime sizes.
+ * @return                     Non-zero on success, or zero if the table
+ *                             is not empty or it was not possible to
+ *                             allocate the new table.
+ */
+
+int hashtable_setPowerOfTwoSize(HashTable *hashTable, int enabled);
+
+/**
+ * Make room in a hash table for a number of entries, so that it is not
+ * resized while they are inserted.  Loading a large number of entries
+ * into a table reserved for them avoids resizing it many times as it
+ * grows.  The table is also not made smaller than this after entries
+ * are removed, until @ref hashtable_compact is called.
+ *
+ * @param hashTable            The hash table.
+ * @param n                    The number of entries to make room for.
+ * @return                     Non-zero on success, or zero if it was not
+ *                             possible to allocate the larger table.
+ */
+
+int hashtable_reserve(HashTable *hashTable, unsigned int n);
+
+/**
+ * Make a hash table as small as it can be for the entries it holds,
+ * freeing memory after many entries have been removed.  Any size
+ * reserved with @ref hashtable_reserve is forgotten.
+ *
+ * @param hashTable            The hash table.
+ * @return                     Non-zero on success, or zero if it was not
+ *                             possible to allocate the smaller table, in
+ *                             which case the table is unchanged.
+ */
+
+int hashtable_compact(HashTable *hashTable);
+
+/**
+ * Hash the keys of a hash table with a seeded hash function, using a
+ * random seed chosen for this table (see @ref hash64_randomSeed).
+ * Without a secret seed, keys can be chosen which all have the same
+ * hash, so that every operation on the table becomes slow.  This
+ * replaces the hash function the table was created with, and must be
+ * called while the table is empty.
+ *
+ * @param hashTable            The hash table.
+ * @param hashFunc             Seeded hash function for the keys used in
+ *                             the table, for example
+ *                             @ref fastStringHashSeeded.
+ * @return                     Non-zero on success, or zero if the table
+ *                             is not empty.
+ */
+
+int hashtable_setSeededHash(HashTable *hashTable,
+                            HashTableSeededHashFunc hashFunc);
+
+/**
+ * Enable or disable the long chain guard.  When enabled, any chain
+ * which grows past a few entries is indexed by a balanced tree of its
+ * keys, so that operations on it take logarithmic rather than linear
+ * time, however many keys have the same hash.  This only happens when
+ * keys collide, which is very unlikely unless they were chosen to.
+ * Tables using @ref HASH_TABLE_ENGINE_FLAT are not affected.
+ *
+ * @param hashTable            The hash table.
+ * @param compareFunc          Function used to order keys, which must
+ *                             find two keys equal exactly when the
+ *                             equality function of the table does, or
+ *                             NULL to disable the guard.
+ */
+
+void hashtable_setChainGuard(HashTable *hashTable,
+                             HashTableCompareFunc compareFunc);
+
 /**
  * Insert a value into a hash table, overwriting any existing entry
  * using the same key.
@@ -183,7 +412,85 @@ HashTableValue hashtable_lookup(HashTable *hashTable,
                                 HashTableKey key);
 
 /**
- * Remove a value from a hash table.
+ * Look up the value for a key, inserting the key with a default value
+ * if it is not in the hash table, with a single search of the table.
+ * A pointer to the value stored in the table is returned, which can be
+ * read and written until the table is next changed.
+ *
+ * If the key was already in the table, the key passed is not stored,
+ * and is not freed with the key free function.
+ *
+ * @param hashTable           The hash table.
+ * @param key                 The key to look up.
+ * @param defaultValue        The value to insert if the key is not in
+ *                            the hash table.
+ * @param inserted            If not NULL, receives non-zero if the key
+ *                            was inserted, or zero if it was already in
+ *                            the hash table.
+ * @return                    Pointer to the value for the key, or NULL
+ *                            if it was not possible to allocate memory
+ *                            for a new entry.
+ */
+
+HashTableValue *hashtable_lookupOrInsert(HashTable *hashTable,
+                                         HashTableKey key,
+                                         HashTableValue defaultValue,
+                                         int *inserted);
+
+/**
+ * Update the value for a key with a function, with a single search of
+ * the table.  The function is passed the current value, or
+ * @ref HASH_TABLE_NULL if the key is not in the hash table, and the
+ * value it returns is stored for the key.  If this replaces a value,
+ * the old one is freed with the value free function.  The function
+ * must not change the hash table.
+ *
+ * As with @ref hashtable_lookupOrInsert, the key passed is only stored
+ * if it was not already in the table.
+ *
+ * @param hashTable           The hash table.
+ * @param key                 The key of the value to update.
+ * @param updateFunc          Function to compute the new value.
+ * @param context             Pointer passed to the function.
+ * @return                    Non-zero if the value was updated, or zero
+ *                            if it was not possible to allocate memory
+ *                            for a new entry.
+ */
+
+int hashtable_update(HashTable *hashTable,
+                     HashTableKey key,
+                     HashTableUpdateFunc updateFunc,
+                     void *context);
+
+/**
+ * Look up several values in a hash table at once.  This gives the same
+ * results as calling @ref hashtable_lookup on each key in turn, but the
+ * keys are hashed ahead of time and the memory they need is prefetched,
+ * so that the cache misses of several lookups overlap.  It is much
+ * faster than separate lookups for large tables.
+ *
+ * @param hashTable           The hash table.
+ * @param keys                Array of keys to look up.
+ * @param n                   Number of keys in the array.
+ * @param outValues           Array of at least n values, which receives
+ *                            the value for each key, or
+ *                            @ref HASH_TABLE_NULL if a key is not in the
+ *                            hash table.
+ */
+
+void hashtable_lookupBatch(HashTable *hashTable,
+                           HashTableKey *keys,
+                           unsigned int n,
+                           HashTableValue *outValues);
+
+/**
+ * Remove a value from a hash table.  The table is never resized by a
+ * remove, so the entry most recently returned by a
+ * @ref HashTableIterator may be removed without invalidating the
+ * iterator, unless an incremental resize is in progress.  Removing any
+ * other entry, or inserting one, invalidates iterators.  A table which
+ * removes have left mostly empty is made smaller by the next insert,
+ * or by @ref hashtable_compact.
  *
  * @param hashTable           The hash table.
  * @param key                 The key of the value to remove.
@@ -202,6 +509,106 @@ int hashtable_remove(HashTable *hashTable, HashTableKey key);
 
 unsigned int hashtable_numEntries(HashTable *hashTable);
 
+/**
+ * Retrieve the number of bytes of memory allocated by a hash table.
+ * This does not include memory used by the keys and values themselves.
+ *
+ * @param hashTable           The hash table.
+ * @return                    The number of bytes allocated.
+ */
+
+size_t hashtable_memoryUsage(HashTable *hashTable);
+
+/**
+ * Number of entries in the chain length histogram of
+ * @ref HashTableStats.
+ */
+
+#define HASH_TABLE_STATS_HISTOGRAM_SIZE 16
+
+/**
+ * Statistics about a hash table, filled in by @ref hashtable_stats.
+ *
+ * The shape of the table is always reported.  The counts of searches
+ * and resizes are only kept if the library is built with
+ * HASH_TABLE_STATS defined; otherwise they are zero, so that other
+ * builds pay nothing for them.
+ */
+
+typedef struct _HashTableStats {
+
+	/** Number of entries in the table. */
+
+    unsigned int entries;
+
+	/** Number of buckets: chains for the chained engine (including
+	 *  those of the old table during an incremental resize), or slots
+	 *  for the flat engine. */
+
+    unsigned int buckets;
+
+	/** Entries per bucket. */
+
+    double loadFactor;
+
+	/** Bytes of memory allocated, as @ref hashtable_memoryUsage. */
+
+    size_t bytesUsed;
+
+	/** For the chained engine, the number of chains of each length,
+	 *  starting from empty chains.  For the flat engine, the number of
+	 *  entries found after probing each number of groups, starting
+	 *  from zero, which is always empty.  The last element also counts
+	 *  all longer chains or probes. */
+
+    unsigned long chainLengths[HASH_TABLE_STATS_HISTOGRAM_SIZE];
+
+	/** The longest chain, or for the flat engine the most groups
+	 *  probed to find an entry. */
+
+    unsigned int maxChainLength;
+
+	/** Non-zero if the counts below are being kept. */
+
+    int countsEnabled;
+
+	/** Number of searches for a key, made by lookups, inserts and
+	 *  removes. */
+
+    unsigned long lookups;
+
+	/** Average and largest number of probes made by a search: entries
+	 *  compared for the chained engine, groups for the flat engine. */
+
+    double averageLookupProbes;
+    unsigned int maxLookupProbes;
+
+	/** Number of times the table was resized, and the processor time
+	 *  spent doing it.  Chains migrated later by an incremental resize
+	 *  are not included in the time. */
+
+    unsigned long resizes;
+    double resizeSeconds;
+} HashTableStats;
+
+/**
+ * Retrieve statistics about a hash table.  This walks the whole table,
+ * so takes time proportional to its size.
+ *
+ * @param hashTable           The hash table.
+ * @param stats               Structure to fill in.
+ */
+
+void hashtable_stats(HashTable *hashTable, HashTableStats *stats);
+
+/**
+ * Reset the counts of searches and resizes kept for a hash table.
+ *
+ * @param hashTable           The hash table.
+ */
+
+void hashtable_resetStats(HashTable *hashTable);
+
 /**
  * Initialise a @ref HashTableIterator to iterate over a hash table.
  *
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 
 #include "dslist.h"
+#include "dsslab.h"
 
 
 /* A doubly-linked list */
@@ -11,6 +12,29 @@ struct _ListEntry {
 	ListEntry *next;
 };
 
+/* Entries are allocated from the slab if one is given, otherwise from
+ * the default allocator.  A list has no structure of its own to record
+ * an allocator in. */
+
+static ListEntry *list_allocateEntry(Slab *slab)
+{
+    const Allocator *allocator = allocator_default();
+
+    if (slab != NULL) {
+        return (ListEntry *) slab_allocate(slab);
+    }
+
+    return (ListEntry *) allocator->allocate(allocator->context,
+                                             sizeof(ListEntry));
+}
+
+static void list_freeEntry(ListEntry *entry)
+{
+    const Allocator *allocator = allocator_default();
+
+    allocator->release(allocator->context, entry, sizeof(ListEntry));
+}
+
 void list_free(ListEntry *list)
 {
 	/* Iterate over each entry, freeing each list entry, until the
@@ -23,13 +47,26 @@ void list_free(ListEntry *list)
 
 		next = entry->next;
 
-		free(entry);
+        list_freeEntry(entry);
 
 		entry = next;
 	}
 }
 
-ListEntry *list_prepend(ListEntry **list, ListValue data)
+Slab *list_newSlab(void)
+{
+    return slab_new(sizeof(ListEntry));
+}
+
+Slab *list_newSlabWithAllocator(const Allocator *allocator)
+{
+    return slab_newWithAllocator(sizeof(ListEntry), allocator);
+}
+
+
+static ListEntry *list_prependInternal(ListEntry **list,
+                                       ListValue data,
+                                       Slab *slab)
 {
 	if (list == NULL) {
 
@@ -40,7 +77,7 @@ ListEntry *list_prepend(ListEntry **list, ListValue data)
 
 	/* Create new entry */
 
-    ListEntry *newEntry = malloc(sizeof(ListEntry));
+    ListEntry *newEntry = list_allocateEntry(slab);
     if (newEntry == NULL) {
 		return NULL;
 	}
@@ -59,7 +96,19 @@ ListEntry *list_prepend(ListEntry **list, ListValue data)
     return newEntry;
 }
 
-ListEntry *list_append(ListEntry **list, ListValue data)
+ListEntry *list_prepend(ListEntry **list, ListValue data)
+{
+    return list_prependInternal(list, data, NULL);
+}
+
+ListEntry *list_prependWithSlab(ListEntry **list, ListValue data, Slab *slab)
+{
+    return list_prependInternal(list, data, slab);
+}
+
+static ListEntry *list_appendInternal(ListEntry **list,
+                                      ListValue data,
+                                      Slab *slab)
 {
 	if (list == NULL) {
 		return NULL;
@@ -67,7 +116,7 @@ ListEntry *list_append(ListEntry **list, ListValue data)
 
 	/* Create new list entry */
 
-    ListEntry *newEntry = malloc(sizeof(ListEntry));
+    ListEntry *newEntry = list_allocateEntry(slab);
     if (newEntry == NULL) {
 		return NULL;
 	}
@@ -101,6 +150,16 @@ ListEntry *list_append(ListEntry **list, ListValue data)
     return newEntry;
 }
 
+ListEntry *list_append(ListEntry **list, ListValue data)
+{
+    return list_appendInternal(list, data, NULL);
+}
+
+ListEntry *list_appendWithSlab(ListEntry **list, ListValue data, Slab *slab)
+{
+    return list_appendInternal(list, data, slab);
+}
+
 ListValue list_data(ListEntry *entry)
 {
     if (entry == NULL) {
@@ -218,7 +277,9 @@ ListValue *list_toArray(ListEntry *list)
 	return array;
 }
 
-int list_removeEntry(ListEntry **list, ListEntry *entry)
+static int list_removeEntryInternal(ListEntry **list,
+                                    ListEntry *entry,
+                                    Slab *slab)
 {
 	/* If the list is empty, or entry is NULL, always fail */
 
@@ -259,13 +320,27 @@ int list_removeEntry(ListEntry **list, ListEntry *entry)
 
 	/* Free the list entry */
 
-	free(entry);
+    if (slab != NULL) {
+        slab_release(slab, entry);
+    } else {
+        list_freeEntry(entry);
+    }
 
 	/* Operation successful */
 
 	return 1;
 }
 
+int list_removeEntry(ListEntry **list, ListEntry *entry)
+{
+    return list_removeEntryInternal(list, entry, NULL);
+}
+
+int list_removeEntryWithSlab(ListEntry **list, ListEntry *entry, Slab *slab)
+{
+    return list_removeEntryInternal(list, entry, slab);
+}
+
 unsigned int list_removeData(ListEntry **list,
                              ListEqualFunc callback,
                              ListValue data)
@@ -309,7 +384,7 @@ unsigned int list_removeData(ListEntry **list,
 
 			/* Free the entry */
 
-			free(rover);
+            list_freeEntry(rover);
 
             ++entriesRemoved;
 		}
@@ -519,7 +594,7 @@ void list_iteratorRemove(ListIterator *iterator)
             iterator->current->next->prev = iterator->current->prev;
 		}
 
-        free(iterator->current);
+        list_freeEntry(iterator->current);
         iterator->current = NULL;
 	}
 }
@@ -18,6 +18,12 @@
  * To remove a value from a list, use @ref list_removeEntry or
  * @ref list_removeData.
  *
+ * Entries can also be allocated from a @ref Slab created with
+ * @ref list_newSlab, using @ref list_prependWithSlab and
+ * @ref list_appendWithSlab.  Such entries may only be removed with
+ * @ref list_removeEntryWithSlab, and the whole list is destroyed by
+ * destroying the slab with @ref slab_free instead of @ref list_free.
+ *
  * To iterate over entries in a list, use @ref list_iterate to initialise
  * a @ref ListIterator structure, with @ref list_iteratorNext and
  * @ref list_iteratorHasMore to retrieve each value in turn.
@@ -35,6 +41,8 @@
 #ifndef DSLIST_H
 #define DSLIST_H
 
+#include "dsslab.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -129,6 +137,54 @@ ListEntry *list_prepend(ListEntry **list, ListValue data);
 
 ListEntry *list_append(ListEntry **list, ListValue data);
 
+/**
+ * Create a slab suitable for allocating list entries.  Several lists
+ * may share the same slab.
+ *
+ * @return             A new slab, or NULL if it was not possible to
+ *                     allocate the memory.
+ */
+
+Slab *list_newSlab(void);
+
+/**
+ * Create a slab suitable for allocating list entries, which takes its
+ * memory from a particular allocator.
+ *
+ * @param allocator    The allocator to use, or NULL to use the default
+ *                     allocator.
+ * @return             A new slab, or NULL if it was not possible to
+ *                     allocate the memory.
+ */
+
+Slab *list_newSlabWithAllocator(const Allocator *allocator);
+
+/**
+ * Prepend a value to the start of a list, allocating the new entry from
+ * a slab.
+ *
+ * @param list         Pointer to the list to prepend to.
+ * @param data         The value to prepend.
+ * @param slab         Slab created with @ref list_newSlab.
+ * @return             The new entry in the list, or NULL if it was not
+ *                     possible to allocate the memory for the new entry.
+ */
+
+ListEntry *list_prependWithSlab(ListEntry **list, ListValue data, Slab *slab);
+
+/**
+ * Append a value to the end of a list, allocating the new entry from a
+ * slab.
+ *
+ * @param list         Pointer to the list to append to.
+ * @param data         The value to append.
+ * @param slab         Slab created with @ref list_newSlab.
+ * @return             The new entry in the list, or NULL if it was not
+ *                     possible to allocate the memory for the new entry.
+ */
+
+ListEntry *list_appendWithSlab(ListEntry **list, ListValue data, Slab *slab);
+
 /**
  * Retrieve the previous entry in a list.
  *
@@ -220,6 +276,19 @@ ListValue *list_toArray(ListEntry *list);
 
 int list_removeEntry(ListEntry **list, ListEntry *entry);
 
+/**
+ * Remove an entry which was allocated from a slab from a list, and give
+ * it back to the slab.
+ *
+ * @param list       Pointer to the list.
+ * @param entry      The list entry to remove.
+ * @param slab       The slab the entry was allocated from.
+ * @return           If the entry is not found in the list, returns zero,
+ *                   else returns non-zero.
+ */
+
+int list_removeEntryWithSlab(ListEntry **list, ListEntry *entry, Slab *slab);
+
 /**
  * Remove all occurrences of a particular value from a list.
  *
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 
 #include "dsqueue.h"
+#include "dsslab.h"
 
 
 /* A double-ended queue */
@@ -14,41 +15,109 @@ struct _QueueEntry {
 };
 
 struct _Queue {
+    AllocatorUsage usage;
 	QueueEntry *head;
 	QueueEntry *tail;
+    Slab *slab;
 };
 
+/* Allocate and free entries, from the slab if the queue has one */
+
+static QueueEntry *queue_allocateEntry(Queue *queue)
+{
+    if (queue->slab != NULL) {
+        return (QueueEntry *) slab_allocate(queue->slab);
+    }
+
+    return (QueueEntry *) allocator_malloc(&queue->usage, sizeof(QueueEntry));
+}
+
+static void queue_freeEntry(Queue *queue, QueueEntry *entry)
+{
+    if (queue->slab != NULL) {
+        slab_release(queue->slab, entry);
+    } else {
+        allocator_free(&queue->usage, entry, sizeof(QueueEntry));
+    }
+}
+
 Queue *queue_new(void)
 {
-    Queue *queue = (Queue *) malloc(sizeof(Queue));
+    return queue_newWithAllocator(NULL);
+}
+
+Queue *queue_newWithAllocator(const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
+    allocator_initUsage(&usage, allocator);
+
+    Queue *queue = (Queue *) allocator_malloc(&usage, sizeof(Queue));
 	if (queue == NULL) {
 		return NULL;
 	}
 
+    queue->usage = usage;
+
 	queue->head = NULL;
 	queue->tail = NULL;
+    queue->slab = NULL;
 
 	return queue;
 }
 
+int queue_useSlab(Queue *queue)
+{
+    if (queue->slab != NULL) {
+        return 1;
+    }
+
+    if (!queue_isEmpty(queue)) {
+        return 0;
+    }
+
+    queue->slab = slab_newWithAllocator(sizeof(QueueEntry),
+                                        queue->usage.allocator);
+
+    return queue->slab != NULL;
+}
+
 void queue_free(Queue *queue)
 {
-	/* Empty the queue */
+	/* Empty the queue.  Entries allocated from a slab are all freed
+	 * along with it. */
 
-	while (!queue_isEmpty(queue)) {
-		queue_popHead(queue);
-	}
+    if (queue->slab != NULL) {
+        slab_free(queue->slab);
+    } else {
+        while (!queue_isEmpty(queue)) {
+            queue_popHead(queue);
+        }
+    }
 
 	/* Free back the queue */
 
-	free(queue);
+    AllocatorUsage usage = queue->usage;
+
+    allocator_free(&usage, queue, sizeof(Queue));
+}
+
+size_t queue_memoryUsage(Queue *queue)
+{
+    size_t result = queue->usage.bytesUsed;
+
+    if (queue->slab != NULL) {
+        result += slab_memoryUsage(queue->slab);
+    }
+
+    return result;
 }
 
 int queue_pushHead(Queue *queue, QueueValue data)
 {
 	/* Create the new entry and fill in the fields in the structure */
 
-    QueueEntry *newEntry = malloc(sizeof(QueueEntry));
+    QueueEntry *newEntry = queue_allocateEntry(queue);
     if (newEntry == NULL) {
 		return 0;
 	}
@@ -111,7 +180,7 @@ QueueValue queue_popHead(Queue *queue)
 
 	/* Free back the queue entry structure */
 
-	free(entry);
+    queue_freeEntry(queue, entry);
 
 	return result;
 }
@@ -129,7 +198,7 @@ int queue_pushTail(Queue *queue, QueueValue data)
 {
 	/* Create the new entry and fill in the fields in the structure */
 
-    QueueEntry *newEntry = malloc(sizeof(QueueEntry));
+    QueueEntry *newEntry = queue_allocateEntry(queue);
     if (newEntry == NULL) {
 		return 0;
 	}
@@ -193,7 +262,7 @@ QueueValue queue_popTail(Queue *queue)
 
 	/* Free back the queue entry structure */
 
-	free(entry);
+    queue_freeEntry(queue, entry);
 
 	return result;
 }
@@ -21,6 +21,8 @@
 #ifndef DSQUEUE_H
 #define DSQUEUE_H
 
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -52,6 +54,31 @@ typedef void *QueueValue;
 
 Queue *queue_new(void);
 
+/**
+ * Create a new double-ended queue which allocates its memory from a
+ * particular allocator.
+ *
+ * @param allocator  The allocator to use, or NULL to use the default
+ *                   allocator.
+ * @return           A new queue, or NULL if it was not possible to allocate
+ *                   the memory.
+ */
+
+Queue *queue_newWithAllocator(const Allocator *allocator);
+
+/**
+ * Allocate the entries of a queue from a @ref Slab owned by the queue,
+ * instead of with malloc.  Pushing and popping become cheaper, and
+ * @ref queue_free releases all entries at once.  This must be called
+ * while the queue is empty.
+ *
+ * @param queue      The queue.
+ * @return           Non-zero on success, or zero if the queue is not
+ *                   empty or the slab could not be allocated.
+ */
+
+int queue_useSlab(Queue *queue);
+
 /**
  * Destroy a queue.
  *
@@ -60,6 +87,16 @@ Queue *queue_new(void);
 
 void queue_free(Queue *queue);
 
+/**
+ * Retrieve the number of bytes of memory allocated by a queue.  This
+ * does not include memory used by the values themselves.
+ *
+ * @param queue      The queue.
+ * @return           The number of bytes allocated.
+ */
+
+size_t queue_memoryUsage(Queue *queue);
+
 /**
  * Add a value to the head of a queue.
  *
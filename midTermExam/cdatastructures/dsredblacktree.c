@@ -1,6 +1,7 @@
 #include <stdlib.h>
 
 #include "dsredblacktree.h"
+#include "dsslab.h"
 
 
 struct _RBTreeNode {
@@ -12,9 +13,11 @@ struct _RBTreeNode {
 };
 
 struct _RBTree {
+    AllocatorUsage usage;
     RBTreeNode *rootNode;
     RBTreeCompareFunc compareFunc;
     int numNodes;
+    Slab *slab;
 };
 
 static RBTreeNodeSide rbtree_nodeSide(RBTreeNode *node)
@@ -114,42 +117,78 @@ static RBTreeNode *rbtree_rotate(RBTree *tree,
 
 RBTree *rbtree_new(RBTreeCompareFunc compareFunc)
 {
-    RBTree *newTree = malloc(sizeof(RBTree));
+    return rbtree_newWithAllocator(compareFunc, NULL);
+}
+
+RBTree *rbtree_newWithAllocator(RBTreeCompareFunc compareFunc,
+                                const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
+    allocator_initUsage(&usage, allocator);
+
+    RBTree *newTree = allocator_malloc(&usage, sizeof(RBTree));
 
     if (newTree == NULL) {
 		return NULL;
 	}
 
+    newTree->usage = usage;
+
     newTree->rootNode = NULL;
     newTree->numNodes = 0;
     newTree->compareFunc = compareFunc;
+    newTree->slab = NULL;
 
     return newTree;
 }
 
-static void rbtree_freeSubtree(RBTreeNode *node)
+int rbtree_useSlab(RBTree *tree)
+{
+    if (tree->slab != NULL) {
+        return 1;
+    }
+
+    if (tree->numNodes != 0) {
+        return 0;
+    }
+
+    tree->slab = slab_newWithAllocator(sizeof(RBTreeNode),
+                                       tree->usage.allocator);
+
+    return tree->slab != NULL;
+}
+
+static void rbtree_freeSubtree(RBTree *tree, RBTreeNode *node)
 {
 	if (node != NULL) {
 		/* Recurse to subnodes */
 
-        rbtree_freeSubtree(node->children[RB_TREE_NODE_LEFT]);
-        rbtree_freeSubtree(node->children[RB_TREE_NODE_RIGHT]);
+        rbtree_freeSubtree(tree, node->children[RB_TREE_NODE_LEFT]);
+        rbtree_freeSubtree(tree, node->children[RB_TREE_NODE_RIGHT]);
 
 		/* Free this node */
 
-		free(node);
+        allocator_free(&tree->usage, node, sizeof(RBTreeNode));
 	}
 }
 
 void rbtree_free(RBTree *tree)
 {
-	/* Free all nodes in the tree */
+	/* Free all nodes in the tree.  Nodes allocated from a slab are
+	 * freed along with it, without walking the tree. */
 
-    rbtree_freeSubtree(tree->rootNode);
+    if (tree->slab != NULL) {
+        slab_free(tree->slab);
+    } else {
+        rbtree_freeSubtree(tree, tree->rootNode);
+    }
 
 	/* Free back the main tree structure */
 
-	free(tree);
+    AllocatorUsage usage = tree->usage;
+
+    allocator_free(&usage, tree, sizeof(RBTree));
 }
 
 static void rbtree_insertCase1(RBTree *tree, RBTreeNode *node);
@@ -301,7 +340,14 @@ RBTreeNode *rbtree_insert(RBTree *tree, RBTreeKey key, RBTreeValue value)
 {
 	/* Allocate a new node */
 
-    RBTreeNode *node = malloc(sizeof(RBTreeNode));
+    RBTreeNode *node;
+
+    if (tree->slab != NULL) {
+        node = slab_allocate(tree->slab);
+    } else {
+        node = allocator_malloc(&tree->usage, sizeof(RBTreeNode));
+    }
+
 	if (node == NULL) {
 		return NULL;
 	}
@@ -453,3 +499,14 @@ int rbtree_numEntries(RBTree *tree)
     return tree->numNodes;
 }
 
+size_t rbtree_memoryUsage(RBTree *tree)
+{
+    size_t result = tree->usage.bytesUsed;
+
+    if (tree->slab != NULL) {
+        result += slab_memoryUsage(tree->slab);
+    }
+
+    return result;
+}
+
@@ -35,6 +35,8 @@
 #ifndef DSREDBLACKTREE_H
 #define DSREDBLACKTREE_H
 
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -118,6 +120,33 @@ typedef enum {
 
 RBTree *rbtree_new(RBTreeCompareFunc compareFunc);
 
+/**
+ * Create a new red-black tree which allocates its memory from a
+ * particular allocator.
+ *
+ * @param compareFunc     Function to use when comparing keys in the tree.
+ * @param allocator       The allocator to use, or NULL to use the default
+ *                        allocator.
+ * @return                A new red-black tree, or NULL if it was not possible
+ *                        to allocate the memory.
+ */
+
+RBTree *rbtree_newWithAllocator(RBTreeCompareFunc compareFunc,
+                                const Allocator *allocator);
+
+/**
+ * Allocate the nodes of a red-black tree from a @ref Slab owned by the
+ * tree, instead of with malloc.  Inserting becomes cheaper, and
+ * @ref rbtree_free releases all nodes at once without walking the tree.
+ * This must be called while the tree is empty.
+ *
+ * @param tree            The tree.
+ * @return                Non-zero on success, or zero if the tree is not
+ *                        empty or the slab could not be allocated.
+ */
+
+int rbtree_useSlab(RBTree *tree);
+
 /**
  * Destroy a red-black tree.
  *
@@ -268,6 +297,17 @@ RBTreeValue *rbtree_toArray(RBTree *tree);
 
 int rbtree_numEntries(RBTree *tree);
 
+/**
+ * Retrieve the number of bytes of memory allocated by a red-black
+ * tree.  This does not include memory used by the keys and values
+ * themselves.
+ *
+ * @param tree            The tree.
+ * @return                The number of bytes allocated.
+ */
+
+size_t rbtree_memoryUsage(RBTree *tree);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,220 @@
+/* Scalable bloom filter: a growing chain of bloom filters */
+
+#include <stdlib.h>
+
+#include "dsscalablebloomfilter.h"
+
+/* Each stage holds this many times the values of the one before, and
+ * has this fraction of its false positive rate.  With a tightening
+ * ratio r the rates of all stages add up to at most 1 / (1 - r) times
+ * the rate of the first stage. */
+
+#define SCALABLE_BLOOM_FILTER_GROWTH 2
+#define SCALABLE_BLOOM_FILTER_TIGHTENING 0.5
+
+struct _ScalableBloomFilter {
+    AllocatorUsage usage;
+    BloomFilterHashFunc hashFunc;
+    BloomFilter **stages;
+    unsigned int numStages;
+    unsigned int stagesAlloced;
+    unsigned int stageCapacity;
+    unsigned int stageEntries;
+    unsigned int numEntries;
+    double stageFalsePositiveRate;
+};
+
+ScalableBloomFilter *scalablebloomfilter_new(unsigned int initialCapacity,
+                                             double falsePositiveRate,
+                                             BloomFilterHashFunc hashFunc)
+{
+    return scalablebloomfilter_newWithAllocator(initialCapacity,
+                                                falsePositiveRate,
+                                                hashFunc, NULL);
+}
+
+/* Add a new stage, sized for stageCapacity values with a false positive
+ * rate of stageFalsePositiveRate.  Returns zero on failure. */
+
+static int scalablebloomfilter_addStage(ScalableBloomFilter *filter)
+{
+    BloomFilter **newStages;
+    BloomFilter *stage;
+    unsigned int newAlloced;
+    unsigned int tableSize;
+    unsigned int numFunctions;
+
+    if (filter->numStages == filter->stagesAlloced) {
+        newAlloced = filter->stagesAlloced * 2;
+
+        if (newAlloced == 0) {
+            newAlloced = 4;
+        }
+
+        newStages = allocator_realloc(&filter->usage, filter->stages,
+                                      filter->stagesAlloced
+                                      * sizeof(BloomFilter *),
+                                      newAlloced * sizeof(BloomFilter *));
+
+        if (newStages == NULL) {
+            return 0;
+        }
+
+        filter->stages = newStages;
+        filter->stagesAlloced = newAlloced;
+    }
+
+    if (!bloomfilter_optimalSize(filter->stageCapacity,
+                                 filter->stageFalsePositiveRate,
+                                 &tableSize, &numFunctions)) {
+        return 0;
+    }
+
+    stage = bloomfilter_newWithAllocator(tableSize, filter->hashFunc,
+                                         numFunctions,
+                                         BLOOM_FILTER_LAYOUT_STANDARD,
+                                         filter->usage.allocator);
+
+    if (stage == NULL) {
+        return 0;
+    }
+
+    filter->stages[filter->numStages] = stage;
+    ++filter->numStages;
+    filter->stageEntries = 0;
+
+    return 1;
+}
+
+ScalableBloomFilter *scalablebloomfilter_newWithAllocator(
+    unsigned int initialCapacity,
+    double falsePositiveRate,
+    BloomFilterHashFunc hashFunc,
+    const Allocator *allocator)
+{
+    ScalableBloomFilter *filter;
+    AllocatorUsage usage;
+
+    if (initialCapacity == 0
+     || !(falsePositiveRate > 0 && falsePositiveRate < 1)) {
+        return NULL;
+    }
+
+    allocator_initUsage(&usage, allocator);
+
+    filter = allocator_malloc(&usage, sizeof(ScalableBloomFilter));
+
+    if (filter == NULL) {
+        return NULL;
+    }
+
+    filter->usage = usage;
+    filter->hashFunc = hashFunc;
+    filter->stages = NULL;
+    filter->numStages = 0;
+    filter->stagesAlloced = 0;
+    filter->numEntries = 0;
+
+	/* Split the target rate between the stages, so that the sum of
+	 * their rates can never exceed it */
+
+    filter->stageCapacity = initialCapacity;
+    filter->stageFalsePositiveRate = falsePositiveRate
+                                   * (1 - SCALABLE_BLOOM_FILTER_TIGHTENING);
+
+    if (!scalablebloomfilter_addStage(filter)) {
+        scalablebloomfilter_free(filter);
+        return NULL;
+    }
+
+    return filter;
+}
+
+void scalablebloomfilter_free(ScalableBloomFilter *filter)
+{
+    AllocatorUsage usage = filter->usage;
+    unsigned int i;
+
+    for (i=0; i<filter->numStages; ++i) {
+        bloomfilter_free(filter->stages[i]);
+    }
+
+    allocator_free(&usage, filter->stages,
+                   filter->stagesAlloced * sizeof(BloomFilter *));
+    allocator_free(&usage, filter, sizeof(ScalableBloomFilter));
+}
+
+size_t scalablebloomfilter_memoryUsage(ScalableBloomFilter *filter)
+{
+    size_t result = filter->usage.bytesUsed;
+    unsigned int i;
+
+    for (i=0; i<filter->numStages; ++i) {
+        result += bloomfilter_memoryUsage(filter->stages[i]);
+    }
+
+    return result;
+}
+
+int scalablebloomfilter_insert(ScalableBloomFilter *filter,
+                               BloomFilterValue value)
+{
+    unsigned int oldCapacity;
+    double oldFalsePositiveRate;
+
+	/* Start a new stage once the newest one is full.  If it cannot be
+	 * added, the filter is left as it was. */
+
+    if (filter->stageEntries >= filter->stageCapacity) {
+        oldCapacity = filter->stageCapacity;
+        oldFalsePositiveRate = filter->stageFalsePositiveRate;
+
+        if (filter->stageCapacity
+            > ~0U / SCALABLE_BLOOM_FILTER_GROWTH) {
+            return 0;
+        }
+
+        filter->stageCapacity *= SCALABLE_BLOOM_FILTER_GROWTH;
+        filter->stageFalsePositiveRate *= SCALABLE_BLOOM_FILTER_TIGHTENING;
+
+        if (!scalablebloomfilter_addStage(filter)) {
+            filter->stageCapacity = oldCapacity;
+            filter->stageFalsePositiveRate = oldFalsePositiveRate;
+            return 0;
+        }
+    }
+
+    bloomfilter_insert(filter->stages[filter->numStages - 1], value);
+
+    ++filter->stageEntries;
+    ++filter->numEntries;
+
+    return 1;
+}
+
+int scalablebloomfilter_query(ScalableBloomFilter *filter,
+                              BloomFilterValue value)
+{
+    unsigned int i;
+
+	/* Later stages are larger and hold more values, so are checked
+	 * first */
+
+    for (i=filter->numStages; i>0; --i) {
+        if (bloomfilter_query(filter->stages[i - 1], value)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+unsigned int scalablebloomfilter_numEntries(ScalableBloomFilter *filter)
+{
+    return filter->numEntries;
+}
+
+unsigned int scalablebloomfilter_numStages(ScalableBloomFilter *filter)
+{
+    return filter->numStages;
+}
@@ -0,0 +1,150 @@
+/**
+ * @file dsscalablebloomfilter.h
+ *
+ * @brief Scalable bloom filter
+ *
+ * A scalable bloom filter is a bloom filter which grows as values are
+ * inserted, so that the number of values need not be known in advance.
+ * It is made of a chain of @ref BloomFilter stages.  Values are
+ * inserted into the newest stage; once it holds as many values as it
+ * was sized for, a new stage twice as large is added.  Each stage has
+ * half the false positive rate of the one before, so that the false
+ * positive rate of the whole filter stays below the rate it was
+ * created with, however many stages are added.
+ *
+ * To create a scalable bloom filter, use @ref scalablebloomfilter_new.
+ * To destroy it, use @ref scalablebloomfilter_free.
+ *
+ * To insert a value, use @ref scalablebloomfilter_insert.  To query
+ * whether a value is part of the set, use
+ * @ref scalablebloomfilter_query.
+ */
+
+#ifndef DSSCALABLEBLOOMFILTER_H
+#define DSSCALABLEBLOOMFILTER_H
+
+#include "dsbloomfilter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A scalable bloom filter structure.
+ */
+
+typedef struct _ScalableBloomFilter ScalableBloomFilter;
+
+/**
+ * Create a new scalable bloom filter.
+ *
+ * @param initialCapacity    Number of values the first stage is sized
+ *                           for.  A small value saves memory when few
+ *                           values are inserted; a value close to the
+ *                           final number of values makes queries
+ *                           faster, since there are fewer stages.
+ * @param falsePositiveRate  The largest chance of a false positive,
+ *                           between 0 and 1.
+ * @param hashFunc           Hash function to use on values stored in the
+ *                           filter.
+ * @return                   A new scalable bloom filter, or NULL if the
+ *                           arguments are out of range or it was not
+ *                           possible to allocate the new filter.
+ */
+
+ScalableBloomFilter *scalablebloomfilter_new(unsigned int initialCapacity,
+                                             double falsePositiveRate,
+                                             BloomFilterHashFunc hashFunc);
+
+/**
+ * Create a new scalable bloom filter which allocates its memory, and
+ * that of its stages, from a particular allocator.
+ *
+ * @param initialCapacity    Number of values the first stage is sized
+ *                           for.
+ * @param falsePositiveRate  The largest chance of a false positive,
+ *                           between 0 and 1.
+ * @param hashFunc           Hash function to use on values stored in the
+ *                           filter.
+ * @param allocator          The allocator to use, or NULL to use the
+ *                           default allocator.
+ * @return                   A new scalable bloom filter, or NULL if the
+ *                           arguments are out of range or it was not
+ *                           possible to allocate the new filter.
+ */
+
+ScalableBloomFilter *scalablebloomfilter_newWithAllocator(
+    unsigned int initialCapacity,
+    double falsePositiveRate,
+    BloomFilterHashFunc hashFunc,
+    const Allocator *allocator);
+
+/**
+ * Destroy a scalable bloom filter.
+ *
+ * @param filter             The scalable bloom filter to destroy.
+ */
+
+void scalablebloomfilter_free(ScalableBloomFilter *filter);
+
+/**
+ * Retrieve the number of bytes of memory allocated by a scalable bloom
+ * filter, including all of its stages.
+ *
+ * @param filter             The scalable bloom filter.
+ * @return                   The number of bytes allocated.
+ */
+
+size_t scalablebloomfilter_memoryUsage(ScalableBloomFilter *filter);
+
+/**
+ * Insert a value into a scalable bloom filter.
+ *
+ * @param filter             The scalable bloom filter.
+ * @param value              The value to insert.
+ * @return                   Non-zero if the value was inserted, or zero
+ *                           if a new stage was needed and it was not
+ *                           possible to allocate it.
+ */
+
+int scalablebloomfilter_insert(ScalableBloomFilter *filter,
+                               BloomFilterValue value);
+
+/**
+ * Query a scalable bloom filter for a particular value.
+ *
+ * @param filter             The scalable bloom filter.
+ * @param value              The value to look up.
+ * @return                   Zero if the value was definitely not
+ *                           inserted into the filter.  Non-zero
+ *                           indicates that it either may or may not
+ *                           have been inserted.
+ */
+
+int scalablebloomfilter_query(ScalableBloomFilter *filter,
+                              BloomFilterValue value);
+
+/**
+ * Retrieve the number of values inserted into a scalable bloom filter.
+ *
+ * @param filter             The scalable bloom filter.
+ * @return                   The number of values inserted.
+ */
+
+unsigned int scalablebloomfilter_numEntries(ScalableBloomFilter *filter);
+
+/**
+ * Retrieve the number of stages in a scalable bloom filter.
+ *
+ * @param filter             The scalable bloom filter.
+ * @return                   The number of stages.
+ */
+
+unsigned int scalablebloomfilter_numStages(ScalableBloomFilter *filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSSCALABLEBLOOMFILTER_H */
+
@@ -1,6 +1,10 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "dsset.h"
+#include "dshashint.h"
+#include "dsslab.h"
 
 
 /* A set */
@@ -11,15 +15,38 @@ struct _SetEntry {
 };
 
 struct _Set {
+    AllocatorUsage usage;
 	SetEntry **table;
 	unsigned int entries;
     unsigned int tableSize;
-    unsigned int primeIndex;
+    unsigned int sizeIndex;
+    unsigned int reserved;
+    int powerOfTwo;
     SetHashFunc hashFunc;
     SetEqualFunc equalFunc;
     SetFreeFunc freeFunc;
+    int incrementalResize;
+    SetEntry **oldTable;
+    unsigned int oldTableSize;
+    unsigned int rehashIndex;
+    Slab *slab;
+#ifdef SET_STATS
+    unsigned long searches;
+    unsigned long searchProbes;
+    unsigned int maxSearchProbes;
+    unsigned long resizes;
+    clock_t resizeTime;
+#endif
 };
 
+/* Statistics are only counted when built with SET_STATS */
+
+#ifdef SET_STATS
+#define SET_COUNT_SEARCH(set, probes) set_countSearch(set, probes)
+#else
+#define SET_COUNT_SEARCH(set, probes) ((void) 0)
+#endif
+
 /* This is a set of good hash table prime numbers, from:
  *   http://planetmath.org/encyclopedia/GoodHashTablePrimes.html
  * Each prime is roughly double the previous value, and as far as
@@ -34,26 +61,113 @@ static const unsigned int SET_PRIMES[] = {
 
 static const unsigned int SET_NUM_PRIMES = sizeof(SET_PRIMES) / sizeof(int);
 
+/* Number of non-empty chains migrated by each operation during an
+ * incremental resize.  This must stay ahead of the inserts so that a
+ * resize completes before the next one is due. */
+
+#define SET_REHASH_CHAINS 4
+
+/* A set is halved by the first insert after removes have left fewer
+ * values than 1/SET_SHRINK_LOAD of its chains, well below the load at
+ * which it grows again */
+
+#define SET_SHRINK_LOAD 12
+
+/* In power of two mode the table starts at 256 chains and doubles on
+ * each resize, up to 2^31 chains */
+
+#define SET_POWER_OF_TWO_MIN_SIZE 256U
+#define SET_MAX_POWER_OF_TWO_INDEX 23
+
+/* Generate the hash of a value.  In power of two mode the chain is
+ * chosen from the low bits of the hash, so the hash is mixed first to
+ * make every bit count. */
+
+static unsigned int set_hash(Set *set, SetValue data)
+{
+    unsigned int hash = set->hashFunc(data);
+
+    if (set->powerOfTwo) {
+        hash = intMix(hash);
+    }
+
+    return hash;
+}
+
+/* Find the chain of a table of a particular size a hash belongs in */
+
+static unsigned int set_bucket(Set *set, unsigned int hash,
+                               unsigned int tableSize)
+{
+    if (set->powerOfTwo) {
+        return hash & (tableSize - 1);
+    }
+
+    return hash % tableSize;
+}
+
+/* Find the size of the table for a size index, or zero if the table
+ * can not grow that large.  Past the last prime the table has one
+ * more size, the largest prime which fits in an unsigned int. */
+
+static unsigned int set_sizeAt(Set *set, unsigned int sizeIndex)
+{
+    if (set->powerOfTwo) {
+        if (sizeIndex > SET_MAX_POWER_OF_TWO_INDEX) {
+            return 0;
+        }
+
+        return SET_POWER_OF_TWO_MIN_SIZE << sizeIndex;
+    }
+
+    if (sizeIndex < SET_NUM_PRIMES) {
+        return SET_PRIMES[sizeIndex];
+    } else if (sizeIndex == SET_NUM_PRIMES) {
+        return 4294967291U;
+    }
+
+    return 0;
+}
+
+#ifdef SET_STATS
+
+static void set_countSearch(Set *set, unsigned int probes)
+{
+    ++set->searches;
+    set->searchProbes += probes;
+
+    if (probes > set->maxSearchProbes) {
+        set->maxSearchProbes = probes;
+    }
+}
+
+static void set_countResize(Set *set, clock_t start)
+{
+    ++set->resizes;
+    set->resizeTime += clock() - start;
+}
+
+#endif
+
 static int set_allocateTable(Set *set)
 {
-	/* Determine the table size based on the current prime index.
-	 * An attempt is made here to ensure sensible behavior if the
-	 * maximum prime is exceeded, but in practice other things are
-	 * likely to break long before that happens. */
+	/* Determine the table size based on the current size index */
 
-    if (set->primeIndex < SET_NUM_PRIMES) {
-        set->tableSize = SET_PRIMES[set->primeIndex];
-	} else {
-        set->tableSize = set->entries * 10;
-	}
+    set->tableSize = set_sizeAt(set, set->sizeIndex);
 
 	/* Allocate the table and initialise to NULL */
 
-    set->table = calloc(set->tableSize, sizeof(SetEntry *));
+    set->table = allocator_calloc(&set->usage, set->tableSize,
+                                  sizeof(SetEntry *));
 
 	return set->table != NULL;
 }
 
+static void set_freeTable(Set *set, SetEntry **table, unsigned int tableSize)
+{
+    allocator_free(&set->usage, table, tableSize * sizeof(SetEntry *));
+}
+
 static void set_freeEntry(Set *set, SetEntry *entry)
 {
 	/* If there is a free function registered, call it to free the
@@ -65,28 +179,67 @@ static void set_freeEntry(Set *set, SetEntry *entry)
 
 	/* Free the entry structure */
 
-	free(entry);
+    if (set->slab != NULL) {
+        slab_release(set->slab, entry);
+    } else {
+        allocator_free(&set->usage, entry, sizeof(SetEntry));
+    }
+}
+
+/* During an incremental resize, the chains of the old table come
+ * before those of the current table */
+
+static SetEntry *set_chainAt(Set *set, unsigned int chain)
+{
+    if (chain < set->oldTableSize) {
+        return set->oldTable[chain];
+    } else {
+        return set->table[chain - set->oldTableSize];
+    }
 }
 
 Set *set_new(SetHashFunc hashFunc, SetEqualFunc equalFunc)
 {
+    return set_newWithAllocator(hashFunc, equalFunc, NULL);
+}
+
+Set *set_newWithAllocator(SetHashFunc hashFunc,
+                          SetEqualFunc equalFunc,
+                          const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
+    allocator_initUsage(&usage, allocator);
+
 	/* Allocate a new set and fill in the fields */
 
-    Set *newSet = (Set *) malloc(sizeof(Set));
+    Set *newSet = (Set *) allocator_malloc(&usage, sizeof(Set));
     if (newSet == NULL) {
 		return NULL;
 	}
 
+    newSet->usage = usage;
+
     newSet->hashFunc = hashFunc;
     newSet->equalFunc = equalFunc;
     newSet->entries = 0;
-    newSet->primeIndex = 0;
+    newSet->sizeIndex = 0;
+    newSet->reserved = 0;
+    newSet->powerOfTwo = 0;
     newSet->freeFunc = NULL;
+    newSet->incrementalResize = 0;
+    newSet->oldTable = NULL;
+    newSet->oldTableSize = 0;
+    newSet->rehashIndex = 0;
+    newSet->slab = NULL;
+#ifdef SET_STATS
+    set_resetStats(newSet);
+#endif
 
 	/* Allocate the table */
 
     if (!set_allocateTable(newSet)) {
-        free(newSet);
+        allocator_free(&newSet->usage, newSet, sizeof(Set));
 		return NULL;
 	}
 
@@ -99,31 +252,43 @@ void set_free(Set *set)
 	SetEntry *next;
 	unsigned int i;
 
-	/* Free all entries in all chains */
+	/* Free all entries in all chains, including those still in the
+	 * old table during an incremental resize.  Entries allocated from
+	 * a slab are freed along with it, so unless there is a free
+	 * function to call the chains need not be walked. */
 
-    for (i=0; i<set->tableSize; ++i) {
-		rover = set->table[i];
+    if (set->slab == NULL || set->freeFunc != NULL) {
+        for (i=0; i<set->oldTableSize + set->tableSize; ++i) {
+            rover = set_chainAt(set, i);
 
-		while (rover != NULL) {
-			next = rover->next;
+            while (rover != NULL) {
+                next = rover->next;
 
-			/* Free this entry */
+                /* Free this entry */
 
-            set_freeEntry(set, rover);
+                set_freeEntry(set, rover);
 
-			/* Advance to the next entry in the chain */
+                /* Advance to the next entry in the chain */
 
-			rover = next;
-		}
-	}
+                rover = next;
+            }
+        }
+    }
 
-	/* Free the table */
+    if (set->slab != NULL) {
+        slab_free(set->slab);
+    }
 
-	free(set->table);
+	/* Free the tables */
+
+    set_freeTable(set, set->oldTable, set->oldTableSize);
+    set_freeTable(set, set->table, set->tableSize);
 
 	/* Free the set structure */
 
-	free(set);
+    AllocatorUsage usage = set->usage;
+
+    allocator_free(&usage, set, sizeof(Set));
 }
 
 void set_registerFreeFunction(Set *set, SetFreeFunc freeFunc)
@@ -131,73 +296,318 @@ void set_registerFreeFunction(Set *set, SetFreeFunc freeFunc)
     set->freeFunc = freeFunc;
 }
 
-static int set_enlarge(Set *set)
+void set_setIncrementalResize(Set *set, int enabled)
+{
+    set->incrementalResize = enabled;
+}
+
+int set_useSlab(Set *set)
+{
+    if (set->slab != NULL) {
+        return 1;
+    }
+
+    if (set->entries != 0) {
+        return 0;
+    }
+
+    set->slab = slab_newWithAllocator(sizeof(SetEntry), set->usage.allocator);
+
+    return set->slab != NULL;
+}
+
+/* Link every entry of a chain into the current table */
+
+static void set_moveChain(Set *set, SetEntry *rover)
+{
+    SetEntry *next;
+    unsigned int index;
+
+	while (rover != NULL) {
+
+		next = rover->next;
+
+		/* Hook this entry into the new table */
+
+        index = set_bucket(set, set_hash(set, rover->data), set->tableSize);
+		rover->next = set->table[index];
+		set->table[index] = rover;
+
+		/* Advance to the next entry in the chain */
+
+		rover = next;
+	}
+}
+
+/* Migrate chains from the old table while an incremental resize is in
+ * progress, doing a bounded amount of work per call */
+
+static void set_rehashStep(Set *set, unsigned int maxChains)
+{
+    unsigned int maxVisits = maxChains * 10;
+    SetEntry *rover;
+
+    while (set->oldTable != NULL && maxChains > 0 && maxVisits > 0) {
+        rover = set->oldTable[set->rehashIndex];
+
+        if (rover != NULL) {
+            set->oldTable[set->rehashIndex] = NULL;
+            set_moveChain(set, rover);
+            --maxChains;
+        }
+
+        --maxVisits;
+        ++set->rehashIndex;
+
+		/* All chains migrated: the old table can go */
+
+        if (set->rehashIndex >= set->oldTableSize) {
+            set_freeTable(set, set->oldTable, set->oldTableSize);
+            set->oldTable = NULL;
+            set->oldTableSize = 0;
+            set->rehashIndex = 0;
+        }
+    }
+}
+
+/* Move the values of the set to a table of another size */
+
+static int set_resize(Set *set, unsigned int sizeIndex)
 {
+	/* Finish any previous incremental resize first */
+
+    while (set->oldTable != NULL) {
+        set_rehashStep(set, set->oldTableSize);
+    }
+
+    if (sizeIndex == set->sizeIndex) {
+        return 1;
+    }
+
 	/* Store the old table */
 
     SetEntry **oldTable = set->table;
     unsigned int oldTableSize = set->tableSize;
-    unsigned int oldPrimeIndex = set->primeIndex;
-
-	/* Use the next table size from the prime number array */
-
-    ++set->primeIndex;
+    unsigned int oldSizeIndex = set->sizeIndex;
+#ifdef SET_STATS
+    clock_t resizeStart = clock();
+#endif
 
 	/* Allocate the new table */
 
+    set->sizeIndex = sizeIndex;
+
     if (!set_allocateTable(set)) {
         set->table = oldTable;
         set->tableSize = oldTableSize;
-        set->primeIndex = oldPrimeIndex;
+        set->sizeIndex = oldSizeIndex;
 
 		return 0;
 	}
 
-	/* Iterate through all entries in the old table and add them
-	 * to the new one */
+	/* In incremental mode, the old table is migrated a few chains at
+	 * a time by subsequent operations */
 
-    SetEntry *rover;
-    SetEntry *next;
-    unsigned int index;
     unsigned int i;
 
-    for (i=0; i<oldTableSize; ++i) {
+    if (set->incrementalResize) {
+        set->oldTable = oldTable;
+        set->oldTableSize = oldTableSize;
+        set->rehashIndex = 0;
+    } else {
 
-		/* Walk along this chain */
+		/* Iterate through all entries in the old table and add them
+		 * to the new one */
 
-        rover = oldTable[i];
+        for (i=0; i<oldTableSize; ++i) {
+            set_moveChain(set, oldTable[i]);
+        }
 
-		while (rover != NULL) {
+		/* Free back the old table */
 
-			next = rover->next;
+        set_freeTable(set, oldTable, oldTableSize);
+    }
 
-			/* Hook this entry into the new table */
+#ifdef SET_STATS
+    set_countResize(set, resizeStart);
+#endif
 
-            index = set->hashFunc(rover->data) % set->tableSize;
-			rover->next = set->table[index];
-			set->table[index] = rover;
+	/* Resized successfully */
 
-			/* Advance to the next entry in the chain */
+	return 1;
+}
+
+static int set_enlarge(Set *set)
+{
+	/* A table which is as large as it can be stays as it is */
+
+    if (set_sizeAt(set, set->sizeIndex + 1) == 0) {
+        return 1;
+    }
+
+    return set_resize(set, set->sizeIndex + 1);
+}
+
+/* Find the size index of the smallest table which can hold a number of
+ * values without being enlarged, or of the largest table if none can */
+
+static unsigned int set_sizeIndexFor(Set *set, uint64_t entries)
+{
+    unsigned int sizeIndex = 0;
+
+    while (entries * 3 >= set_sizeAt(set, sizeIndex)
+        && set_sizeAt(set, sizeIndex + 1) != 0) {
+        ++sizeIndex;
+    }
+
+    return sizeIndex;
+}
 
-			rover = next;
+int set_reserve(Set *set, unsigned int n)
+{
+    unsigned int sizeIndex = set_sizeIndexFor(set, n);
+
+	/* The new table is filled in one go, even in incremental mode */
+
+    if (sizeIndex > set->sizeIndex) {
+        if (!set_resize(set, sizeIndex)) {
+            return 0;
+        }
+
+        while (set->oldTable != NULL) {
+            set_rehashStep(set, set->oldTableSize);
+        }
+    }
+
+    set->reserved = n;
+
+    return 1;
+}
+
+int set_compact(Set *set)
+{
+    unsigned int sizeIndex = set_sizeIndexFor(set, set->entries);
+
+    set->reserved = 0;
+
+    if (sizeIndex < set->sizeIndex && !set_resize(set, sizeIndex)) {
+        return 0;
+    }
+
+    while (set->oldTable != NULL) {
+        set_rehashStep(set, set->oldTableSize);
+    }
+
+    return 1;
+}
+
+/* Halve a table which removes have left mostly empty, unless it was
+ * reserved at this size.  This is called by set_insert rather than by
+ * set_remove, so that values can be removed while iterating over the
+ * set.  If memory runs out the table just stays as it is. */
+
+static void set_shrink(Set *set)
+{
+    if (set->sizeIndex > 0
+     && set->entries < set->tableSize / SET_SHRINK_LOAD
+     && set_sizeIndexFor(set, set->reserved) < set->sizeIndex) {
+        set_resize(set, set->sizeIndex - 1);
+    }
+}
+
+int set_setPowerOfTwoSize(Set *set, int enabled)
+{
+    SetEntry **oldTable = set->table;
+    unsigned int oldTableSize = set->tableSize;
+    unsigned int oldSizeIndex = set->sizeIndex;
+    int oldPowerOfTwo = set->powerOfTwo;
+
+    if (set->entries != 0) {
+        return 0;
+    }
+
+    enabled = enabled != 0;
+
+    if (enabled == set->powerOfTwo) {
+        return 1;
+    }
+
+	/* The set is empty, so the table is simply replaced by the first
+	 * table of the new mode, after any (empty) old table */
+
+    while (set->oldTable != NULL) {
+        set_rehashStep(set, set->oldTableSize);
+    }
+
+    set->powerOfTwo = enabled;
+    set->sizeIndex = set_sizeIndexFor(set, set->reserved);
+
+    if (!set_allocateTable(set)) {
+        set->table = oldTable;
+        set->tableSize = oldTableSize;
+        set->sizeIndex = oldSizeIndex;
+        set->powerOfTwo = oldPowerOfTwo;
+
+        return 0;
+    }
+
+    set_freeTable(set, oldTable, oldTableSize);
+
+    return 1;
+}
+
+/* Find the link which points at the entry for a value, or NULL if the
+ * value is not in the set.  Both tables are searched while an
+ * incremental resize is in progress. */
+
+static SetEntry **set_findLink(Set *set, SetValue data, unsigned int hash)
+{
+    SetEntry **rover = &set->table[set_bucket(set, hash, set->tableSize)];
+    unsigned int probes = 0;
+
+	while (*rover != NULL) {
+        ++probes;
+
+        if (set->equalFunc(data, (*rover)->data) != 0) {
+            SET_COUNT_SEARCH(set, probes);
+            return rover;
 		}
+
+		rover = &((*rover)->next);
 	}
 
-	/* Free back the old table */
+    if (set->oldTable == NULL) {
+        SET_COUNT_SEARCH(set, probes);
+        return NULL;
+    }
 
-    free(oldTable);
+    rover = &set->oldTable[set_bucket(set, hash, set->oldTableSize)];
 
-	/* Resized successfully */
+	while (*rover != NULL) {
+        ++probes;
 
-	return 1;
+        if (set->equalFunc(data, (*rover)->data) != 0) {
+            SET_COUNT_SEARCH(set, probes);
+            return rover;
+		}
+
+		rover = &((*rover)->next);
+	}
+
+    SET_COUNT_SEARCH(set, probes);
+
+    return NULL;
 }
 
 int set_insert(Set *set, SetValue data)
 {
+    set_shrink(set);
+    set_rehashStep(set, SET_REHASH_CHAINS);
+
 	/* The hash table becomes less efficient as the number of entries
 	 * increases. Check if the percentage used becomes large. */
 
-    if ((set->entries * 3) / set->tableSize > 0) {
+    if ((uint64_t) set->entries * 3 >= set->tableSize) {
 
 		/* The table is more than 1/3 full and must be increased
 		 * in size */
@@ -207,33 +617,30 @@ int set_insert(Set *set, SetValue data)
 		}
 	}
 
-	/* Use the hash of the data to determine an index to insert into the
-	 * table at. */
-
-    unsigned int index = set->hashFunc(data) % set->tableSize;
+	/* Use the hash of the data to determine if this data has already
+	 * been added to the table */
 
-	/* Walk along this chain and attempt to determine if this data has
-	 * already been added to the table */
+    unsigned int hash = set_hash(set, data);
 
-    SetEntry *rover = set->table[index];
+    if (set_findLink(set, data, hash) != NULL) {
 
-	while (rover != NULL) {
+		/* This data is already in the set */
 
-        if (set->equalFunc(data, rover->data) != 0) {
-
-			/* This data is already in the set */
-
-			return 0;
-		}
-
-		rover = rover->next;
+		return 0;
 	}
 
 	/* Not in the set.  We must add a new entry. */
 
 	/* Make a new entry for this data */
 
-    SetEntry *newEntry = (SetEntry *) malloc(sizeof(SetEntry));
+    SetEntry *newEntry;
+
+    if (set->slab != NULL) {
+        newEntry = (SetEntry *) slab_allocate(set->slab);
+    } else {
+        newEntry = (SetEntry *) allocator_malloc(&set->usage,
+                                                 sizeof(SetEntry));
+    }
 
     if (newEntry == NULL) {
 		return 0;
@@ -243,6 +650,8 @@ int set_insert(Set *set, SetValue data)
 
 	/* Link into chain */
 
+    unsigned int index = set_bucket(set, hash, set->tableSize);
+
     newEntry->next = set->table[index];
     set->table[index] = newEntry;
 
@@ -257,73 +666,42 @@ int set_insert(Set *set, SetValue data)
 
 int set_remove(Set *set, SetValue data)
 {
-	/* Look up the data by its hash key */
-
-    unsigned int index = set->hashFunc(data) % set->tableSize;
-
-	/* Search this chain, until the corresponding entry is found */
-
-    SetEntry **rover = &set->table[index];
-    SetEntry *entry;
-
-	while (*rover != NULL) {
-        if (set->equalFunc(data, (*rover)->data) != 0) {
+    set_rehashStep(set, SET_REHASH_CHAINS);
 
-			/* Found the entry */
+	/* Look up the data by its hash key */
 
-			entry = *rover;
+    SetEntry **link = set_findLink(set, data, set_hash(set, data));
 
-			/* Unlink from the linked list */
+    if (link == NULL) {
 
-			*rover = entry->next;
+		/* Not found in set */
 
-			/* Update counter */
+        return 0;
+    }
 
-			--set->entries;
+	/* Unlink from the linked list */
 
-			/* Free the entry and return */
+    SetEntry *entry = *link;
+    *link = entry->next;
 
-            set_freeEntry(set, entry);
+	/* Update counter */
 
-			return 1;
-		}
+	--set->entries;
 
-		/* Advance to the next entry */
+	/* Free the entry */
 
-		rover = &((*rover)->next);
-	}
+    set_freeEntry(set, entry);
 
-	/* Not found in set */
-
-	return 0;
+	return 1;
 }
 
 int set_query(Set *set, SetValue data)
 {
-	/* Look up the data by its hash key */
+    set_rehashStep(set, SET_REHASH_CHAINS);
 
-    unsigned int index = set->hashFunc(data) % set->tableSize;
-
-	/* Search this chain, until the corresponding entry is found */
-
-    SetEntry *rover = set->table[index];
-
-	while (rover != NULL) {
-        if (set->equalFunc(data, rover->data) != 0) {
-
-			/* Found the entry */
-
-			return 1;
-		}
-
-		/* Advance to the next entry in the chain */
-
-		rover = rover->next;
-	}
-
-	/* Not found */
+	/* Look up the data by its hash key */
 
-	return 0;
+    return set_findLink(set, data, set_hash(set, data)) != NULL;
 }
 
 unsigned int set_numEntries(Set *set)
@@ -331,6 +709,17 @@ unsigned int set_numEntries(Set *set)
 	return set->entries;
 }
 
+size_t set_memoryUsage(Set *set)
+{
+    size_t result = set->usage.bytesUsed;
+
+    if (set->slab != NULL) {
+        result += slab_memoryUsage(set->slab);
+    }
+
+    return result;
+}
+
 SetValue *set_toArray(Set *set)
 {
 	/* Create an array to hold the set entries */
@@ -348,9 +737,9 @@ SetValue *set_toArray(Set *set)
     SetEntry *rover;
     unsigned int i;
 
-    for (i=0; i<set->tableSize; ++i) {
+    for (i=0; i<set->oldTableSize + set->tableSize; ++i) {
 
-		rover = set->table[i];
+        rover = set_chainAt(set, i);
 
 		while (rover != NULL) {
 
@@ -370,7 +759,8 @@ SetValue *set_toArray(Set *set)
 
 Set *set_union(Set *set1, Set *set2)
 {
-    Set *newSet = set_new(set1->hashFunc, set1->equalFunc);
+    Set *newSet = set_newWithAllocator(set1->hashFunc, set1->equalFunc,
+                                       set1->usage.allocator);
     if (newSet == NULL) {
 		return NULL;
 	}
@@ -428,7 +818,8 @@ Set *set_union(Set *set1, Set *set2)
 
 Set *set_intersection(Set *set1, Set *set2)
 {
-    Set *newSet = set_new(set1->hashFunc, set2->equalFunc);
+    Set *newSet = set_newWithAllocator(set1->hashFunc, set2->equalFunc,
+                                       set1->usage.allocator);
     if (newSet == NULL) {
 		return NULL;
 	}
@@ -473,12 +864,12 @@ void set_iterate(Set *set, SetIterator *iterator)
 	/* Find the first entry */
 
     unsigned int chain;
-    for (chain = 0; chain < set->tableSize; ++chain) {
+    for (chain = 0; chain < set->oldTableSize + set->tableSize; ++chain) {
 
 		/* There is a value at the start of this chain */
 
-		if (set->table[chain] != NULL) {
-            iterator->nextEntry = set->table[chain];
+        if (set_chainAt(set, chain) != NULL) {
+            iterator->nextEntry = set_chainAt(set, chain);
 			break;
 		}
 	}
@@ -521,15 +912,15 @@ SetValue set_iteratorNext(SetIterator *iterator)
 
 		chain = iterator->nextChain + 1;
 
-        while (chain < set->tableSize) {
+        while (chain < set->oldTableSize + set->tableSize) {
 
 			/* Is there a chain at this table entry? */
 
-			if (set->table[chain] != NULL) {
+            if (set_chainAt(set, chain) != NULL) {
 
 				/* Valid chain found! */
 
-				iterator->nextEntry = set->table[chain];
+                iterator->nextEntry = set_chainAt(set, chain);
 
 				break;
 			}
@@ -550,3 +941,64 @@ int set_iteratorHasMore(SetIterator *iterator)
 	return iterator->nextEntry != NULL;
 }
 
+void set_stats(Set *set, SetStats *stats)
+{
+    SetEntry *rover;
+    unsigned int numChains = set->oldTableSize + set->tableSize;
+    unsigned int length;
+    unsigned int i;
+
+    memset(stats, 0, sizeof(SetStats));
+
+    stats->entries = set->entries;
+    stats->buckets = numChains;
+    stats->bytesUsed = set_memoryUsage(set);
+
+    for (i=0; i<numChains; ++i) {
+        length = 0;
+
+        for (rover=set_chainAt(set, i); rover != NULL; rover=rover->next) {
+            ++length;
+        }
+
+        if (length > stats->maxChainLength) {
+            stats->maxChainLength = length;
+        }
+
+        if (length >= SET_STATS_HISTOGRAM_SIZE) {
+            length = SET_STATS_HISTOGRAM_SIZE - 1;
+        }
+
+        ++stats->chainLengths[length];
+    }
+
+    if (numChains > 0) {
+        stats->loadFactor = (double) stats->entries / numChains;
+    }
+
+#ifdef SET_STATS
+    stats->countsEnabled = 1;
+    stats->lookups = set->searches;
+    stats->maxLookupProbes = set->maxSearchProbes;
+    stats->resizes = set->resizes;
+    stats->resizeSeconds = (double) set->resizeTime / CLOCKS_PER_SEC;
+
+    if (set->searches > 0) {
+        stats->averageLookupProbes = (double) set->searchProbes
+                                   / set->searches;
+    }
+#endif
+}
+
+void set_resetStats(Set *set)
+{
+#ifdef SET_STATS
+    set->searches = 0;
+    set->searchProbes = 0;
+    set->maxSearchProbes = 0;
+    set->resizes = 0;
+    set->resizeTime = 0;
+#else
+    (void) set;
+#endif
+}
@@ -27,6 +27,8 @@
 #ifndef DSSET_H
 #define DSSET_H
 
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -106,6 +108,23 @@ typedef void (*SetFreeFunc)(SetValue value);
 
 Set *set_new(SetHashFunc hashFunc, SetEqualFunc equalFunc);
 
+/**
+ * Create a new set which allocates its memory from a particular
+ * allocator.
+ *
+ * @param hashFunc      Hash function used on values in the set.
+ * @param equalFunc     Compares two values in the set to determine
+ *                      if they are equal.
+ * @param allocator     The allocator to use, or NULL to use the default
+ *                      allocator.
+ * @return              A new set, or NULL if it was not possible to
+ *                      allocate the memory for the set.
+ */
+
+Set *set_newWithAllocator(SetHashFunc hashFunc,
+                          SetEqualFunc equalFunc,
+                          const Allocator *allocator);
+
 /**
  * Destroy a set.
  *
@@ -126,7 +145,79 @@ void set_free(Set *set);
 void set_registerFreeFunction(Set *set, SetFreeFunc freeFunc);
 
 /**
- * Add a value to a set.
+ * Enable or disable incremental resizing.  When enabled, growing the
+ * set keeps the old table and each subsequent insert, remove or query
+ * moves a few of its chains to the new table, instead of moving every
+ * value at once.
+ *
+ * While a resize is in progress, any operation on the set (including
+ * @ref set_query) invalidates iterators.
+ *
+ * @param set           The set.
+ * @param enabled       Non-zero to enable incremental resizing, zero to
+ *                      disable it.
+ */
+
+void set_setIncrementalResize(Set *set, int enabled);
+
+/**
+ * Allocate the entries of a set from a @ref Slab owned by the set,
+ * instead of with malloc.  Adding and removing values becomes cheaper,
+ * and @ref set_free releases all entries at once.  This must be called
+ * while the set is empty.
+ *
+ * @param set           The set.
+ * @return              Non-zero on success, or zero if the set is not
+ *                      empty or the slab could not be allocated.
+ */
+
+int set_useSlab(Set *set);
+
+/**
+ * Enable or disable power of two table sizes.  The chain a value goes
+ * in is then chosen with a mask of the low bits of its hash, after the
+ * hash is mixed, instead of by dividing the hash by a prime table
+ * size.  This must be called while the set is empty.
+ *
+ * @param set           The set.
+ * @param enabled       Non-zero to use power of two sizes, zero to use
+ *                      prime sizes.
+ * @return              Non-zero on success, or zero if the set is not
+ *                      empty or the new table could not be allocated.
+ */
+
+int set_setPowerOfTwoSize(Set *set, int enabled);
+
+/**
+ * Make room in a set for a number of values, so that it is not resized
+ * while they are added.  The set is also not made smaller than this
+ * after values are removed, until @ref set_compact is called.
+ *
+ * @param set           The set.
+ * @param n             The number of values to make room for.
+ * @return              Non-zero on success, or zero if the larger table
+ *                      could not be allocated.
+ */
+
+int set_reserve(Set *set, unsigned int n);
+
+/**
+ * Make a set as small as it can be for the values it holds, freeing
+ * memory after many values have been removed.  Any size reserved with
+ * @ref set_reserve is forgotten.
+ *
+ * @param set           The set.
+ * @return              Non-zero on success, or zero if the smaller table
+ *                      could not be allocated, in which case the set is
+ *                      unchanged.
+ */
+
+int set_compact(Set *set);
+
+/**
+ * Add a value to a set.  A set which removes have left mostly empty is
+ * first made smaller, though not smaller than the size reserved with
+ * @ref set_reserve.
  *
  * @param set           The set.
  * @param data          The value to add to the set.
@@ -139,7 +230,11 @@ void set_registerFreeFunction(Set *set, SetFreeFunc freeFunc);
 int set_insert(Set *set, SetValue data);
 
 /**
- * Remove a value from a set.
+ * Remove a value from a set.  The set is never resized by a remove, so
+ * the value most recently returned by a @ref SetIterator may be
+ * removed without invalidating the iterator, unless an incremental
+ * resize is in progress.  Removing any other value, or adding one,
+ * invalidates iterators.
  *
  * @param set           The set.
  * @param data          The value to remove from the set.
@@ -170,6 +265,97 @@ int set_query(Set *set, SetValue data);
 
 unsigned int set_numEntries(Set *set);
 
+/**
+ * Retrieve the number of bytes of memory allocated by a set.  This does
+ * not include memory used by the values themselves.
+ *
+ * @param set           The set.
+ * @return              The number of bytes allocated.
+ */
+
+size_t set_memoryUsage(Set *set);
+
+/**
+ * Number of entries in the chain length histogram of @ref SetStats.
+ */
+
+#define SET_STATS_HISTOGRAM_SIZE 16
+
+/**
+ * Statistics about a set, filled in by @ref set_stats.
+ *
+ * The shape of the table is always reported.  The counts of searches
+ * and resizes are only kept if the library is built with SET_STATS
+ * defined; otherwise they are zero.
+ */
+
+typedef struct _SetStats {
+
+	/** Number of values in the set. */
+
+    unsigned int entries;
+
+	/** Number of chains, including those of the old table during an
+	 *  incremental resize. */
+
+    unsigned int buckets;
+
+	/** Values per chain. */
+
+    double loadFactor;
+
+	/** Bytes of memory allocated, as @ref set_memoryUsage. */
+
+    size_t bytesUsed;
+
+	/** Number of chains of each length, starting from empty chains.
+	 *  The last element also counts all longer chains. */
+
+    unsigned long chainLengths[SET_STATS_HISTOGRAM_SIZE];
+
+	/** The longest chain. */
+
+    unsigned int maxChainLength;
+
+	/** Non-zero if the counts below are being kept. */
+
+    int countsEnabled;
+
+	/** Number of searches for a value, made by queries, inserts and
+	 *  removes. */
+
+    unsigned long lookups;
+
+	/** Average and largest number of values compared by a search. */
+
+    double averageLookupProbes;
+    unsigned int maxLookupProbes;
+
+	/** Number of times the table was resized, and the processor time
+	 *  spent doing it. */
+
+    unsigned long resizes;
+    double resizeSeconds;
+} SetStats;
+
+/**
+ * Retrieve statistics about a set.  This walks the whole table, so
+ * takes time proportional to its size.
+ *
+ * @param set           The set.
+ * @param stats         Structure to fill in.
+ */
+
+void set_stats(Set *set, SetStats *stats);
+
+/**
+ * Reset the counts of searches and resizes kept for a set.
+ *
+ * @param set           The set.
+ */
+
+void set_resetStats(Set *set);
+
 /**
  * Create an array containing all entries in a set.
  *
@@ -182,7 +368,8 @@ unsigned int set_numEntries(Set *set);
 SetValue *set_toArray(Set *set);
 
 /**
- * Perform a union of two sets.
+ * Perform a union of two sets.  The new set uses the allocator of the
+ * first set.
  *
  * @param set1             The first set.
  * @param set2             The second set.
@@ -194,7 +381,8 @@ SetValue *set_toArray(Set *set);
 Set *set_union(Set *set1, Set *set2);
 
 /**
- * Perform an intersection of two sets.
+ * Perform an intersection of two sets.  The new set uses the allocator
+ * of the first set.
  *
  * @param set1             The first set.
  * @param set2             The second set.
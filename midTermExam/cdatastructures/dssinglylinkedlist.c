@@ -1,6 +1,7 @@
 #include <stdlib.h>
 
 #include "dssinglylinkedlist.h"
+#include "dsslab.h"
 
 
 /* A singly-linked list */
@@ -10,6 +11,29 @@ struct _SListEntry {
     SListEntry *next;
 };
 
+/* Entries are allocated from the slab if one is given, otherwise from
+ * the default allocator.  A list has no structure of its own to record
+ * an allocator in. */
+
+static SListEntry *slist_allocateEntry(Slab *slab)
+{
+    const Allocator *allocator = allocator_default();
+
+    if (slab != NULL) {
+        return (SListEntry *) slab_allocate(slab);
+    }
+
+    return (SListEntry *) allocator->allocate(allocator->context,
+                                              sizeof(SListEntry));
+}
+
+static void slist_freeEntry(SListEntry *entry)
+{
+    const Allocator *allocator = allocator_default();
+
+    allocator->release(allocator->context, entry, sizeof(SListEntry));
+}
+
 void slist_free(SListEntry *list)
 {
 	/* Iterate over each entry, freeing each list entry, until the
@@ -22,17 +46,30 @@ void slist_free(SListEntry *list)
 
 		next = entry->next;
 
-		free(entry);
+        slist_freeEntry(entry);
 
 		entry = next;
 	}
 }
 
-SListEntry *slist_prepend(SListEntry **list, SListValue data)
+Slab *slist_newSlab(void)
+{
+    return slab_new(sizeof(SListEntry));
+}
+
+Slab *slist_newSlabWithAllocator(const Allocator *allocator)
+{
+    return slab_newWithAllocator(sizeof(SListEntry), allocator);
+}
+
+
+static SListEntry *slist_prependInternal(SListEntry **list,
+                                         SListValue data,
+                                         Slab *slab)
 {
 	/* Create new entry */
 
-    SListEntry *newEntry = malloc(sizeof(SListEntry));
+    SListEntry *newEntry = slist_allocateEntry(slab);
 
     if (newEntry == NULL) {
 		return NULL;
@@ -48,11 +85,25 @@ SListEntry *slist_prepend(SListEntry **list, SListValue data)
     return newEntry;
 }
 
-SListEntry *slist_append(SListEntry **list, SListValue data)
+SListEntry *slist_prepend(SListEntry **list, SListValue data)
+{
+    return slist_prependInternal(list, data, NULL);
+}
+
+SListEntry *slist_prependWithSlab(SListEntry **list,
+                                  SListValue data,
+                                  Slab *slab)
+{
+    return slist_prependInternal(list, data, slab);
+}
+
+static SListEntry *slist_appendInternal(SListEntry **list,
+                                        SListValue data,
+                                        Slab *slab)
 {
 	/* Create new list entry */
 
-    SListEntry *newEntry = malloc(sizeof(SListEntry));
+    SListEntry *newEntry = slist_allocateEntry(slab);
 
     if (newEntry == NULL) {
 		return NULL;
@@ -84,6 +135,18 @@ SListEntry *slist_append(SListEntry **list, SListValue data)
     return newEntry;
 }
 
+SListEntry *slist_append(SListEntry **list, SListValue data)
+{
+    return slist_appendInternal(list, data, NULL);
+}
+
+SListEntry *slist_appendWithSlab(SListEntry **list,
+                                 SListValue data,
+                                 Slab *slab)
+{
+    return slist_appendInternal(list, data, slab);
+}
+
 SListValue slist_data(SListEntry *listentry)
 {
 	return listentry->data;
@@ -183,7 +246,9 @@ SListValue *slist_toArray(SListEntry *list)
 	return array;
 }
 
-int slist_removeEntry(SListEntry **list, SListEntry *entry)
+static int slist_removeEntryInternal(SListEntry **list,
+                                     SListEntry *entry,
+                                     Slab *slab)
 {
 	/* If the list is empty, or entry is NULL, always fail */
 
@@ -228,13 +293,29 @@ int slist_removeEntry(SListEntry **list, SListEntry *entry)
 
 	/* Free the list entry */
 
-	free(entry);
+    if (slab != NULL) {
+        slab_release(slab, entry);
+    } else {
+        slist_freeEntry(entry);
+    }
 
 	/* Operation successful */
 
 	return 1;
 }
 
+int slist_removeEntry(SListEntry **list, SListEntry *entry)
+{
+    return slist_removeEntryInternal(list, entry, NULL);
+}
+
+int slist_removeEntryWithSlab(SListEntry **list,
+                              SListEntry *entry,
+                              Slab *slab)
+{
+    return slist_removeEntryInternal(list, entry, slab);
+}
+
 unsigned int slist_removeData(SListEntry **list,
                               SListEqualFunc callback,
                               SListValue data)
@@ -256,7 +337,7 @@ unsigned int slist_removeData(SListEntry **list,
 			/* Data found, so remove this entry and free */
 
 			next = (*rover)->next;
-			free(*rover);
+            slist_freeEntry(*rover);
 			*rover = next;
 
 			/* Count the number of entries removed */
@@ -448,7 +529,7 @@ void slist_iteratorRemove(SListIterator *iterator)
 		/* Remove the current entry */
 
         *iterator->prevNext = iterator->current->next;
-        free(iterator->current);
+        slist_freeEntry(iterator->current);
         iterator->current = NULL;
 	}
 }
@@ -17,6 +17,12 @@
  * To add a new value at the start of a list, use @ref slist_prepend.
  * To add a new value at the end of a list, use @ref slist_append.
  *
+ * Entries can also be allocated from a @ref Slab created with
+ * @ref slist_newSlab, using @ref slist_prependWithSlab and
+ * @ref slist_appendWithSlab.  Such entries may only be removed with
+ * @ref slist_removeEntryWithSlab, and the whole list is destroyed by
+ * destroying the slab with @ref slab_free instead of @ref slist_free.
+ *
  * To find the length of a list, use @ref slist_length.
  *
  * To access a value in a list by its index in the list, use
@@ -47,6 +53,8 @@
 #ifndef DSSINGLYLINKEDLIST_H
 #define DSSINGLYLINKEDLIST_H
 
+#include "dsslab.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -137,6 +145,58 @@ SListEntry *slist_prepend(SListEntry **list, SListValue data);
 
 SListEntry *slist_append(SListEntry **list, SListValue data);
 
+/**
+ * Create a slab suitable for allocating list entries.  Several lists
+ * may share the same slab.
+ *
+ * @return          A new slab, or NULL if it was not possible to allocate
+ *                  the memory.
+ */
+
+Slab *slist_newSlab(void);
+
+/**
+ * Create a slab suitable for allocating list entries, which takes its
+ * memory from a particular allocator.
+ *
+ * @param allocator  The allocator to use, or NULL to use the default
+ *                   allocator.
+ * @return           A new slab, or NULL if it was not possible to allocate
+ *                   the memory.
+ */
+
+Slab *slist_newSlabWithAllocator(const Allocator *allocator);
+
+/**
+ * Prepend a value to the start of a list, allocating the new entry from
+ * a slab.
+ *
+ * @param list      Pointer to the list to prepend to.
+ * @param data      The value to prepend.
+ * @param slab      Slab created with @ref slist_newSlab.
+ * @return          The new entry in the list, or NULL if it was not possible
+ *                  to allocate a new entry.
+ */
+
+SListEntry *slist_prependWithSlab(SListEntry **list,
+                                  SListValue data,
+                                  Slab *slab);
+
+/**
+ * Append a value to the end of a list, allocating the new entry from a
+ * slab.
+ *
+ * @param list      Pointer to the list to append to.
+ * @param data      The value to append.
+ * @param slab      Slab created with @ref slist_newSlab.
+ * @return          The new entry in the list, or NULL if it was not possible
+ *                  to allocate a new entry.
+ */
+
+SListEntry *slist_appendWithSlab(SListEntry **list,
+                                 SListValue data,
+                                 Slab *slab);
+
 /**
  * Retrieve the next entry in a list.
  *
@@ -217,6 +277,21 @@ SListValue *slist_toArray(SListEntry *list);
 
 int slist_removeEntry(SListEntry **list, SListEntry *entry);
 
+/**
+ * Remove an entry which was allocated from a slab from a list, and give
+ * it back to the slab.
+ *
+ * @param list       Pointer to the list.
+ * @param entry      The list entry to remove.
+ * @param slab       The slab the entry was allocated from.
+ * @return           If the entry is not found in the list, returns zero,
+ *                   else returns non-zero.
+ */
+
+int slist_removeEntryWithSlab(SListEntry **list,
+                              SListEntry *entry,
+                              Slab *slab);
+
 /**
  * Remove all occurrences of a particular value from a list.
  *
@@ -0,0 +1,164 @@
+/* Slab allocator for fixed-size objects */
+
+#include <stdlib.h>
+
+#include "dsslab.h"
+
+
+typedef struct _SlabChunk SlabChunk;
+
+/* Chunks are kept in a list so that they can all be freed at once.  The
+ * header is a union with a long double so that the objects following it
+ * are suitably aligned for any type. */
+
+struct _SlabChunk {
+    union {
+        SlabChunk *next;
+        long double align;
+    } header;
+};
+
+/* A released object holds a pointer to the next object on the free
+ * list in its first bytes */
+
+typedef struct _SlabFreeObject SlabFreeObject;
+
+struct _SlabFreeObject {
+    SlabFreeObject *next;
+};
+
+struct _Slab {
+    AllocatorUsage usage;
+    unsigned int objectSize;
+    unsigned int objectsPerChunk;
+    SlabChunk *chunks;
+    SlabFreeObject *freeList;
+    unsigned char *unused;
+    unsigned int numUnused;
+};
+
+/* Target chunk size.  Chunks always hold at least
+ * SLAB_MIN_OBJECTS_PER_CHUNK objects, however large they are. */
+
+#define SLAB_CHUNK_SIZE 65536
+#define SLAB_MIN_OBJECTS_PER_CHUNK 16
+
+/* Size in bytes of each chunk of a slab */
+
+static size_t slab_chunkSize(Slab *slab)
+{
+    return sizeof(SlabChunk)
+         + (size_t) slab->objectSize * slab->objectsPerChunk;
+}
+
+Slab *slab_new(unsigned int objectSize)
+{
+    return slab_newWithAllocator(objectSize, NULL);
+}
+
+Slab *slab_newWithAllocator(unsigned int objectSize,
+                            const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
+    allocator_initUsage(&usage, allocator);
+
+    Slab *slab = (Slab *) allocator_malloc(&usage, sizeof(Slab));
+
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    slab->usage = usage;
+
+    /* Objects must be able to hold a free list pointer, and are rounded
+     * up to keep every object in a chunk aligned */
+
+    if (objectSize < sizeof(SlabFreeObject)) {
+        objectSize = sizeof(SlabFreeObject);
+    }
+
+    objectSize = (objectSize + sizeof(SlabChunk) - 1)
+               / sizeof(SlabChunk) * sizeof(SlabChunk);
+
+    slab->objectSize = objectSize;
+    slab->objectsPerChunk = SLAB_CHUNK_SIZE / objectSize;
+
+    if (slab->objectsPerChunk < SLAB_MIN_OBJECTS_PER_CHUNK) {
+        slab->objectsPerChunk = SLAB_MIN_OBJECTS_PER_CHUNK;
+    }
+
+    slab->chunks = NULL;
+    slab->freeList = NULL;
+    slab->unused = NULL;
+    slab->numUnused = 0;
+
+    return slab;
+}
+
+void slab_free(Slab *slab)
+{
+    SlabChunk *chunk = slab->chunks;
+    SlabChunk *next;
+    size_t chunkSize = slab_chunkSize(slab);
+
+    while (chunk != NULL) {
+        next = chunk->header.next;
+        allocator_free(&slab->usage, chunk, chunkSize);
+        chunk = next;
+    }
+
+    AllocatorUsage usage = slab->usage;
+
+    allocator_free(&usage, slab, sizeof(Slab));
+}
+
+void *slab_allocate(Slab *slab)
+{
+    /* Reuse a released object if there is one */
+
+    if (slab->freeList != NULL) {
+        SlabFreeObject *object = slab->freeList;
+        slab->freeList = object->next;
+
+        return object;
+    }
+
+    /* Otherwise carve the next object from the newest chunk, allocating
+     * a new chunk when it is used up */
+
+    if (slab->numUnused == 0) {
+        SlabChunk *chunk = allocator_malloc(&slab->usage,
+                                            slab_chunkSize(slab));
+
+        if (chunk == NULL) {
+            return NULL;
+        }
+
+        chunk->header.next = slab->chunks;
+        slab->chunks = chunk;
+
+        slab->unused = (unsigned char *) (chunk + 1);
+        slab->numUnused = slab->objectsPerChunk;
+    }
+
+    void *result = slab->unused;
+
+    slab->unused += slab->objectSize;
+    --slab->numUnused;
+
+    return result;
+}
+
+void slab_release(Slab *slab, void *object)
+{
+    SlabFreeObject *freeObject = (SlabFreeObject *) object;
+
+    freeObject->next = slab->freeList;
+    slab->freeList = freeObject;
+}
+
+size_t slab_memoryUsage(Slab *slab)
+{
+    return slab->usage.bytesUsed;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file dsslab.h
+ *
+ * @brief Fixed-size object allocator.
+ *
+ * A slab hands out objects of a single size from large chunks of
+ * memory, instead of calling malloc and free for each object.  Released
+ * objects are kept on a free list and reused by later allocations.  All
+ * objects are returned to the system at once when the slab is
+ * destroyed, at a cost proportional to the number of chunks rather than
+ * the number of objects.
+ *
+ * The node-based containers can use a slab for their nodes: see
+ * @ref hashtable_useSlab, @ref set_useSlab, @ref queue_useSlab,
+ * @ref avltree_useSlab, @ref rbtree_useSlab and @ref trie_useSlab.
+ * Lists allocate from a slab owned by the caller, with
+ * @ref list_prependWithSlab and @ref slist_prependWithSlab and related
+ * functions.
+ *
+ * To create a slab, use @ref slab_new.  To destroy a slab and every
+ * object allocated from it, use @ref slab_free.
+ *
+ * To allocate an object, use @ref slab_allocate.  To give an object
+ * back to the slab, use @ref slab_release.
+ */
+
+#ifndef DSSLAB_H
+#define DSSLAB_H
+
+#include "dsallocator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A slab allocator.
+ */
+
+typedef struct _Slab Slab;
+
+/**
+ * Create a new slab.
+ *
+ * @param objectSize       Size in bytes of the objects allocated from the
+ *                         slab.
+ * @return                 A new slab, or NULL if it was not possible to
+ *                         allocate the memory.
+ */
+
+Slab *slab_new(unsigned int objectSize);
+
+/**
+ * Create a new slab which takes its chunks from a particular allocator.
+ *
+ * @param objectSize       Size in bytes of the objects allocated from the
+ *                         slab.
+ * @param allocator        The allocator to use, or NULL to use the
+ *                         default allocator.
+ * @return                 A new slab, or NULL if it was not possible to
+ *                         allocate the memory.
+ */
+
+Slab *slab_newWithAllocator(unsigned int objectSize,
+                            const Allocator *allocator);
+
+/**
+ * Destroy a slab.  All objects allocated from the slab are freed,
+ * whether or not they have been released.
+ *
+ * @param slab             The slab to destroy.
+ */
+
+void slab_free(Slab *slab);
+
+/**
+ * Allocate an object from a slab.  The contents of the object are
+ * undefined.
+ *
+ * @param slab             The slab.
+ * @return                 Pointer to the new object, or NULL if it was
+ *                         not possible to allocate a new chunk.
+ */
+
+void *slab_allocate(Slab *slab);
+
+/**
+ * Give an object back to the slab it was allocated from, so that it can
+ * be reused.
+ *
+ * @param slab             The slab.
+ * @param object           The object to release.
+ */
+
+void slab_release(Slab *slab, void *object);
+
+/**
+ * Retrieve the number of bytes of memory allocated by a slab, including
+ * objects which have been released but not yet reused.
+ *
+ * @param slab             The slab.
+ * @return                 The number of bytes allocated.
+ */
+
+size_t slab_memoryUsage(Slab *slab);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSSLAB_H */
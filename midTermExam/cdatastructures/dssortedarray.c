@@ -41,6 +41,11 @@ struct _SortedArray {
 	 * The callback use to determine the order of two values.
 	 */
     SortedArrayCompareFunc compareFunc;
+
+	/**
+	 * The allocator used, and the number of bytes allocated.
+	 */
+    AllocatorUsage usage;
 };
 
 /* Function for finding first index of range which equals data. An equal value
@@ -105,10 +110,25 @@ unsigned int sortedarray_length(SortedArray *array)
 	return array->length;
 }
 
+size_t sortedarray_memoryUsage(SortedArray *array)
+{
+    return array->usage.bytesUsed;
+}
+
 SortedArray *sortedarray_new(unsigned int length,
                              SortedArrayEqualFunc equalFunc,
                              SortedArrayCompareFunc compareFunc)
 {
+    return sortedarray_newWithAllocator(length, equalFunc, compareFunc, NULL);
+}
+
+SortedArray *sortedarray_newWithAllocator(unsigned int length,
+                                          SortedArrayEqualFunc equalFunc,
+                                          SortedArrayCompareFunc compareFunc,
+                                          const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
 	/* check input requirements */
     if (equalFunc == NULL || compareFunc == NULL) {
 		return NULL;
@@ -119,18 +139,22 @@ SortedArray *sortedarray_new(unsigned int length,
 		length = 16;
 	}
 
-	SortedArrayValue *array = malloc(sizeof(SortedArrayValue) * length);
+    allocator_initUsage(&usage, allocator);
+
+    SortedArrayValue *array = allocator_malloc(&usage,
+                                               sizeof(SortedArrayValue)
+                                               * length);
 
 	/* on failure, return null */
 	if (array == NULL) {
 		return NULL;
 	}
 
-	SortedArray *sortedarray = malloc(sizeof(SortedArray));    
+    SortedArray *sortedarray = allocator_malloc(&usage, sizeof(SortedArray));
 
 	/* check for failure */
 	if (sortedarray == NULL) {
-		free(array);
+        allocator_free(&usage, array, sizeof(SortedArrayValue) * length);
 		return NULL;
 	}
     
@@ -140,14 +164,18 @@ SortedArray *sortedarray_new(unsigned int length,
 	sortedarray->_alloced = length;
     sortedarray->equalFunc = equalFunc;
     sortedarray->compareFunc = compareFunc;
+    sortedarray->usage = usage;
 	return sortedarray;
 }
 
 void sortedarray_free(SortedArray *sortedarray)
 {
 	if (sortedarray != NULL) {
-		free(sortedarray->data);
-		free(sortedarray);
+        AllocatorUsage usage = sortedarray->usage;
+
+        allocator_free(&usage, sortedarray->data,
+                       sizeof(SortedArrayValue) * sortedarray->_alloced);
+        allocator_free(&usage, sortedarray, sizeof(SortedArray));
 	}
 }
 
@@ -216,7 +244,10 @@ int sortedarray_insert(SortedArray *sortedArray, SortedArrayValue data)
 		SortedArrayValue *data;
 
         newSize = sortedArray->_alloced * 2;
-        data = realloc(sortedArray->data, sizeof(SortedArrayValue) * newSize);
+        data = allocator_realloc(&sortedArray->usage, sortedArray->data,
+                                 sizeof(SortedArrayValue)
+                                 * sortedArray->_alloced,
+                                 sizeof(SortedArrayValue) * newSize);
 
 		if (data == NULL) {
 			return 0;
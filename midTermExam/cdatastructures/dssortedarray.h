@@ -22,6 +22,8 @@
 #ifndef DSSORTEDARRAY_H
 #define DSSORTEDARRAY_H
 
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -85,6 +87,14 @@ SortedArrayValue *sortedarray_get(SortedArray *array, unsigned int i);
  */
 unsigned int sortedarray_length(SortedArray *array);
 
+/**
+ * Retrieve the number of bytes of memory allocated by a SortedArray.
+ *
+ * @param array			The SortedArray.
+ * @return				The number of bytes allocated.
+ */
+size_t sortedarray_memoryUsage(SortedArray *array);
+
 /**
  * Allocate a new SortedArray for use.
  *
@@ -102,6 +112,27 @@ SortedArray *sortedarray_new(unsigned int length,
                              SortedArrayEqualFunc equalFunc,
                              SortedArrayCompareFunc compareFunc);
 
+/**
+ * Allocate a new SortedArray which takes its memory from a particular
+ * allocator.
+ *
+ * @param length        Indication to the amount of memory that should be
+ *                      allocated. If 0 is given, then a default is used.
+ * @param equalFunc     The function used to determine if two values in the
+ *                      SortedArray equal. This may not be NULL.
+ * @param compareFunc   The function used to determine the relative order of
+ *                      two values in the SortedArray. This may not be NULL.
+ * @param allocator     The allocator to use, or NULL to use the default
+ *                      allocator.
+ *
+ * @return              A new SortedArray or NULL if it was not possible to
+ *                      allocate one.
+ */
+SortedArray *sortedarray_newWithAllocator(unsigned int length,
+                                          SortedArrayEqualFunc equalFunc,
+                                          SortedArrayCompareFunc compareFunc,
+                                          const Allocator *allocator);
+
 /**
  * Frees a SortedArray from memory.
  *
@@ -0,0 +1,305 @@
+/* String interning
+ *
+ * The strings are copied into blocks allocated from the allocator, one
+ * after another, each followed by a zero.  An open-addressed index of
+ * the copies, probed linearly, finds the copy of a string.  Each slot
+ * of the index keeps the hash and length of its string, so that most
+ * slots holding other strings are passed over without reading them.
+ * The hash is seeded with a random seed chosen for each pool, so that
+ * strings from an untrusted source can not be chosen to collide. */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsstringpool.h"
+#include "dshash64.h"
+
+
+typedef struct _StringPoolBlock StringPoolBlock;
+typedef struct _StringPoolSlot StringPoolSlot;
+
+/* Blocks are kept in a list so that they can all be freed at once */
+
+struct _StringPoolBlock {
+    StringPoolBlock *next;
+    size_t size;
+};
+
+struct _StringPoolSlot {
+    const char *string;
+    size_t length;
+    uint64_t hash;
+};
+
+struct _StringPool {
+    AllocatorUsage usage;
+    StringPoolSlot *slots;
+    unsigned int numSlots;
+    unsigned int numStrings;
+    StringPoolBlock *blocks;
+    char *unused;
+    size_t numUnused;
+    uint64_t seed;
+};
+
+/* Size of each block of strings, not counting its header.  Strings
+ * longer than a quarter of this get a block of their own, so as not to
+ * waste the rest of the current block. */
+
+#define STRING_POOL_BLOCK_SIZE 65536
+
+/* Initial number of slots in the index.  Always a power of two.  The
+ * index is doubled in size when it becomes half full. */
+
+#define STRING_POOL_INITIAL_SLOTS 64
+
+StringPool *stringpool_new(void)
+{
+    return stringpool_newWithAllocator(NULL);
+}
+
+StringPool *stringpool_newWithAllocator(const Allocator *allocator)
+{
+    AllocatorUsage usage;
+    StringPool *pool;
+
+    allocator_initUsage(&usage, allocator);
+
+    pool = (StringPool *) allocator_malloc(&usage, sizeof(StringPool));
+
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->usage = usage;
+
+    pool->slots = (StringPoolSlot *) allocator_calloc(
+        &pool->usage, STRING_POOL_INITIAL_SLOTS, sizeof(StringPoolSlot));
+
+    if (pool->slots == NULL) {
+        allocator_free(&pool->usage, pool, sizeof(StringPool));
+
+        return NULL;
+    }
+
+    pool->numSlots = STRING_POOL_INITIAL_SLOTS;
+    pool->numStrings = 0;
+    pool->blocks = NULL;
+    pool->unused = NULL;
+    pool->numUnused = 0;
+    pool->seed = hash64_randomSeed();
+
+    return pool;
+}
+
+void stringpool_free(StringPool *pool)
+{
+    StringPoolBlock *block;
+    StringPoolBlock *next;
+
+    for (block=pool->blocks; block != NULL; block=next) {
+        next = block->next;
+        allocator_free(&pool->usage, block,
+                       sizeof(StringPoolBlock) + block->size);
+    }
+
+    allocator_free(&pool->usage, pool->slots,
+                   (size_t) pool->numSlots * sizeof(StringPoolSlot));
+
+    AllocatorUsage usage = pool->usage;
+
+    allocator_free(&usage, pool, sizeof(StringPool));
+}
+
+/* Find the slot holding a string, or the empty slot where it would go */
+
+static StringPoolSlot *stringpool_find(StringPool *pool, const char *data,
+                                       size_t length, uint64_t hash)
+{
+    unsigned int mask = pool->numSlots - 1;
+    unsigned int i = (unsigned int) hash & mask;
+    StringPoolSlot *slot;
+
+    for (;;) {
+        slot = &pool->slots[i];
+
+        if (slot->string == NULL) {
+            return slot;
+        }
+
+        if (slot->hash == hash && slot->length == length
+         && (length == 0 || memcmp(slot->string, data, length) == 0)) {
+            return slot;
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+/* Double the size of the index */
+
+static int stringpool_enlarge(StringPool *pool)
+{
+    StringPoolSlot *oldSlots = pool->slots;
+    unsigned int oldNumSlots = pool->numSlots;
+    StringPoolSlot *newSlots;
+    unsigned int i;
+
+    if (oldNumSlots > UINT_MAX / 2) {
+        return 0;
+    }
+
+    newSlots = (StringPoolSlot *) allocator_calloc(&pool->usage,
+                                                   (size_t) oldNumSlots * 2,
+                                                   sizeof(StringPoolSlot));
+
+    if (newSlots == NULL) {
+        return 0;
+    }
+
+    pool->slots = newSlots;
+    pool->numSlots = oldNumSlots * 2;
+
+    for (i=0; i<oldNumSlots; ++i) {
+        if (oldSlots[i].string != NULL) {
+            *stringpool_find(pool, oldSlots[i].string, oldSlots[i].length,
+                             oldSlots[i].hash) = oldSlots[i];
+        }
+    }
+
+    allocator_free(&pool->usage, oldSlots,
+                   (size_t) oldNumSlots * sizeof(StringPoolSlot));
+
+    return 1;
+}
+
+/* Take room for a string and its terminating zero from the current
+ * block, starting a new block if it does not fit */
+
+static char *stringpool_allocate(StringPool *pool, size_t size)
+{
+    StringPoolBlock *block;
+    char *result;
+
+    if (size > STRING_POOL_BLOCK_SIZE / 4) {
+
+		/* A block of its own, put behind the current block so that
+		 * what is left of that can still be used */
+
+        if (size > SIZE_MAX - sizeof(StringPoolBlock)) {
+            return NULL;
+        }
+
+        block = (StringPoolBlock *) allocator_malloc(
+            &pool->usage, sizeof(StringPoolBlock) + size);
+
+        if (block == NULL) {
+            return NULL;
+        }
+
+        block->size = size;
+
+        if (pool->blocks != NULL) {
+            block->next = pool->blocks->next;
+            pool->blocks->next = block;
+        } else {
+            block->next = NULL;
+            pool->blocks = block;
+        }
+
+        return (char *) (block + 1);
+    }
+
+    if (size > pool->numUnused) {
+        block = (StringPoolBlock *) allocator_malloc(
+            &pool->usage, sizeof(StringPoolBlock) + STRING_POOL_BLOCK_SIZE);
+
+        if (block == NULL) {
+            return NULL;
+        }
+
+        block->size = STRING_POOL_BLOCK_SIZE;
+        block->next = pool->blocks;
+        pool->blocks = block;
+        pool->unused = (char *) (block + 1);
+        pool->numUnused = STRING_POOL_BLOCK_SIZE;
+    }
+
+    result = pool->unused;
+    pool->unused += size;
+    pool->numUnused -= size;
+
+    return result;
+}
+
+const char *stringpool_intern(StringPool *pool, const char *string)
+{
+    return stringpool_internLength(pool, string, strlen(string));
+}
+
+const char *stringpool_internLength(StringPool *pool, const char *data,
+                                    size_t length)
+{
+    uint64_t hash = hash64_bytes(data, length, pool->seed);
+    StringPoolSlot *slot = stringpool_find(pool, data, length, hash);
+    char *copy;
+
+    if (slot->string != NULL) {
+        return slot->string;
+    }
+
+	/* Keep the index at most half full, so that probe sequences stay
+	 * short */
+
+    if ((pool->numStrings + 1) * 2 > pool->numSlots) {
+        if (!stringpool_enlarge(pool)) {
+            return NULL;
+        }
+
+        slot = stringpool_find(pool, data, length, hash);
+    }
+
+    if (length == SIZE_MAX) {
+        return NULL;
+    }
+
+    copy = stringpool_allocate(pool, length + 1);
+
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    if (length > 0) {
+        memcpy(copy, data, length);
+    }
+
+    copy[length] = '\0';
+
+    slot->string = copy;
+    slot->length = length;
+    slot->hash = hash;
+    ++pool->numStrings;
+
+    return copy;
+}
+
+const char *stringpool_lookup(StringPool *pool, const char *string)
+{
+    size_t length = strlen(string);
+
+    return stringpool_find(pool, string, length,
+                           hash64_bytes(string, length, pool->seed))->string;
+}
+
+unsigned int stringpool_numStrings(StringPool *pool)
+{
+    return pool->numStrings;
+}
+
+size_t stringpool_memoryUsage(StringPool *pool)
+{
+    return pool->usage.bytesUsed;
+}
+
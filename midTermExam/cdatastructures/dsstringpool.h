@@ -0,0 +1,136 @@
+/**
+ * @file dsstringpool.h
+ *
+ * @brief String interning.
+ *
+ * A string pool keeps one copy of each distinct string given to it.
+ * Interning a string returns a pointer to the pool's copy, which is the
+ * same pointer every time an equal string is interned, so interned
+ * strings can be compared with == instead of strcmp.  A @ref HashTable
+ * or @ref Set keyed by interned strings can use @ref pointerHashMix (or
+ * @ref pointerHash) and @ref pointerEqual, turning string-keyed lookups
+ * into pointer-keyed ones, and need not copy or free its keys.
+ *
+ * The copies are packed one after another into large blocks of memory,
+ * which are never moved, so the pointers stay valid until the pool is
+ * destroyed.  Strings can not be removed from a pool one at a time.
+ *
+ * To create a string pool, use @ref stringpool_new.  To destroy a
+ * string pool and all the strings in it, use @ref stringpool_free.
+ *
+ * To intern a string, use @ref stringpool_intern, or
+ * @ref stringpool_internLength for a string which is not terminated by
+ * a zero.  To find whether a string has been interned without adding
+ * it, use @ref stringpool_lookup.
+ */
+
+#ifndef DSSTRINGPOOL_H
+#define DSSTRINGPOOL_H
+
+#include <stddef.h>
+
+#include "dsallocator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A string pool structure.
+ */
+
+typedef struct _StringPool StringPool;
+
+/**
+ * Create a new string pool.
+ *
+ * @return                 A new string pool, or NULL if it was not
+ *                         possible to allocate the memory.
+ */
+
+StringPool *stringpool_new(void);
+
+/**
+ * Create a new string pool which allocates its memory from a
+ * particular allocator.
+ *
+ * @param allocator        The allocator to use, or NULL to use the
+ *                         default allocator.
+ * @return                 A new string pool, or NULL if it was not
+ *                         possible to allocate the memory.
+ */
+
+StringPool *stringpool_newWithAllocator(const Allocator *allocator);
+
+/**
+ * Destroy a string pool.  All pointers to strings interned in it become
+ * invalid.
+ *
+ * @param pool             The string pool to destroy.
+ */
+
+void stringpool_free(StringPool *pool);
+
+/**
+ * Intern a string.
+ *
+ * @param pool             The string pool.
+ * @param string           The string.
+ * @return                 The pool's copy of the string, or NULL if it
+ *                         was not possible to allocate memory.
+ */
+
+const char *stringpool_intern(StringPool *pool, const char *string);
+
+/**
+ * Intern a string given by its characters and length, which need not
+ * be followed by a zero.  The pool's copy is terminated by a zero.  If
+ * the characters include zeros, the copy can only be read with its
+ * length.
+ *
+ * @param pool             The string pool.
+ * @param data             The characters of the string.
+ * @param length           Number of characters.
+ * @return                 The pool's copy of the string, or NULL if it
+ *                         was not possible to allocate memory.
+ */
+
+const char *stringpool_internLength(StringPool *pool, const char *data,
+                                    size_t length);
+
+/**
+ * Look up a string in a string pool, without adding it.
+ *
+ * @param pool             The string pool.
+ * @param string           The string.
+ * @return                 The pool's copy of the string, or NULL if it has
+ *                         not been interned.
+ */
+
+const char *stringpool_lookup(StringPool *pool, const char *string);
+
+/**
+ * Retrieve the number of distinct strings in a string pool.
+ *
+ * @param pool             The string pool.
+ * @return                 The number of strings.
+ */
+
+unsigned int stringpool_numStrings(StringPool *pool);
+
+/**
+ * Retrieve the number of bytes of memory used by a string pool,
+ * including the copies of the strings.
+ *
+ * @param pool             The string pool.
+ * @return                 The number of bytes allocated.
+ */
+
+size_t stringpool_memoryUsage(StringPool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSSTRINGPOOL_H */
+
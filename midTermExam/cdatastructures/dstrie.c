@@ -1,45 +1,276 @@
-/* Trie: fast mapping of strings to values */
-
+/* Trie: fast mapping of strings to values
+ *
+ * The trie is an adaptive radix tree.  Inner nodes come in four sizes,
+ * holding up to 4, 16, 48 or 256 children, and are grown and shrunk as
+ * children come and go.  A chain of nodes with one child each is
+ * replaced by a prefix stored in the node below it, and a key is kept
+ * in a leaf as high up the tree as it can be told apart from the other
+ * keys.  Leaves hold the whole key, so only the first TRIE_MAX_PREFIX
+ * bytes of a prefix need to be stored: the rest are checked against the
+ * leaf at the end of the search. */
+
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "dstrie.h"
+#include "dsslab.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRIE_USE_SSE2
+#endif
+
+/* Number of prefix bytes stored in each inner node */
+
+#define TRIE_MAX_PREFIX 8
 
+typedef enum {
+    TRIE_NODE4,
+    TRIE_NODE16,
+    TRIE_NODE48,
+    TRIE_NODE256,
+    TRIE_NUM_NODE_TYPES
+} TrieNodeType;
 
+typedef struct _TrieLeaf TrieLeaf;
 typedef struct _TrieNode TrieNode;
 
-struct _TrieNode {
+struct _TrieLeaf {
 	TrieValue data;
-    unsigned int useCount;
-	TrieNode *next[256];
+    unsigned int keyLength;
+    unsigned char key[];
+};
+
+/* Header shared by all inner nodes.  leaf holds the key which ends at
+ * this node, if there is one.  A child pointer may point to either an
+ * inner node or a leaf: leaves are marked by setting the lowest bit. */
+
+struct _TrieNode {
+    TrieLeaf *leaf;
+    unsigned int prefixLength;
+    unsigned short numChildren;
+    unsigned char type;
+    unsigned char prefix[TRIE_MAX_PREFIX];
+};
+
+/* The keys of Node4 and Node16 are kept sorted */
+
+typedef struct {
+    TrieNode node;
+    unsigned char keys[4];
+    TrieNode *children[4];
+} TrieNode4;
+
+typedef struct {
+    TrieNode node;
+    unsigned char keys[16];
+    TrieNode *children[16];
+} TrieNode16;
+
+/* childIndex holds, for each byte, one more than the position of its
+ * child in children, or zero if there is no child for the byte */
+
+typedef struct {
+    TrieNode node;
+    unsigned char childIndex[256];
+    TrieNode *children[48];
+} TrieNode48;
+
+typedef struct {
+    TrieNode node;
+    TrieNode *children[256];
+} TrieNode256;
+
+#define TRIE_IS_LEAF(node) (((uintptr_t) (node)) & 1)
+#define TRIE_LEAF(node) ((TrieLeaf *) ((uintptr_t) (node) - 1))
+#define TRIE_TAG_LEAF(leaf) ((TrieNode *) ((uintptr_t) (leaf) + 1))
+
+static const size_t trie_nodeSizes[TRIE_NUM_NODE_TYPES] = {
+    sizeof(TrieNode4),
+    sizeof(TrieNode16),
+    sizeof(TrieNode48),
+    sizeof(TrieNode256),
 };
 
 struct _Trie {
+    AllocatorUsage usage;
     TrieNode *rootNode;
+    unsigned int numEntries;
+    Slab *slabs[TRIE_NUM_NODE_TYPES];
 };
 
 Trie *trie_new(void)
 {
-    Trie *newTrie = (Trie *) malloc(sizeof(Trie));
+    return trie_newWithAllocator(NULL);
+}
+
+Trie *trie_newWithAllocator(const Allocator *allocator)
+{
+    AllocatorUsage usage;
+
+    allocator_initUsage(&usage, allocator);
+
+    Trie *newTrie = (Trie *) allocator_malloc(&usage, sizeof(Trie));
     if (newTrie == NULL) {
 		return NULL;
 	}
 
+    newTrie->usage = usage;
+
     newTrie->rootNode = NULL;
+    newTrie->numEntries = 0;
+    memset(newTrie->slabs, 0, sizeof(newTrie->slabs));
 
     return newTrie;
 }
 
-static void trie_freeListPush(TrieNode **list, TrieNode *node)
+int trie_useSlab(Trie *trie)
+{
+    int i;
+
+    if (trie->slabs[0] != NULL) {
+        return 1;
+    }
+
+    if (trie->rootNode != NULL) {
+        return 0;
+    }
+
+	/* One slab for each size of inner node */
+
+    for (i=0; i<TRIE_NUM_NODE_TYPES; ++i) {
+        trie->slabs[i] = slab_newWithAllocator(
+            (unsigned int) trie_nodeSizes[i], trie->usage.allocator);
+
+        if (trie->slabs[i] == NULL) {
+            while (i > 0) {
+                --i;
+                slab_free(trie->slabs[i]);
+                trie->slabs[i] = NULL;
+            }
+
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Allocate a new, zeroed inner node, from a slab if the trie has them */
+
+static TrieNode *trie_allocateNode(Trie *trie, TrieNodeType type)
+{
+    TrieNode *node;
+
+    if (trie->slabs[0] == NULL) {
+        node = (TrieNode *) allocator_malloc(&trie->usage,
+                                             trie_nodeSizes[type]);
+    } else {
+        node = (TrieNode *) slab_allocate(trie->slabs[type]);
+    }
+
+    if (node != NULL) {
+        memset(node, 0, trie_nodeSizes[type]);
+        node->type = (unsigned char) type;
+    }
+
+    return node;
+}
+
+static void trie_freeNode(Trie *trie, TrieNode *node)
+{
+    if (trie->slabs[0] != NULL) {
+        slab_release(trie->slabs[node->type], node);
+    } else {
+        allocator_free(&trie->usage, node, trie_nodeSizes[node->type]);
+    }
+}
+
+static TrieLeaf *trie_allocateLeaf(Trie *trie,
+                                   unsigned char *key,
+                                   unsigned int keyLength,
+                                   TrieValue value)
+{
+    TrieLeaf *leaf;
+
+	/* The key is followed by a NUL, so that text keys can be handed
+	 * to iteration functions as strings */
+
+    leaf = (TrieLeaf *) allocator_malloc(&trie->usage,
+                                         offsetof(TrieLeaf, key)
+                                         + keyLength + 1);
+
+    if (leaf != NULL) {
+        leaf->data = value;
+        leaf->keyLength = keyLength;
+        memcpy(leaf->key, key, keyLength);
+        leaf->key[keyLength] = '\0';
+    }
+
+    return leaf;
+}
+
+static void trie_freeLeaf(Trie *trie, TrieLeaf *leaf)
+{
+    allocator_free(&trie->usage, leaf,
+                   offsetof(TrieLeaf, key) + leaf->keyLength + 1);
+}
+
+/* Copy everything but the type from one node header to another */
+
+static void trie_copyHeader(TrieNode *dest, TrieNode *src)
+{
+    dest->leaf = src->leaf;
+    dest->prefixLength = src->prefixLength;
+    dest->numChildren = src->numChildren;
+    memcpy(dest->prefix, src->prefix, TRIE_MAX_PREFIX);
+}
+
+/* The array of child pointers of a node and its length.  Entries not
+ * in use are NULL. */
+
+static TrieNode **trie_childArray(TrieNode *node, unsigned int *length)
+{
+    switch (node->type) {
+    case TRIE_NODE4:
+        *length = 4;
+        return ((TrieNode4 *) node)->children;
+    case TRIE_NODE16:
+        *length = 16;
+        return ((TrieNode16 *) node)->children;
+    case TRIE_NODE48:
+        *length = 48;
+        return ((TrieNode48 *) node)->children;
+    default:
+        *length = 256;
+        return ((TrieNode256 *) node)->children;
+    }
+}
+
+static void trie_freeListPush(Trie *trie, TrieNode **list, TrieNode *node)
 {
-	node->data = *list;
+	/* Leaves have no children, so can be freed straight away.  The
+	 * leaf of an inner node is freed to make room for the link. */
+
+    if (TRIE_IS_LEAF(node)) {
+        trie_freeLeaf(trie, TRIE_LEAF(node));
+        return;
+    }
+
+    if (node->leaf != NULL) {
+        trie_freeLeaf(trie, node->leaf);
+    }
+
+    node->leaf = (TrieLeaf *) *list;
 	*list = node;
 }
 
 static TrieNode *trie_freeListPop(TrieNode **list)
 {
     TrieNode *result = *list;
-	*list = result->data;
+    *list = (TrieNode *) result->leaf;
 
 	return result;
 }
@@ -47,11 +278,14 @@ static TrieNode *trie_freeListPop(TrieNode **list)
 void trie_free(Trie *trie)
 {
     TrieNode *freeList = NULL;
+    TrieNode **children;
+    unsigned int length;
+    unsigned int i;
 
 	/* Start with the root node */
 
     if (trie->rootNode != NULL) {
-        trie_freeListPush(&freeList, trie->rootNode);
+        trie_freeListPush(trie, &freeList, trie->rootNode);
 	}
 
 	/* Go through the free list, freeing nodes.  We add new nodes as
@@ -65,468 +299,1185 @@ void trie_free(Trie *trie)
 
 		/* Add all children of this node to the free list */
 
-        int i;
-		for (i=0; i<256; ++i) {
-			if (node->next[i] != NULL) {
-                trie_freeListPush(&freeList, node->next[i]);
+        children = trie_childArray(node, &length);
+
+        for (i=0; i<length; ++i) {
+            if (children[i] != NULL) {
+                trie_freeListPush(trie, &freeList, children[i]);
 			}
 		}
 
-		/* Free the node */
+		/* Free the node.  Nodes allocated from a slab are all freed
+		 * along with it below. */
 
-		free(node);
+        if (trie->slabs[0] == NULL) {
+            trie_freeNode(trie, node);
+        }
 	}
 
+    for (i=0; i<TRIE_NUM_NODE_TYPES; ++i) {
+        if (trie->slabs[i] != NULL) {
+            slab_free(trie->slabs[i]);
+        }
+    }
+
 	/* Free the trie */
 
-	free(trie);
+    AllocatorUsage usage = trie->usage;
+
+    allocator_free(&usage, trie, sizeof(Trie));
 }
 
-static TrieNode *trie_findEnd(Trie *trie, char *key)
+#ifdef TRIE_USE_SSE2
+
+/* Bitmask of the keys of a Node16 which equal a byte, compared all at
+ * once */
+
+static unsigned int trie_node16Match(TrieNode16 *node, unsigned char c)
 {
-	/* Search down the trie until the end of string is reached */
+    __m128i keys = _mm_loadu_si128((const __m128i *) node->keys);
+    unsigned int mask;
 
-    TrieNode *node = trie->rootNode;
+    mask = (unsigned int) _mm_movemask_epi8(
+        _mm_cmpeq_epi8(keys, _mm_set1_epi8((char) c)));
 
-    char *p;
+    return mask & ((1U << node->node.numChildren) - 1);
+}
 
-	for (p=key; *p != '\0'; ++p) {
+#else
 
-		if (node == NULL) {
-			/* Not found in the tree. Return. */
+static unsigned int trie_node16Match(TrieNode16 *node, unsigned char c)
+{
+    unsigned int mask = 0;
+    unsigned int i;
 
-			return NULL;
-		}
+    for (i=0; i<node->node.numChildren; ++i) {
+        if (node->keys[i] == c) {
+            mask |= 1U << i;
+        }
+    }
 
-		/* Jump to the next node */
+    return mask;
+}
 
-		node = node->next[(unsigned char) *p];
-	}
+#endif
 
-	/* This key is present if the value at the last node is not NULL */
+/* Index of the lowest set bit in a non-zero mask */
 
-	return node;
+static unsigned int trie_lowestBit(unsigned int mask)
+{
+#if defined(__GNUC__)
+    return (unsigned int) __builtin_ctz(mask);
+#else
+    unsigned int i = 0;
+
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        ++i;
+    }
+
+    return i;
+#endif
 }
 
-static TrieNode *trie_findEndBinary(Trie *trie,
-                                    unsigned char *key,
-                                    int keyLength)
+/* Find the child pointer for a byte, or NULL if there is none */
+
+static TrieNode **trie_findChild(TrieNode *node, unsigned char c)
 {
-	/* Search down the trie until the end of string is reached */
+    TrieNode4 *node4;
+    TrieNode16 *node16;
+    TrieNode48 *node48;
+    TrieNode256 *node256;
+    unsigned int mask;
+    unsigned int i;
+
+    switch (node->type) {
+    case TRIE_NODE4:
+        node4 = (TrieNode4 *) node;
+
+        for (i=0; i<node->numChildren; ++i) {
+            if (node4->keys[i] == c) {
+                return &node4->children[i];
+            }
+        }
+        break;
+
+    case TRIE_NODE16:
+        node16 = (TrieNode16 *) node;
+        mask = trie_node16Match(node16, c);
+
+        if (mask != 0) {
+            return &node16->children[trie_lowestBit(mask)];
+        }
+        break;
+
+    case TRIE_NODE48:
+        node48 = (TrieNode48 *) node;
+        i = node48->childIndex[c];
+
+        if (i != 0) {
+            return &node48->children[i - 1];
+        }
+        break;
+
+    default:
+        node256 = (TrieNode256 *) node;
+
+        if (node256->children[c] != NULL) {
+            return &node256->children[c];
+        }
+        break;
+    }
+
+    return NULL;
+}
 
-    TrieNode *node = trie->rootNode;
-    int j;
-    int c;
+/* The child of a node with the lowest byte */
 
-    for (j=0; j<keyLength; j++) {
+static TrieNode *trie_firstChild(TrieNode *node)
+{
+    TrieNode48 *node48;
+    TrieNode256 *node256;
+    unsigned int c;
 
-		if (node == NULL) {
-			/* Not found in the tree. Return. */
-			return NULL;
-		}
+    switch (node->type) {
+    case TRIE_NODE4:
+        return ((TrieNode4 *) node)->children[0];
 
-		c = (unsigned char) key[j];
+    case TRIE_NODE16:
+        return ((TrieNode16 *) node)->children[0];
 
-		/* Jump to the next node */
+    case TRIE_NODE48:
+        node48 = (TrieNode48 *) node;
 
-		node = node->next[c];
-	}
+        for (c=0; node48->childIndex[c] == 0; ++c);
 
-	/* This key is present if the value at the last node is not NULL */
+        return node48->children[node48->childIndex[c] - 1];
 
-	return node;
+    default:
+        node256 = (TrieNode256 *) node;
+
+        for (c=0; node256->children[c] == NULL; ++c);
+
+        return node256->children[c];
+    }
 }
 
-/* Roll back an insert operation after a failed malloc() call. */
+/* The leaf with the smallest key below a node.  Every leaf below a
+ * node shares the whole of its prefix. */
 
-static void trie_insertRollback(Trie *trie, unsigned char *key)
+static TrieLeaf *trie_minimumLeaf(TrieNode *node)
 {
-	/* Follow the chain along.  We know that we will never reach the
-	 * end of the string because trie_insert never got that far.  As a
-	 * result, it is not necessary to check for the end of string
-	 * delimiter (NUL) */
+    while (!TRIE_IS_LEAF(node)) {
+        if (node->leaf != NULL) {
+            return node->leaf;
+        }
 
-    TrieNode *node = trie->rootNode;
-    TrieNode **prevPtr = &trie->rootNode;
-    unsigned char *p = key;
-    TrieNode *nextNode;
-    TrieNode **nextPrevPtr;
+        node = trie_firstChild(node);
+    }
 
-	while (node != NULL) {
+    return TRIE_LEAF(node);
+}
 
-		/* Find the next node now. We might free this node. */
+static int trie_leafMatches(TrieLeaf *leaf,
+                            unsigned char *key,
+                            unsigned int keyLength)
+{
+    return leaf->keyLength == keyLength
+        && memcmp(leaf->key, key, keyLength) == 0;
+}
 
-        nextPrevPtr = &node->next[(unsigned char) *p];
-        nextNode = *nextPrevPtr;
-		++p;
+/* Check the stored part of a node's prefix against a key.  Returns
+ * non-zero if the key may continue below the node; the leaf found at
+ * the end of the search must still be checked. */
 
-		/* Decrease the use count and free the node if it
-		 * reaches zero. */
+static int trie_checkPrefix(TrieNode *node,
+                            unsigned char *key,
+                            unsigned int keyLength,
+                            unsigned int depth)
+{
+    unsigned int stored;
 
-        --node->useCount;
+    if (keyLength - depth < node->prefixLength) {
+        return 0;
+    }
 
-        if (node->useCount == 0) {
-			free(node);
+    stored = node->prefixLength;
 
-            if (prevPtr != NULL) {
-                *prevPtr = NULL;
-			}
+    if (stored > TRIE_MAX_PREFIX) {
+        stored = TRIE_MAX_PREFIX;
+    }
 
-            nextPrevPtr = NULL;
-		}
+    return memcmp(node->prefix, key + depth, stored) == 0;
+}
 
-		/* Update pointers */
+/* Number of bytes of a node's prefix which match a key, checking the
+ * bytes which are not stored in the node against a leaf below it */
 
-        node = nextNode;
-        prevPtr = nextPrevPtr;
-	}
+static unsigned int trie_prefixMismatch(TrieNode *node,
+                                        unsigned char *key,
+                                        unsigned int keyLength,
+                                        unsigned int depth)
+{
+    TrieLeaf *leaf;
+    unsigned int max;
+    unsigned int stored;
+    unsigned int i;
+
+    max = keyLength - depth;
+
+    if (max > node->prefixLength) {
+        max = node->prefixLength;
+    }
+
+    stored = max < TRIE_MAX_PREFIX ? max : TRIE_MAX_PREFIX;
+
+    for (i=0; i<stored; ++i) {
+        if (node->prefix[i] != key[depth + i]) {
+            return i;
+        }
+    }
+
+    if (i < max) {
+        leaf = trie_minimumLeaf(node);
+
+        for (; i<max; ++i) {
+            if (leaf->key[depth + i] != key[depth + i]) {
+                return i;
+            }
+        }
+    }
+
+    return max;
 }
 
-int trie_insert(Trie *trie, char *key, TrieValue value)
+static TrieLeaf *trie_findLeaf(Trie *trie,
+                               unsigned char *key,
+                               unsigned int keyLength)
 {
-	/* Cannot insert NULL values */
+	/* Search down the trie until the end of the key is reached */
 
-	if (value == TRIE_NULL) {
-		return 0;
-	}
+    TrieNode *node = trie->rootNode;
+    TrieNode **child;
+    TrieLeaf *leaf;
+    unsigned int depth = 0;
 
-	/* Search to see if this is already in the tree */
+    while (node != NULL) {
 
-    TrieNode *node = trie_findEnd(trie, key);
+        if (TRIE_IS_LEAF(node)) {
+            leaf = TRIE_LEAF(node);
 
-	/* Already in the tree? If so, replace the existing value and
-	 * return success. */
+            return trie_leafMatches(leaf, key, keyLength) ? leaf : NULL;
+        }
 
-	if (node != NULL && node->data != TRIE_NULL) {
-		node->data = value;
-		return 1;
-	}
+        if (!trie_checkPrefix(node, key, keyLength, depth)) {
+            return NULL;
+        }
 
-	/* Search down the trie until we reach the end of string,
-	 * creating nodes as necessary */
+        depth += node->prefixLength;
 
-    TrieNode **rover = &trie->rootNode;
-    char *p = key;
+		/* The key ends at this node? */
 
-	for (;;) {
+        if (depth == keyLength) {
+            leaf = node->leaf;
 
-		node = *rover;
+            if (leaf != NULL && trie_leafMatches(leaf, key, keyLength)) {
+                return leaf;
+            }
 
-		if (node == NULL) {
+            return NULL;
+        }
 
-			/* Node does not exist, so create it */
+		/* Jump to the next node */
+
+        child = trie_findChild(node, key[depth]);
 
-			node = (TrieNode *) calloc(1, sizeof(TrieNode));
+        if (child == NULL) {
+            return NULL;
+        }
 
-			if (node == NULL) {
+        node = *child;
+        ++depth;
+    }
 
-				/* Allocation failed.  Go back and undo
-				 * what we have done so far. */
+    return NULL;
+}
 
-                trie_insertRollback(trie,
-				                     (unsigned char *) key);
+/* Insert a key and child into the sorted arrays of a Node4 or Node16 */
 
-				return 0;
-			}
+static void trie_insertSorted(unsigned char *keys,
+                              TrieNode **children,
+                              unsigned int count,
+                              unsigned char c,
+                              TrieNode *child)
+{
+    unsigned int pos = 0;
 
-			node->data = TRIE_NULL;
+    while (pos < count && keys[pos] < c) {
+        ++pos;
+    }
 
-			/* Link in to the trie */
+    memmove(keys + pos + 1, keys + pos, count - pos);
+    memmove(children + pos + 1, children + pos,
+            (count - pos) * sizeof(TrieNode *));
 
-			*rover = node;
-		}
+    keys[pos] = c;
+    children[pos] = child;
+}
 
-		/* Increase the node use count */
+/* Replace a full node with one of the next size up.  Returns NULL if
+ * it was not possible to allocate the new node. */
 
-        ++node->useCount;
+static TrieNode *trie_growNode(Trie *trie, TrieNode **ref)
+{
+    TrieNode *node = *ref;
+    TrieNode *bigger;
+    TrieNode4 *node4;
+    TrieNode16 *node16;
+    TrieNode48 *node48;
+    unsigned int i;
+
+    bigger = trie_allocateNode(trie, (TrieNodeType) (node->type + 1));
+
+    if (bigger == NULL) {
+        return NULL;
+    }
+
+    trie_copyHeader(bigger, node);
+
+    switch (node->type) {
+    case TRIE_NODE4:
+        node4 = (TrieNode4 *) node;
+        memcpy(((TrieNode16 *) bigger)->keys, node4->keys, 4);
+        memcpy(((TrieNode16 *) bigger)->children, node4->children,
+               4 * sizeof(TrieNode *));
+        break;
+
+    case TRIE_NODE16:
+        node16 = (TrieNode16 *) node;
+
+        for (i=0; i<16; ++i) {
+            ((TrieNode48 *) bigger)->children[i] = node16->children[i];
+            ((TrieNode48 *) bigger)->childIndex[node16->keys[i]] =
+                (unsigned char) (i + 1);
+        }
+        break;
+
+    default:
+        node48 = (TrieNode48 *) node;
+
+        for (i=0; i<256; ++i) {
+            if (node48->childIndex[i] != 0) {
+                ((TrieNode256 *) bigger)->children[i] =
+                    node48->children[node48->childIndex[i] - 1];
+            }
+        }
+        break;
+    }
+
+    trie_freeNode(trie, node);
+    *ref = bigger;
+
+    return bigger;
+}
 
-		/* Current character */
+/* Add a child to a node, growing the node if it is full.  Returns zero
+ * if it was not possible to allocate a bigger node. */
 
-        int c = (unsigned char) *p;
+static int trie_addChild(Trie *trie,
+                         TrieNode **ref,
+                         unsigned char c,
+                         TrieNode *child)
+{
+    TrieNode *node = *ref;
+    TrieNode48 *node48;
+    unsigned int pos;
 
-		/* Reached the end of string?  If so, we're finished. */
+    switch (node->type) {
+    case TRIE_NODE4:
+        if (node->numChildren == 4) {
+            node = trie_growNode(trie, ref);
+            return node != NULL && trie_addChild(trie, ref, c, child);
+        }
 
-		if (c == '\0') {
+        trie_insertSorted(((TrieNode4 *) node)->keys,
+                          ((TrieNode4 *) node)->children,
+                          node->numChildren, c, child);
+        break;
 
-			/* Set the data at the node we have reached */
+    case TRIE_NODE16:
+        if (node->numChildren == 16) {
+            node = trie_growNode(trie, ref);
+            return node != NULL && trie_addChild(trie, ref, c, child);
+        }
 
-			node->data = value;
+        trie_insertSorted(((TrieNode16 *) node)->keys,
+                          ((TrieNode16 *) node)->children,
+                          node->numChildren, c, child);
+        break;
 
-			break;
-		}
+    case TRIE_NODE48:
+        if (node->numChildren == 48) {
+            node = trie_growNode(trie, ref);
+            return node != NULL && trie_addChild(trie, ref, c, child);
+        }
 
-		/* Advance to the next node in the chain */
+		/* Children removed earlier may have left gaps */
 
-		rover = &node->next[c];
-		++p;
-	}
+        node48 = (TrieNode48 *) node;
 
-	return 1;
+        for (pos=0; node48->children[pos] != NULL; ++pos);
+
+        node48->children[pos] = child;
+        node48->childIndex[c] = (unsigned char) (pos + 1);
+        break;
+
+    default:
+        ((TrieNode256 *) node)->children[c] = child;
+        break;
+    }
+
+    ++node->numChildren;
+
+    return 1;
 }
 
+/* Place a leaf in a new node: either as the key ending at the node, or
+ * as a child.  The node always has room. */
 
-int trie_insertBinary(Trie *trie,
-                      unsigned char *key,
-                      int keyLength,
-                      TrieValue value)
+static void trie_addLeaf(Trie *trie,
+                         TrieNode **ref,
+                         TrieLeaf *leaf,
+                         unsigned int depth)
 {
-	/* Cannot insert NULL values */
+    if (leaf->keyLength == depth) {
+        (*ref)->leaf = leaf;
+    } else {
+        trie_addChild(trie, ref, leaf->key[depth], TRIE_TAG_LEAF(leaf));
+    }
+}
 
-	if (value == TRIE_NULL) {
-		return 0;
-	}
 
-	/* Search to see if this is already in the tree */
+/* Insert a key which is not already in the trie.  Returns zero if it
+ * was not possible to allocate memory, leaving the trie unchanged. */
 
-    TrieNode *node = trie_findEndBinary(trie, key, keyLength);
+static int trie_insertNew(Trie *trie,
+                          unsigned char *key,
+                          unsigned int keyLength,
+                          TrieValue value)
+{
+    TrieNode **ref = &trie->rootNode;
+    TrieNode **child;
+    TrieNode *node;
+    TrieNode *newNode;
+    TrieLeaf *leaf;
+    TrieLeaf *newLeaf;
+    unsigned int depth = 0;
+    unsigned int length;
+    unsigned int max;
+    unsigned char c;
 
-	/* Already in the tree? If so, replace the existing value and
-	 * return success. */
+	/* Search down the trie to the point where the key leaves it */
 
-	if (node != NULL && node->data != TRIE_NULL) {
-		node->data = value;
-		return 1;
-	}
+	for (;;) {
 
-	/* Search down the trie until we reach the end of string,
-	 * creating nodes as necessary */
+        node = *ref;
 
-    TrieNode **rover = &trie->rootNode;
+		/* Empty slot: the new leaf goes here */
 
-    int p = 0;
+        if (node == NULL) {
+            newLeaf = trie_allocateLeaf(trie, key, keyLength, value);
 
-	for (;;) {
+            if (newLeaf == NULL) {
+                return 0;
+            }
 
-		node = *rover;
+            *ref = TRIE_TAG_LEAF(newLeaf);
 
-		if (node == NULL) {
+            return 1;
+        }
 
-			/* Node does not exist, so create it */
+		/* A leaf with a different key: replace it with a node holding
+		 * the prefix the two keys share, with both leaves below it */
 
-			node = (TrieNode *) calloc(1, sizeof(TrieNode));
+        if (TRIE_IS_LEAF(node)) {
+            leaf = TRIE_LEAF(node);
 
-			if (node == NULL) {
+            max = leaf->keyLength < keyLength ? leaf->keyLength : keyLength;
 
-				/* Allocation failed.  Go back and undo
-				 * what we have done so far. */
+            for (length=0; depth + length < max
+                           && leaf->key[depth + length]
+                              == key[depth + length]; ++length);
 
-                trie_insertRollback(trie, key);
+            newNode = trie_allocateNode(trie, TRIE_NODE4);
+            newLeaf = trie_allocateLeaf(trie, key, keyLength, value);
 
-				return 0;
-			}
+            if (newNode == NULL || newLeaf == NULL) {
+                break;
+            }
 
-			node->data = TRIE_NULL;
+            newNode->prefixLength = length;
+            memcpy(newNode->prefix, key + depth,
+                   length < TRIE_MAX_PREFIX ? length : TRIE_MAX_PREFIX);
 
-			/* Link in to the trie */
+            trie_addLeaf(trie, &newNode, leaf, depth + length);
+            trie_addLeaf(trie, &newNode, newLeaf, depth + length);
 
-			*rover = node;
-		}
+            *ref = newNode;
 
-		/* Increase the node use count */
+            return 1;
+        }
 
-        ++node->useCount;
+		/* The key leaves part way through the node's prefix: split the
+		 * prefix with a new node, keeping the rest of the prefix after
+		 * the branching byte in the old node */
 
-		/* Current character */
+        length = trie_prefixMismatch(node, key, keyLength, depth);
 
-        int c = (unsigned char) key[p];
+        if (length < node->prefixLength) {
+            newNode = trie_allocateNode(trie, TRIE_NODE4);
+            newLeaf = trie_allocateLeaf(trie, key, keyLength, value);
 
-		/* Reached the end of string?  If so, we're finished. */
+            if (newNode == NULL || newLeaf == NULL) {
+                break;
+            }
 
-        if (p == keyLength) {
+            newNode->prefixLength = length;
+            memcpy(newNode->prefix, node->prefix,
+                   length < TRIE_MAX_PREFIX ? length : TRIE_MAX_PREFIX);
 
-			/* Set the data at the node we have reached */
+            if (node->prefixLength <= TRIE_MAX_PREFIX) {
+                c = node->prefix[length];
+                node->prefixLength -= length + 1;
+                memmove(node->prefix, node->prefix + length + 1,
+                        node->prefixLength);
+            } else {
+                leaf = trie_minimumLeaf(node);
+                c = leaf->key[depth + length];
+                node->prefixLength -= length + 1;
+                memcpy(node->prefix, leaf->key + depth + length + 1,
+                       node->prefixLength < TRIE_MAX_PREFIX
+                           ? node->prefixLength : TRIE_MAX_PREFIX);
+            }
 
-			node->data = value;
+            trie_addChild(trie, &newNode, c, node);
+            trie_addLeaf(trie, &newNode, newLeaf, depth + length);
 
-			break;
-		}
+            *ref = newNode;
 
-		/* Advance to the next node in the chain */
+            return 1;
+        }
 
-		rover = &node->next[c];
-		++p;
-	}
+        depth += node->prefixLength;
 
-	return 1;
-}
+		/* The key ends at this node */
 
-int trie_removeBinary(Trie *trie, unsigned char *key, int keyLength)
-{
-	/* Find the end node and remove the value */
+        if (depth == keyLength) {
+            newLeaf = trie_allocateLeaf(trie, key, keyLength, value);
 
-    TrieNode *node = trie_findEndBinary(trie, key, keyLength);
+            if (newLeaf == NULL) {
+                return 0;
+            }
 
-	if (node != NULL && node->data != TRIE_NULL) {
-		node->data = TRIE_NULL;
-	} else {
-		return 0;
-	}
+            node->leaf = newLeaf;
 
-	/* Now traverse the tree again as before, decrementing the use
-	 * count of each node.  Free back nodes as necessary. */
+            return 1;
+        }
 
-    node = trie->rootNode;
-    TrieNode **lastNextPtr = &trie->rootNode;
-    int p = 0;
-    int c;
+		/* Jump to the next node, or add the leaf as a new child */
 
-    TrieNode *next;
+        child = trie_findChild(node, key[depth]);
 
-	for (;;) {
+        if (child == NULL) {
+            newLeaf = trie_allocateLeaf(trie, key, keyLength, value);
 
-		/* Find the next node */
-		c = (unsigned char) key[p];
-		next = node->next[c];
+            if (newLeaf == NULL) {
+                return 0;
+            }
 
-		/* Free this node if necessary */
+            if (!trie_addChild(trie, ref, key[depth],
+                               TRIE_TAG_LEAF(newLeaf))) {
+                trie_freeLeaf(trie, newLeaf);
+                return 0;
+            }
 
-        --node->useCount;
+            return 1;
+        }
 
-        if (node->useCount <= 0) {
-			free(node);
+        ref = child;
+        ++depth;
+    }
 
-			/* Set the "next" pointer on the previous node to NULL,
-			 * to unlink the freed node from the tree.  This only
-			 * needs to be done once in a remove.  After the first
-			 * unlink, all further nodes are also going to be
-			 * free'd. */
+	/* Allocation failed while splitting a node */
 
-            if (lastNextPtr != NULL) {
-                *lastNextPtr = NULL;
-                lastNextPtr = NULL;
-			}
-		}
+    if (newNode != NULL) {
+        trie_freeNode(trie, newNode);
+    }
 
-		/* Go to the next character or finish */
-        if (p == keyLength) {
-			break;
-		} else {
-			++p;
-		}
+    if (newLeaf != NULL) {
+        trie_freeLeaf(trie, newLeaf);
+    }
 
-		/* If necessary, save the location of the "next" pointer
-		 * so that it may be set to NULL on the next iteration if
-		 * the next node visited is freed. */
+    return 0;
+}
 
-        if (lastNextPtr != NULL) {
-            lastNextPtr = &node->next[c];
-		}
+/* Remove one entry from the sorted arrays of a Node4 or Node16 */
 
-		/* Jump to the next node */
+static void trie_removeSorted(unsigned char *keys,
+                              TrieNode **children,
+                              unsigned int count,
+                              unsigned int pos)
+{
+    memmove(keys + pos, keys + pos + 1, count - pos - 1);
+    memmove(children + pos, children + pos + 1,
+            (count - pos - 1) * sizeof(TrieNode *));
 
-		node = next;
-	}
+    children[count - 1] = NULL;
+}
 
-	/* Removed successfully */
+/* Replace a Node4 which no longer branches with what is left below
+ * it: either its own leaf, or its only child, with this node's prefix
+ * and branching byte added to the front of the child's prefix */
 
-	return 1;
+static void trie_collapseNode(Trie *trie, TrieNode **ref)
+{
+    TrieNode4 *node4 = (TrieNode4 *) *ref;
+    TrieNode *node = *ref;
+    TrieNode *child;
+    unsigned int length;
+    unsigned int sub;
+
+    if (node->numChildren == 0) {
+        *ref = TRIE_TAG_LEAF(node->leaf);
+        trie_freeNode(trie, node);
+        return;
+    }
+
+    if (node->numChildren > 1 || node->leaf != NULL) {
+        return;
+    }
+
+    child = node4->children[0];
+
+    if (!TRIE_IS_LEAF(child)) {
+        length = node->prefixLength;
+
+        if (length < TRIE_MAX_PREFIX) {
+            node->prefix[length] = node4->keys[0];
+            ++length;
+        }
+
+        if (length < TRIE_MAX_PREFIX) {
+            sub = TRIE_MAX_PREFIX - length;
+
+            if (sub > child->prefixLength) {
+                sub = child->prefixLength;
+            }
+
+            memcpy(node->prefix + length, child->prefix, sub);
+            length += sub;
+        }
+
+        memcpy(child->prefix, node->prefix,
+               length < TRIE_MAX_PREFIX ? length : TRIE_MAX_PREFIX);
+        child->prefixLength += node->prefixLength + 1;
+    }
+
+    *ref = child;
+    trie_freeNode(trie, node);
 }
 
-int trie_remove(Trie *trie, char *key)
+/* Replace a node with one of the next size down once it has few enough
+ * children.  If the smaller node cannot be allocated, the node is left
+ * as it is. */
+
+static void trie_shrinkNode(Trie *trie, TrieNode **ref)
 {
-	/* Find the end node and remove the value */
+    TrieNode *node = *ref;
+    TrieNode *smaller;
+    TrieNode16 *node16;
+    TrieNode48 *node48;
+    TrieNode256 *node256;
+    unsigned int i;
+    unsigned int pos;
+
+    switch (node->type) {
+    case TRIE_NODE4:
+        trie_collapseNode(trie, ref);
+        return;
+
+    case TRIE_NODE16:
+        if (node->numChildren > 3
+         || (smaller = trie_allocateNode(trie, TRIE_NODE4)) == NULL) {
+            return;
+        }
+
+        node16 = (TrieNode16 *) node;
+        memcpy(((TrieNode4 *) smaller)->keys, node16->keys, 3);
+        memcpy(((TrieNode4 *) smaller)->children, node16->children,
+               3 * sizeof(TrieNode *));
+        break;
+
+    case TRIE_NODE48:
+        if (node->numChildren > 12
+         || (smaller = trie_allocateNode(trie, TRIE_NODE16)) == NULL) {
+            return;
+        }
+
+        node48 = (TrieNode48 *) node;
+        node16 = (TrieNode16 *) smaller;
+
+        for (i=0, pos=0; i<256; ++i) {
+            if (node48->childIndex[i] != 0) {
+                node16->keys[pos] = (unsigned char) i;
+                node16->children[pos] =
+                    node48->children[node48->childIndex[i] - 1];
+                ++pos;
+            }
+        }
+        break;
+
+    default:
+        if (node->numChildren > 37
+         || (smaller = trie_allocateNode(trie, TRIE_NODE48)) == NULL) {
+            return;
+        }
+
+        node256 = (TrieNode256 *) node;
+        node48 = (TrieNode48 *) smaller;
+
+        for (i=0, pos=0; i<256; ++i) {
+            if (node256->children[i] != NULL) {
+                node48->children[pos] = node256->children[i];
+                node48->childIndex[i] = (unsigned char) (pos + 1);
+                ++pos;
+            }
+        }
+        break;
+    }
+
+    trie_copyHeader(smaller, node);
+    trie_freeNode(trie, node);
+    *ref = smaller;
+}
 
-    TrieNode *node = trie_findEnd(trie, key);
+/* Remove the child for a byte from a node */
 
-	if (node != NULL && node->data != TRIE_NULL) {
-		node->data = TRIE_NULL;
-	} else {
+static void trie_removeChild(Trie *trie,
+                             TrieNode **ref,
+                             unsigned char c,
+                             TrieNode **child)
+{
+    TrieNode *node = *ref;
+
+    switch (node->type) {
+    case TRIE_NODE4:
+        trie_removeSorted(((TrieNode4 *) node)->keys,
+                          ((TrieNode4 *) node)->children,
+                          node->numChildren,
+                          (unsigned int) (child
+                                          - ((TrieNode4 *) node)->children));
+        break;
+
+    case TRIE_NODE16:
+        trie_removeSorted(((TrieNode16 *) node)->keys,
+                          ((TrieNode16 *) node)->children,
+                          node->numChildren,
+                          (unsigned int) (child
+                                          - ((TrieNode16 *) node)->children));
+        break;
+
+    case TRIE_NODE48:
+        *child = NULL;
+        ((TrieNode48 *) node)->childIndex[c] = 0;
+        break;
+
+    default:
+        *child = NULL;
+        break;
+    }
+
+    --node->numChildren;
+
+    trie_shrinkNode(trie, ref);
+}
+
+int trie_insert(Trie *trie, char *key, TrieValue value)
+{
+    return trie_insertBinary(trie, (unsigned char *) key,
+                             (int) strlen(key), value);
+}
+
+int trie_insertBinary(Trie *trie,
+                      unsigned char *key,
+                      int keyLength,
+                      TrieValue value)
+{
+	/* Cannot insert NULL values */
+
+    if (value == TRIE_NULL || keyLength < 0) {
 		return 0;
 	}
 
-	/* Now traverse the tree again as before, decrementing the use
-	 * count of each node.  Free back nodes as necessary. */
+	/* Already in the tree? If so, replace the existing value and
+	 * return success. */
 
-    node = trie->rootNode;
-    TrieNode **lastNextPtr = &trie->rootNode;
-    char *p = key;
-    int c;
+    TrieLeaf *leaf = trie_findLeaf(trie, key, (unsigned int) keyLength);
 
-    TrieNode *next;
+    if (leaf != NULL) {
+        leaf->data = value;
+        return 1;
+    }
 
-	for (;;) {
+    if (!trie_insertNew(trie, key, (unsigned int) keyLength, value)) {
+        return 0;
+    }
 
-		/* Find the next node */
+    ++trie->numEntries;
 
-		c = (unsigned char) *p;
-		next = node->next[c];
+	return 1;
+}
 
-		/* Free this node if necessary */
+int trie_removeBinary(Trie *trie, unsigned char *key, int keyLength)
+{
+    TrieNode **ref = &trie->rootNode;
+    TrieNode **child;
+    TrieNode *node;
+    TrieLeaf *leaf;
+    unsigned int length = (unsigned int) keyLength;
+    unsigned int depth = 0;
 
-        --node->useCount;
+    if (keyLength < 0 || trie->rootNode == NULL) {
+        return 0;
+    }
 
-        if (node->useCount <= 0) {
-			free(node);
+	/* A trie holding a single key has just a leaf */
 
-			/* Set the "next" pointer on the previous node to NULL,
-			 * to unlink the freed node from the tree.  This only
-			 * needs to be done once in a remove.  After the first
-			 * unlink, all further nodes are also going to be
-			 * free'd. */
+    if (TRIE_IS_LEAF(trie->rootNode)) {
+        leaf = TRIE_LEAF(trie->rootNode);
 
-            if (lastNextPtr != NULL) {
-                *lastNextPtr = NULL;
-                lastNextPtr = NULL;
-			}
-		}
+        if (!trie_leafMatches(leaf, key, length)) {
+            return 0;
+        }
 
-		/* Go to the next character or finish */
+        trie->rootNode = NULL;
+    } else {
 
-		if (c == '\0') {
-			break;
-		} else {
-			++p;
-		}
+		/* Search down the trie for the node holding the leaf, then
+		 * unlink the leaf and shrink the node as necessary */
 
-		/* If necessary, save the location of the "next" pointer
-		 * so that it may be set to NULL on the next iteration if
-		 * the next node visited is freed. */
+        for (;;) {
+            node = *ref;
 
-        if (lastNextPtr != NULL) {
-            lastNextPtr = &node->next[c];
-		}
+            if (!trie_checkPrefix(node, key, length, depth)) {
+                return 0;
+            }
 
-		/* Jump to the next node */
+            depth += node->prefixLength;
 
-		node = next;
-	}
+            if (depth == length) {
+                leaf = node->leaf;
+
+                if (leaf == NULL || !trie_leafMatches(leaf, key, length)) {
+                    return 0;
+                }
+
+                node->leaf = NULL;
+                trie_shrinkNode(trie, ref);
+                break;
+            }
+
+            child = trie_findChild(node, key[depth]);
+
+            if (child == NULL) {
+                return 0;
+            }
+
+            if (TRIE_IS_LEAF(*child)) {
+                leaf = TRIE_LEAF(*child);
+
+                if (!trie_leafMatches(leaf, key, length)) {
+                    return 0;
+                }
+
+                trie_removeChild(trie, ref, key[depth], child);
+                break;
+            }
+
+            ref = child;
+            ++depth;
+        }
+    }
+
+    trie_freeLeaf(trie, leaf);
+    --trie->numEntries;
 
 	/* Removed successfully */
 
 	return 1;
 }
 
-TrieValue trie_lookup(Trie *trie, char *key)
+int trie_remove(Trie *trie, char *key)
 {
-    TrieNode *node = trie_findEnd(trie, key);
+    return trie_removeBinary(trie, (unsigned char *) key, (int) strlen(key));
+}
 
-	if (node != NULL) {
-		return node->data;
-	} else {
-		return TRIE_NULL;
-	}
+TrieValue trie_lookup(Trie *trie, char *key)
+{
+    return trie_lookupBinary(trie, (unsigned char *) key, (int) strlen(key));
 }
 
 TrieValue trie_lookupBinary(Trie *trie, unsigned char *key, int keyLength)
 {
-    TrieNode *node = trie_findEndBinary(trie, key, keyLength);
+    TrieLeaf *leaf;
+
+    if (keyLength < 0) {
+        return TRIE_NULL;
+    }
 
-	if (node != NULL) {
-		return node->data;
+    leaf = trie_findLeaf(trie, key, (unsigned int) keyLength);
+
+    if (leaf != NULL) {
+		return leaf->data;
 	} else {
 		return TRIE_NULL;
 	}
 }
 
-unsigned int trie_numEntries(Trie *trie)
+TrieValue trie_longestPrefix(Trie *trie, char *key)
 {
-	/* To find the number of entries, simply look at the use count
-	 * of the root node. */
+    return trie_longestPrefixBinary(trie, (unsigned char *) key,
+                                    (int) strlen(key));
+}
 
-    if (trie->rootNode == NULL) {
-		return 0;
-	} else {
-        return trie->rootNode->useCount;
-	}
+TrieValue trie_longestPrefixBinary(Trie *trie,
+                                   unsigned char *key,
+                                   int keyLength)
+{
+    TrieNode *node = trie->rootNode;
+    TrieNode **child;
+    TrieLeaf *candidate;
+    TrieLeaf *best = NULL;
+    unsigned int length = (unsigned int) keyLength;
+    unsigned int depth = 0;
+    unsigned int checked = 0;
+
+    if (keyLength < 0) {
+        return TRIE_NULL;
+    }
+
+	/* Search down the trie as for a lookup, noting each key ending on
+	 * the way which is a prefix of the key.  Prefix bytes not stored
+	 * in the nodes are skipped, so each candidate is checked against
+	 * the key.  A candidate shares the bytes of every key above it,
+	 * so only the bytes after the last good candidate need checking,
+	 * and once a candidate fails all those below it fail too. */
+
+    while (node != NULL) {
+
+        if (TRIE_IS_LEAF(node)) {
+            candidate = TRIE_LEAF(node);
+            node = NULL;
+        } else {
+            if (!trie_checkPrefix(node, key, length, depth)) {
+                break;
+            }
+
+            depth += node->prefixLength;
+            candidate = node->leaf;
+
+            if (depth < length) {
+                child = trie_findChild(node, key[depth]);
+                node = child != NULL ? *child : NULL;
+                ++depth;
+            } else {
+                node = NULL;
+            }
+        }
+
+        if (candidate != NULL) {
+            if (candidate->keyLength > length
+             || memcmp(candidate->key + checked, key + checked,
+                       candidate->keyLength - checked) != 0) {
+                break;
+            }
+
+            best = candidate;
+            checked = candidate->keyLength;
+        }
+    }
+
+    if (best != NULL) {
+        return best->data;
+    } else {
+        return TRIE_NULL;
+    }
+}
+
+/* Visit every key below a node in order.  A key ending at a node comes
+ * before all the longer keys below it, then the children follow in
+ * order of their byte.  Returns zero if the iteration was stopped. */
+
+static int trie_iterateNode(TrieNode *node,
+                            TrieIterateFunc func,
+                            void *context)
+{
+    TrieNode4 *node4;
+    TrieNode16 *node16;
+    TrieNode48 *node48;
+    TrieNode256 *node256;
+    TrieLeaf *leaf;
+    unsigned int i;
+
+    if (TRIE_IS_LEAF(node)) {
+        leaf = TRIE_LEAF(node);
+
+        return func(leaf->key, (int) leaf->keyLength, leaf->data, context);
+    }
+
+    leaf = node->leaf;
+
+    if (leaf != NULL
+     && !func(leaf->key, (int) leaf->keyLength, leaf->data, context)) {
+        return 0;
+    }
+
+    switch (node->type) {
+    case TRIE_NODE4:
+        node4 = (TrieNode4 *) node;
+
+        for (i=0; i<node->numChildren; ++i) {
+            if (!trie_iterateNode(node4->children[i], func, context)) {
+                return 0;
+            }
+        }
+        break;
+
+    case TRIE_NODE16:
+        node16 = (TrieNode16 *) node;
+
+        for (i=0; i<node->numChildren; ++i) {
+            if (!trie_iterateNode(node16->children[i], func, context)) {
+                return 0;
+            }
+        }
+        break;
+
+    case TRIE_NODE48:
+        node48 = (TrieNode48 *) node;
+
+        for (i=0; i<256; ++i) {
+            if (node48->childIndex[i] != 0
+             && !trie_iterateNode(node48->children[node48->childIndex[i] - 1],
+                                  func, context)) {
+                return 0;
+            }
+        }
+        break;
+
+    default:
+        node256 = (TrieNode256 *) node;
+
+        for (i=0; i<256; ++i) {
+            if (node256->children[i] != NULL
+             && !trie_iterateNode(node256->children[i], func, context)) {
+                return 0;
+            }
+        }
+        break;
+    }
+
+    return 1;
+}
+
+void trie_iteratePrefix(Trie *trie,
+                        char *prefix,
+                        TrieIterateFunc func,
+                        void *context)
+{
+    trie_iteratePrefixBinary(trie, (unsigned char *) prefix,
+                             (int) strlen(prefix), func, context);
+}
+
+void trie_iteratePrefixBinary(Trie *trie,
+                              unsigned char *prefix,
+                              int prefixLength,
+                              TrieIterateFunc func,
+                              void *context)
+{
+    TrieNode *node = trie->rootNode;
+    TrieNode **child;
+    TrieLeaf *leaf;
+    unsigned int length = (unsigned int) prefixLength;
+    unsigned int depth = 0;
+    unsigned int max;
+
+    if (prefixLength < 0) {
+        return;
+    }
+
+	/* Search down the trie for the node below which every key starts
+	 * with the prefix */
+
+    while (node != NULL) {
+
+        if (TRIE_IS_LEAF(node)) {
+            leaf = TRIE_LEAF(node);
+
+            if (leaf->keyLength >= length
+             && memcmp(leaf->key, prefix, length) == 0) {
+                func(leaf->key, (int) leaf->keyLength, leaf->data, context);
+            }
+
+            return;
+        }
+
+		/* The whole of the node's prefix is checked here, since the
+		 * keys below are visited without checking them again */
+
+        max = length - depth;
+
+        if (max > node->prefixLength) {
+            max = node->prefixLength;
+        }
+
+        if (trie_prefixMismatch(node, prefix, length, depth) < max) {
+            return;
+        }
+
+        if (length - depth <= node->prefixLength) {
+            trie_iterateNode(node, func, context);
+            return;
+        }
+
+        depth += node->prefixLength;
+
+        child = trie_findChild(node, prefix[depth]);
+
+        if (child == NULL) {
+            return;
+        }
+
+        node = *child;
+        ++depth;
+    }
 }
 
+unsigned int trie_numEntries(Trie *trie)
+{
+    return trie->numEntries;
+}
+
+size_t trie_memoryUsage(Trie *trie)
+{
+    size_t result = trie->usage.bytesUsed;
+    int i;
+
+    for (i=0; i<TRIE_NUM_NODE_TYPES; ++i) {
+        if (trie->slabs[i] != NULL) {
+            result += slab_memoryUsage(trie->slabs[i]);
+        }
+    }
+
+    return result;
+}
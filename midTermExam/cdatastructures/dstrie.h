@@ -6,13 +6,21 @@
  * A trie is a data structure which provides fast mappings from strings
  * to values.
  *
+ * This trie is an adaptive radix tree: each node is only as large as
+ * its number of children needs, and runs of nodes with a single child
+ * are merged into one, so that memory use stays close to the size of
+ * the keys themselves.
+ *
  * To create a new trie, use @ref trie_new.  To destroy a trie,
  * use @ref trie_free.
  *
  * To insert a value into a trie, use @ref trie_insert. To remove a value
  * from a trie, use @ref trie_remove.
  *
- * To look up a value from its key, use @ref trie_lookup.
+ * To look up a value from its key, use @ref trie_lookup.  To find the
+ * longest key in the trie which is a prefix of a string, use
+ * @ref trie_longestPrefix.  To visit all keys starting with a prefix,
+ * in order, use @ref trie_iteratePrefix.
  *
  * To find the number of entries in a trie, use @ref trie_numEntries.
  */
@@ -20,6 +28,8 @@
 #ifndef DSTRIE_H
 #define DSTRIE_H
 
+#include "dsallocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -42,6 +52,27 @@ typedef void *TrieValue;
 
 #define TRIE_NULL ((void *) 0)
 
+/**
+ * Function called for each key visited by @ref trie_iteratePrefix.
+ * The key is followed by a NUL byte, so that keys inserted with
+ * @ref trie_insert can be used as strings.  It must not be modified,
+ * and the trie must not be changed during the iteration.
+ *
+ * @param key                The key.
+ * @param keyLength          The key length in bytes, not counting the
+ *                           NUL byte which follows it.
+ * @param value              The value stored with the key.
+ * @param context            The context pointer passed to
+ *                           @ref trie_iteratePrefix.
+ * @return                   Non-zero to continue the iteration, or zero
+ *                           to stop it.
+ */
+
+typedef int (*TrieIterateFunc)(unsigned char *key,
+                               int keyLength,
+                               TrieValue value,
+                               void *context);
+
 /**
  * Create a new trie.
  *
@@ -52,6 +83,34 @@ typedef void *TrieValue;
 
 Trie *trie_new(void);
 
+/**
+ * Create a new trie which allocates its memory from a particular
+ * allocator.
+ *
+ * @param allocator          The allocator to use, or NULL to use the
+ *                           default allocator.
+ * @return                   Pointer to a new trie structure, or NULL if it
+ *                           was not possible to allocate memory for the
+ *                           new trie.
+ */
+
+Trie *trie_newWithAllocator(const Allocator *allocator);
+
+/**
+ * Allocate the inner nodes of a trie from slabs (see @ref Slab) owned
+ * by the trie, one for each size of node, instead of allocating each
+ * node separately.  Inserting and removing become cheaper, and
+ * @ref trie_free releases all inner nodes at once.  Leaves, whose size
+ * depends on the length of their key, are still allocated separately.
+ * This must be called while the trie is empty.
+ *
+ * @param trie               The trie.
+ * @return                   Non-zero on success, or zero if the trie is
+ *                           not empty or the slab could not be allocated.
+ */
+
+int trie_useSlab(Trie *trie);
+
 /**
  * Destroy a trie.
  *
@@ -119,6 +178,76 @@ TrieValue trie_lookup(Trie *trie, char *key);
 
 TrieValue trie_lookupBinary(Trie *trie, unsigned char *key, int keyLength);
 
+/**
+ * Find the value of the longest key in a trie which is a prefix of a
+ * string, including the string itself.  This is the lookup used by
+ * routing tables.  The string is NUL-terminated; for binary strings,
+ * use @ref trie_longestPrefixBinary.
+ *
+ * @param trie               The trie.
+ * @param key                The string.
+ * @return                   The value of the longest matching key, or
+ *                           @ref TRIE_NULL if no key in the trie is a
+ *                           prefix of the string.
+ */
+
+TrieValue trie_longestPrefix(Trie *trie, char *key);
+
+/**
+ * Find the value of the longest key in a trie which is a prefix of a
+ * sequence of bytes, including the whole sequence.  For a
+ * NUL-terminated text string, use @ref trie_longestPrefix.
+ *
+ * @param trie               The trie.
+ * @param key                The sequence of bytes.
+ * @param keyLength          The length of the sequence in bytes.
+ * @return                   The value of the longest matching key, or
+ *                           @ref TRIE_NULL if no key in the trie is a
+ *                           prefix of the sequence.
+ */
+
+TrieValue trie_longestPrefixBinary(Trie *trie,
+                                   unsigned char *key,
+                                   int keyLength);
+
+/**
+ * Visit every key in a trie which starts with a prefix, in
+ * lexicographic order of their bytes, calling a function for each.
+ * Nothing is allocated.  The prefix is a NUL-terminated string; for
+ * binary strings, use @ref trie_iteratePrefixBinary.
+ *
+ * @param trie               The trie.
+ * @param prefix             The prefix.  An empty string visits every
+ *                           key in the trie.
+ * @param func               Function to call for each key.
+ * @param context            Pointer passed to each call of the function.
+ */
+
+void trie_iteratePrefix(Trie *trie,
+                        char *prefix,
+                        TrieIterateFunc func,
+                        void *context);
+
+/**
+ * Visit every key in a trie which starts with a prefix, in
+ * lexicographic order of their bytes, calling a function for each.
+ * Nothing is allocated.  The prefix is a sequence of bytes; for a
+ * NUL-terminated text string, use @ref trie_iteratePrefix.
+ *
+ * @param trie               The trie.
+ * @param prefix             The prefix.
+ * @param prefixLength       The prefix length in bytes.  Zero visits
+ *                           every key in the trie.
+ * @param func               Function to call for each key.
+ * @param context            Pointer passed to each call of the function.
+ */
+
+void trie_iteratePrefixBinary(Trie *trie,
+                              unsigned char *prefix,
+                              int prefixLength,
+                              TrieIterateFunc func,
+                              void *context);
+
 /**
  * Remove an entry from a trie.
  * The key is a NUL-terminated string; for binary strings, use
@@ -155,6 +284,16 @@ int trie_removeBinary(Trie *trie, unsigned char *key, int keyLength);
 
 unsigned int trie_numEntries(Trie *trie);
 
+/**
+ * Retrieve the number of bytes of memory allocated by a trie.  This
+ * does not include memory used by the values themselves.
+ *
+ * @param trie               The trie.
+ * @return                   The number of bytes allocated.
+ */
+
+size_t trie_memoryUsage(Trie *trie);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,1018 @@
+/* Thread-safe cache with expiring entries
+ *
+ * Each shard is a chained hash table protected by a mutex.  Every entry
+ * is on three lists at once, through links held in the entry itself:
+ * its hash chain, the recency list of its shard, and, if it can expire,
+ * a slot of the shard's timer wheel.
+ *
+ * The timer wheel has TTL_CACHE_WHEEL_LEVELS levels of
+ * TTL_CACHE_WHEEL_SLOTS slots.  A slot of level 0 holds the entries
+ * expiring in one particular tick (millisecond); a slot of level n
+ * covers 64 times as many ticks as a slot of level n-1.  An entry goes
+ * in the lowest level whose slots still reach its expiry time.  As the
+ * wheel turns, each time a level n slot comes round its entries are
+ * moved down to the levels below, so that they reach level 0 in time
+ * to expire.  Adding, removing and expiring an entry all take constant
+ * time, and a sweep only touches entries which are due, or are being
+ * moved down a level. */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "dsttlcache.h"
+#include "dshashint.h"
+
+
+typedef struct _TTLCacheEntry TTLCacheEntry;
+typedef struct _TTLCacheShard TTLCacheShard;
+
+#define TTL_CACHE_WHEEL_BITS 6
+#define TTL_CACHE_WHEEL_SLOTS (1U << TTL_CACHE_WHEEL_BITS)
+#define TTL_CACHE_WHEEL_LEVELS 5
+
+/* Initial number of buckets in each shard.  Always a power of two. */
+
+#define TTL_CACHE_INITIAL_BUCKETS 16
+
+/* Number of entries the sweeper thread removes from a shard before
+ * letting other threads have the lock */
+
+#define TTL_CACHE_SWEEP_BATCH 256
+
+/* The wheel links are a pointer to the next entry in the slot, and a
+ * pointer to whatever points at this entry (the previous entry's link,
+ * or the slot itself), so that an entry can be taken out without
+ * knowing which slot it is in.  wheelPrev is NULL if the entry is not
+ * on the wheel.  wheelLevel is the level of the wheel it is on. */
+
+struct _TTLCacheEntry {
+    HashTablePair pair;
+    unsigned int hash;
+    uint64_t expires;
+    TTLCacheEntry *chainNext;
+    TTLCacheEntry *newer;
+    TTLCacheEntry *older;
+    TTLCacheEntry *wheelNext;
+    TTLCacheEntry **wheelPrev;
+    unsigned int wheelLevel;
+};
+
+struct _TTLCacheShard {
+    pthread_mutex_t lock;
+    AllocatorUsage usage;
+    TTLCacheEntry **buckets;
+    unsigned int numBuckets;
+    unsigned int entries;
+    TTLCacheEntry *newest;
+    TTLCacheEntry *oldest;
+    TTLCacheEntry *wheel[TTL_CACHE_WHEEL_LEVELS][TTL_CACHE_WHEEL_SLOTS];
+    unsigned int wheelEntries[TTL_CACHE_WHEEL_LEVELS];
+    uint64_t currentTick;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long expirations;
+    unsigned long evictions;
+};
+
+struct _TTLCache {
+    AllocatorUsage usage;
+    HashTableHashFunc hashFunc;
+    HashTableEqualFunc equalFunc;
+    HashTableKeyFreeFunc keyFreeFunc;
+    HashTableValueFreeFunc valueFreeFunc;
+    TTLCacheClockFunc clockFunc;
+    void *clockContext;
+    TTLCacheShard *shards;
+    unsigned int numShards;
+    unsigned int shardBits;
+    unsigned int shardCapacity;
+
+    /* The sweeper thread waits on the condition between sweeps, so
+     * that it can be stopped without waiting out the interval */
+
+    pthread_mutex_t sweeperLock;
+    pthread_cond_t sweeperCond;
+    pthread_t sweeper;
+    int sweeperRunning;
+    int sweeperStopping;
+    unsigned int sweeperInterval;
+};
+
+/* Default clock: milliseconds of the monotonic clock */
+
+static uint64_t ttlcache_monotonicClock(void *context)
+{
+    struct timespec now;
+
+    (void) context;
+
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    clock_gettime(CLOCK_REALTIME, &now);
+#endif
+
+    return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static uint64_t ttlcache_now(TTLCache *cache)
+{
+    return cache->clockFunc(cache->clockContext);
+}
+
+/* Shards and buckets are selected with shifts and masks, so the user
+ * hash is spread with intMix first.  The top bits of the mixed hash
+ * choose the shard, the bottom bits the bucket within it. */
+
+static TTLCacheShard *ttlcache_shard(TTLCache *cache, unsigned int hash)
+{
+    if (cache->shardBits == 0) {
+        return &cache->shards[0];
+    }
+
+    return &cache->shards[hash >> (32 - cache->shardBits)];
+}
+
+static TTLCacheEntry **ttlcache_chain(TTLCacheShard *shard,
+                                      unsigned int hash)
+{
+    return &shard->buckets[hash & (shard->numBuckets - 1)];
+}
+
+/* Put an entry on the wheel of its shard.  Entries due at or before
+ * minTick go in the level 0 slot of minTick.  Entries further ahead
+ * than the top level reaches go in its furthest slot, and are moved
+ * back up again when that slot comes round. */
+
+static void ttlcache_wheelAdd(TTLCacheShard *shard, TTLCacheEntry *entry,
+                              uint64_t minTick)
+{
+    uint64_t tick = entry->expires;
+    uint64_t current = shard->currentTick;
+    unsigned int shift = 0;
+    unsigned int level;
+    unsigned int slot;
+    TTLCacheEntry **head;
+
+    if (tick < minTick) {
+        tick = minTick;
+    }
+
+	/* Find the lowest level on which the entry is less than a turn
+	 * of the wheel ahead */
+
+    for (level=0; level<TTL_CACHE_WHEEL_LEVELS; ++level) {
+        shift = level * TTL_CACHE_WHEEL_BITS;
+
+        if ((tick >> shift) - (current >> shift) < TTL_CACHE_WHEEL_SLOTS) {
+            break;
+        }
+    }
+
+    if (level == TTL_CACHE_WHEEL_LEVELS) {
+        level = TTL_CACHE_WHEEL_LEVELS - 1;
+        tick = ((current >> shift) + TTL_CACHE_WHEEL_SLOTS - 1) << shift;
+    }
+
+    slot = (unsigned int) (tick >> shift) & (TTL_CACHE_WHEEL_SLOTS - 1);
+    head = &shard->wheel[level][slot];
+
+    entry->wheelNext = *head;
+    entry->wheelPrev = head;
+
+    if (*head != NULL) {
+        (*head)->wheelPrev = &entry->wheelNext;
+    }
+
+    *head = entry;
+    entry->wheelLevel = level;
+    ++shard->wheelEntries[level];
+}
+
+static void ttlcache_wheelRemove(TTLCacheShard *shard, TTLCacheEntry *entry)
+{
+    TTLCacheEntry **head = entry->wheelPrev;
+
+    if (head == NULL) {
+        return;
+    }
+
+    --shard->wheelEntries[entry->wheelLevel];
+
+    *head = entry->wheelNext;
+
+    if (entry->wheelNext != NULL) {
+        entry->wheelNext->wheelPrev = head;
+    }
+
+    entry->wheelPrev = NULL;
+}
+
+/* Take an entry out of the recency list of its shard */
+
+static void ttlcache_unlinkRecency(TTLCacheShard *shard, TTLCacheEntry *entry)
+{
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        shard->newest = entry->older;
+    }
+
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        shard->oldest = entry->newer;
+    }
+}
+
+static void ttlcache_linkNewest(TTLCacheShard *shard, TTLCacheEntry *entry)
+{
+    entry->newer = NULL;
+    entry->older = shard->newest;
+
+    if (shard->newest != NULL) {
+        shard->newest->newer = entry;
+    } else {
+        shard->oldest = entry;
+    }
+
+    shard->newest = entry;
+}
+
+static void ttlcache_freeEntry(TTLCache *cache, TTLCacheShard *shard,
+                               TTLCacheEntry *entry)
+{
+    if (cache->keyFreeFunc != NULL) {
+        cache->keyFreeFunc(entry->pair.key);
+    }
+
+    if (cache->valueFreeFunc != NULL) {
+        cache->valueFreeFunc(entry->pair.value);
+    }
+
+    allocator_free(&shard->usage, entry, sizeof(TTLCacheEntry));
+}
+
+/* Find the link in a chain which points to the entry for a key.  The
+ * link holds NULL if the key is not in the shard. */
+
+static TTLCacheEntry **ttlcache_findLink(TTLCache *cache,
+                                         TTLCacheShard *shard,
+                                         HashTableKey key,
+                                         unsigned int hash)
+{
+    TTLCacheEntry **link = ttlcache_chain(shard, hash);
+
+    while (*link != NULL) {
+        if ((*link)->hash == hash
+         && cache->equalFunc((*link)->pair.key, key)) {
+            break;
+        }
+
+        link = &(*link)->chainNext;
+    }
+
+    return link;
+}
+
+/* Remove an entry, given the link to it in its chain, and free it */
+
+static void ttlcache_removeEntry(TTLCache *cache, TTLCacheShard *shard,
+                                 TTLCacheEntry **link)
+{
+    TTLCacheEntry *entry = *link;
+
+    *link = entry->chainNext;
+    ttlcache_unlinkRecency(shard, entry);
+    ttlcache_wheelRemove(shard, entry);
+    --shard->entries;
+
+    ttlcache_freeEntry(cache, shard, entry);
+}
+
+/* Remove an entry found other than through its key */
+
+static void ttlcache_removeFound(TTLCache *cache, TTLCacheShard *shard,
+                                 TTLCacheEntry *entry)
+{
+    TTLCacheEntry **link = ttlcache_chain(shard, entry->hash);
+
+    while (*link != entry) {
+        link = &(*link)->chainNext;
+    }
+
+    ttlcache_removeEntry(cache, shard, link);
+}
+
+static int ttlcache_expired(TTLCacheEntry *entry, uint64_t now)
+{
+    return entry->expires != 0 && entry->expires <= now;
+}
+
+/* Move the entries of a wheel slot down to the levels below */
+
+static void ttlcache_cascade(TTLCacheShard *shard, unsigned int level)
+{
+    unsigned int shift = level * TTL_CACHE_WHEEL_BITS;
+    unsigned int slot = (unsigned int) (shard->currentTick >> shift)
+                      & (TTL_CACHE_WHEEL_SLOTS - 1);
+    TTLCacheEntry *entry = shard->wheel[level][slot];
+    TTLCacheEntry *next;
+
+    shard->wheel[level][slot] = NULL;
+
+    while (entry != NULL) {
+        next = entry->wheelNext;
+        --shard->wheelEntries[level];
+        ttlcache_wheelAdd(shard, entry, shard->currentTick);
+        entry = next;
+    }
+}
+
+/* Turn the wheel of a shard on to the tick after the current one, or
+ * further if there is nothing on the wheel to stop for, but never past
+ * the tick now.  The levels whose slots come round are cascaded. */
+
+static void ttlcache_wheelAdvance(TTLCacheShard *shard, uint64_t now)
+{
+    uint64_t tick = shard->currentTick + 1;
+    uint64_t boundary;
+    unsigned int shift;
+    unsigned int level;
+
+	/* If the lowest levels are empty, nothing can happen before the
+	 * next slot of the lowest level in use comes round */
+
+    for (level=0; level<TTL_CACHE_WHEEL_LEVELS; ++level) {
+        if (shard->wheelEntries[level] != 0) {
+            break;
+        }
+    }
+
+    if (level == TTL_CACHE_WHEEL_LEVELS) {
+        shard->currentTick = now;
+
+        return;
+    }
+
+    if (level > 0) {
+        shift = level * TTL_CACHE_WHEEL_BITS;
+        boundary = ((shard->currentTick >> shift) + 1) << shift;
+        tick = boundary < now ? boundary : now;
+    }
+
+    shard->currentTick = tick;
+
+	/* Cascade from the highest level whose slot has come round, so
+	 * that entries can move down more than one level */
+
+    for (level=TTL_CACHE_WHEEL_LEVELS - 1; level>0; --level) {
+        shift = level * TTL_CACHE_WHEEL_BITS;
+
+        if ((tick & ((UINT64_C(1) << shift) - 1)) == 0) {
+            break;
+        }
+    }
+
+    for (; level>0; --level) {
+        ttlcache_cascade(shard, level);
+    }
+}
+
+/* Remove up to budget expired entries from a shard, turning its wheel
+ * on to the tick now.  Returns the number removed, and sets *more if
+ * the budget ran out before the wheel caught up.  Called with the shard
+ * lock held. */
+
+static unsigned int ttlcache_sweepShard(TTLCache *cache,
+                                        TTLCacheShard *shard,
+                                        uint64_t now,
+                                        unsigned int budget,
+                                        int *more)
+{
+    TTLCacheEntry **slot;
+    unsigned int removed = 0;
+
+    for (;;) {
+        slot = &shard->wheel[0][shard->currentTick
+                                & (TTL_CACHE_WHEEL_SLOTS - 1)];
+
+        while (*slot != NULL && removed < budget) {
+            ttlcache_removeFound(cache, shard, *slot);
+            ++shard->expirations;
+            ++removed;
+        }
+
+        if (*slot != NULL) {
+            *more = 1;
+
+            break;
+        }
+
+        if (shard->currentTick >= now) {
+            break;
+        }
+
+        ttlcache_wheelAdvance(shard, now);
+    }
+
+    return removed;
+}
+
+TTLCache *ttlcache_new(HashTableHashFunc hashFunc,
+                       HashTableEqualFunc equalFunc,
+                       unsigned int numShards,
+                       unsigned int capacity)
+{
+    return ttlcache_newWithAllocator(hashFunc, equalFunc, numShards,
+                                     capacity, NULL);
+}
+
+TTLCache *ttlcache_newWithAllocator(HashTableHashFunc hashFunc,
+                                    HashTableEqualFunc equalFunc,
+                                    unsigned int numShards,
+                                    unsigned int capacity,
+                                    const Allocator *allocator)
+{
+    AllocatorUsage usage;
+    TTLCache *cache;
+    TTLCacheShard *shard;
+    unsigned int shardBits = 0;
+    uint64_t now;
+    unsigned int i;
+
+    allocator_initUsage(&usage, allocator);
+
+    cache = allocator_malloc(&usage, sizeof(TTLCache));
+
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->usage = usage;
+
+	/* Round the number of shards up to a power of two */
+
+    while ((1U << shardBits) < numShards && shardBits < 16) {
+        ++shardBits;
+    }
+
+    cache->hashFunc = hashFunc;
+    cache->equalFunc = equalFunc;
+    cache->keyFreeFunc = NULL;
+    cache->valueFreeFunc = NULL;
+    cache->clockFunc = ttlcache_monotonicClock;
+    cache->clockContext = NULL;
+    cache->numShards = 1U << shardBits;
+    cache->shardBits = shardBits;
+    cache->shardCapacity = capacity == 0 ? 0
+        : (capacity - 1) / cache->numShards + 1;
+    cache->sweeperRunning = 0;
+    cache->sweeperStopping = 0;
+    cache->sweeperInterval = 0;
+
+    if (pthread_mutex_init(&cache->sweeperLock, NULL) != 0) {
+        allocator_free(&cache->usage, cache, sizeof(TTLCache));
+
+        return NULL;
+    }
+
+    if (pthread_cond_init(&cache->sweeperCond, NULL) != 0) {
+        pthread_mutex_destroy(&cache->sweeperLock);
+        allocator_free(&cache->usage, cache, sizeof(TTLCache));
+
+        return NULL;
+    }
+
+    cache->shards = allocator_calloc(&cache->usage, cache->numShards,
+                                     sizeof(TTLCacheShard));
+
+    if (cache->shards == NULL) {
+        pthread_cond_destroy(&cache->sweeperCond);
+        pthread_mutex_destroy(&cache->sweeperLock);
+        allocator_free(&cache->usage, cache, sizeof(TTLCache));
+
+        return NULL;
+    }
+
+	/* Set up each shard with its own lock and bucket array.  The
+	 * wheels start at the current time. */
+
+    now = ttlcache_now(cache);
+
+    for (i=0; i<cache->numShards; ++i) {
+        shard = &cache->shards[i];
+        allocator_initUsage(&shard->usage, cache->usage.allocator);
+        shard->buckets = allocator_calloc(&shard->usage,
+                                          TTL_CACHE_INITIAL_BUCKETS,
+                                          sizeof(TTLCacheEntry *));
+
+        if (shard->buckets == NULL
+         || pthread_mutex_init(&shard->lock, NULL) != 0) {
+            if (shard->buckets != NULL) {
+                allocator_free(&shard->usage, shard->buckets,
+                               TTL_CACHE_INITIAL_BUCKETS
+                               * sizeof(TTLCacheEntry *));
+                shard->buckets = NULL;
+            }
+            ttlcache_free(cache);
+
+            return NULL;
+        }
+
+        shard->numBuckets = TTL_CACHE_INITIAL_BUCKETS;
+        shard->currentTick = now;
+    }
+
+    return cache;
+}
+
+void ttlcache_free(TTLCache *cache)
+{
+    TTLCacheShard *shard;
+    TTLCacheEntry *entry;
+    TTLCacheEntry *older;
+    unsigned int i;
+
+    ttlcache_stopSweeper(cache);
+
+    for (i=0; i<cache->numShards; ++i) {
+        shard = &cache->shards[i];
+
+		/* Shards are left zeroed if creating the cache failed before
+		 * they were set up */
+
+        if (shard->buckets == NULL) {
+            continue;
+        }
+
+        for (entry=shard->newest; entry != NULL; entry=older) {
+            older = entry->older;
+            ttlcache_freeEntry(cache, shard, entry);
+        }
+
+        allocator_free(&shard->usage, shard->buckets,
+                       shard->numBuckets * sizeof(TTLCacheEntry *));
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    pthread_cond_destroy(&cache->sweeperCond);
+    pthread_mutex_destroy(&cache->sweeperLock);
+
+    AllocatorUsage usage = cache->usage;
+
+    allocator_free(&usage, cache->shards,
+                   cache->numShards * sizeof(TTLCacheShard));
+    allocator_free(&usage, cache, sizeof(TTLCache));
+}
+
+void ttlcache_registerFreeFunctions(TTLCache *cache,
+                                    HashTableKeyFreeFunc keyFreeFunc,
+                                    HashTableValueFreeFunc valueFreeFunc)
+{
+    cache->keyFreeFunc = keyFreeFunc;
+    cache->valueFreeFunc = valueFreeFunc;
+}
+
+int ttlcache_setClock(TTLCache *cache, TTLCacheClockFunc clockFunc,
+                      void *context)
+{
+    uint64_t now;
+    unsigned int i;
+
+    for (i=0; i<cache->numShards; ++i) {
+        if (cache->shards[i].entries != 0) {
+            return 0;
+        }
+    }
+
+    cache->clockFunc = clockFunc;
+    cache->clockContext = context;
+
+	/* The wheels are empty, so they can simply be moved to the time of
+	 * the new clock */
+
+    now = ttlcache_now(cache);
+
+    for (i=0; i<cache->numShards; ++i) {
+        cache->shards[i].currentTick = now;
+    }
+
+    return 1;
+}
+
+/* Double the bucket array of a shard.  If there is not the memory, the
+ * shard carries on with longer chains. */
+
+static void ttlcache_enlarge(TTLCacheShard *shard)
+{
+    unsigned int newSize = shard->numBuckets * 2;
+    TTLCacheEntry **newBuckets;
+    TTLCacheEntry *entry;
+    TTLCacheEntry *next;
+    unsigned int i;
+
+    newBuckets = allocator_calloc(&shard->usage, newSize,
+                                  sizeof(TTLCacheEntry *));
+
+    if (newBuckets == NULL) {
+        return;
+    }
+
+    for (i=0; i<shard->numBuckets; ++i) {
+        for (entry=shard->buckets[i]; entry != NULL; entry=next) {
+            next = entry->chainNext;
+            entry->chainNext = newBuckets[entry->hash & (newSize - 1)];
+            newBuckets[entry->hash & (newSize - 1)] = entry;
+        }
+    }
+
+    allocator_free(&shard->usage, shard->buckets,
+                   shard->numBuckets * sizeof(TTLCacheEntry *));
+    shard->buckets = newBuckets;
+    shard->numBuckets = newSize;
+}
+
+/* Set the expiry time of an entry, and put it on the wheel */
+
+static void ttlcache_setExpiry(TTLCacheShard *shard, TTLCacheEntry *entry,
+                               uint64_t now, uint64_t ttl)
+{
+    ttlcache_wheelRemove(shard, entry);
+
+    if (ttl == TTL_CACHE_NO_EXPIRY) {
+        entry->expires = 0;
+
+        return;
+    }
+
+    entry->expires = ttl > UINT64_MAX - now ? UINT64_MAX : now + ttl;
+
+	/* The level 0 slot of the current tick has already been swept */
+
+    ttlcache_wheelAdd(shard, entry, shard->currentTick + 1);
+}
+
+int ttlcache_put(TTLCache *cache, HashTableKey key, HashTableValue value,
+                 uint64_t ttl)
+{
+    unsigned int hash = intMix(cache->hashFunc(key));
+    TTLCacheShard *shard = ttlcache_shard(cache, hash);
+    TTLCacheEntry **link;
+    TTLCacheEntry *entry;
+    uint64_t now = ttlcache_now(cache);
+
+    pthread_mutex_lock(&shard->lock);
+
+    link = ttlcache_findLink(cache, shard, key, hash);
+    entry = *link;
+
+    if (entry != NULL) {
+
+		/* Replace the key and value, freeing the old ones */
+
+        if (cache->valueFreeFunc != NULL && entry->pair.value != value) {
+            cache->valueFreeFunc(entry->pair.value);
+        }
+
+        if (cache->keyFreeFunc != NULL && entry->pair.key != key) {
+            cache->keyFreeFunc(entry->pair.key);
+        }
+
+        entry->pair.key = key;
+        entry->pair.value = value;
+
+        ttlcache_unlinkRecency(shard, entry);
+        ttlcache_linkNewest(shard, entry);
+        ttlcache_setExpiry(shard, entry, now, ttl);
+
+        pthread_mutex_unlock(&shard->lock);
+
+        return 1;
+    }
+
+    entry = allocator_malloc(&shard->usage, sizeof(TTLCacheEntry));
+
+    if (entry == NULL) {
+        pthread_mutex_unlock(&shard->lock);
+
+        return 0;
+    }
+
+    entry->pair.key = key;
+    entry->pair.value = value;
+    entry->hash = hash;
+    entry->wheelPrev = NULL;
+
+	/* Make room in a full shard by evicting its least recently used
+	 * entry */
+
+    if (cache->shardCapacity != 0 && shard->entries >= cache->shardCapacity) {
+        ttlcache_removeFound(cache, shard, shard->oldest);
+        ++shard->evictions;
+    }
+
+    if (shard->entries >= shard->numBuckets) {
+        ttlcache_enlarge(shard);
+    }
+
+    link = ttlcache_chain(shard, hash);
+    entry->chainNext = *link;
+    *link = entry;
+
+    ttlcache_linkNewest(shard, entry);
+    ttlcache_setExpiry(shard, entry, now, ttl);
+    ++shard->entries;
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return 1;
+}
+
+/* Look up a value, passing it through a copy function, if one is
+ * given, while the shard is still locked */
+
+static HashTableValue ttlcache_lookup(TTLCache *cache, HashTableKey key,
+                                      TTLCacheCopyFunc copyFunc,
+                                      void *context)
+{
+    unsigned int hash = intMix(cache->hashFunc(key));
+    TTLCacheShard *shard = ttlcache_shard(cache, hash);
+    TTLCacheEntry **link;
+    TTLCacheEntry *entry;
+    HashTableValue value = HASH_TABLE_NULL;
+    uint64_t now = ttlcache_now(cache);
+
+    pthread_mutex_lock(&shard->lock);
+
+    link = ttlcache_findLink(cache, shard, key, hash);
+    entry = *link;
+
+    if (entry != NULL && ttlcache_expired(entry, now)) {
+        ttlcache_removeEntry(cache, shard, link);
+        ++shard->expirations;
+        entry = NULL;
+    }
+
+    if (entry != NULL) {
+        ++shard->hits;
+        value = entry->pair.value;
+
+        if (copyFunc != NULL) {
+            value = copyFunc(value, context);
+        }
+
+        if (shard->newest != entry) {
+            ttlcache_unlinkRecency(shard, entry);
+            ttlcache_linkNewest(shard, entry);
+        }
+    } else {
+        ++shard->misses;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return value;
+}
+
+HashTableValue ttlcache_get(TTLCache *cache, HashTableKey key)
+{
+    return ttlcache_lookup(cache, key, NULL, NULL);
+}
+
+HashTableValue ttlcache_getCopy(TTLCache *cache, HashTableKey key,
+                                TTLCacheCopyFunc copyFunc, void *context)
+{
+    return ttlcache_lookup(cache, key, copyFunc, context);
+}
+
+int ttlcache_remove(TTLCache *cache, HashTableKey key)
+{
+    unsigned int hash = intMix(cache->hashFunc(key));
+    TTLCacheShard *shard = ttlcache_shard(cache, hash);
+    TTLCacheEntry **link;
+    int result = 0;
+    uint64_t now = ttlcache_now(cache);
+
+    pthread_mutex_lock(&shard->lock);
+
+    link = ttlcache_findLink(cache, shard, key, hash);
+
+    if (*link != NULL) {
+        if (ttlcache_expired(*link, now)) {
+            ++shard->expirations;
+        } else {
+            result = 1;
+        }
+
+        ttlcache_removeEntry(cache, shard, link);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return result;
+}
+
+/* Sweep every shard once, returning the number of entries removed and
+ * setting *more if any shard has expired entries left over */
+
+static unsigned int ttlcache_sweepAll(TTLCache *cache, unsigned int budget,
+                                      int *more)
+{
+    TTLCacheShard *shard;
+    unsigned int removed = 0;
+    uint64_t now = ttlcache_now(cache);
+    unsigned int i;
+
+    *more = 0;
+
+    for (i=0; i<cache->numShards; ++i) {
+        shard = &cache->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        removed += ttlcache_sweepShard(cache, shard, now, budget, more);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return removed;
+}
+
+unsigned int ttlcache_sweep(TTLCache *cache, unsigned int maxPerShard)
+{
+    int more;
+
+    return ttlcache_sweepAll(cache, maxPerShard == 0 ? UINT_MAX
+                                                     : maxPerShard,
+                             &more);
+}
+
+static void *ttlcache_sweeperMain(void *data)
+{
+    TTLCache *cache = (TTLCache *) data;
+    struct timespec deadline;
+    int more;
+
+    pthread_mutex_lock(&cache->sweeperLock);
+
+    while (!cache->sweeperStopping) {
+        pthread_mutex_unlock(&cache->sweeperLock);
+
+		/* Sweep in batches until the wheels have caught up, so that
+		 * no lock is held for long */
+
+        do {
+            ttlcache_sweepAll(cache, TTL_CACHE_SWEEP_BATCH, &more);
+        } while (more);
+
+        pthread_mutex_lock(&cache->sweeperLock);
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += cache->sweeperInterval / 1000;
+        deadline.tv_nsec += (long) (cache->sweeperInterval % 1000) * 1000000;
+
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_nsec -= 1000000000;
+            ++deadline.tv_sec;
+        }
+
+        while (!cache->sweeperStopping
+            && pthread_cond_timedwait(&cache->sweeperCond,
+                                      &cache->sweeperLock,
+                                      &deadline) != ETIMEDOUT) {
+        }
+    }
+
+    pthread_mutex_unlock(&cache->sweeperLock);
+
+    return NULL;
+}
+
+int ttlcache_startSweeper(TTLCache *cache, unsigned int interval)
+{
+    int result = 0;
+
+    pthread_mutex_lock(&cache->sweeperLock);
+
+    if (!cache->sweeperRunning) {
+        cache->sweeperStopping = 0;
+        cache->sweeperInterval = interval;
+
+        if (pthread_create(&cache->sweeper, NULL, ttlcache_sweeperMain,
+                           cache) == 0) {
+            cache->sweeperRunning = 1;
+            result = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->sweeperLock);
+
+    return result;
+}
+
+void ttlcache_stopSweeper(TTLCache *cache)
+{
+    pthread_mutex_lock(&cache->sweeperLock);
+
+    if (!cache->sweeperRunning) {
+        pthread_mutex_unlock(&cache->sweeperLock);
+
+        return;
+    }
+
+    cache->sweeperStopping = 1;
+    pthread_cond_signal(&cache->sweeperCond);
+    pthread_mutex_unlock(&cache->sweeperLock);
+
+    pthread_join(cache->sweeper, NULL);
+
+    pthread_mutex_lock(&cache->sweeperLock);
+    cache->sweeperRunning = 0;
+    pthread_mutex_unlock(&cache->sweeperLock);
+}
+
+unsigned int ttlcache_numEntries(TTLCache *cache)
+{
+    unsigned int entries = 0;
+    unsigned int i;
+
+    for (i=0; i<cache->numShards; ++i) {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        entries += cache->shards[i].entries;
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+
+    return entries;
+}
+
+unsigned int ttlcache_numShards(TTLCache *cache)
+{
+    return cache->numShards;
+}
+
+size_t ttlcache_memoryUsage(TTLCache *cache)
+{
+    size_t bytesUsed = cache->usage.bytesUsed;
+    unsigned int i;
+
+    for (i=0; i<cache->numShards; ++i) {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        bytesUsed += cache->shards[i].usage.bytesUsed;
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+
+    return bytesUsed;
+}
+
+void ttlcache_shardStats(TTLCache *cache, unsigned int shard,
+                         TTLCacheStats *stats)
+{
+    TTLCacheShard *s = &cache->shards[shard];
+    unsigned long gets;
+
+    pthread_mutex_lock(&s->lock);
+
+    stats->entries = s->entries;
+    stats->hits = s->hits;
+    stats->misses = s->misses;
+    stats->expirations = s->expirations;
+    stats->evictions = s->evictions;
+
+    pthread_mutex_unlock(&s->lock);
+
+    gets = stats->hits + stats->misses;
+    stats->hitRate = gets > 0 ? (double) stats->hits / gets : 0.0;
+}
+
+void ttlcache_stats(TTLCache *cache, TTLCacheStats *stats)
+{
+    TTLCacheStats shardStats;
+    unsigned long gets;
+    unsigned int i;
+
+    stats->entries = 0;
+    stats->hits = 0;
+    stats->misses = 0;
+    stats->expirations = 0;
+    stats->evictions = 0;
+
+    for (i=0; i<cache->numShards; ++i) {
+        ttlcache_shardStats(cache, i, &shardStats);
+        stats->entries += shardStats.entries;
+        stats->hits += shardStats.hits;
+        stats->misses += shardStats.misses;
+        stats->expirations += shardStats.expirations;
+        stats->evictions += shardStats.evictions;
+    }
+
+    gets = stats->hits + stats->misses;
+    stats->hitRate = gets > 0 ? (double) stats->hits / gets : 0.0;
+}
+
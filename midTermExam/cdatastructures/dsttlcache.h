@@ -0,0 +1,374 @@
+/**
+ * @file dsttlcache.h
+ *
+ * @brief Thread-safe cache with expiring entries.
+ *
+ * A TTL cache maps keys to values, like a @ref HashTable, but each
+ * entry has a time to live, after which it expires and is removed.  The
+ * cache may be used from several threads at once.  Keys are partitioned
+ * across a number of shards, each with its own lock, so that threads
+ * using different shards do not contend.
+ *
+ * Expired entries are removed in two ways.  A lookup which finds an
+ * expired entry removes it and reports a miss, so an expired value is
+ * never returned.  Entries which are not looked up again are removed by
+ * @ref ttlcache_sweep, which can be called from a maintenance thread of
+ * the caller's own or from one started with
+ * @ref ttlcache_startSweeper.  Each shard keeps its entries on a
+ * hierarchical timer wheel, ordered by expiry time, so that a sweep
+ * only visits the entries which have expired, and can be limited to a
+ * number of entries at a time; the cache is never scanned as a whole.
+ *
+ * A cache may also be given a capacity.  When a shard is full, adding
+ * an entry evicts the least recently used entry of that shard.
+ *
+ * Times are in milliseconds, read from the system's monotonic clock
+ * unless another clock is given with @ref ttlcache_setClock.
+ *
+ * To create a TTL cache, use @ref ttlcache_new.  To destroy it, use
+ * @ref ttlcache_free.
+ *
+ * To add a value, use @ref ttlcache_put.  To look up a value, use
+ * @ref ttlcache_get, or @ref ttlcache_getCopy if other threads may
+ * replace or remove it while it is in use.  To remove a value, use
+ * @ref ttlcache_remove.
+ *
+ * To read the hits, misses, expiries and evictions of each shard, use
+ * @ref ttlcache_shardStats, or @ref ttlcache_stats for the totals.
+ *
+ * The same hash and equality functions used with @ref HashTable can be
+ * used here.  They must be safe to call from several threads at once.
+ */
+
+#ifndef DSTTLCACHE_H
+#define DSTTLCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dsallocator.h"
+#include "dshashtable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A TTL cache structure.
+ */
+
+typedef struct _TTLCache TTLCache;
+
+/**
+ * Time to live meaning that an entry never expires.
+ */
+
+#define TTL_CACHE_NO_EXPIRY 0
+
+/**
+ * Function used by a @ref TTLCache to read the current time.
+ *
+ * @param context  The context pointer passed to @ref ttlcache_setClock.
+ * @return         The current time in milliseconds.  The time must
+ *                 never go backwards.
+ */
+
+typedef uint64_t (*TTLCacheClockFunc)(void *context);
+
+/**
+ * Function used by @ref ttlcache_getCopy to copy a value, or take a
+ * reference to it, while the entry holding it is locked.
+ *
+ * @param value    The value found in the cache.
+ * @param context  The context pointer passed to @ref ttlcache_getCopy.
+ * @return         The copy, which belongs to the caller.
+ */
+
+typedef HashTableValue (*TTLCacheCopyFunc)(HashTableValue value,
+                                           void *context);
+
+/**
+ * Create a new TTL cache.
+ *
+ * @param hashFunc             Function used to generate hash keys for the
+ *                             keys used in the cache.
+ * @param equalFunc            Function used to test keys used in the cache
+ *                             for equality.
+ * @param numShards            Number of shards to split the cache into.
+ *                             This is rounded up to a power of two.  A
+ *                             few times the number of threads using the
+ *                             cache is a good choice.
+ * @param capacity             The largest number of entries the cache can
+ *                             hold, divided evenly between the shards, or
+ *                             zero for no limit.
+ * @return                     A new TTL cache, or NULL if it was not
+ *                             possible to allocate it.
+ */
+
+TTLCache *ttlcache_new(HashTableHashFunc hashFunc,
+                       HashTableEqualFunc equalFunc,
+                       unsigned int numShards,
+                       unsigned int capacity);
+
+/**
+ * Create a new TTL cache which allocates its memory from a particular
+ * allocator.  The allocator functions are only ever called by one
+ * thread at a time for each shard, but different shards may call them
+ * at the same time.
+ *
+ * @param hashFunc             Function used to generate hash keys for the
+ *                             keys used in the cache.
+ * @param equalFunc            Function used to test keys used in the cache
+ *                             for equality.
+ * @param numShards            Number of shards to split the cache into.
+ *                             This is rounded up to a power of two.
+ * @param capacity             The largest number of entries the cache can
+ *                             hold, or zero for no limit.
+ * @param allocator            The allocator to use, or NULL to use the
+ *                             default allocator.
+ * @return                     A new TTL cache, or NULL if it was not
+ *                             possible to allocate it.
+ */
+
+TTLCache *ttlcache_newWithAllocator(HashTableHashFunc hashFunc,
+                                    HashTableEqualFunc equalFunc,
+                                    unsigned int numShards,
+                                    unsigned int capacity,
+                                    const Allocator *allocator);
+
+/**
+ * Destroy a TTL cache, stopping its sweeper thread if it has one.  No
+ * other thread may be using the cache when it is destroyed.
+ *
+ * @param cache                The cache to destroy.
+ */
+
+void ttlcache_free(TTLCache *cache);
+
+/**
+ * Register functions used to free the key and value when an entry is
+ * removed from a TTL cache, whether it expires, is evicted, removed or
+ * replaced, or the cache is destroyed.  This must be called before the
+ * cache is shared between threads.
+ *
+ * @param cache                The cache.
+ * @param keyFreeFunc          Function used to free keys.
+ * @param valueFreeFunc        Function used to free values.
+ */
+
+void ttlcache_registerFreeFunctions(TTLCache *cache,
+                                    HashTableKeyFreeFunc keyFreeFunc,
+                                    HashTableValueFreeFunc valueFreeFunc);
+
+/**
+ * Set the clock used by a TTL cache.  This must be called while the
+ * cache is empty, before it is shared between threads.
+ *
+ * @param cache                The cache.
+ * @param clockFunc            Function to read the time.
+ * @param context              Context pointer to pass to the function.
+ * @return                     Non-zero on success, or zero if the cache
+ *                             is not empty.
+ */
+
+int ttlcache_setClock(TTLCache *cache, TTLCacheClockFunc clockFunc,
+                      void *context);
+
+/**
+ * Add a value to a TTL cache, overwriting any existing entry using the
+ * same key.  The entry's time to live starts again from now.
+ *
+ * @param cache                The cache.
+ * @param key                  The key for the new value.
+ * @param value                The value to insert.
+ * @param ttl                  Time to live in milliseconds, or
+ *                             @ref TTL_CACHE_NO_EXPIRY.
+ * @return                     Non-zero if the value was added successfully,
+ *                             or zero if it was not possible to allocate
+ *                             memory for the new entry.
+ */
+
+int ttlcache_put(TTLCache *cache, HashTableKey key, HashTableValue value,
+                 uint64_t ttl);
+
+/**
+ * Look up a value in a TTL cache, counting a hit or a miss.  An expired
+ * entry is removed, and counts as a miss.
+ *
+ * If a value free function is registered, the value returned is only
+ * safe to use until another thread replaces or removes the entry, or it
+ * expires.  Use @ref ttlcache_getCopy when that can happen.
+ *
+ * @param cache                The cache.
+ * @param key                  The key of the value to look up.
+ * @return                     The value, or @ref HASH_TABLE_NULL if there
+ *                             is no live value with that key.
+ */
+
+HashTableValue ttlcache_get(TTLCache *cache, HashTableKey key);
+
+/**
+ * Look up a value in a TTL cache and copy it before the entry is
+ * unlocked, counting a hit or a miss as @ref ttlcache_get does.  The
+ * copy stays valid however the cache changes afterwards.  The copy
+ * function may instead take a reference to a reference counted value,
+ * which the value free function then releases.
+ *
+ * The copy function is called with the lock of the entry's shard held,
+ * so it must be quick, and must not use the cache.
+ *
+ * @param cache                The cache.
+ * @param key                  The key of the value to look up.
+ * @param copyFunc             Function to copy the value.
+ * @param context              Context pointer to pass to the function.
+ * @return                     The copy returned by the function, or
+ *                             @ref HASH_TABLE_NULL if there is no live
+ *                             value with that key, in which case the
+ *                             function is not called.
+ */
+
+HashTableValue ttlcache_getCopy(TTLCache *cache, HashTableKey key,
+                                TTLCacheCopyFunc copyFunc, void *context);
+
+/**
+ * Remove a value from a TTL cache.
+ *
+ * @param cache                The cache.
+ * @param key                  The key of the value to remove.
+ * @return                     Non-zero if a live entry was removed, or
+ *                             zero if the key was not found or had
+ *                             expired.
+ */
+
+int ttlcache_remove(TTLCache *cache, HashTableKey key);
+
+/**
+ * Remove expired entries from a TTL cache.  Each shard is locked in
+ * turn, and only the entries which are due are visited.
+ *
+ * @param cache                The cache.
+ * @param maxPerShard          The largest number of entries to remove from
+ *                             each shard, so as to bound how long each lock
+ *                             is held, or zero for no limit.  Entries left
+ *                             over are removed by later sweeps.
+ * @return                     The number of entries removed.
+ */
+
+unsigned int ttlcache_sweep(TTLCache *cache, unsigned int maxPerShard);
+
+/**
+ * Start a thread which sweeps a TTL cache in the background.  Entries
+ * are removed within about one interval of expiring.
+ *
+ * @param cache                The cache.
+ * @param interval             Time between sweeps in milliseconds.
+ * @return                     Non-zero on success, or zero if the cache
+ *                             already has a sweeper thread or the thread
+ *                             could not be started.
+ */
+
+int ttlcache_startSweeper(TTLCache *cache, unsigned int interval);
+
+/**
+ * Stop the sweeper thread of a TTL cache, waiting for it to finish.
+ * Nothing is done if there is no sweeper thread.
+ *
+ * @param cache                The cache.
+ */
+
+void ttlcache_stopSweeper(TTLCache *cache);
+
+/**
+ * Retrieve the number of entries in a TTL cache, including any which
+ * have expired but not yet been removed.  If other threads are
+ * modifying the cache, the result is only approximate.
+ *
+ * @param cache                The cache.
+ * @return                     The number of entries.
+ */
+
+unsigned int ttlcache_numEntries(TTLCache *cache);
+
+/**
+ * Retrieve the number of shards of a TTL cache.
+ *
+ * @param cache                The cache.
+ * @return                     The number of shards.
+ */
+
+unsigned int ttlcache_numShards(TTLCache *cache);
+
+/**
+ * Retrieve the number of bytes of memory allocated by a TTL cache, not
+ * counting the keys and values.  This takes the lock of each shard in
+ * turn.
+ *
+ * @param cache                The cache.
+ * @return                     The number of bytes allocated.
+ */
+
+size_t ttlcache_memoryUsage(TTLCache *cache);
+
+/**
+ * Counts kept by a @ref TTLCache, filled in by @ref ttlcache_shardStats
+ * and @ref ttlcache_stats.
+ */
+
+typedef struct _TTLCacheStats {
+
+	/** Number of entries, including any which have expired but not
+	 *  yet been removed. */
+
+    unsigned int entries;
+
+	/** Number of calls to @ref ttlcache_get or @ref ttlcache_getCopy
+	 *  which found a live entry. */
+
+    unsigned long hits;
+
+	/** Number of those calls which did not. */
+
+    unsigned long misses;
+
+	/** Hits as a fraction of all lookups, or zero if there have been
+	 *  none. */
+
+    double hitRate;
+
+	/** Number of entries removed because they expired, either when
+	 *  looked up or by a sweep. */
+
+    unsigned long expirations;
+
+	/** Number of entries evicted because their shard was full. */
+
+    unsigned long evictions;
+} TTLCacheStats;
+
+/**
+ * Retrieve the counts kept by one shard of a TTL cache.
+ *
+ * @param cache                The cache.
+ * @param shard                Index of the shard, less than
+ *                             @ref ttlcache_numShards.
+ * @param stats                Structure to fill in.
+ */
+
+void ttlcache_shardStats(TTLCache *cache, unsigned int shard,
+                         TTLCacheStats *stats);
+
+/**
+ * Retrieve the counts kept by a TTL cache, totalled over all shards.
+ *
+ * @param cache                The cache.
+ * @param stats                Structure to fill in.
+ */
+
+void ttlcache_stats(TTLCache *cache, TTLCacheStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef DSTTLCACHE_H */
+
@@ -0,0 +1,194 @@
+/* Throughput of ConcurrentHashTable against a HashTable behind one
+ * global mutex, for increasing numbers of threads.
+ *
+ * Usage: concurrenthashtablebench [maxThreads [opsPerThread [readPercent]]]
+ *
+ * Each thread runs a random mix of lookups, inserts and removes over a
+ * fixed range of keys, half of which are in the table at the start. */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "dscompareint.h"
+#include "dsconcurrenthashtable.h"
+#include "dshashint.h"
+#include "dshashtable.h"
+
+#define NUM_KEYS 1000000
+#define NUM_SHARDS 64
+
+static int keys[NUM_KEYS];
+
+static unsigned int opsPerThread = 2000000;
+static unsigned int readPercent = 90;
+
+static ConcurrentHashTable *concurrentTable;
+static HashTable *lockedTable;
+static pthread_mutex_t tableLock = PTHREAD_MUTEX_INITIALIZER;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* xorshift32, so that threads do not share the state of rand() */
+
+static unsigned int nextRandom(unsigned int *state)
+{
+    unsigned int x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+static void *concurrentWorker(void *arg)
+{
+    unsigned int state = (unsigned int) (size_t) arg * 2654435761U + 1;
+    unsigned int i;
+    int *key;
+    unsigned int op;
+
+    for (i=0; i<opsPerThread; ++i) {
+        key = &keys[nextRandom(&state) % NUM_KEYS];
+        op = nextRandom(&state) % 100;
+
+        if (op < readPercent) {
+            concurrenthashtable_lookup(concurrentTable, key);
+        } else if (op % 2 == 0) {
+            concurrenthashtable_insert(concurrentTable, key, key);
+        } else {
+            concurrenthashtable_remove(concurrentTable, key);
+        }
+    }
+
+    return NULL;
+}
+
+static void *lockedWorker(void *arg)
+{
+    unsigned int state = (unsigned int) (size_t) arg * 2654435761U + 1;
+    unsigned int i;
+    int *key;
+    unsigned int op;
+
+    for (i=0; i<opsPerThread; ++i) {
+        key = &keys[nextRandom(&state) % NUM_KEYS];
+        op = nextRandom(&state) % 100;
+
+        pthread_mutex_lock(&tableLock);
+
+        if (op < readPercent) {
+            hashtable_lookup(lockedTable, key);
+        } else if (op % 2 == 0) {
+            hashtable_insert(lockedTable, key, key);
+        } else {
+            hashtable_remove(lockedTable, key);
+        }
+
+        pthread_mutex_unlock(&tableLock);
+    }
+
+    return NULL;
+}
+
+/* Run a worker on a number of threads, returning millions of operations
+ * per second */
+
+static double run(void *(*worker)(void *), unsigned int numThreads)
+{
+    pthread_t threads[256];
+    double start;
+    double elapsed;
+    unsigned int i;
+
+    start = now();
+
+    for (i=0; i<numThreads; ++i) {
+        pthread_create(&threads[i], NULL, worker, (void *) (size_t) (i + 1));
+    }
+
+    for (i=0; i<numThreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    elapsed = now() - start;
+
+    return (double) opsPerThread * numThreads / elapsed / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int maxThreads = 8;
+    unsigned int numThreads;
+    double concurrentRate;
+    double lockedRate;
+    unsigned int i;
+
+    if (argc > 1) {
+        maxThreads = (unsigned int) atoi(argv[1]);
+    }
+
+    if (argc > 2) {
+        opsPerThread = (unsigned int) atoi(argv[2]);
+    }
+
+    if (argc > 3) {
+        readPercent = (unsigned int) atoi(argv[3]);
+    }
+
+    if (maxThreads < 1 || maxThreads > 256) {
+        fprintf(stderr, "maxThreads must be from 1 to 256\n");
+
+        return 1;
+    }
+
+    for (i=0; i<NUM_KEYS; ++i) {
+        keys[i] = (int) i;
+    }
+
+    printf("%u operations per thread, %u%% lookups, %d keys\n",
+           opsPerThread, readPercent, NUM_KEYS);
+    printf("threads  concurrent Mops/s  global mutex Mops/s  speedup\n");
+
+    for (numThreads=1; numThreads<=maxThreads; numThreads*=2) {
+        concurrentTable = concurrenthashtable_new(intHash, intEqual,
+                                                  NUM_SHARDS);
+        lockedTable = hashtable_new(intHash, intEqual);
+
+        if (concurrentTable == NULL || lockedTable == NULL) {
+            fprintf(stderr, "out of memory\n");
+
+            return 1;
+        }
+
+        for (i=0; i<NUM_KEYS; i+=2) {
+            concurrenthashtable_insert(concurrentTable, &keys[i], &keys[i]);
+            hashtable_insert(lockedTable, &keys[i], &keys[i]);
+        }
+
+        concurrentRate = run(concurrentWorker, numThreads);
+        lockedRate = run(lockedWorker, numThreads);
+
+        printf("%7u  %18.2f  %19.2f  %7.2fx\n", numThreads,
+               concurrentRate, lockedRate, concurrentRate / lockedRate);
+
+        concurrenthashtable_free(concurrentTable);
+        hashtable_free(lockedTable);
+    }
+
+    return 0;
+}
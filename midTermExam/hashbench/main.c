@@ -0,0 +1,128 @@
+/* Throughput of stringHash (djb2) against fastStringHash and
+ * hash64_bytes (wyhash), for keys from 4 bytes to 4 KB.
+ *
+ * Usage: hashbench [megabytesPerRun]
+ *
+ * For each key length, a set of different keys of that length is
+ * hashed over and over until the given amount of data has been hashed.
+ * The keys are small enough to stay in the cache, so this measures the
+ * hash functions rather than memory.  fastStringHash and stringHash
+ * must find the end of each string; hash64_bytes is given its length. */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dshash64.h"
+#include "dshashstring.h"
+
+#define NUM_KEYS 64
+#define MAX_LENGTH 4096
+
+static char keys[NUM_KEYS][MAX_LENGTH + 1];
+
+/* Every hash is added in here and printed, so that the compiler can
+ * not leave out the calls */
+
+static uint64_t sink;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double timeStringHash(unsigned int (*hashFunc)(void *),
+                             unsigned int numRounds)
+{
+    double start = now();
+    unsigned int round;
+    unsigned int i;
+
+    for (round=0; round<numRounds; ++round) {
+        for (i=0; i<NUM_KEYS; ++i) {
+            sink += hashFunc(keys[i]);
+        }
+    }
+
+    return now() - start;
+}
+
+static double timeHash64Bytes(size_t length, unsigned int numRounds)
+{
+    double start = now();
+    unsigned int round;
+    unsigned int i;
+
+    for (round=0; round<numRounds; ++round) {
+        for (i=0; i<NUM_KEYS; ++i) {
+            sink += hash64_bytes(keys[i], length, 0);
+        }
+    }
+
+    return now() - start;
+}
+
+int main(int argc, char *argv[])
+{
+    double megabytes = 256;
+    double bytes;
+    unsigned int numRounds;
+    size_t length;
+    unsigned int i;
+    size_t j;
+
+    if (argc > 1) {
+        megabytes = atof(argv[1]);
+    }
+
+    if (megabytes <= 0) {
+        fprintf(stderr, "megabytesPerRun must be positive\n");
+
+        return 1;
+    }
+
+	/* Random printable characters, so that no key ends early */
+
+    srand(1);
+
+    for (i=0; i<NUM_KEYS; ++i) {
+        for (j=0; j<MAX_LENGTH; ++j) {
+            keys[i][j] = (char) ('!' + rand() % 94);
+        }
+    }
+
+    printf("%g MB hashed per function and length, GB/s\n", megabytes);
+    printf("length  stringHash  fastStringHash  hash64_bytes\n");
+
+    for (length=4; length<=MAX_LENGTH; length*=2) {
+        for (i=0; i<NUM_KEYS; ++i) {
+            keys[i][length] = '\0';
+        }
+
+        numRounds = (unsigned int) (megabytes * 1e6 / length / NUM_KEYS) + 1;
+        bytes = (double) numRounds * NUM_KEYS * length;
+
+        printf("%6u  %10.2f  %14.2f  %12.2f\n", (unsigned int) length,
+               bytes / timeStringHash(stringHash, numRounds) / 1e9,
+               bytes / timeStringHash(fastStringHash, numRounds) / 1e9,
+               bytes / timeHash64Bytes(length, numRounds) / 1e9);
+
+        for (i=0; i<NUM_KEYS; ++i) {
+            keys[i][length] = (char) ('!' + rand() % 94);
+        }
+    }
+
+    printf("(checksum %llx)\n", (unsigned long long) sink);
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+QMAKE_CFLAGS += -std=c11
+INCLUDEPATH += ../cdatastructures
+
+SOURCES += \
+        main.c \
+        ../cdatastructures/dshashint.c \
+        ../cdatastructures/dshashpointer.c
@@ -0,0 +1,168 @@
+/* Distribution of intHash and pointerHash against intHashMix and
+ * pointerHashMix in power of two tables.
+ *
+ * Usage: hashdistbench [log2Buckets]
+ *
+ * For each pattern of keys, as many keys as there are buckets are
+ * placed in the bucket chosen by the low bits of their hash, as a table
+ * indexed with a mask would place them.  The fraction of buckets used,
+ * the longest chain and the average number of keys compared by a
+ * lookup which finds its key are printed.  With a hash which spreads
+ * the keys evenly at random, about 63% of buckets are used and a lookup
+ * compares 1.5 keys on average. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dshashint.h"
+#include "dshashpointer.h"
+
+typedef struct {
+    int id;
+    double weight;
+    void *data;
+} Record;
+
+static unsigned int log2Buckets = 16;
+static unsigned int numBuckets;
+static unsigned int *chainLengths;
+
+static void printDistribution(const char *pattern, const char *hashName,
+                              unsigned int (*hashFunc)(void *),
+                              void **keys)
+{
+    unsigned int mask = numBuckets - 1;
+    unsigned int used = 0;
+    unsigned int longest = 0;
+    double compares = 0;
+    unsigned int length;
+    unsigned int i;
+
+    for (i=0; i<numBuckets; ++i) {
+        chainLengths[i] = 0;
+    }
+
+    for (i=0; i<numBuckets; ++i) {
+        ++chainLengths[hashFunc(keys[i]) & mask];
+    }
+
+	/* A lookup for the k-th key of a chain compares k keys */
+
+    for (i=0; i<numBuckets; ++i) {
+        length = chainLengths[i];
+
+        if (length > 0) {
+            ++used;
+            compares += (double) length * (length + 1) / 2;
+        }
+
+        if (length > longest) {
+            longest = length;
+        }
+    }
+
+    printf("%-22s  %-14s  %6.1f%%  %7u  %8.2f\n", pattern, hashName,
+           100.0 * used / numBuckets, longest, compares / numBuckets);
+}
+
+int main(int argc, char *argv[])
+{
+    void **keys;
+    int *ints;
+    Record *records;
+    void **blocks;
+    unsigned int i;
+
+    if (argc > 1) {
+        log2Buckets = (unsigned int) atoi(argv[1]);
+    }
+
+    if (log2Buckets < 4 || log2Buckets > 24) {
+        fprintf(stderr, "log2Buckets must be from 4 to 24\n");
+
+        return 1;
+    }
+
+    numBuckets = 1U << log2Buckets;
+    chainLengths = malloc(numBuckets * sizeof(unsigned int));
+    keys = malloc(numBuckets * sizeof(void *));
+    ints = malloc(numBuckets * sizeof(int));
+    records = malloc(numBuckets * sizeof(Record));
+    blocks = malloc(numBuckets * sizeof(void *));
+
+    if (chainLengths == NULL || keys == NULL || ints == NULL
+     || records == NULL || blocks == NULL) {
+        fprintf(stderr, "out of memory\n");
+
+        return 1;
+    }
+
+    printf("%u keys in %u buckets\n", numBuckets, numBuckets);
+    printf("%-22s  %-14s  %7s  %7s  %8s\n", "keys", "hash", "used",
+           "longest", "compares");
+
+    for (i=0; i<numBuckets; ++i) {
+        keys[i] = &ints[i];
+    }
+
+	/* Sequential IDs, IDs spaced by a power of two, and IDs which only
+	 * differ in their high bits */
+
+    for (i=0; i<numBuckets; ++i) {
+        ints[i] = (int) i;
+    }
+
+    printDistribution("sequential ints", "intHash", intHash, keys);
+    printDistribution("sequential ints", "intHashMix", intHashMix, keys);
+
+    for (i=0; i<numBuckets; ++i) {
+        ints[i] = (int) (i * 64);
+    }
+
+    printDistribution("ints spaced by 64", "intHash", intHash, keys);
+    printDistribution("ints spaced by 64", "intHashMix", intHashMix, keys);
+
+    for (i=0; i<numBuckets; ++i) {
+        ints[i] = (int) ((i << 16) | (i >> 16));
+    }
+
+    printDistribution("ints in high bits", "intHash", intHash, keys);
+    printDistribution("ints in high bits", "intHashMix", intHashMix, keys);
+
+	/* Pointers to the elements of an array of structures, and to
+	 * separately allocated blocks */
+
+    for (i=0; i<numBuckets; ++i) {
+        keys[i] = &records[i];
+    }
+
+    printDistribution("array elements", "pointerHash", pointerHash, keys);
+    printDistribution("array elements", "pointerHashMix", pointerHashMix,
+                      keys);
+
+    for (i=0; i<numBuckets; ++i) {
+        blocks[i] = malloc(32);
+
+        if (blocks[i] == NULL) {
+            fprintf(stderr, "out of memory\n");
+
+            return 1;
+        }
+    }
+
+    printDistribution("malloc'd blocks", "pointerHash", pointerHash, blocks);
+    printDistribution("malloc'd blocks", "pointerHashMix", pointerHashMix,
+                      blocks);
+
+    for (i=0; i<numBuckets; ++i) {
+        free(blocks[i]);
+    }
+
+    free(chainLengths);
+    free(keys);
+    free(ints);
+    free(records);
+    free(blocks);
+
+    return 0;
+}
@@ -0,0 +1,20 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+QMAKE_CFLAGS += -std=c11
+INCLUDEPATH += ../cdatastructures
+
+SOURCES += \
+        main.c \
+        ../cdatastructures/dsallocator.c \
+        ../cdatastructures/dsavltree.c \
+        ../cdatastructures/dscompareint.c \
+        ../cdatastructures/dshash64.c \
+        ../cdatastructures/dshashint.c \
+        ../cdatastructures/dshashtable.c \
+        ../cdatastructures/dsset.c \
+        ../cdatastructures/dsslab.c
+
+unix: LIBS += -lpthread
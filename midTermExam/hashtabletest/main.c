@@ -0,0 +1,879 @@
+/* Randomized test of HashTable and Set against a reference model.
+ *
+ * Usage: hashtabletest [numOperations [seed]]
+ *
+ * Each configuration of the table (both engines, with and without
+ * incremental resizing, power of two sizes and a slab) is run with a
+ * plain hash, a hash which sends every key to one of a few values with
+ * the long chain guard enabled, and a seeded hash.  A random mix of
+ * inserts, removes, lookups, hashtable_lookupOrInsert,
+ * hashtable_update and hashtable_lookupBatch is applied to the table
+ * and to a plain array of the expected value for each key, and the two
+ * are compared after every operation and, in full, at intervals.
+ *
+ * Each run then removes entries while iterating over the table, fills
+ * the table after hashtable_reserve and checks that it is not resized,
+ * and checks that it is made smaller by hashtable_compact and by an
+ * insert after most entries are removed.  The free functions must be
+ * called once for each key and value the table lets go of, and the
+ * memory the table reports must match what its allocator handed out.
+ * Sets are given the same treatment, without the engine and hash
+ * variations. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dscompareint.h"
+#include "dshash64.h"
+#include "dshashint.h"
+#include "dshashtable.h"
+#include "dsset.h"
+
+#define MAX_KEYS 20000
+#define COLLIDING_KEYS 1000
+#define NUM_VALUES 64
+
+/* Stop the current run, reporting where it failed */
+
+#define CHECK(condition)                                                 \
+    do {                                                                 \
+        if (!(condition)) {                                              \
+            fprintf(stderr, "%s: operation %u: line %d: %s\n",           \
+                    testName, operation, __LINE__, #condition);          \
+            return 0;                                                    \
+        }                                                                \
+    } while (0)
+
+typedef enum {
+    HASH_MODE_PLAIN,
+    HASH_MODE_COLLIDING,
+    HASH_MODE_SEEDED
+} HashMode;
+
+typedef struct {
+    HashTableEngine engine;
+    int incremental;
+    int powerOfTwo;
+    int slab;
+    HashMode hashMode;
+} TestConfig;
+
+static unsigned int numOperations = 100000;
+static uint64_t randomState = 1;
+
+static char testName[96];
+static unsigned int operation;
+
+static int keys[MAX_KEYS];
+static int values[NUM_VALUES];
+
+/* Index of the value expected for each key, or -1 if the key should
+ * not be in the table */
+
+static int model[MAX_KEYS];
+static unsigned int modelEntries;
+static unsigned int numKeys;
+
+static unsigned long keysFreed;
+static unsigned long valuesFreed;
+
+/* Bytes and blocks held by the test allocator */
+
+static size_t allocatedBytes;
+static size_t allocatedBlocks;
+
+static uint64_t nextRandom(void)
+{
+    /* xorshift64* */
+
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static unsigned int randomBelow(unsigned int n)
+{
+    return (unsigned int) ((nextRandom() >> 32) % n);
+}
+
+/* An allocator which counts what it hands out, so that the memory a
+ * table reports can be checked and leaks found */
+
+static void *countingAllocate(void *context, size_t size)
+{
+    void *block = malloc(size);
+
+    (void) context;
+
+    if (block != NULL) {
+        allocatedBytes += size;
+        ++allocatedBlocks;
+    }
+
+    return block;
+}
+
+static void *countingAllocateZeroed(void *context, size_t size)
+{
+    void *block = calloc(1, size);
+
+    (void) context;
+
+    if (block != NULL) {
+        allocatedBytes += size;
+        ++allocatedBlocks;
+    }
+
+    return block;
+}
+
+static void countingRelease(void *context, void *block, size_t size)
+{
+    (void) context;
+
+    allocatedBytes -= size;
+    --allocatedBlocks;
+    free(block);
+}
+
+static const Allocator countingAllocator = {
+    countingAllocate, NULL, countingRelease, NULL, NULL
+};
+
+static const Allocator countingZeroedAllocator = {
+    countingAllocate, NULL, countingRelease, NULL, countingAllocateZeroed
+};
+
+static void keyFree(void *key)
+{
+    (void) key;
+
+    ++keysFreed;
+}
+
+static void valueFree(void *value)
+{
+    (void) value;
+
+    ++valuesFreed;
+}
+
+/* Sends every key to one of eight hashes */
+
+static unsigned int collidingHash(void *key)
+{
+    return (unsigned int) *(int *) key & 7;
+}
+
+static unsigned int seededIntHash(void *key, uint64_t seed)
+{
+    return (unsigned int) hash64_bytes(key, sizeof(int), seed);
+}
+
+/* Replaces a value with the next one, or adds the first */
+
+static HashTableValue nextValue(HashTableValue value, void *context)
+{
+    (void) context;
+
+    if (value == HASH_TABLE_NULL) {
+        return &values[0];
+    }
+
+    return &values[(*(int *) value + 1) % NUM_VALUES];
+}
+
+static void resetModel(unsigned int keyCount)
+{
+    unsigned int i;
+
+    for (i=0; i<keyCount; ++i) {
+        model[i] = -1;
+    }
+
+    numKeys = keyCount;
+    modelEntries = 0;
+    keysFreed = 0;
+    valuesFreed = 0;
+
+    /* A failed run leaves its table allocated, so the count starts
+     * again */
+
+    allocatedBytes = 0;
+    allocatedBlocks = 0;
+}
+
+/* Compare the whole table with the model */
+
+static int checkTable(HashTable *hashTable)
+{
+    static HashTableKey batchKeys[MAX_KEYS];
+    static HashTableValue batchValues[MAX_KEYS];
+    static unsigned char seen[MAX_KEYS];
+    HashTableIterator iterator;
+    HashTablePair pair;
+    HashTableStats stats;
+    HashTableValue value;
+    unsigned long histogramTotal;
+    unsigned int numSeen;
+    unsigned int i;
+    int key;
+
+    CHECK(hashtable_numEntries(hashTable) == modelEntries);
+    CHECK(hashtable_memoryUsage(hashTable) == allocatedBytes);
+
+    for (i=0; i<numKeys; ++i) {
+        value = hashtable_lookup(hashTable, &keys[i]);
+
+        if (model[i] < 0) {
+            CHECK(value == HASH_TABLE_NULL);
+        } else {
+            CHECK(value == &values[model[i]]);
+        }
+
+        batchKeys[i] = &keys[i];
+        seen[i] = 0;
+    }
+
+    hashtable_lookupBatch(hashTable, batchKeys, numKeys, batchValues);
+
+    for (i=0; i<numKeys; ++i) {
+        if (model[i] < 0) {
+            CHECK(batchValues[i] == HASH_TABLE_NULL);
+        } else {
+            CHECK(batchValues[i] == &values[model[i]]);
+        }
+    }
+
+    /* Every entry must be returned exactly once */
+
+    numSeen = 0;
+    hashtable_iterate(hashTable, &iterator);
+
+    while (hashtable_iteratorHasMore(&iterator)) {
+        pair = hashtable_iteratorNext(&iterator);
+        key = *(int *) pair.key;
+
+        CHECK(key >= 0 && (unsigned int) key < numKeys);
+        CHECK(pair.key == &keys[key]);
+        CHECK(model[key] >= 0 && pair.value == &values[model[key]]);
+        CHECK(!seen[key]);
+
+        seen[key] = 1;
+        ++numSeen;
+    }
+
+    CHECK(numSeen == modelEntries);
+
+    /* The histogram counts chains for the chained engine, and entries
+     * for the flat engine */
+
+    hashtable_stats(hashTable, &stats);
+
+    CHECK(stats.entries == modelEntries);
+    CHECK(stats.bytesUsed == allocatedBytes);
+
+    histogramTotal = 0;
+
+    for (i=0; i<HASH_TABLE_STATS_HISTOGRAM_SIZE; ++i) {
+        histogramTotal += stats.chainLengths[i];
+    }
+
+    CHECK(histogramTotal == stats.buckets || histogramTotal == stats.entries);
+
+    return 1;
+}
+
+/* Apply one random operation to the table and the model */
+
+static int randomOperation(HashTable *hashTable)
+{
+    HashTableValue *slot;
+    HashTableValue value;
+    HashTableKey batchKeys[16];
+    HashTableValue batchValues[16];
+    unsigned int choice = randomBelow(100);
+    unsigned int key = randomBelow(numKeys);
+    unsigned int valueIndex = randomBelow(NUM_VALUES);
+    unsigned long expectedKeysFreed = keysFreed;
+    unsigned long expectedValuesFreed = valuesFreed;
+    unsigned int i;
+    int inserted;
+
+    if (choice < 30) {
+
+        /* An insert over an existing entry frees its key and value */
+
+        CHECK(hashtable_insert(hashTable, &keys[key], &values[valueIndex]));
+
+        if (model[key] >= 0) {
+            ++expectedKeysFreed;
+            ++expectedValuesFreed;
+        } else {
+            ++modelEntries;
+        }
+
+        model[key] = (int) valueIndex;
+
+    } else if (choice < 50) {
+        CHECK(hashtable_remove(hashTable, &keys[key]) == (model[key] >= 0));
+
+        if (model[key] >= 0) {
+            ++expectedKeysFreed;
+            ++expectedValuesFreed;
+            --modelEntries;
+            model[key] = -1;
+        }
+
+    } else if (choice < 70) {
+        value = hashtable_lookup(hashTable, &keys[key]);
+
+        if (model[key] < 0) {
+            CHECK(value == HASH_TABLE_NULL);
+        } else {
+            CHECK(value == &values[model[key]]);
+        }
+
+    } else if (choice < 80) {
+
+        /* The value may be written through the pointer returned */
+
+        slot = hashtable_lookupOrInsert(hashTable, &keys[key],
+                                        &values[valueIndex], &inserted);
+
+        CHECK(slot != NULL);
+        CHECK(inserted == (model[key] < 0));
+
+        if (inserted) {
+            CHECK(*slot == &values[valueIndex]);
+            ++modelEntries;
+            model[key] = (int) valueIndex;
+        } else {
+            CHECK(*slot == &values[model[key]]);
+        }
+
+        if (randomBelow(2)) {
+            *slot = &values[valueIndex];
+            model[key] = (int) valueIndex;
+        }
+
+    } else if (choice < 90) {
+
+        /* nextValue always changes the value, so an existing one is
+         * freed */
+
+        CHECK(hashtable_update(hashTable, &keys[key], nextValue, NULL));
+
+        if (model[key] < 0) {
+            ++modelEntries;
+            model[key] = 0;
+        } else {
+            ++expectedValuesFreed;
+            model[key] = (model[key] + 1) % NUM_VALUES;
+        }
+
+    } else {
+        for (i=0; i<16; ++i) {
+            batchKeys[i] = &keys[randomBelow(numKeys)];
+        }
+
+        hashtable_lookupBatch(hashTable, batchKeys, 16, batchValues);
+
+        for (i=0; i<16; ++i) {
+            key = (unsigned int) *(int *) batchKeys[i];
+
+            if (model[key] < 0) {
+                CHECK(batchValues[i] == HASH_TABLE_NULL);
+            } else {
+                CHECK(batchValues[i] == &values[model[key]]);
+            }
+        }
+    }
+
+    CHECK(keysFreed == expectedKeysFreed);
+    CHECK(valuesFreed == expectedValuesFreed);
+    CHECK(hashtable_numEntries(hashTable) == modelEntries);
+
+    return 1;
+}
+
+/* Remove about half of the entries as they are returned by an
+ * iterator.  Every entry must still be returned exactly once. */
+
+static int removeWhileIterating(HashTable *hashTable)
+{
+    static unsigned char seen[MAX_KEYS];
+    HashTableIterator iterator;
+    HashTablePair pair;
+    unsigned int numSeen = 0;
+    unsigned int expected = modelEntries;
+    unsigned int i;
+    int key;
+
+    for (i=0; i<numKeys; ++i) {
+        seen[i] = 0;
+    }
+
+    hashtable_iterate(hashTable, &iterator);
+
+    while (hashtable_iteratorHasMore(&iterator)) {
+        pair = hashtable_iteratorNext(&iterator);
+        key = *(int *) pair.key;
+
+        CHECK(key >= 0 && (unsigned int) key < numKeys);
+        CHECK(model[key] >= 0 && !seen[key]);
+
+        seen[key] = 1;
+        ++numSeen;
+
+        if (randomBelow(2)) {
+            CHECK(hashtable_remove(hashTable, pair.key));
+            model[key] = -1;
+            --modelEntries;
+        }
+    }
+
+    CHECK(numSeen == expected);
+
+    return 1;
+}
+
+static unsigned int numBuckets(HashTable *hashTable)
+{
+    HashTableStats stats;
+
+    hashtable_stats(hashTable, &stats);
+
+    return stats.buckets;
+}
+
+/* Fill the table after reserving room, then empty it, checking when it
+ * may and may not change size */
+
+static int checkResizing(HashTable *hashTable)
+{
+    unsigned int reservedBuckets;
+    unsigned int fullBuckets;
+    unsigned int i;
+
+    CHECK(hashtable_reserve(hashTable, numKeys));
+    reservedBuckets = numBuckets(hashTable);
+
+    for (i=0; i<numKeys; ++i) {
+        if (model[i] < 0) {
+            CHECK(hashtable_insert(hashTable, &keys[i], &values[0]));
+            model[i] = 0;
+            ++modelEntries;
+        }
+    }
+
+    CHECK(numBuckets(hashTable) <= reservedBuckets);
+
+    if (!checkTable(hashTable)) {
+        return 0;
+    }
+
+    /* The reserved size is kept as entries are removed */
+
+    fullBuckets = numBuckets(hashTable);
+
+    for (i=1; i<numKeys; ++i) {
+        CHECK(hashtable_remove(hashTable, &keys[i]));
+        model[i] = -1;
+        --modelEntries;
+    }
+
+    CHECK(hashtable_insert(hashTable, &keys[1], &values[1]));
+    model[1] = 1;
+    ++modelEntries;
+
+    if (!checkTable(hashTable)) {
+        return 0;
+    }
+
+    CHECK(numBuckets(hashTable) == fullBuckets);
+
+    /* Until the table is compacted */
+
+    CHECK(hashtable_compact(hashTable));
+    CHECK(numBuckets(hashTable) < fullBuckets);
+
+    if (!checkTable(hashTable)) {
+        return 0;
+    }
+
+    /* Without a reservation, an insert shrinks a table which removes
+     * have left mostly empty.  Lookups complete any incremental
+     * resize before the size is compared. */
+
+    for (i=2; i<numKeys; ++i) {
+        CHECK(hashtable_insert(hashTable, &keys[i], &values[2]));
+        model[i] = 2;
+        ++modelEntries;
+    }
+
+    if (!checkTable(hashTable)) {
+        return 0;
+    }
+
+    fullBuckets = numBuckets(hashTable);
+
+    for (i=2; i<numKeys; ++i) {
+        CHECK(hashtable_remove(hashTable, &keys[i]));
+        model[i] = -1;
+        --modelEntries;
+    }
+
+    CHECK(hashtable_insert(hashTable, &keys[2], &values[2]));
+    model[2] = 2;
+    ++modelEntries;
+
+    if (!checkTable(hashTable)) {
+        return 0;
+    }
+
+    CHECK(numBuckets(hashTable) < fullBuckets);
+
+    return 1;
+}
+
+static int runHashTableTest(const TestConfig *config, unsigned int index)
+{
+    static const char *hashModeNames[] = { "plain", "colliding", "seeded" };
+    const Allocator *allocator;
+    HashTable *hashTable;
+    HashTableHashFunc hashFunc;
+    unsigned int checkInterval;
+    unsigned long expectedKeysFreed;
+    unsigned long expectedValuesFreed;
+
+    sprintf(testName, "%s incremental=%d powerOfTwo=%d slab=%d %s",
+            config->engine == HASH_TABLE_ENGINE_FLAT ? "flat" : "chained",
+            config->incremental, config->powerOfTwo, config->slab,
+            hashModeNames[config->hashMode]);
+    operation = 0;
+
+    resetModel(config->hashMode == HASH_MODE_COLLIDING ? COLLIDING_KEYS
+                                                         : MAX_KEYS);
+
+    /* Every third run uses an allocator without a zeroed allocate
+     * function */
+
+    allocator = index % 3 == 0 ? &countingAllocator
+                               : &countingZeroedAllocator;
+    hashFunc = config->hashMode == HASH_MODE_COLLIDING ? collidingHash
+                                                         : intHash;
+
+    hashTable = hashtable_newWithAllocator(hashFunc, intEqual,
+                                           config->engine, allocator);
+
+    CHECK(hashTable != NULL);
+
+    hashtable_registerFreeFunctions(hashTable, keyFree, valueFree);
+    hashtable_setIncrementalResize(hashTable, config->incremental);
+
+    CHECK(hashtable_setPowerOfTwoSize(hashTable, config->powerOfTwo));
+
+    if (config->slab) {
+        CHECK(hashtable_useSlab(hashTable));
+    }
+
+    if (config->hashMode == HASH_MODE_COLLIDING) {
+        hashtable_setChainGuard(hashTable, intCompare);
+    } else if (config->hashMode == HASH_MODE_SEEDED) {
+        CHECK(hashtable_setSeededHash(hashTable, seededIntHash));
+    }
+
+    checkInterval = numOperations / 8 + 1;
+
+    for (operation=1; operation<=numOperations; ++operation) {
+        if (!randomOperation(hashTable)) {
+            return 0;
+        }
+
+        if (operation % checkInterval == 0 && !checkTable(hashTable)) {
+            return 0;
+        }
+    }
+
+    /* Only the entry just returned may be removed while iterating, and
+     * not during an incremental resize, which compacting completes */
+
+    if (config->incremental) {
+        CHECK(hashtable_compact(hashTable));
+    }
+
+    if (!removeWhileIterating(hashTable) || !checkTable(hashTable)) {
+        return 0;
+    }
+
+    if (!checkResizing(hashTable)) {
+        return 0;
+    }
+
+    /* Every removed entry has been freed once, and the rest are freed
+     * with the table */
+
+    expectedKeysFreed = keysFreed + modelEntries;
+    expectedValuesFreed = valuesFreed + modelEntries;
+
+    hashtable_free(hashTable);
+
+    CHECK(keysFreed == expectedKeysFreed);
+    CHECK(valuesFreed == expectedValuesFreed);
+    CHECK(allocatedBytes == 0 && allocatedBlocks == 0);
+
+    printf("%-52s ok\n", testName);
+
+    return 1;
+}
+
+static int checkSet(Set *set)
+{
+    static unsigned char seen[MAX_KEYS];
+    SetIterator iterator;
+    SetValue *array;
+    unsigned int numSeen = 0;
+    unsigned int i;
+    int key;
+
+    CHECK(set_numEntries(set) == modelEntries);
+    CHECK(set_memoryUsage(set) == allocatedBytes);
+
+    for (i=0; i<numKeys; ++i) {
+        CHECK(set_query(set, &keys[i]) == (model[i] >= 0));
+        seen[i] = 0;
+    }
+
+    set_iterate(set, &iterator);
+
+    while (set_iteratorHasMore(&iterator)) {
+        key = *(int *) set_iteratorNext(&iterator);
+
+        CHECK(key >= 0 && (unsigned int) key < numKeys);
+        CHECK(model[key] >= 0 && !seen[key]);
+
+        seen[key] = 1;
+        ++numSeen;
+    }
+
+    CHECK(numSeen == modelEntries);
+
+    array = set_toArray(set);
+
+    CHECK(array != NULL);
+
+    for (i=0; i<modelEntries; ++i) {
+        key = *(int *) array[i];
+
+        CHECK(seen[key] == 1);
+        seen[key] = 2;
+    }
+
+    free(array);
+
+    return 1;
+}
+
+static int runSetTest(int incremental, int powerOfTwo, int slab)
+{
+    SetIterator iterator;
+    SetValue value;
+    Set *set;
+    unsigned long expectedFreed;
+    unsigned int checkInterval;
+    size_t sizeBefore;
+    unsigned int key;
+    unsigned int i;
+    int added;
+
+    sprintf(testName, "set incremental=%d powerOfTwo=%d slab=%d",
+            incremental, powerOfTwo, slab);
+    operation = 0;
+
+    resetModel(MAX_KEYS);
+
+    set = set_newWithAllocator(intHash, intEqual, &countingZeroedAllocator);
+
+    CHECK(set != NULL);
+
+    set_registerFreeFunction(set, valueFree);
+    set_setIncrementalResize(set, incremental);
+
+    CHECK(set_setPowerOfTwoSize(set, powerOfTwo));
+
+    if (slab) {
+        CHECK(set_useSlab(set));
+    }
+
+    checkInterval = numOperations / 8 + 1;
+
+    for (operation=1; operation<=numOperations; ++operation) {
+        key = randomBelow(numKeys);
+        expectedFreed = valuesFreed;
+
+        switch (randomBelow(3)) {
+        case 0:
+
+            /* Adding a value already in the set leaves it unchanged */
+
+            added = set_insert(set, &keys[key]);
+
+            CHECK(added == (model[key] < 0));
+
+            if (added) {
+                model[key] = 0;
+                ++modelEntries;
+            }
+            break;
+
+        case 1:
+            CHECK(set_remove(set, &keys[key]) == (model[key] >= 0));
+
+            if (model[key] >= 0) {
+                model[key] = -1;
+                --modelEntries;
+                ++expectedFreed;
+            }
+            break;
+
+        default:
+            CHECK(set_query(set, &keys[key]) == (model[key] >= 0));
+            break;
+        }
+
+        CHECK(valuesFreed == expectedFreed);
+        CHECK(set_numEntries(set) == modelEntries);
+
+        if (operation % checkInterval == 0 && !checkSet(set)) {
+            return 0;
+        }
+    }
+
+    /* Remove about half the values while iterating */
+
+    if (incremental) {
+        CHECK(set_compact(set));
+    }
+
+    set_iterate(set, &iterator);
+
+    while (set_iteratorHasMore(&iterator)) {
+        value = set_iteratorNext(&iterator);
+
+        if (randomBelow(2)) {
+            CHECK(set_remove(set, value));
+            model[*(int *) value] = -1;
+            --modelEntries;
+        }
+    }
+
+    if (!checkSet(set)) {
+        return 0;
+    }
+
+    /* Fill the set, then check that removing almost everything and
+     * adding one value shrinks it, as does compacting */
+
+    for (i=0; i<numKeys; ++i) {
+        if (model[i] < 0) {
+            CHECK(set_insert(set, &keys[i]));
+            model[i] = 0;
+            ++modelEntries;
+        }
+    }
+
+    sizeBefore = set_memoryUsage(set);
+
+    for (i=1; i<numKeys; ++i) {
+        CHECK(set_remove(set, &keys[i]));
+        model[i] = -1;
+        --modelEntries;
+    }
+
+    CHECK(set_insert(set, &keys[1]));
+    model[1] = 0;
+    ++modelEntries;
+
+    if (!checkSet(set)) {
+        return 0;
+    }
+
+    CHECK(set_memoryUsage(set) < sizeBefore);
+    sizeBefore = set_memoryUsage(set);
+
+    CHECK(set_compact(set));
+    CHECK(set_memoryUsage(set) < sizeBefore);
+
+    if (!checkSet(set)) {
+        return 0;
+    }
+
+    expectedFreed = valuesFreed + modelEntries;
+
+    set_free(set);
+
+    CHECK(valuesFreed == expectedFreed);
+    CHECK(allocatedBytes == 0 && allocatedBlocks == 0);
+
+    printf("%-52s ok\n", testName);
+
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    TestConfig config;
+    unsigned int i;
+    int success = 1;
+
+    if (argc > 1) {
+        numOperations = (unsigned int) atoi(argv[1]);
+    }
+
+    if (argc > 2) {
+        randomState = (uint64_t) atoi(argv[2]);
+    }
+
+    if (numOperations < 1 || numOperations > 100000000) {
+        fprintf(stderr, "numOperations must be from 1 to 100000000\n");
+
+        return 1;
+    }
+
+    if (randomState == 0) {
+        fprintf(stderr, "seed must not be zero\n");
+
+        return 1;
+    }
+
+    for (i=0; i<MAX_KEYS; ++i) {
+        keys[i] = (int) i;
+    }
+
+    for (i=0; i<NUM_VALUES; ++i) {
+        values[i] = (int) i;
+    }
+
+    printf("%u operations per run\n", numOperations);
+
+    for (i=0; i<2 * 2 * 2 * 2 * 3; ++i) {
+        config.engine = i & 1 ? HASH_TABLE_ENGINE_FLAT
+                              : HASH_TABLE_ENGINE_CHAINED;
+        config.incremental = (i >> 1) & 1;
+        config.powerOfTwo = (i >> 2) & 1;
+        config.slab = (i >> 3) & 1;
+        config.hashMode = (HashMode) (i >> 4);
+
+        success &= runHashTableTest(&config, i);
+    }
+
+    for (i=0; i<2 * 2 * 2; ++i) {
+        success &= runSetTest(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+    }
+
+    return success ? 0 : 1;
+}
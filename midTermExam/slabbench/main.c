@@ -0,0 +1,315 @@
+/* Insert/remove churn on node-based containers, with nodes allocated
+ * by malloc and from a slab.
+ *
+ * Usage: slabbench [numOps [liveNodes]]
+ *
+ * Each container is filled with liveNodes entries, then each operation
+ * adds a new entry and removes the oldest one, so the number of nodes
+ * stays the same while every node is freed and allocated again.  The
+ * time to destroy the container afterwards is reported separately. */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "dsavltree.h"
+#include "dscompareint.h"
+#include "dshashint.h"
+#include "dshashtable.h"
+#include "dslist.h"
+#include "dsqueue.h"
+#include "dsredblacktree.h"
+#include "dsset.h"
+#include "dsslab.h"
+
+static int *keys;
+static unsigned int numOps = 2000000;
+static unsigned int liveNodes = 100000;
+
+/* Seconds taken to destroy the container in the last run */
+
+static double freeSeconds;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double churnHashTable(int useSlab)
+{
+    HashTable *hashTable = hashtable_new(intHash, intEqual);
+    double start;
+    unsigned int i;
+
+    if (useSlab) {
+        hashtable_useSlab(hashTable);
+    }
+
+    for (i=0; i<liveNodes; ++i) {
+        hashtable_insert(hashTable, &keys[i], &keys[i]);
+    }
+
+    start = now();
+
+    for (i=0; i<numOps; ++i) {
+        hashtable_insert(hashTable, &keys[i + liveNodes], &keys[i]);
+        hashtable_remove(hashTable, &keys[i]);
+    }
+
+    start = now() - start;
+
+    freeSeconds = now();
+    hashtable_free(hashTable);
+    freeSeconds = now() - freeSeconds;
+
+    return start;
+}
+
+static double churnSet(int useSlab)
+{
+    Set *set = set_new(intHash, intEqual);
+    double start;
+    unsigned int i;
+
+    if (useSlab) {
+        set_useSlab(set);
+    }
+
+    for (i=0; i<liveNodes; ++i) {
+        set_insert(set, &keys[i]);
+    }
+
+    start = now();
+
+    for (i=0; i<numOps; ++i) {
+        set_insert(set, &keys[i + liveNodes]);
+        set_remove(set, &keys[i]);
+    }
+
+    start = now() - start;
+
+    freeSeconds = now();
+    set_free(set);
+    freeSeconds = now() - freeSeconds;
+
+    return start;
+}
+
+static double churnAVLTree(int useSlab)
+{
+    AVLTree *tree = avltree_new(intCompare);
+    double start;
+    unsigned int i;
+
+    if (useSlab) {
+        avltree_useSlab(tree);
+    }
+
+    for (i=0; i<liveNodes; ++i) {
+        avltree_insert(tree, &keys[i], &keys[i]);
+    }
+
+    start = now();
+
+    for (i=0; i<numOps; ++i) {
+        avltree_insert(tree, &keys[i + liveNodes], &keys[i]);
+        avltree_remove(tree, &keys[i]);
+    }
+
+    start = now() - start;
+
+    freeSeconds = now();
+    avltree_free(tree);
+    freeSeconds = now() - freeSeconds;
+
+    return start;
+}
+
+static double churnRBTree(int useSlab)
+{
+    RBTree *tree = rbtree_new(intCompare);
+    double start;
+    unsigned int i;
+
+    if (useSlab) {
+        rbtree_useSlab(tree);
+    }
+
+    for (i=0; i<liveNodes; ++i) {
+        rbtree_insert(tree, &keys[i], &keys[i]);
+    }
+
+    start = now();
+
+    for (i=0; i<numOps; ++i) {
+        rbtree_insert(tree, &keys[i + liveNodes], &keys[i]);
+        rbtree_remove(tree, &keys[i]);
+    }
+
+    start = now() - start;
+
+    freeSeconds = now();
+    rbtree_free(tree);
+    freeSeconds = now() - freeSeconds;
+
+    return start;
+}
+
+static double churnQueue(int useSlab)
+{
+    Queue *queue = queue_new();
+    double start;
+    unsigned int i;
+
+    if (useSlab) {
+        queue_useSlab(queue);
+    }
+
+    for (i=0; i<liveNodes; ++i) {
+        queue_pushTail(queue, &keys[i]);
+    }
+
+    start = now();
+
+    for (i=0; i<numOps; ++i) {
+        queue_pushTail(queue, &keys[i + liveNodes]);
+        queue_popHead(queue);
+    }
+
+    start = now() - start;
+
+    freeSeconds = now();
+    queue_free(queue);
+    freeSeconds = now() - freeSeconds;
+
+    return start;
+}
+
+/* Lists have no container object, so the slab belongs to the caller
+ * and the whole list is released with it */
+
+static double churnList(int useSlab)
+{
+    ListEntry *list = NULL;
+    ListEntry *last = NULL;
+    Slab *slab = useSlab ? list_newSlab() : NULL;
+    double start;
+    unsigned int i;
+
+	/* Appending walks the whole list, so entries are added at the
+	 * front, and the oldest is the last */
+
+    for (i=0; i<liveNodes; ++i) {
+        ListEntry *entry = useSlab
+                         ? list_prependWithSlab(&list, &keys[i], slab)
+                         : list_prepend(&list, &keys[i]);
+
+        if (last == NULL) {
+            last = entry;
+        }
+    }
+
+    start = now();
+
+    for (i=0; i<numOps; ++i) {
+        ListEntry *prev = list_prev(last);
+
+        if (useSlab) {
+            list_prependWithSlab(&list, &keys[i + liveNodes], slab);
+            list_removeEntryWithSlab(&list, last, slab);
+        } else {
+            list_prepend(&list, &keys[i + liveNodes]);
+            list_removeEntry(&list, last);
+        }
+
+        last = prev;
+    }
+
+    start = now() - start;
+
+    freeSeconds = now();
+
+    if (useSlab) {
+        slab_free(slab);
+    } else {
+        list_free(list);
+    }
+
+    freeSeconds = now() - freeSeconds;
+
+    return start;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct {
+        const char *name;
+        double (*churn)(int useSlab);
+    } containers[] = {
+        { "HashTable", churnHashTable },
+        { "Set", churnSet },
+        { "AVLTree", churnAVLTree },
+        { "RBTree", churnRBTree },
+        { "Queue", churnQueue },
+        { "List", churnList },
+    };
+    double mallocSeconds;
+    double mallocFreeSeconds;
+    double slabSeconds;
+    unsigned int i;
+
+    if (argc > 1) {
+        numOps = (unsigned int) atoi(argv[1]);
+    }
+
+    if (argc > 2) {
+        liveNodes = (unsigned int) atoi(argv[2]);
+    }
+
+    if (numOps < 1 || liveNodes < 1 || numOps > 100000000
+     || liveNodes > 100000000) {
+        fprintf(stderr, "numOps and liveNodes must be from 1 to 100000000\n");
+
+        return 1;
+    }
+
+    keys = malloc(((size_t) numOps + liveNodes) * sizeof(int));
+
+    if (keys == NULL) {
+        fprintf(stderr, "out of memory\n");
+
+        return 1;
+    }
+
+    for (i=0; i<numOps + liveNodes; ++i) {
+        keys[i] = (int) i;
+    }
+
+    printf("%u operations, %u live nodes\n", numOps, liveNodes);
+    printf("container  malloc ns/op  slab ns/op  speedup"
+           "  malloc free ms  slab free ms\n");
+
+    for (i=0; i<sizeof(containers) / sizeof(*containers); ++i) {
+        mallocSeconds = containers[i].churn(0);
+        mallocFreeSeconds = freeSeconds;
+        slabSeconds = containers[i].churn(1);
+
+        printf("%-9s  %12.1f  %10.1f  %6.2fx  %14.2f  %12.2f\n",
+               containers[i].name,
+               mallocSeconds * 1e9 / numOps, slabSeconds * 1e9 / numOps,
+               mallocSeconds / slabSeconds,
+               mallocFreeSeconds * 1e3, freeSeconds * 1e3);
+    }
+
+    free(keys);
+
+    return 0;
+}
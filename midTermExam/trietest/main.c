@@ -0,0 +1,613 @@
+/* Randomized test of Trie against a reference model.
+ *
+ * Usage: trietest [numOperations [seed]]
+ *
+ * A pool of keys is generated in which many keys share prefixes longer
+ * than the eight bytes an inner node stores, many keys are prefixes of
+ * others, and some keys hold any byte, including NUL.  The pool is
+ * sorted, and a random mix of inserts, removes and lookups is applied
+ * to the trie and to an array of the expected value for each key,
+ * through both the string and the binary functions.
+ *
+ * At intervals, every key is looked up, trie_longestPrefix is compared
+ * with a search of the model, and trie_iteratePrefix must visit exactly
+ * the present keys starting with a prefix, in the order of the sorted
+ * pool, stopping when asked to.  Finally one node is grown through
+ * every size, by adding children for all 256 bytes, and shrunk again.
+ * The memory the trie reports must match what its allocator handed
+ * out.  All of this is done with and without slabs. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dstrie.h"
+
+#define MAX_KEYS 8000
+#define MAX_KEY_LENGTH 48
+#define NUM_VALUES 64
+
+/* Stop the current run, reporting where it failed */
+
+#define CHECK(condition)                                                 \
+    do {                                                                 \
+        if (!(condition)) {                                              \
+            fprintf(stderr, "%s: operation %u: line %d: %s\n",           \
+                    testName, operation, __LINE__, #condition);          \
+            return 0;                                                    \
+        }                                                                \
+    } while (0)
+
+typedef struct {
+    unsigned char bytes[MAX_KEY_LENGTH + 1];
+    int length;
+} TestKey;
+
+/* State of a check of trie_iteratePrefix */
+
+typedef struct {
+    unsigned int *expected;
+    unsigned int numExpected;
+    unsigned int position;
+    unsigned int limit;
+    int failed;
+} IterateCheck;
+
+static unsigned int numOperations = 200000;
+static uint64_t randomState = 1;
+
+static char testName[64];
+static unsigned int operation;
+
+/* The pool of keys, sorted, and the index of the value expected for
+ * each, or -1 if the key should not be in the trie */
+
+static TestKey keys[MAX_KEYS];
+static unsigned int numKeys;
+static int model[MAX_KEYS];
+static unsigned int modelEntries;
+
+static int values[NUM_VALUES];
+
+/* Bytes held by the test allocator */
+
+static size_t allocatedBytes;
+
+static uint64_t nextRandom(void)
+{
+    /* xorshift64* */
+
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static unsigned int randomBelow(unsigned int n)
+{
+    return (unsigned int) ((nextRandom() >> 32) % n);
+}
+
+static void *countingAllocate(void *context, size_t size)
+{
+    void *block = malloc(size);
+
+    (void) context;
+
+    if (block != NULL) {
+        allocatedBytes += size;
+    }
+
+    return block;
+}
+
+static void countingRelease(void *context, void *block, size_t size)
+{
+    (void) context;
+
+    allocatedBytes -= size;
+    free(block);
+}
+
+static const Allocator countingAllocator = {
+    countingAllocate, NULL, countingRelease, NULL, NULL
+};
+
+/* Order keys by their bytes, with a key before any key it is a prefix
+ * of */
+
+static int compareKeys(const void *location1, const void *location2)
+{
+    const TestKey *key1 = location1;
+    const TestKey *key2 = location2;
+    int length = key1->length < key2->length ? key1->length : key2->length;
+    int result = memcmp(key1->bytes, key2->bytes, (size_t) length);
+
+    if (result != 0) {
+        return result;
+    }
+
+    return key1->length - key2->length;
+}
+
+static int isPrefix(const unsigned char *prefix, int prefixLength,
+                    const TestKey *key)
+{
+    return prefixLength <= key->length
+        && memcmp(prefix, key->bytes, (size_t) prefixLength) == 0;
+}
+
+static void appendRandom(TestKey *key, int count, int binary)
+{
+    static const char alphabet[] = "abcd";
+
+    while (count-- > 0 && key->length < MAX_KEY_LENGTH) {
+        key->bytes[key->length++] = binary
+            ? (unsigned char) randomBelow(256)
+            : (unsigned char) alphabet[randomBelow(sizeof(alphabet) - 1)];
+    }
+}
+
+/* Build the pool.  Most keys extend part of an earlier key, so long
+ * shared prefixes and keys which are prefixes of others are common. */
+
+static void generateKeys(void)
+{
+    TestKey *key;
+    unsigned int count;
+    unsigned int i;
+
+    for (count=0; count<MAX_KEYS; ++count) {
+        key = &keys[count];
+        key->length = 0;
+
+        if (count > 0 && randomBelow(4) != 0) {
+            *key = keys[randomBelow(count)];
+            key->length = (int) randomBelow((unsigned int) key->length + 1);
+        }
+
+        appendRandom(key, (int) randomBelow(20), randomBelow(4) == 0);
+    }
+
+    qsort(keys, MAX_KEYS, sizeof(TestKey), compareKeys);
+
+    numKeys = 1;
+
+    for (i=1; i<MAX_KEYS; ++i) {
+        if (compareKeys(&keys[i], &keys[numKeys - 1]) != 0) {
+            keys[numKeys++] = keys[i];
+        }
+    }
+
+    for (i=0; i<numKeys; ++i) {
+        keys[i].bytes[keys[i].length] = '\0';
+    }
+}
+
+/* Keys without a NUL byte can also go through the string functions */
+
+static int useString(const TestKey *key)
+{
+    return memchr(key->bytes, 0, (size_t) key->length) == NULL
+        && randomBelow(2) != 0;
+}
+
+static int insertKey(Trie *trie, unsigned int index, TrieValue value)
+{
+    TestKey *key = &keys[index];
+
+    if (useString(key)) {
+        return trie_insert(trie, (char *) key->bytes, value);
+    }
+
+    return trie_insertBinary(trie, key->bytes, key->length, value);
+}
+
+static int removeKey(Trie *trie, unsigned int index)
+{
+    TestKey *key = &keys[index];
+
+    if (useString(key)) {
+        return trie_remove(trie, (char *) key->bytes);
+    }
+
+    return trie_removeBinary(trie, key->bytes, key->length);
+}
+
+static TrieValue lookupKey(Trie *trie, const TestKey *key)
+{
+    if (useString(key)) {
+        return trie_lookup(trie, (char *) key->bytes);
+    }
+
+    return trie_lookupBinary(trie, (unsigned char *) key->bytes,
+                             key->length);
+}
+
+static TrieValue expectedValue(unsigned int index)
+{
+    return model[index] < 0 ? TRIE_NULL : &values[model[index]];
+}
+
+static int iterateCallback(unsigned char *key,
+                           int keyLength,
+                           TrieValue value,
+                           void *context)
+{
+    IterateCheck *check = context;
+    unsigned int index;
+
+    if (check->position >= check->numExpected) {
+        check->failed = 1;
+
+        return 0;
+    }
+
+    index = check->expected[check->position++];
+
+    if (keyLength != keys[index].length
+     || memcmp(key, keys[index].bytes, (size_t) keyLength) != 0
+     || key[keyLength] != '\0'
+     || value != expectedValue(index)) {
+        check->failed = 1;
+
+        return 0;
+    }
+
+    return check->position < check->limit;
+}
+
+/* Check the keys visited for a prefix against the sorted pool */
+
+static int checkIteratePrefix(Trie *trie, TestKey *prefix)
+{
+    static unsigned int expected[MAX_KEYS];
+    IterateCheck check;
+    unsigned int i;
+
+    check.numExpected = 0;
+
+    for (i=0; i<numKeys; ++i) {
+        if (model[i] >= 0
+         && isPrefix(prefix->bytes, prefix->length, &keys[i])) {
+            expected[check.numExpected++] = i;
+        }
+    }
+
+    /* Sometimes stop the iteration part way through */
+
+    check.expected = expected;
+    check.position = 0;
+    check.limit = randomBelow(4) == 0 ? randomBelow(check.numExpected + 1)
+                                      : check.numExpected;
+    check.failed = 0;
+
+    if (check.limit == 0) {
+        check.limit = 1;
+    }
+
+    if (useString(prefix)) {
+        trie_iteratePrefix(trie, (char *) prefix->bytes,
+                           iterateCallback, &check);
+    } else {
+        trie_iteratePrefixBinary(trie, prefix->bytes, prefix->length,
+                                 iterateCallback, &check);
+    }
+
+    CHECK(!check.failed);
+    CHECK(check.position == (check.limit < check.numExpected
+                             ? check.limit : check.numExpected));
+
+    return 1;
+}
+
+/* Check the longest present key which is a prefix of a string */
+
+static int checkLongestPrefix(Trie *trie, TestKey *query)
+{
+    TrieValue expected = TRIE_NULL;
+    TrieValue value;
+    int longest = -1;
+    unsigned int i;
+
+    for (i=0; i<numKeys; ++i) {
+        if (model[i] >= 0 && keys[i].length > longest
+         && isPrefix(keys[i].bytes, keys[i].length, query)) {
+            longest = keys[i].length;
+            expected = expectedValue(i);
+        }
+    }
+
+    if (useString(query)) {
+        value = trie_longestPrefix(trie, (char *) query->bytes);
+    } else {
+        value = trie_longestPrefixBinary(trie, query->bytes, query->length);
+    }
+
+    CHECK(value == expected);
+
+    return 1;
+}
+
+static int checkTrie(Trie *trie)
+{
+    TestKey query;
+    unsigned int i;
+
+    CHECK(trie_numEntries(trie) == modelEntries);
+    CHECK(trie_memoryUsage(trie) == allocatedBytes);
+
+    for (i=0; i<numKeys; ++i) {
+        CHECK(lookupKey(trie, &keys[i]) == expectedValue(i));
+    }
+
+    /* Queries are keys from the pool, cut short or extended */
+
+    for (i=0; i<100; ++i) {
+        query = keys[randomBelow(numKeys)];
+
+        if (randomBelow(2)) {
+            query.length = (int) randomBelow((unsigned int) query.length + 1);
+        } else {
+            appendRandom(&query, (int) randomBelow(8), randomBelow(2));
+        }
+
+        query.bytes[query.length] = '\0';
+
+        if (!checkLongestPrefix(trie, &query)
+         || !checkIteratePrefix(trie, &query)) {
+            return 0;
+        }
+    }
+
+    query.length = 0;
+    query.bytes[0] = '\0';
+
+    return checkIteratePrefix(trie, &query);
+}
+
+/* Grow one node through every size by adding a child for each byte
+ * under a prefix longer than a node stores, then shrink it again */
+
+static int checkNodeSizes(Trie *trie)
+{
+    static const char base[] = "a prefix longer than eight bytes";
+    unsigned char order[256];
+    TestKey prefix;
+    TestKey key;
+    size_t emptyUsage;
+    unsigned int count;
+    unsigned int i;
+    unsigned int j;
+    unsigned char swap;
+
+    for (i=0; i<numKeys; ++i) {
+        if (model[i] >= 0) {
+            CHECK(removeKey(trie, i));
+            model[i] = -1;
+            --modelEntries;
+        }
+    }
+
+    CHECK(trie_numEntries(trie) == 0);
+    emptyUsage = trie_memoryUsage(trie);
+
+    /* The pool is replaced by the base key and one key for each byte
+     * after it, in a random order */
+
+    numKeys = 257;
+    keys[0].length = (int) strlen(base);
+    memcpy(keys[0].bytes, base, sizeof(base));
+
+    for (i=0; i<256; ++i) {
+        keys[i + 1] = keys[0];
+        keys[i + 1].bytes[keys[0].length] = (unsigned char) i;
+        keys[i + 1].length = keys[0].length + 1;
+        keys[i + 1].bytes[keys[i + 1].length] = '\0';
+        order[i] = (unsigned char) i;
+    }
+
+    for (i=255; i>0; --i) {
+        j = randomBelow(i + 1);
+        swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    prefix = keys[0];
+
+    CHECK(trie_insert(trie, (char *) keys[0].bytes, &values[0]));
+    model[0] = 0;
+    ++modelEntries;
+
+    for (count=1; count<=256; ++count) {
+        i = order[count - 1] + 1u;
+
+        CHECK(insertKey(trie, i, &values[i % NUM_VALUES]));
+        model[i] = (int) (i % NUM_VALUES);
+        ++modelEntries;
+
+        for (j=0; j<numKeys; ++j) {
+            CHECK(lookupKey(trie, &keys[j]) == expectedValue(j));
+        }
+
+        if (!checkIteratePrefix(trie, &prefix)) {
+            return 0;
+        }
+    }
+
+    if (!checkTrie(trie)) {
+        return 0;
+    }
+
+    /* A key one byte past each child is not in the trie, but its
+     * longest prefix is */
+
+    for (i=1; i<numKeys; ++i) {
+        key = keys[i];
+        appendRandom(&key, 1, 1);
+        key.bytes[key.length] = '\0';
+
+        CHECK(lookupKey(trie, &key) == TRIE_NULL);
+
+        if (!checkLongestPrefix(trie, &key)) {
+            return 0;
+        }
+    }
+
+    for (count=256; count>0; --count) {
+        i = order[count - 1] + 1u;
+
+        CHECK(removeKey(trie, i));
+        CHECK(!removeKey(trie, i));
+        model[i] = -1;
+        --modelEntries;
+
+        for (j=0; j<numKeys; ++j) {
+            CHECK(lookupKey(trie, &keys[j]) == expectedValue(j));
+        }
+
+        if (!checkIteratePrefix(trie, &prefix)) {
+            return 0;
+        }
+    }
+
+    CHECK(trie_remove(trie, (char *) keys[0].bytes));
+    model[0] = -1;
+    --modelEntries;
+
+    CHECK(trie_numEntries(trie) == 0);
+    CHECK(trie_memoryUsage(trie) == emptyUsage);
+    CHECK(trie_memoryUsage(trie) == allocatedBytes);
+
+    return 1;
+}
+
+static int runTest(int slab)
+{
+    Trie *trie;
+    TrieValue value;
+    unsigned int checkInterval;
+    unsigned int poolSize;
+    unsigned int index;
+    unsigned int valueIndex;
+    unsigned int i;
+    int removed;
+
+    sprintf(testName, "trie slab=%d", slab);
+    operation = 0;
+    allocatedBytes = 0;
+
+    generateKeys();
+    poolSize = numKeys;
+
+    for (i=0; i<numKeys; ++i) {
+        model[i] = -1;
+    }
+
+    modelEntries = 0;
+
+    trie = trie_newWithAllocator(&countingAllocator);
+
+    CHECK(trie != NULL);
+
+    if (slab) {
+        CHECK(trie_useSlab(trie));
+    }
+
+    checkInterval = numOperations / 8 + 1;
+
+    for (operation=1; operation<=numOperations; ++operation) {
+        index = randomBelow(numKeys);
+        valueIndex = randomBelow(NUM_VALUES);
+
+        switch (randomBelow(3)) {
+        case 0:
+
+            /* Inserting an existing key replaces its value */
+
+            CHECK(insertKey(trie, index, &values[valueIndex]));
+
+            if (model[index] < 0) {
+                ++modelEntries;
+            }
+
+            model[index] = (int) valueIndex;
+            break;
+
+        case 1:
+            removed = removeKey(trie, index);
+
+            CHECK(removed == (model[index] >= 0));
+
+            if (removed) {
+                model[index] = -1;
+                --modelEntries;
+            }
+            break;
+
+        default:
+            value = lookupKey(trie, &keys[index]);
+
+            CHECK(value == expectedValue(index));
+            break;
+        }
+
+        CHECK(trie_numEntries(trie) == modelEntries);
+
+        if (operation % checkInterval == 0 && !checkTrie(trie)) {
+            return 0;
+        }
+    }
+
+    if (!checkTrie(trie) || !checkNodeSizes(trie)) {
+        return 0;
+    }
+
+    trie_free(trie);
+
+    CHECK(allocatedBytes == 0);
+
+    printf("%-20s ok (%u keys)\n", testName, poolSize);
+
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int i;
+    int success = 1;
+
+    if (argc > 1) {
+        numOperations = (unsigned int) atoi(argv[1]);
+    }
+
+    if (argc > 2) {
+        randomState = (uint64_t) atoi(argv[2]);
+    }
+
+    if (numOperations < 1 || numOperations > 100000000) {
+        fprintf(stderr, "numOperations must be from 1 to 100000000\n");
+
+        return 1;
+    }
+
+    if (randomState == 0) {
+        fprintf(stderr, "seed must not be zero\n");
+
+        return 1;
+    }
+
+    for (i=0; i<NUM_VALUES; ++i) {
+        values[i] = (int) i;
+    }
+
+    printf("%u operations per run\n", numOperations);
+
+    success &= runTest(0);
+    success &= runTest(1);
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,582 @@
+/* Test of TTLCache expiry, using a fake clock.
+ *
+ * Usage: ttlcachetest [numEntries [seed]]
+ *
+ * Entries are given times to live on every level of the timer wheel,
+ * on both sides of each level's reach, and beyond the reach of the top
+ * level.  The clock is then stepped to one millisecond before and
+ * exactly at each expiry time: an entry must still be found just
+ * before it is due, and a sweep at the due time must remove exactly the
+ * entries which are due.  The same is checked for expiry found by
+ * ttlcache_get, for entries whose time to live is restarted by a new
+ * put, for sweeps limited to a number of entries per shard, and for a
+ * cache of several shards whose clock jumps forward by random amounts.
+ * Eviction of the least recently used entry of a full shard is checked
+ * too.  The free functions must be called once for each entry the cache
+ * lets go of, and the memory the cache reports must match what its
+ * allocator handed out. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dscompareint.h"
+#include "dshashint.h"
+#include "dsttlcache.h"
+
+#define MAX_ENTRIES 20000
+
+/* Stop the current test, reporting where it failed */
+
+#define CHECK(condition)                                                 \
+    do {                                                                 \
+        if (!(condition)) {                                              \
+            fprintf(stderr, "%s: time %llu: line %d: %s\n",              \
+                    testName, (unsigned long long) fakeTime, __LINE__,   \
+                    #condition);                                         \
+            return 0;                                                    \
+        }                                                                \
+    } while (0)
+
+static unsigned int numEntries = 5000;
+static uint64_t randomState = 1;
+
+static const char *testName;
+
+/* The time read by the cache, in milliseconds.  It starts away from any
+ * multiple of the wheel's slot sizes. */
+
+static uint64_t fakeTime;
+
+static int keys[MAX_ENTRIES];
+
+/* Expiry time of each key, 0 if it never expires, or UINT64_MAX if it
+ * is not in the cache */
+
+static uint64_t expiry[MAX_ENTRIES];
+
+static unsigned long valuesFreed;
+static size_t allocatedBytes;
+
+static uint64_t nextRandom(void)
+{
+    /* xorshift64* */
+
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static uint64_t fakeClock(void *context)
+{
+    (void) context;
+
+    return fakeTime;
+}
+
+static void valueFree(void *value)
+{
+    (void) value;
+
+    ++valuesFreed;
+}
+
+static HashTableValue copyValue(HashTableValue value, void *context)
+{
+    (void) context;
+
+    return value;
+}
+
+/* Entries are allocated by several shards, but only one thread uses
+ * the cache here */
+
+static void *countingAllocate(void *context, size_t size)
+{
+    void *block = malloc(size);
+
+    (void) context;
+
+    if (block != NULL) {
+        allocatedBytes += size;
+    }
+
+    return block;
+}
+
+static void countingRelease(void *context, void *block, size_t size)
+{
+    (void) context;
+
+    allocatedBytes -= size;
+    free(block);
+}
+
+static const Allocator countingAllocator = {
+    countingAllocate, NULL, countingRelease, NULL, NULL
+};
+
+/* A time to live anywhere within a random level of the wheel, which
+ * has 64 slots per level and 1 ms ticks, or past the top level */
+
+static uint64_t randomTTL(void)
+{
+    unsigned int level = (unsigned int) (nextRandom() % 6);
+
+    return 1 + nextRandom() % (UINT64_C(1) << (6 * level + 6));
+}
+
+/* The first keys get times to live either side of the reach of each
+ * level, and the rest random ones */
+
+static uint64_t pickTTL(unsigned int i)
+{
+    static const uint64_t edges[] = {
+        1, 2, 63, 64, 65,
+        4095, 4096, 4097,
+        262143, 262144, 262145,
+        16777215, 16777216, 16777217,
+        1073741823, 1073741824, 1073741825,
+        4000000000ULL
+    };
+
+    if (i < sizeof(edges) / sizeof(*edges)) {
+        return edges[i];
+    }
+
+    return randomTTL();
+}
+
+static TTLCache *newCache(unsigned int numShards, unsigned int capacity)
+{
+    TTLCache *cache;
+
+    /* A failed test leaves its cache allocated, so the counts start
+     * again */
+
+    valuesFreed = 0;
+    allocatedBytes = 0;
+
+    cache = ttlcache_newWithAllocator(intHash, intEqual, numShards, capacity,
+                                      &countingAllocator);
+
+    if (cache != NULL) {
+        ttlcache_registerFreeFunctions(cache, NULL, valueFree);
+        ttlcache_setClock(cache, fakeClock, NULL);
+    }
+
+    return cache;
+}
+
+static int freeCache(TTLCache *cache, unsigned long expectedFreed)
+{
+    expectedFreed += ttlcache_numEntries(cache);
+
+    ttlcache_free(cache);
+
+    CHECK(valuesFreed == expectedFreed);
+    CHECK(allocatedBytes == 0);
+
+    printf("%-28s ok\n", testName);
+
+    return 1;
+}
+
+static int compareTimes(const void *location1, const void *location2)
+{
+    uint64_t time1 = *(const uint64_t *) location1;
+    uint64_t time2 = *(const uint64_t *) location2;
+
+    return time1 < time2 ? -1 : time1 > time2;
+}
+
+/* Number of keys which are due by the current time, which are then
+ * marked as gone */
+
+static unsigned int takeDue(unsigned int count)
+{
+    unsigned int due = 0;
+    unsigned int i;
+
+    for (i=0; i<count; ++i) {
+        if (expiry[i] != 0 && expiry[i] != UINT64_MAX
+         && expiry[i] <= fakeTime) {
+            expiry[i] = UINT64_MAX;
+            ++due;
+        }
+    }
+
+    return due;
+}
+
+static int checkLive(TTLCache *cache, unsigned int count)
+{
+    unsigned int live = 0;
+    unsigned int i;
+
+    for (i=0; i<count; ++i) {
+        if (expiry[i] != UINT64_MAX) {
+            CHECK(ttlcache_getCopy(cache, &keys[i], copyValue, NULL)
+                  == &keys[i]);
+            ++live;
+        }
+    }
+
+    CHECK(ttlcache_numEntries(cache) == live);
+    CHECK(ttlcache_memoryUsage(cache) == allocatedBytes);
+
+    return 1;
+}
+
+/* Step to just before and exactly at each expiry time, sweeping at
+ * each.  Nothing may go early, and everything due must go on time. */
+
+static int testSweepExact(void)
+{
+    static uint64_t times[MAX_ENTRIES];
+    TTLCache *cache;
+    unsigned long removed = 0;
+    unsigned int count;
+    unsigned int i;
+
+    testName = "exact expiry by sweep";
+    fakeTime = 1000003;
+    cache = newCache(1, 0);
+
+    CHECK(cache != NULL);
+
+    for (i=0; i<numEntries; ++i) {
+        expiry[i] = fakeTime + pickTTL(i);
+        times[i] = expiry[i];
+
+        CHECK(ttlcache_put(cache, &keys[i], &keys[i], expiry[i] - fakeTime));
+    }
+
+    qsort(times, numEntries, sizeof(uint64_t), compareTimes);
+
+    for (i=0; i<numEntries; ++i) {
+        if (i > 0 && times[i] == times[i - 1]) {
+            continue;
+        }
+
+        fakeTime = times[i] - 1;
+
+        CHECK(ttlcache_sweep(cache, 0) == 0);
+
+        /* Only check every entry now and again, as it is slow */
+
+        if (i % 64 == 0 && !checkLive(cache, numEntries)) {
+            return 0;
+        }
+
+        fakeTime = times[i];
+        count = takeDue(numEntries);
+
+        CHECK(count > 0);
+        CHECK(ttlcache_sweep(cache, 0) == count);
+        CHECK(ttlcache_numEntries(cache) == numEntries - removed - count);
+
+        removed += count;
+    }
+
+    CHECK(ttlcache_numEntries(cache) == 0);
+
+    return freeCache(cache, removed);
+}
+
+/* An expired entry is found and removed by a lookup */
+
+static int testGetExact(void)
+{
+    TTLCacheStats stats;
+    TTLCache *cache;
+    unsigned long removed = 0;
+    unsigned int count = numEntries < 2000 ? numEntries : 2000;
+    unsigned int i;
+
+    testName = "exact expiry by get";
+    fakeTime = 7777777;
+    cache = newCache(4, 0);
+
+    CHECK(cache != NULL);
+
+    for (i=0; i<count; ++i) {
+        expiry[i] = fakeTime + pickTTL(i);
+
+        CHECK(ttlcache_put(cache, &keys[i], &keys[i], expiry[i] - fakeTime));
+    }
+
+    /* Expiry times are far apart, so visit the keys in order of their
+     * expiry, stepping the clock forward each time */
+
+    for (;;) {
+        uint64_t next = UINT64_MAX;
+
+        for (i=0; i<count; ++i) {
+            if (expiry[i] != UINT64_MAX && expiry[i] < next) {
+                next = expiry[i];
+            }
+        }
+
+        if (next == UINT64_MAX) {
+            break;
+        }
+
+        fakeTime = next - 1;
+
+        for (i=0; i<count; ++i) {
+            if (expiry[i] == next) {
+                CHECK(ttlcache_get(cache, &keys[i]) == &keys[i]);
+            }
+        }
+
+        fakeTime = next;
+
+        for (i=0; i<count; ++i) {
+            if (expiry[i] == next) {
+                CHECK(ttlcache_get(cache, &keys[i]) == HASH_TABLE_NULL);
+                CHECK(!ttlcache_remove(cache, &keys[i]));
+                expiry[i] = UINT64_MAX;
+                ++removed;
+            }
+        }
+
+        CHECK(ttlcache_numEntries(cache) == count - removed);
+    }
+
+    ttlcache_stats(cache, &stats);
+
+    CHECK(stats.expirations == removed);
+    CHECK(stats.misses == removed);
+    CHECK(stats.hits == removed);
+    CHECK(valuesFreed == removed);
+
+    return freeCache(cache, removed);
+}
+
+/* A new put restarts the time to live, from any level to any other, or
+ * makes the entry never expire */
+
+static int testRestart(void)
+{
+    TTLCache *cache;
+    unsigned long removed = 0;
+    unsigned int count = numEntries < 1000 ? numEntries : 1000;
+    unsigned int i;
+    uint64_t lastExpiry = 0;
+    uint64_t ttl;
+
+    testName = "restarted time to live";
+    fakeTime = 123456789;
+    cache = newCache(2, 0);
+
+    CHECK(cache != NULL);
+
+    for (i=0; i<count; ++i) {
+        CHECK(ttlcache_put(cache, &keys[i], &keys[i], pickTTL(i)));
+    }
+
+    /* A little later, put every key again with a new time to live */
+
+    fakeTime += 50;
+
+    for (i=0; i<count; ++i) {
+        ttl = i % 10 == 0 ? TTL_CACHE_NO_EXPIRY : pickTTL(count - i);
+        expiry[i] = ttl == TTL_CACHE_NO_EXPIRY ? 0 : fakeTime + ttl;
+
+        CHECK(ttlcache_put(cache, &keys[i], &keys[i], ttl));
+
+        if (expiry[i] > lastExpiry) {
+            lastExpiry = expiry[i];
+        }
+    }
+
+    /* The value put is the same one, so it is not freed */
+
+    CHECK(valuesFreed == 0);
+
+    /* Jump through the old and new expiry times */
+
+    while (fakeTime < lastExpiry) {
+        fakeTime += 1 + nextRandom() % (UINT64_C(1) << (nextRandom() % 32));
+
+        i = takeDue(count);
+        CHECK(ttlcache_sweep(cache, 0) == i);
+        removed += i;
+
+        if (!checkLive(cache, count)) {
+            return 0;
+        }
+    }
+
+    CHECK(ttlcache_numEntries(cache) == (count + 9) / 10);
+
+    return freeCache(cache, removed);
+}
+
+/* A sweep limited per shard leaves the rest for later sweeps */
+
+static int testSweepBudget(void)
+{
+    TTLCache *cache;
+    unsigned int count = numEntries < 1000 ? numEntries : 1000;
+    unsigned int swept = 0;
+    unsigned int result;
+    unsigned int i;
+
+    testName = "sweep budget";
+    fakeTime = 5000;
+    cache = newCache(1, 0);
+
+    CHECK(cache != NULL);
+
+    for (i=0; i<count; ++i) {
+        CHECK(ttlcache_put(cache, &keys[i], &keys[i], 100 + i % 3));
+    }
+
+    fakeTime += 200;
+
+    do {
+        result = ttlcache_sweep(cache, 64);
+
+        CHECK(result <= 64);
+        swept += result;
+        CHECK(ttlcache_numEntries(cache) == count - swept);
+    } while (result > 0);
+
+    CHECK(swept == count);
+
+    return freeCache(cache, count);
+}
+
+/* Several shards, with random times to live and random steps of the
+ * clock, sometimes large enough to pass many expiry times at once */
+
+static int testRandomSteps(void)
+{
+    TTLCache *cache;
+    unsigned long removed = 0;
+    unsigned int count;
+    unsigned int step;
+    unsigned int i;
+    uint64_t ttl;
+
+    testName = "random steps, 8 shards";
+    fakeTime = 999999937;
+    cache = newCache(8, 0);
+
+    CHECK(cache != NULL);
+
+    for (i=0; i<numEntries; ++i) {
+        expiry[i] = UINT64_MAX;
+    }
+
+    for (step=0; step<2000; ++step) {
+
+        /* Put a few keys, some of them already in the cache */
+
+        for (count=0; count<10; ++count) {
+            i = (unsigned int) (nextRandom() % numEntries);
+            ttl = nextRandom() % 8 == 0 ? TTL_CACHE_NO_EXPIRY
+                                        : randomTTL();
+
+            expiry[i] = ttl == TTL_CACHE_NO_EXPIRY ? 0 : fakeTime + ttl;
+
+            CHECK(ttlcache_put(cache, &keys[i], &keys[i], ttl));
+        }
+
+        fakeTime += nextRandom() % (UINT64_C(1) << (nextRandom() % 28));
+
+        count = takeDue(numEntries);
+
+        CHECK(ttlcache_sweep(cache, 0) == count);
+        removed += count;
+
+        if (step % 100 == 0 && !checkLive(cache, numEntries)) {
+            return 0;
+        }
+    }
+
+    CHECK(valuesFreed == removed);
+
+    return freeCache(cache, removed);
+}
+
+/* A full shard evicts its least recently used entry */
+
+static int testEviction(void)
+{
+    TTLCacheStats stats;
+    TTLCache *cache;
+    unsigned int i;
+
+    testName = "eviction";
+    fakeTime = 1;
+    cache = newCache(1, 16);
+
+    CHECK(cache != NULL);
+
+    for (i=0; i<16; ++i) {
+        CHECK(ttlcache_put(cache, &keys[i], &keys[i], 1000));
+    }
+
+    /* Using key 0 makes key 1 the least recently used */
+
+    CHECK(ttlcache_get(cache, &keys[0]) == &keys[0]);
+    CHECK(ttlcache_put(cache, &keys[16], &keys[16], 1000));
+
+    CHECK(ttlcache_numEntries(cache) == 16);
+    CHECK(ttlcache_get(cache, &keys[0]) == &keys[0]);
+    CHECK(ttlcache_get(cache, &keys[1]) == HASH_TABLE_NULL);
+    CHECK(ttlcache_get(cache, &keys[16]) == &keys[16]);
+
+    ttlcache_stats(cache, &stats);
+
+    CHECK(stats.evictions == 1);
+    CHECK(valuesFreed == 1);
+
+    return freeCache(cache, 1);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int i;
+    int success = 1;
+
+    if (argc > 1) {
+        numEntries = (unsigned int) atoi(argv[1]);
+    }
+
+    if (argc > 2) {
+        randomState = (uint64_t) atoi(argv[2]);
+    }
+
+    if (numEntries < 32 || numEntries > MAX_ENTRIES) {
+        fprintf(stderr, "numEntries must be from 32 to %d\n", MAX_ENTRIES);
+
+        return 1;
+    }
+
+    if (randomState == 0) {
+        fprintf(stderr, "seed must not be zero\n");
+
+        return 1;
+    }
+
+    for (i=0; i<MAX_ENTRIES; ++i) {
+        keys[i] = (int) i;
+    }
+
+    printf("%u entries\n", numEntries);
+
+    success &= testSweepExact();
+    success &= testGetExact();
+    success &= testRestart();
+    success &= testSweepBudget();
+    success &= testRandomSteps();
+    success &= testEviction();
+
+    return success ? 0 : 1;
+}